@@ -0,0 +1,270 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file CipherPipeline.cpp
+//-----------------------------------------------------------------------------
+
+#include "CipherPipeline.h"
+#include "PWSrand.h"
+#include "Util.h"
+#include "crypto/Fish.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+  const size_t ALIGNMENT = 4096;
+  const int NCHUNKS = 3; // one each for the reader, the cipher & the writer
+  const size_t MIN_SEGMENT = 64 * 1024; // not worth a thread for less
+
+  // Hands chunks from one stage to the next. Once closed (on failure),
+  // Pop() returns nullptr, so that all stages give up.
+  template <typename T>
+  class HandOff
+  {
+  public:
+    void Push(T *p)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(p);
+      }
+      m_cv.notify_one();
+    }
+
+    T *Pop()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] {return m_bClosed || !m_queue.empty();});
+      if (m_bClosed)
+        return nullptr;
+      T *p = m_queue.front();
+      m_queue.pop_front();
+      return p;
+    }
+
+    void Close()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bClosed = true;
+      }
+      m_cv.notify_all();
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<T *> m_queue;
+    bool m_bClosed = false;
+  };
+
+  void XorBlock(unsigned char *block, const unsigned char *cbc, unsigned BS)
+  {
+    for (unsigned i = 0; i < BS; i++)
+      block[i] ^= cbc[i];
+  }
+}
+
+struct CipherPipeline::Chunk {
+  unsigned char *data = nullptr; // m_bufferSize + BS, for padding
+  size_t len = 0;    // read
+  size_t outlen = 0; // to be written
+  bool bLast = false;
+};
+
+CipherPipeline::CipherPipeline(const Fish *fish, unsigned char *cbcbuffer,
+                               size_t bufferSize, unsigned nThreads)
+  : m_fish(fish), m_cbcbuffer(cbcbuffer), m_BS(fish->GetBlockSize()),
+    m_nThreads(nThreads), m_nThreadsUsed(0), m_nBytes(0)
+{
+  // A whole number of pages, which is also a whole number of blocks
+  m_bufferSize = roundUp(std::max(bufferSize, ALIGNMENT), ALIGNMENT);
+  if (m_nThreads == 0)
+    m_nThreads = std::max(1U, std::thread::hardware_concurrency());
+}
+
+bool CipherPipeline::Encrypt(FILE *in, FILE *out)
+{
+  return Run(in, out, true, 0);
+}
+
+bool CipherPipeline::Decrypt(FILE *in, FILE *out, ulong64 length)
+{
+  return Run(in, out, false, length);
+}
+
+bool CipherPipeline::Run(FILE *in, FILE *out, bool bEncrypt, ulong64 length)
+{
+  m_nBytes = 0;
+  m_nThreadsUsed = 1;
+
+  // When decrypting, we know how much to read and write.
+  // An empty 8 byte block cipher record still has one block, see _writecbcRest.
+  ulong64 ctLeft = (length + m_BS - 1) / m_BS * m_BS;
+  if (ctLeft == 0 && m_BS == 8)
+    ctLeft = m_BS;
+  ulong64 ptLeft = length;
+
+  Chunk chunks[NCHUNKS];
+  HandOff<Chunk> empty, full, done;
+  for (auto &chunk : chunks) {
+    chunk.data = static_cast<unsigned char *>(
+      ::operator new(m_bufferSize + m_BS, std::align_val_t(ALIGNMENT)));
+    empty.Push(&chunk);
+  }
+
+  std::atomic<bool> bFailed(false);
+  std::atomic<int> error(0); // errno is per thread
+  auto fail = [&](int err) {
+    error = err;
+    bFailed = true;
+    empty.Close(); full.Close(); done.Close();
+  };
+
+  std::thread reader([&]() {
+    Chunk *chunk;
+    while ((chunk = empty.Pop()) != nullptr) {
+      size_t want = m_bufferSize;
+      if (!bEncrypt && ctLeft < want)
+        want = static_cast<size_t>(ctLeft);
+      chunk->len = (want == 0) ? 0 : fread(chunk->data, 1, want, in);
+      if (ferror(in)) {
+        fail(errno);
+        return;
+      }
+      if (bEncrypt) {
+        chunk->bLast = chunk->len < want;
+      } else {
+        if (chunk->len != want) { // truncated ciphertext
+          fail(0);
+          return;
+        }
+        ctLeft -= want;
+        chunk->bLast = (ctLeft == 0);
+      }
+      const bool bLast = chunk->bLast;
+      full.Push(chunk);
+      if (bLast)
+        return;
+    }
+  });
+
+  std::thread writer([&]() {
+    Chunk *chunk;
+    while ((chunk = done.Pop()) != nullptr) {
+      if (chunk->outlen > 0 &&
+          fwrite(chunk->data, 1, chunk->outlen, out) != chunk->outlen) {
+        fail(EIO); // as _writecbc* do
+        return;
+      }
+      const bool bLast = chunk->bLast;
+      empty.Push(chunk);
+      if (bLast)
+        return;
+    }
+  });
+
+  Chunk *chunk;
+  while ((chunk = full.Pop()) != nullptr) {
+    if (bEncrypt) {
+      EncryptChunk(*chunk);
+      m_nBytes += chunk->len;
+    } else {
+      DecryptChunk(*chunk);
+      chunk->outlen = static_cast<size_t>(std::min(ptLeft, ulong64(chunk->len)));
+      ptLeft -= chunk->outlen;
+      m_nBytes += chunk->outlen;
+    }
+    const bool bLast = chunk->bLast;
+    done.Push(chunk);
+    if (bLast)
+      break;
+  }
+
+  reader.join();
+  writer.join();
+
+  for (auto &chunk : chunks) {
+    trashMemory(chunk.data, m_bufferSize + m_BS);
+    ::operator delete(chunk.data, std::align_val_t(ALIGNMENT));
+  }
+
+  if (bFailed && error != 0)
+    errno = error;
+  return !bFailed;
+}
+
+void CipherPipeline::EncryptChunk(Chunk &chunk)
+{
+  const size_t len = chunk.len;
+  size_t blocks = roundUp(len, m_BS);
+  if (blocks == 0 && m_BS == 8 && m_nBytes == 0)
+    blocks = m_BS; // empty file, bwd compat as in _writecbcRest
+
+  unsigned char *p = chunk.data;
+  for (size_t x = 0; x < blocks; x += m_BS, p += m_BS) {
+    if (len - std::min(len, x) < m_BS) { // uneven (or empty) last block
+      const size_t n = len - std::min(len, x);
+      PWSrand::GetInstance()->GetRandomData(p + n, static_cast<unsigned long>(m_BS - n));
+    }
+    XorBlock(p, m_cbcbuffer, m_BS);
+    m_fish->Encrypt(p, p);
+    memcpy(m_cbcbuffer, p, m_BS);
+  }
+  chunk.outlen = blocks;
+}
+
+void CipherPipeline::DecryptChunk(Chunk &chunk)
+{
+  const size_t len = chunk.len; // a whole number of blocks
+  if (len == 0)
+    return;
+  const size_t nBlocks = len / m_BS;
+  unsigned nSegments = static_cast<unsigned>(
+    std::min(size_t(m_nThreads), std::max(size_t(1), len / MIN_SEGMENT)));
+  const size_t segBlocks = (nBlocks + nSegments - 1) / nSegments;
+  nSegments = static_cast<unsigned>((nBlocks + segBlocks - 1) / segBlocks); // none empty
+  m_nThreadsUsed = std::max(m_nThreadsUsed, nSegments);
+
+  // Each segment's IV is the ciphertext block just before it, so these
+  // have to be saved before anything's decrypted in place
+  std::vector<unsigned char> ivs(nSegments * m_BS);
+  memcpy(ivs.data(), m_cbcbuffer, m_BS);
+  for (unsigned i = 1; i < nSegments; i++)
+    memcpy(&ivs[i * m_BS], chunk.data + i * segBlocks * m_BS - m_BS, m_BS);
+  memcpy(m_cbcbuffer, chunk.data + len - m_BS, m_BS); // for the next chunk
+
+  auto decrypt = [&](unsigned i) {
+    unsigned char *iv = &ivs[i * m_BS];
+    unsigned char ct[16];
+    const size_t end = std::min(len, (i + 1) * segBlocks * m_BS);
+    for (size_t x = i * segBlocks * m_BS; x < end; x += m_BS) {
+      unsigned char *p = chunk.data + x;
+      memcpy(ct, p, m_BS);
+      m_fish->Decrypt(p, p);
+      XorBlock(p, iv, m_BS);
+      memcpy(iv, ct, m_BS);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < nSegments; i++)
+    threads.emplace_back(decrypt, i);
+  decrypt(0); // this thread does its share too
+  for (auto &t : threads)
+    t.join();
+  trashMemory(ivs.data(), ivs.size());
+}
@@ -0,0 +1,74 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// CipherPipeline.h
+//-----------------------------------------------------------------------------
+
+#ifndef __CIPHERPIPELINE_H
+#define __CIPHERPIPELINE_H
+
+#include <cstdio> // for FILE *
+
+#include "../os/typedefs.h"
+
+class Fish;
+
+/**
+ * CipherPipeline streams a file through a block cipher in CBC mode, as
+ * _writecbcRest/_readcbc do, for the file encryption mode (.PSF files).
+ *
+ * A reader thread, the cipher (the calling thread) and a writer thread
+ * each work on a different buffer, so that the disk and the CPU are kept
+ * busy at the same time. Buffers are large and page aligned.
+ *
+ * CBC encryption is inherently serial, but each ciphertext block can be
+ * decrypted independently given the one before it. Decrypt() therefore
+ * splits each buffer between up to nThreads threads.
+ *
+ * The output is identical to that of the block at a time functions,
+ * including the random padding of the last block.
+ */
+
+class CipherPipeline
+{
+public:
+  enum {DEFAULT_BUFSIZE = 4 << 20};
+
+  // cbcbuffer is the IV, updated as for _writecbcRest/_readcbc.
+  // nThreads == 0 means one per processor.
+  CipherPipeline(const Fish *fish, unsigned char *cbcbuffer,
+                 size_t bufferSize = DEFAULT_BUFSIZE, unsigned nThreads = 0);
+
+  // Encrypts the rest of in, until EOF, to out.
+  bool Encrypt(FILE *in, FILE *out);
+  // Decrypts the blocks holding length bytes of plaintext from in to out.
+  bool Decrypt(FILE *in, FILE *out, ulong64 length);
+
+  // For the last Encrypt/Decrypt: plaintext bytes, most threads ciphering
+  ulong64 GetBytesProcessed() const {return m_nBytes;}
+  unsigned GetCipherThreads() const {return m_nThreadsUsed;}
+
+private:
+  struct Chunk;
+  bool Run(FILE *in, FILE *out, bool bEncrypt, ulong64 length);
+  void EncryptChunk(Chunk &chunk);
+  void DecryptChunk(Chunk &chunk);
+
+  const Fish *m_fish;
+  unsigned char *m_cbcbuffer;
+  const unsigned m_BS;
+  size_t m_bufferSize;
+  unsigned m_nThreads;
+  unsigned m_nThreadsUsed;
+  ulong64 m_nBytes;
+};
+
+#endif /* __CIPHERPIPELINE_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -10,7 +10,9 @@
 
 #include "CommandInterface.h"
 #include "Command.h"
+#include "ItemDelta.h"
 #include "PWSprefs.h"
+#include "SearchIndex.h"
 
 #include <algorithm>
 #include <iterator>
@@ -54,6 +56,43 @@ Command::~Command()
 {
 }
 
+static size_t StringsMemoryUsage(const std::vector<StringX> &vsx)
+{
+  size_t usage = vsx.capacity() * sizeof(StringX);
+  for (const auto &sx : vsx)
+    usage += sx.capacity() * sizeof(TCHAR);
+  return usage;
+}
+
+size_t Command::GetMemoryUsage() const
+{
+  return sizeof(*this) + StringsMemoryUsage(m_vSavedModifiedNodes) +
+    StringsMemoryUsage(m_vSavedModifiedEmptyGroups);
+}
+
+void Command::ApplyEntryDelta(const CUUID &entry_uuid, const CItemDelta &delta,
+                              bool bRedo)
+{
+  ItemListIter pos = m_pcomInt->Find(entry_uuid);
+  if (pos == m_pcomInt->GetEntryEndIter())
+    return;
+
+  const CItemData old_ci(pos->second);
+  CItemData new_ci(old_ci);
+  if (bRedo)
+    delta.Redo(new_ci);
+  else
+    delta.Undo(new_ci);
+
+  m_pcomInt->DoReplaceEntry(old_ci, new_ci);
+  // Relative expiry intervals are counted from the password's last change
+  if (delta.Changes(CItemData::PMTIME))
+    m_pcomInt->UpdateExpiryEntry(new_ci);
+
+  m_pcomInt->AddChangedNodes(old_ci.GetGroup());
+  m_pcomInt->AddChangedNodes(new_ci.GetGroup());
+}
+
 void Command::SaveDBInformation()
 {
   // Currently handles only modified nodes and empty groups - could add any other DB
@@ -119,6 +158,15 @@ MultiCommands::~MultiCommands()
            [] (Command *pcmd) {delete pcmd;});
 }
 
+size_t MultiCommands::GetMemoryUsage() const
+{
+  size_t usage = Command::GetMemoryUsage() + sizeof(*this) - sizeof(Command) +
+    m_vpcmds.capacity() * sizeof(Command *) + m_vRCs.capacity() * sizeof(int);
+  for (const auto *pcmd : m_vpcmds)
+    usage += pcmd->GetMemoryUsage();
+  return usage;
+}
+
 Command *MultiCommands::FindCommand(const std::type_info &ti)
 {
   // Initial implementation - search for first command of a specific class
@@ -542,12 +590,31 @@ AddEntryCommand::~AddEntryCommand()
 {
 }
 
+size_t AddEntryCommand::GetMemoryUsage() const
+{
+  return Command::GetMemoryUsage() + m_ci.GetMemoryUsage() + m_att.GetMemoryUsage();
+}
+
 int AddEntryCommand::Execute()
 {
   if (!m_pcomInt->IsReadOnly()) {
     SaveDBInformation();
 
-    m_pcomInt->DoAddEntry(m_ci, &m_att);
+    // If the database already has this attachment, the entry shares it
+    // rather than adding another copy. m_ci is updated to match, for Undo.
+    const CItemAtt *patt = &m_att;
+    if (m_att.HasContent()) {
+      CUUID shared_uuid;
+      if (!m_pcomInt->HasAtt(m_att.GetUUID()) &&
+          m_pcomInt->FindAttByContent(m_att, shared_uuid)) {
+        m_ci.SetAttUUID(shared_uuid);
+        patt = nullptr;
+      } else {
+        m_ci.SetAttUUID(m_att.GetUUID());
+      }
+    }
+
+    m_pcomInt->DoAddEntry(m_ci, patt);
     m_pcomInt->AddChangedNodes(m_ci.GetGroup());
 
     if (m_ci.IsDependent()) {
@@ -566,6 +633,10 @@ int AddEntryCommand::Execute()
       m_pcomInt->AddExpiryEntry(m_ci);
     }
     m_CommandDBChange = DB;
+
+    // Kept for undo/redo only
+    m_ci.ReleaseCipher();
+    m_att.ReleaseCipher();
   }
   return 0;
 }
@@ -581,6 +652,7 @@ void AddEntryCommand::Undo()
 
     DeleteEntryCommand delete_entry_cmd(m_pcomInt, m_ci, this);
     delete_entry_cmd.Execute();
+    m_ci.ReleaseCipher();
 
     RestoreDBInformation();
   }
@@ -636,6 +708,14 @@ DeleteEntryCommand::~DeleteEntryCommand()
 {
 }
 
+size_t DeleteEntryCommand::GetMemoryUsage() const
+{
+  size_t usage = Command::GetMemoryUsage() + m_ci.GetMemoryUsage() + m_att.GetMemoryUsage();
+  for (const auto &ci : m_vdependents)
+    usage += ci.GetMemoryUsage();
+  return usage;
+}
+
 int DeleteEntryCommand::Execute()
 {
   // Get out quick if R-O
@@ -676,6 +756,12 @@ int DeleteEntryCommand::Execute()
   m_pcomInt->RemoveExpiryEntry(m_ci);
 
   m_CommandDBChange = DB;
+
+  // Kept for undo/redo only
+  m_ci.ReleaseCipher();
+  m_att.ReleaseCipher();
+  for (const auto &ci : m_vdependents)
+    ci.ReleaseCipher();
   return 0;
 }
 
@@ -734,6 +820,9 @@ void DeleteEntryCommand::Undo()
 
     // Since not needed for Undo/Redo again - delete it
     delete pmulticmds;
+    m_ci.ReleaseCipher();
+    for (const auto &ci : m_vdependents)
+      ci.ReleaseCipher();
 
     RestoreDBInformation();
   } // R/W & change to undo
@@ -758,6 +847,11 @@ DeleteAttachmentCommand::~DeleteAttachmentCommand()
 {
 }
 
+size_t DeleteAttachmentCommand::GetMemoryUsage() const
+{
+  return Command::GetMemoryUsage() + m_ci.GetMemoryUsage() + m_att.GetMemoryUsage();
+}
+
 int DeleteAttachmentCommand::Execute()
 {
   // Get out quick if R-O
@@ -795,7 +889,8 @@ void DeleteAttachmentCommand::Undo()
 EditEntryCommand::EditEntryCommand(CommandInterface *pcomInt,
                                    const CItemData &old_ci,
                                    const CItemData &new_ci)
-  : Command(pcomInt), m_old_ci(old_ci), m_new_ci(new_ci)
+  : Command(pcomInt), m_entry_uuid(old_ci.GetUUID()),
+    m_old_ci(old_ci), m_new_ci(new_ci), m_pdelta(nullptr)
 {
   // We're only supposed to operate on entries
   // with same uuids, and possibly different fields
@@ -806,6 +901,13 @@ EditEntryCommand::EditEntryCommand(CommandInterface *pcomInt,
 
 EditEntryCommand::~EditEntryCommand()
 {
+  delete m_pdelta;
+}
+
+size_t EditEntryCommand::GetMemoryUsage() const
+{
+  return Command::GetMemoryUsage() + m_old_ci.GetMemoryUsage() + m_new_ci.GetMemoryUsage() +
+    (m_pdelta != nullptr ? m_pdelta->GetMemoryUsage() : 0);
 }
 
 int EditEntryCommand::Execute()
@@ -813,18 +915,25 @@ int EditEntryCommand::Execute()
   if (!m_pcomInt->IsReadOnly()) {
     SaveDBInformation();
 
-    m_pcomInt->DoReplaceEntry(m_old_ci, m_new_ci);
+    if (m_pdelta == nullptr) {
+      m_pcomInt->DoReplaceEntry(m_old_ci, m_new_ci);
 
-    m_pcomInt->AddChangedNodes(m_old_ci.GetGroup());
-    m_pcomInt->AddChangedNodes(m_new_ci.GetGroup());
+      m_pcomInt->AddChangedNodes(m_old_ci.GetGroup());
+      m_pcomInt->AddChangedNodes(m_new_ci.GetGroup());
+
+      // From here on, undo & redo only need what changed
+      m_pdelta = new CItemDelta(m_old_ci, m_new_ci);
+      m_old_ci.Clear(); m_old_ci.ReleaseCipher();
+      m_new_ci.Clear(); m_new_ci.ReleaseCipher();
+    } else
+      ApplyEntryDelta(m_entry_uuid, *m_pdelta, true);
 
     if (m_bNotifyGUI) {
-      const CUUID entry_uuid = m_old_ci.GetUUID();
       // If the entry's group has changed, refresh the entire tree, otherwise, just the entry
       // in the tree and list views
-      UpdateGUICommand::GUI_Action gac = (m_old_ci.GetGroup() != m_new_ci.GetGroup()) ?
+      UpdateGUICommand::GUI_Action gac = m_pdelta->Changes(CItemData::GROUP) ?
         UpdateGUICommand::GUI_REFRESH_TREE : UpdateGUICommand::GUI_REFRESH_ENTRY;
-      m_pcomInt->NotifyGUINeedsUpdating(gac, entry_uuid);
+      m_pcomInt->NotifyGUINeedsUpdating(gac, m_entry_uuid);
     }
 
     m_CommandDBChange = DB;
@@ -835,15 +944,14 @@ int EditEntryCommand::Execute()
 void EditEntryCommand::Undo()
 {
   if (!m_pcomInt->IsReadOnly() && m_CommandDBChange == DB) {
-    m_pcomInt->DoReplaceEntry(m_new_ci, m_old_ci);
+    ApplyEntryDelta(m_entry_uuid, *m_pdelta, false);
 
     if (m_bNotifyGUI) {
-      const CUUID entry_uuid = m_old_ci.GetUUID();
       // If the entry's group has changed, refresh the entire tree, otherwise, just the entry
       // in the tree and list views
-      UpdateGUICommand::GUI_Action gac = (m_old_ci.GetGroup() != m_new_ci.GetGroup()) ?
+      UpdateGUICommand::GUI_Action gac = m_pdelta->Changes(CItemData::GROUP) ?
                 UpdateGUICommand::GUI_REFRESH_TREE : UpdateGUICommand::GUI_REFRESH_ENTRY;
-      m_pcomInt->NotifyGUINeedsUpdating(gac, entry_uuid);
+      m_pcomInt->NotifyGUINeedsUpdating(gac, m_entry_uuid);
     }
 
     RestoreDBInformation();
@@ -856,13 +964,24 @@ void EditEntryCommand::Undo()
 
 EditAttachmentCommand::EditAttachmentCommand(CommandInterface *pcomInt,
   const CItemAtt &old_att,
-  const CItemAtt &new_att)
-  : Command(pcomInt), m_old_att(old_att), m_new_att(new_att)
+  const CItemAtt &new_att,
+  const CItemData *pci)
+  : Command(pcomInt), m_old_att(old_att), m_new_att(new_att),
+    m_entry_uuid(pws_os::CUUID::NullUUID())
 {
   // We're only supposed to operate on entries
   // with same uuids, and possibly different fields
   ASSERT(m_old_att.GetUUID() == m_new_att.GetUUID());
 
+  // Copy on write: other entries sharing the attachment keep it as is
+  if (pci != nullptr && pci->HasAttRef() && pci->GetAttUUID() == m_old_att.GetUUID() &&
+      m_pcomInt->HasAtt(m_old_att.GetUUID()) &&
+      m_pcomInt->GetAtt(m_old_att.GetUUID()).GetRefcount() > 1) {
+    m_entry_uuid = pci->GetUUID();
+    m_new_att.CreateUUID();
+    m_new_att.SetRefcount(1);
+  }
+
   m_CommandChangeType = DB;
 }
 
@@ -870,10 +989,33 @@ EditAttachmentCommand::~EditAttachmentCommand()
 {
 }
 
+size_t EditAttachmentCommand::GetMemoryUsage() const
+{
+  return Command::GetMemoryUsage() + m_old_att.GetMemoryUsage() + m_new_att.GetMemoryUsage();
+}
+
+void EditAttachmentCommand::SetEntryAttUUID(const pws_os::CUUID &attuuid)
+{
+  ItemListIter iter = m_pcomInt->Find(m_entry_uuid);
+  ASSERT(iter != m_pcomInt->GetEntryEndIter());
+  if (iter == m_pcomInt->GetEntryEndIter())
+    return;
+
+  const CItemData old_ci(iter->second);
+  CItemData new_ci(old_ci);
+  new_ci.SetAttUUID(attuuid);
+  m_pcomInt->DoReplaceEntry(old_ci, new_ci);
+}
+
 int EditAttachmentCommand::Execute()
 {
   if (!m_pcomInt->IsReadOnly()) {
-    m_pcomInt->DoReplaceAttachment(m_old_att, m_new_att);
+    if (m_entry_uuid != pws_os::CUUID::NullUUID()) {
+      m_pcomInt->DoAddAttachment(m_new_att);
+      m_pcomInt->DoDeleteAttachment(m_old_att); // only drops the entry's reference
+      SetEntryAttUUID(m_new_att.GetUUID());
+    } else
+      m_pcomInt->DoReplaceAttachment(m_old_att, m_new_att);
 
     m_CommandDBChange = DB;
   }
@@ -883,7 +1025,12 @@ int EditAttachmentCommand::Execute()
 void EditAttachmentCommand::Undo()
 {
   if (!m_pcomInt->IsReadOnly() && m_CommandDBChange == DB) {
-    m_pcomInt->DoReplaceAttachment(m_new_att, m_old_att);
+    if (m_entry_uuid != pws_os::CUUID::NullUUID()) {
+      SetEntryAttUUID(m_old_att.GetUUID());
+      m_pcomInt->DoDeleteAttachment(m_new_att);
+      m_pcomInt->DoAddAttachment(m_old_att); // shared again
+    } else
+      m_pcomInt->DoReplaceAttachment(m_new_att, m_old_att);
   }
 }
 
@@ -895,44 +1042,41 @@ UpdateEntryCommand::UpdateEntryCommand(CommandInterface *pcomInt,
                                        const CItemData &ci,
                                        CItemData::FieldType ftype,
                                        const StringX &value)
-  : Command(pcomInt), m_old_ci(ci), m_ftype(ftype)
+  : Command(pcomInt), m_entry_uuid(ci.GetUUID()), m_ftype(ftype), m_pdelta(nullptr)
 {
   m_CommandChangeType = DB;
 
   m_new_ci.SetFieldValue(ftype, value);
 }
 
-void UpdateEntryCommand::Doit(const CUUID &entry_uuid,
-                              CItemData::FieldType ftype,
-                              const StringX &value,
-                              CItemData::EntryStatus es,
-                              UpdateGUICommand::ExecuteFn efn)
+UpdateEntryCommand::~UpdateEntryCommand()
 {
-  ItemListIter pos = m_pcomInt->Find(entry_uuid);
-  if (pos != m_pcomInt->GetEntryEndIter()) {
-    if (ftype != CItemData::PASSWORD)
-      pos->second.SetFieldValue(ftype, value);
-    else {
-      time_t tttoldXtime;
-      if (efn == UpdateGUICommand::WN_EXECUTE_REDO) {
-        m_old_ci.SetPWHistory(pos->second.GetPWHistory());
-        pos->second.GetXTime(tttoldXtime);
-        m_old_ci.SetXTime(tttoldXtime);
-        pos->second.UpdatePassword(value);
-      } else {
-        pos->second.SetPassword(value);
-        m_old_ci.GetXTime(tttoldXtime);
-        pos->second.SetXTime(tttoldXtime);
-        pos->second.SetPWHistory(m_old_ci.GetPWHistory());
-      }
-    }
-    if (ftype == CItemData::PASSWORD ||
-        ftype == CItemData::XTIME)
-      m_pcomInt->UpdateExpiryEntry(pos->second);
+  delete m_pdelta;
+}
 
-    pos->second.SetStatus(es);
-    m_pcomInt->AddChangedNodes(pos->second.GetGroup());
-  }
+size_t UpdateEntryCommand::GetMemoryUsage() const
+{
+  return Command::GetMemoryUsage() + m_new_ci.GetMemoryUsage() +
+    (m_pdelta != nullptr ? m_pdelta->GetMemoryUsage() : 0);
+}
+
+void UpdateEntryCommand::Doit(CItemData &ci, const StringX &value)
+{
+  if (m_ftype != CItemData::PASSWORD)
+    ci.SetFieldValue(m_ftype, value);
+  else
+    ci.UpdatePassword(value);
+
+  if (m_ftype == CItemData::PASSWORD ||
+      m_ftype == CItemData::XTIME)
+    m_pcomInt->UpdateExpiryEntry(ci);
+
+  if (CSearchIndex::IsIndexedField(m_ftype))
+    m_pcomInt->UpdateSearchIndex(ci);
+
+  ci.SetStatus(CItemData::ES_MODIFIED);
+  m_pcomInt->RefreshEntryMetadata(ci);
+  m_pcomInt->AddChangedNodes(ci.GetGroup());
 }
 
 int UpdateEntryCommand::Execute()
@@ -940,16 +1084,26 @@ int UpdateEntryCommand::Execute()
   if (!m_pcomInt->IsReadOnly()) {
     SaveDBInformation();
 
-    Doit(m_old_ci.GetUUID(), m_ftype, m_new_ci.GetFieldValue(m_ftype),
-         CItemData::ES_MODIFIED, UpdateGUICommand::WN_EXECUTE_REDO);
+    const StringX value = m_new_ci.GetFieldValue(m_ftype);
+    if (m_pdelta == nullptr) {
+      ItemListIter pos = m_pcomInt->Find(m_entry_uuid);
+      if (pos != m_pcomInt->GetEntryEndIter()) {
+        const CItemData old_ci(pos->second);
+        Doit(pos->second, value);
+
+        // From here on, undo & redo only need what changed
+        m_pdelta = new CItemDelta(old_ci, pos->second);
+        m_new_ci.Clear(); m_new_ci.ReleaseCipher();
+      }
+    } else
+      ApplyEntryDelta(m_entry_uuid, *m_pdelta, true);
 
     if (m_bNotifyGUI)
       m_pcomInt->NotifyGUINeedsUpdating(UpdateGUICommand::GUI_REFRESH_ENTRYFIELD,
-                                        m_old_ci.GetUUID(), m_ftype);
+                                        m_entry_uuid, m_ftype);
 
-    if (m_ftype == CItemData::XTIME)
-      m_pcomInt->UpdateExpiryEntry(m_old_ci.GetUUID(), m_ftype,
-                                   m_new_ci.GetFieldValue(m_ftype));
+    if (m_ftype == CItemData::XTIME && !value.empty())
+      m_pcomInt->UpdateExpiryEntry(m_entry_uuid, m_ftype, value);
 
     m_CommandDBChange = DB;
   }
@@ -959,16 +1113,16 @@ int UpdateEntryCommand::Execute()
 void UpdateEntryCommand::Undo()
 {
   if (!m_pcomInt->IsReadOnly() && m_CommandDBChange == DB) {
-    Doit(m_old_ci.GetUUID(), m_ftype, m_old_ci.GetFieldValue(m_ftype),
-         m_old_ci.GetStatus(), UpdateGUICommand::WN_UNDO);
+    if (m_pdelta != nullptr)
+      ApplyEntryDelta(m_entry_uuid, *m_pdelta, false);
 
     if (m_bNotifyGUI)
       m_pcomInt->NotifyGUINeedsUpdating(UpdateGUICommand::GUI_REFRESH_ENTRYFIELD,
-                                        m_old_ci.GetUUID(), m_ftype);
+                                        m_entry_uuid, m_ftype);
   
     RestoreDBInformation();
     if (m_bNotifyGUI) // To update the filter view
-      m_pcomInt->NotifyGUINeedsUpdating(UpdateGUICommand::GUI_REFRESH_ENTRY, m_old_ci.GetUUID());
+      m_pcomInt->NotifyGUINeedsUpdating(UpdateGUICommand::GUI_REFRESH_ENTRY, m_entry_uuid);
   }
 }
 
@@ -979,36 +1133,58 @@ void UpdateEntryCommand::Undo()
 UpdatePasswordCommand::UpdatePasswordCommand(CommandInterface *pcomInt,
                                              const CItemData &ci,
                                              const StringX &sxNewPassword)
-  : Command(pcomInt), m_old_ci(ci)
+  : Command(pcomInt), m_entry_uuid(ci.GetUUID()),
+    m_bChanged(ci.GetPassword() != sxNewPassword), m_pdelta(nullptr)
 {
   m_CommandChangeType = DB;
 
   m_new_ci.SetPassword(sxNewPassword);
+  m_new_ci.ReleaseCipher();
+}
+
+UpdatePasswordCommand::~UpdatePasswordCommand()
+{
+  delete m_pdelta;
+}
+
+size_t UpdatePasswordCommand::GetMemoryUsage() const
+{
+  return Command::GetMemoryUsage() + m_new_ci.GetMemoryUsage() +
+    (m_pdelta != nullptr ? m_pdelta->GetMemoryUsage() : 0);
 }
 
 int UpdatePasswordCommand::Execute()
 {
-  if (!m_pcomInt->IsReadOnly() &&m_old_ci.GetPassword() != m_new_ci.GetPassword()) {
+  if (!m_pcomInt->IsReadOnly() && m_bChanged) {
     SaveDBInformation();
 
-    ItemListIter pos = m_pcomInt->Find(m_old_ci.GetUUID());
-    if (pos != m_pcomInt->GetEntryEndIter()) {
-      pos->second.UpdatePassword(m_new_ci.GetPassword());
-      time_t tttNewXTime, tttOldXTime;
-      pos->second.GetXTime(tttNewXTime);
-      m_old_ci.GetXTime(tttOldXTime);
-      if (tttOldXTime != tttNewXTime) {
-        m_pcomInt->UpdateExpiryEntry(pos->second);
+    if (m_pdelta == nullptr) {
+      ItemListIter pos = m_pcomInt->Find(m_entry_uuid);
+      if (pos != m_pcomInt->GetEntryEndIter()) {
+        const CItemData old_ci(pos->second);
+        pos->second.UpdatePassword(m_new_ci.GetPassword());
+        time_t tttNewXTime, tttOldXTime;
+        pos->second.GetXTime(tttNewXTime);
+        old_ci.GetXTime(tttOldXTime);
+        if (tttOldXTime != tttNewXTime) {
+          m_pcomInt->UpdateExpiryEntry(pos->second);
+        }
+        pos->second.SetStatus(CItemData::ES_MODIFIED);
+        m_pcomInt->RefreshEntryMetadata(pos->second);
+        m_pcomInt->AddChangedNodes(pos->second.GetGroup());
+
+        // From here on, undo & redo only need what changed
+        m_pdelta = new CItemDelta(old_ci, pos->second);
+        m_new_ci.Clear(); m_new_ci.ReleaseCipher();
       }
-      pos->second.SetStatus(CItemData::ES_MODIFIED);
-      m_pcomInt->AddChangedNodes(pos->second.GetGroup());
-    }
+    } else
+      ApplyEntryDelta(m_entry_uuid, *m_pdelta, true);
 
     m_CommandDBChange = DB;
 
     if (m_bNotifyGUI)
       m_pcomInt->NotifyGUINeedsUpdating(UpdateGUICommand::GUI_REFRESH_ENTRYPASSWORD,
-                                        m_old_ci.GetUUID());
+                                        m_entry_uuid);
   }
   return 0;
 }
@@ -1016,19 +1192,12 @@ int UpdatePasswordCommand::Execute()
 void UpdatePasswordCommand::Undo()
 {
   if (!m_pcomInt->IsReadOnly() && m_CommandDBChange == DB) {
-    ItemListIter pos = m_pcomInt->Find(m_old_ci.GetUUID());
-    if (pos != m_pcomInt->GetEntryEndIter()) {
-      time_t tttOldXTime;
-      m_old_ci.GetXTime(tttOldXTime);
-      pos->second.SetPassword(m_old_ci.GetPassword());
-      pos->second.SetPWHistory(m_old_ci.GetPWHistory());
-      pos->second.SetStatus(m_old_ci.GetStatus());
-      pos->second.SetXTime(tttOldXTime);
-    }
+    if (m_pdelta != nullptr)
+      ApplyEntryDelta(m_entry_uuid, *m_pdelta, false);
 
     if (m_bNotifyGUI)
       m_pcomInt->NotifyGUINeedsUpdating(UpdateGUICommand::GUI_REFRESH_ENTRYPASSWORD,
-                                        m_old_ci.GetUUID());
+                                        m_entry_uuid);
 
     RestoreDBInformation();  
   }
@@ -1088,6 +1257,14 @@ AddDependentEntriesCommand::~AddDependentEntriesCommand()
 {
 }
 
+size_t AddDependentEntriesCommand::GetMemoryUsage() const
+{
+  size_t usage = Command::GetMemoryUsage() + sizeof(*this) - sizeof(Command);
+  for (const auto &item : m_mapDeletedItems)
+    usage += item.second.GetMemoryUsage();
+  return usage;
+}
+
 int AddDependentEntriesCommand::Execute()
 {
   int rc(0);
@@ -1103,6 +1280,8 @@ int AddDependentEntriesCommand::Execute()
     rc = m_pcomInt->DoAddDependentEntries(m_dependentslist, m_pRpt,
                                           m_type, m_iVia,
                                           &m_mapDeletedItems, &m_mapSaveStatus);
+    for (const auto &item : m_mapDeletedItems) // kept for undo only
+      item.second.ReleaseCipher();
 
     m_CommandDBChange = DB;
   }
@@ -13,6 +13,7 @@
 
 class CReport;
 class CommandInterface;
+class CItemDelta;
 
 #include "ItemData.h"
 #include "PWSfile.h"
@@ -58,12 +59,21 @@ public:
   // This states if something was actually changed
   bool WasDBChanged() const { return m_CommandDBChange != NONE; }
 
+  // Approximate memory held for undo/redo, for PWScore's undo memory limit.
+  // Commands holding entries or other sizeable data add their own.
+  virtual size_t GetMemoryUsage() const;
+
 protected:
   Command(CommandInterface *pcomInt); // protected constructor!
 
   void SaveDBInformation();
   void RestoreDBInformation();
 
+  // Commands that change an entry in place keep only a CItemDelta once
+  // executed, and undo/redo by applying it to the entry.
+  void ApplyEntryDelta(const pws_os::CUUID &entry_uuid, const CItemDelta &delta,
+                       bool bRedo);
+
   // If a command is within a MultiCommand, do not save DB information
   // other than that needed for the actual command.
   // This prevents multiple copies of similar data that is only needed once
@@ -238,6 +248,7 @@ public:
   ~AddEntryCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
   friend class DeleteEntryCommand; // allow access to c'tor
 
@@ -260,6 +271,7 @@ public:
   ~DeleteEntryCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
   friend class AddEntryCommand; // allow access to c'tor
 
@@ -283,12 +295,16 @@ public:
   ~EditEntryCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
 private:
+  EditEntryCommand& operator=(const EditEntryCommand&) = delete; // Do not implement
   EditEntryCommand(CommandInterface *pcomInt, const CItemData &old_ci,
                    const CItemData &new_ci);
-  CItemData m_old_ci;
-  CItemData m_new_ci;
+  const pws_os::CUUID m_entry_uuid;
+  CItemData m_old_ci; // both versions until executed,
+  CItemData m_new_ci; // after which only
+  CItemDelta *m_pdelta; // how they differ is kept
 };
 
 class DeleteAttachmentCommand : public Command
@@ -301,6 +317,7 @@ public:
   ~DeleteAttachmentCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
 private:
   DeleteAttachmentCommand& operator=(const DeleteEntryCommand&) = delete; // Do not implement
@@ -313,19 +330,27 @@ private:
 class EditAttachmentCommand : public Command
 {
 public:
+  // If other entries share the attachment, the edit is made to a copy
+  // that only pci's entry refers to, see GetAttUUID()
   static EditAttachmentCommand *Create(CommandInterface *pcomInt,
     const CItemAtt &old_att,
-    const CItemAtt &new_att)
-  { return new EditAttachmentCommand(pcomInt, old_att, new_att); }
+    const CItemAtt &new_att,
+    const CItemData *pci = nullptr)
+  { return new EditAttachmentCommand(pcomInt, old_att, new_att, pci); }
   ~EditAttachmentCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
+  // The edited attachment's uuid, a new one if it was copied
+  pws_os::CUUID GetAttUUID() const {return m_new_att.GetUUID();}
 
 private:
   EditAttachmentCommand(CommandInterface *pcomInt, const CItemAtt &old_att,
-    const CItemAtt &new_att);
+    const CItemAtt &new_att, const CItemData *pci);
+  void SetEntryAttUUID(const pws_os::CUUID &attuuid);
   CItemAtt m_old_att;
   CItemAtt m_new_att;
+  pws_os::CUUID m_entry_uuid; // set if the edit is to a copy
 };
 
 class UpdateEntryCommand : public Command
@@ -336,22 +361,22 @@ public:
                                     CItemData::FieldType ftype,
                                     const StringX &value)
   { return new UpdateEntryCommand(pcomInt, ci, ftype, value); }
+  ~UpdateEntryCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
 private:
+  UpdateEntryCommand& operator=(const UpdateEntryCommand&) = delete; // Do not implement
   UpdateEntryCommand(CommandInterface *pcomInt, const CItemData &ci,
                      const CItemData::FieldType ftype,
                      const StringX &value);
-  void Doit(const pws_os::CUUID &entry_uuid,
-            CItemData::FieldType ftype,
-            const StringX &value,
-            CItemData::EntryStatus es,
-            UpdateGUICommand::ExecuteFn efn);
-
-  CItemData m_old_ci;
-  CItemData m_new_ci;
+  void Doit(CItemData &ci, const StringX &value);
+
+  const pws_os::CUUID m_entry_uuid;
+  CItemData m_new_ci; // for new value, until executed
   const CItemData::FieldType m_ftype;
+  CItemDelta *m_pdelta; // for undo/redo, once executed
 };
 
 class UpdatePasswordCommand : public Command
@@ -361,14 +386,19 @@ public:
                                        const CItemData &ci,
                                        const StringX &sxNewPassword)
   { return new UpdatePasswordCommand(pcomInt, ci, sxNewPassword); }
+  ~UpdatePasswordCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
 private:
+  UpdatePasswordCommand& operator=(const UpdatePasswordCommand&) = delete; // Do not implement
   UpdatePasswordCommand(CommandInterface *pcomInt,
                         const CItemData &ci, const StringX &sxNewPassword);
-  const CItemData m_old_ci; // for uuid, password, password history, XTime, entry status
-  CItemData m_new_ci; // for new password
+  const pws_os::CUUID m_entry_uuid;
+  const bool m_bChanged; // is the new password different?
+  CItemData m_new_ci; // for new password, until executed
+  CItemDelta *m_pdelta; // for undo/redo, once executed
 };
 
 class AddDependentEntryCommand : public Command
@@ -405,6 +435,7 @@ public:
   ~AddDependentEntriesCommand();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
 private:
   AddDependentEntriesCommand(CommandInterface *pcomInt,
@@ -552,6 +583,7 @@ public:
   ~MultiCommands();
   int Execute();
   void Undo();
+  size_t GetMemoryUsage() const;
 
   void Add(Command *pcmd);
   void Insert(Command *pcmd, size_t ioffset = 0); // VERY INEFFICIENT - use sparingly
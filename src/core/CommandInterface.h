@@ -83,6 +83,7 @@ class CommandInterface {
   virtual void SetBase2ShortcutsMmap(ItemMMap &) = 0;
   virtual const CItemAtt &GetAtt(const pws_os::CUUID &attuuid) const = 0;
   virtual bool HasAtt(const pws_os::CUUID &attuuid) const = 0;
+  virtual bool FindAttByContent(const CItemAtt &att, pws_os::CUUID &attuuid) const = 0;
 
   virtual void NotifyGUINeedsUpdating(UpdateGUICommand::GUI_Action,
                                       const pws_os::CUUID &,
@@ -96,6 +97,9 @@ class CommandInterface {
                                  const StringX &value) = 0;
   virtual void RemoveExpiryEntry(const CItemData &ci) = 0;
 
+  virtual void UpdateSearchIndex(const CItemData &ci) = 0;
+  virtual void RefreshEntryMetadata(const CItemData &ci) = 0;
+
   virtual const PSWDPolicyMap &GetPasswordPolicies() = 0;
   virtual bool SetPasswordPolicies(const PSWDPolicyMap &MapPSWDPLC) = 0;
   virtual bool AddPolicy(const StringX &sxPolicyName, const PWPolicy &st_pp,
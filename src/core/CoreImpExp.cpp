@@ -238,6 +238,7 @@ struct TextRecordWriter {
 
   // operator for OrderedItemList
   void operator()(const CItemData &item) {
+    CItemData::DecodedView view(item); // group, title & user are read repeatedly
     if (m_subgroup_name.empty() ||
         item.Matches(m_subgroup_name, m_subgroup_object,
         m_subgroup_function)) {
@@ -375,6 +376,7 @@ struct XMLRecordWriter {
 
   // operator for OrderedItemList
   void operator()(const CItemData &item) {
+    CItemData::DecodedView view(item); // group, title & user are read repeatedly
     m_id++;
     if (m_subgroup_name.empty() ||
         item.Matches(m_subgroup_name,
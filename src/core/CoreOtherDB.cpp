@@ -20,6 +20,7 @@
 #include "Report.h"
 #include "StringXStream.h"
 #include "DBCompareData.h"
+#include "PWSTrace.h"
 
 #include "os/typedefs.h"
 
@@ -92,6 +93,9 @@ void PWScore::Compare(PWScore *pothercore,
     }
   */
 
+  PWSTrace::Span span("Compare");
+  span.SetArg(static_cast<int64>(GetNumEntries() + pothercore->GetNumEntries()));
+
   CItemData::FieldBits bsConflicts(0);
   st_CompareData st_data;
   int numOnlyInCurrent(0), numOnlyInComp(0), numConflicts(0), numIdentical(0);
@@ -107,6 +111,7 @@ void PWScore::Compare(PWScore *pothercore,
 
     st_data.Empty();
     const CItemData &currentItem = GetEntry(currentPos);
+    CItemData::DecodedView view(currentItem);
 
     if (!subgroup_bset ||
         currentItem.Matches(std::wstring(subgroup_name), subgroup_object,
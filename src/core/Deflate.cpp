@@ -0,0 +1,450 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// Deflate.cpp
+// Compression is LZ77 with hash chains and the fixed Huffman codes - simple,
+// and good enough for the text-like attachments that are worth compressing.
+// Decompression handles all DEFLATE block types, along the lines of
+// Mark Adler's puff.c
+//-----------------------------------------------------------------------------
+
+#include "Deflate.h"
+#include "Util.h"
+
+namespace {
+  const unsigned short LBASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  const unsigned char LEXT[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  const unsigned short DBASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577};
+  const unsigned char DEXT[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  const unsigned MAXBITS = 15;   // longest Huffman code
+  const unsigned WSIZE = 32768;  // window
+  const unsigned MIN_MATCH = 3;
+  const unsigned MAX_MATCH = 258;
+  const unsigned HASH_BITS = 15;
+  const unsigned MAX_CHAIN = 64; // how hard to look for a match
+
+  // -------- Compression
+
+  class BitWriter
+  {
+  public:
+    BitWriter(std::vector<unsigned char> &out, size_t limit)
+      : m_out(out), m_limit(limit), m_bits(0), m_nbits(0), m_full(false) {}
+
+    void Put(uint32 bits, unsigned n) // LSB first
+    {
+      m_bits |= static_cast<ulong64>(bits) << m_nbits;
+      m_nbits += n;
+      while (m_nbits >= 8) {
+        Byte(static_cast<unsigned char>(m_bits));
+        m_bits >>= 8;
+        m_nbits -= 8;
+      }
+    }
+
+    void PutCode(uint32 code, unsigned n) // Huffman codes go MSB first
+    {
+      uint32 rev = 0;
+      for (unsigned i = 0; i < n; i++)
+        rev = (rev << 1) | ((code >> i) & 1);
+      Put(rev, n);
+    }
+
+    void Flush()
+    {
+      if (m_nbits > 0)
+        Byte(static_cast<unsigned char>(m_bits));
+      m_bits = 0;
+      m_nbits = 0;
+    }
+
+    bool IsFull() const {return m_full;}
+
+  private:
+    void Byte(unsigned char b)
+    {
+      if (m_out.size() < m_limit)
+        m_out.push_back(b);
+      else
+        m_full = true;
+    }
+
+    std::vector<unsigned char> &m_out;
+    const size_t m_limit;
+    ulong64 m_bits;
+    unsigned m_nbits;
+    bool m_full;
+  };
+
+  void PutLiteral(BitWriter &bw, unsigned v) // fixed literal/length code
+  {
+    if (v < 144)
+      bw.PutCode(0x30 + v, 8);
+    else if (v < 256)
+      bw.PutCode(0x190 + v - 144, 9);
+    else if (v < 280)
+      bw.PutCode(v - 256, 7);
+    else
+      bw.PutCode(0xc0 + v - 280, 8);
+  }
+
+  void PutMatch(BitWriter &bw, unsigned len, unsigned dist)
+  {
+    unsigned i = 28;
+    while (LBASE[i] > len)
+      i--;
+    PutLiteral(bw, 257 + i);
+    bw.Put(len - LBASE[i], LEXT[i]);
+
+    unsigned j = 29;
+    while (DBASE[j] > dist)
+      j--;
+    bw.PutCode(j, 5); // fixed distance code
+    bw.Put(dist - DBASE[j], DEXT[j]);
+  }
+
+  inline uint32 Hash(const unsigned char *p)
+  {
+    const uint32 v = p[0] | (uint32(p[1]) << 8) | (uint32(p[2]) << 16);
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+  }
+
+  // -------- Decompression
+
+  class BitReader
+  {
+  public:
+    BitReader(const unsigned char *in, size_t len)
+      : m_in(in), m_len(len), m_pos(0), m_bits(0), m_nbits(0), m_error(false) {}
+
+    uint32 Bits(unsigned n)
+    {
+      while (m_nbits < n) {
+        if (m_pos == m_len) {
+          m_error = true;
+          return 0;
+        }
+        m_bits |= static_cast<uint32>(m_in[m_pos++]) << m_nbits;
+        m_nbits += 8;
+      }
+      const uint32 v = m_bits & ((1U << n) - 1);
+      m_bits >>= n;
+      m_nbits -= n;
+      return v;
+    }
+
+    void AlignToByte() {m_bits = 0; m_nbits = 0;}
+
+    bool Byte(unsigned char &b)
+    {
+      if (m_pos == m_len)
+        return false;
+      b = m_in[m_pos++];
+      return true;
+    }
+
+    bool Error() const {return m_error;}
+
+  private:
+    const unsigned char *m_in;
+    const size_t m_len;
+    size_t m_pos;
+    uint32 m_bits;
+    unsigned m_nbits;
+    bool m_error;
+  };
+
+  struct Huffman {
+    short count[MAXBITS + 1]; // number of codes of each length
+    short symbol[288];        // symbols ordered by code
+  };
+
+  // Returns 0 for a complete code, > 0 for an incomplete one, < 0 if over-subscribed
+  int Build(Huffman &h, const short *length, int n)
+  {
+    for (unsigned len = 0; len <= MAXBITS; len++)
+      h.count[len] = 0;
+    for (int s = 0; s < n; s++)
+      h.count[length[s]]++;
+    if (h.count[0] == n)
+      return 0; // no codes - decoding will fail if used
+
+    int left = 1;
+    for (unsigned len = 1; len <= MAXBITS; len++) {
+      left <<= 1;
+      left -= h.count[len];
+      if (left < 0)
+        return left;
+    }
+
+    short offs[MAXBITS + 1];
+    offs[1] = 0;
+    for (unsigned len = 1; len < MAXBITS; len++)
+      offs[len + 1] = static_cast<short>(offs[len] + h.count[len]);
+    for (int s = 0; s < n; s++)
+      if (length[s] != 0)
+        h.symbol[offs[length[s]]++] = static_cast<short>(s);
+    return left;
+  }
+
+  int Decode(BitReader &br, const Huffman &h)
+  {
+    int code = 0, first = 0, index = 0;
+    for (unsigned len = 1; len <= MAXBITS; len++) {
+      code |= static_cast<int>(br.Bits(1));
+      const int count = h.count[len];
+      if (code - count < first)
+        return h.symbol[index + (code - first)];
+      index += count;
+      first += count;
+      first <<= 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+
+  class Inflater
+  {
+  public:
+    Inflater(const unsigned char *in, size_t inlen, unsigned char *out, size_t outlen)
+      : m_br(in, inlen), m_out(out), m_outlen(outlen), m_outpos(0) {}
+
+    bool Run()
+    {
+      bool last;
+      do {
+        last = m_br.Bits(1) != 0;
+        bool ok;
+        switch (m_br.Bits(2)) {
+        case 0: ok = Stored(); break;
+        case 1: ok = Fixed(); break;
+        case 2: ok = Dynamic(); break;
+        default: ok = false;
+        }
+        if (!ok || m_br.Error())
+          return false;
+      } while (!last);
+      return m_outpos == m_outlen;
+    }
+
+  private:
+    bool Stored()
+    {
+      m_br.AlignToByte();
+      unsigned char b[4];
+      for (auto &c : b)
+        if (!m_br.Byte(c))
+          return false;
+      const unsigned len = b[0] | (b[1] << 8);
+      if (len != (~(b[2] | (b[3] << 8)) & 0xffff))
+        return false;
+      if (len > m_outlen - m_outpos)
+        return false;
+      for (unsigned i = 0; i < len; i++)
+        if (!m_br.Byte(m_out[m_outpos++]))
+          return false;
+      return true;
+    }
+
+    bool Fixed()
+    {
+      short lengths[288 + 30];
+      int s = 0;
+      for (; s < 144; s++) lengths[s] = 8;
+      for (; s < 256; s++) lengths[s] = 9;
+      for (; s < 280; s++) lengths[s] = 7;
+      for (; s < 288; s++) lengths[s] = 8;
+      for (; s < 288 + 30; s++) lengths[s] = 5;
+      Huffman lencode, distcode;
+      Build(lencode, lengths, 288);
+      Build(distcode, lengths + 288, 30);
+      return Codes(lencode, distcode);
+    }
+
+    bool Dynamic()
+    {
+      static const unsigned char order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+      const int nlen = static_cast<int>(m_br.Bits(5)) + 257;
+      const int ndist = static_cast<int>(m_br.Bits(5)) + 1;
+      const int ncode = static_cast<int>(m_br.Bits(4)) + 4;
+      if (nlen > 286 || ndist > 30)
+        return false;
+
+      short lengths[320];
+      int index;
+      for (index = 0; index < ncode; index++)
+        lengths[order[index]] = static_cast<short>(m_br.Bits(3));
+      for (; index < 19; index++)
+        lengths[order[index]] = 0;
+      Huffman lencode, distcode;
+      if (Build(lencode, lengths, 19) != 0) // must be complete
+        return false;
+
+      index = 0;
+      while (index < nlen + ndist) {
+        int symbol = Decode(m_br, lencode);
+        if (symbol < 0 || m_br.Error())
+          return false;
+        if (symbol < 16) {
+          lengths[index++] = static_cast<short>(symbol);
+        } else {
+          short len = 0;
+          int rep;
+          if (symbol == 16) {
+            if (index == 0)
+              return false;
+            len = lengths[index - 1];
+            rep = 3 + static_cast<int>(m_br.Bits(2));
+          } else if (symbol == 17) {
+            rep = 3 + static_cast<int>(m_br.Bits(3));
+          } else {
+            rep = 11 + static_cast<int>(m_br.Bits(7));
+          }
+          if (index + rep > nlen + ndist)
+            return false;
+          while (rep-- > 0)
+            lengths[index++] = len;
+        }
+      }
+      if (lengths[256] == 0) // no end-of-block code
+        return false;
+
+      int err = Build(lencode, lengths, nlen);
+      if (err < 0 || (err > 0 && nlen - lencode.count[0] != 1))
+        return false; // incomplete code only allowed for a single length
+      err = Build(distcode, lengths + nlen, ndist);
+      if (err < 0 || (err > 0 && ndist - distcode.count[0] != 1))
+        return false;
+      return Codes(lencode, distcode);
+    }
+
+    bool Codes(const Huffman &lencode, const Huffman &distcode)
+    {
+      for (;;) {
+        int symbol = Decode(m_br, lencode);
+        if (symbol < 0 || m_br.Error())
+          return false;
+        if (symbol < 256) {
+          if (m_outpos == m_outlen)
+            return false;
+          m_out[m_outpos++] = static_cast<unsigned char>(symbol);
+        } else if (symbol == 256) {
+          return true;
+        } else {
+          symbol -= 257;
+          if (symbol >= 29)
+            return false;
+          const size_t len = LBASE[symbol] + m_br.Bits(LEXT[symbol]);
+          symbol = Decode(m_br, distcode);
+          if (symbol < 0 || symbol >= 30)
+            return false;
+          const size_t dist = DBASE[symbol] + m_br.Bits(DEXT[symbol]);
+          if (m_br.Error() || dist > m_outpos || len > m_outlen - m_outpos)
+            return false;
+          for (size_t i = 0; i < len; i++, m_outpos++)
+            m_out[m_outpos] = m_out[m_outpos - dist];
+        }
+      }
+    }
+
+    BitReader m_br;
+    unsigned char *m_out;
+    const size_t m_outlen;
+    size_t m_outpos;
+  };
+}
+
+bool PWSDeflate::Compress(const unsigned char *in, size_t inlen,
+                          std::vector<unsigned char> &out)
+{
+  out.clear();
+  if (inlen < MIN_MATCH)
+    return false;
+  out.reserve(inlen); // no point in more
+  BitWriter bw(out, inlen - 1);
+
+  // Chains of earlier positions with the same hash, as position + 1, 0 ends
+  std::vector<uint32> head(size_t(1) << HASH_BITS, 0);
+  std::vector<uint32> prev(WSIZE, 0);
+  auto insert = [&](size_t p) {
+    const uint32 h = Hash(in + p);
+    prev[p & (WSIZE - 1)] = head[h];
+    head[h] = static_cast<uint32>(p + 1);
+  };
+
+  bw.Put(1, 1); // BFINAL - just the one block
+  bw.Put(1, 2); // BTYPE: fixed Huffman codes
+
+  size_t p = 0;
+  while (p < inlen && !bw.IsFull()) {
+    size_t bestLen = 0, bestDist = 0;
+    if (p + MIN_MATCH <= inlen) {
+      const size_t maxLen = std::min(size_t(MAX_MATCH), inlen - p);
+      uint32 cand = head[Hash(in + p)];
+      for (unsigned chain = 0; cand != 0 && chain < MAX_CHAIN; chain++) {
+        const size_t c = cand - 1;
+        if (p - c > WSIZE)
+          break;
+        if (in[c + bestLen] == in[p + bestLen]) {
+          size_t l = 0;
+          while (l < maxLen && in[c + l] == in[p + l])
+            l++;
+          if (l > bestLen) {
+            bestLen = l;
+            bestDist = p - c;
+            if (l == maxLen)
+              break;
+          }
+        }
+        const uint32 next = prev[c & (WSIZE - 1)];
+        if (next >= cand) // slot reused by a later position, chain's gone
+          break;
+        cand = next;
+      }
+    }
+
+    if (bestLen >= MIN_MATCH) {
+      PutMatch(bw, static_cast<unsigned>(bestLen), static_cast<unsigned>(bestDist));
+      for (size_t k = 0; k < bestLen; k++)
+        if (p + k + MIN_MATCH <= inlen)
+          insert(p + k);
+      p += bestLen;
+    } else {
+      PutLiteral(bw, in[p]);
+      if (p + MIN_MATCH <= inlen)
+        insert(p);
+      p++;
+    }
+  }
+  PutLiteral(bw, 256); // end of block
+  bw.Flush();
+
+  if (bw.IsFull()) {
+    trashMemory(out.data(), out.size());
+    out.clear();
+    return false;
+  }
+  return true;
+}
+
+bool PWSDeflate::Decompress(const unsigned char *in, size_t inlen,
+                            unsigned char *out, size_t outlen)
+{
+  Inflater inflater(in, inlen, out, outlen);
+  return inflater.Run();
+}
@@ -0,0 +1,37 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// Deflate.h
+// Raw DEFLATE (RFC 1951) compression, used for attachment content.
+// Self-contained, so that any inflater can read what we write,
+// without our depending on an external library.
+//-----------------------------------------------------------------------------
+
+#ifndef __DEFLATE_H
+#define __DEFLATE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace PWSDeflate {
+  // Returns false (and out empty) if the result wouldn't be smaller than
+  // the input. As out may hold sensitive data, it's sized once, so there
+  // are no copies left behind by reallocation - caller should trash it.
+  bool Compress(const unsigned char *in, size_t inlen,
+                std::vector<unsigned char> &out);
+
+  // Returns false unless in is valid DEFLATE data that inflates
+  // to exactly outlen bytes.
+  bool Decompress(const unsigned char *in, size_t inlen,
+                  unsigned char *out, size_t outlen);
+}
+
+#endif /* __DEFLATE_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
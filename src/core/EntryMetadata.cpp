@@ -0,0 +1,238 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// EntryMetadata.cpp
+//-----------------------------------------------------------------------------
+
+#include "EntryMetadata.h"
+#include "PWSrand.h"
+#include "SecureString.h"
+#include "Util.h"
+#include "crypto/siphash.h"
+
+using pws_os::CUUID;
+
+CEntryMetadata::CEntryMetadata()
+{
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+}
+
+CEntryMetadata::~CEntryMetadata()
+{
+  trashMemory(m_key, sizeof(m_key));
+}
+
+int CEntryMetadata::TimeColumn(int whichtime)
+{
+  switch (whichtime) {
+    case CItemData::CTIME:  return 0;
+    case CItemData::PMTIME: return 1;
+    case CItemData::ATIME:  return 2;
+    case CItemData::XTIME:  return 3;
+    case CItemData::RMTIME: return 4;
+    default:                return -1; // not an entry time
+  }
+}
+
+uint64 CEntryMetadata::HashStrings(const StringX *psx, size_t n) const
+{
+  // Hash each string as UTF-8, terminated by a zero,
+  // so that ("ab", "c") and ("a", "bc") differ
+  SecureStringU8 buf, utf8;
+  for (size_t i = 0; i < n; i++) {
+    ToSecureUTF8(psx[i], utf8);
+    buf += utf8;
+    buf += '\0';
+  }
+  return SipHash::Hash(m_key, reinterpret_cast<const unsigned char *>(buf.data()),
+                       buf.length());
+}
+
+void CEntryMetadata::Clear()
+{
+  m_mapRows.clear();
+  m_vUUIDs.clear();
+  for (auto &vt : m_vTimes)
+    vt.clear();
+  m_vEntryTypes.clear();
+  m_vStatus.clear();
+  m_vPolicyIDs.clear();
+  m_vGTUHashes.clear();
+  m_vAttUUIDs.clear();
+}
+
+void CEntryMetadata::Add(const CItemData &ci)
+{
+  const CUUID uuid = ci.GetUUID();
+  size_t row;
+  auto iter = m_mapRows.find(uuid);
+  if (iter != m_mapRows.end()) {
+    row = iter->second;
+  } else {
+    row = m_vUUIDs.size();
+    m_mapRows[uuid] = row;
+    m_vUUIDs.push_back(uuid);
+    for (auto &vt : m_vTimes)
+      vt.push_back(time_t(0));
+    m_vEntryTypes.push_back(0);
+    m_vStatus.push_back(0);
+    m_vPolicyIDs.push_back(0);
+    m_vGTUHashes.push_back(0);
+    m_vAttUUIDs.push_back(CUUID::NullUUID());
+  }
+
+  ci.GetCTime(m_vTimes[0][row]);
+  ci.GetPMTime(m_vTimes[1][row]);
+  ci.GetATime(m_vTimes[2][row]);
+  ci.GetXTime(m_vTimes[3][row]);
+  ci.GetRMTime(m_vTimes[4][row]);
+  m_vEntryTypes[row] = static_cast<unsigned char>(ci.GetEntryType());
+  m_vStatus[row] = static_cast<unsigned char>(ci.GetStatus());
+
+  if (ci.IsPolicyNameSet()) {
+    const StringX sxPolicyName = ci.GetPolicyName();
+    m_vPolicyIDs[row] = HashStrings(&sxPolicyName, 1) | 1; // never 0
+  } else
+    m_vPolicyIDs[row] = 0;
+
+  const StringX gtu[3] = {ci.GetGroup(), ci.GetTitle(), ci.GetUser()};
+  m_vGTUHashes[row] = HashStrings(gtu, 3);
+
+  m_vAttUUIDs[row] = ci.HasAttRef() ? ci.GetAttUUID() : CUUID::NullUUID();
+}
+
+void CEntryMetadata::Remove(const CUUID &uuid)
+{
+  auto iter = m_mapRows.find(uuid);
+  if (iter == m_mapRows.end())
+    return;
+
+  // Move last row into the hole
+  const size_t row = iter->second;
+  const size_t last = m_vUUIDs.size() - 1;
+  m_mapRows.erase(iter);
+  if (row != last) {
+    m_vUUIDs[row] = m_vUUIDs[last];
+    for (auto &vt : m_vTimes)
+      vt[row] = vt[last];
+    m_vEntryTypes[row] = m_vEntryTypes[last];
+    m_vStatus[row] = m_vStatus[last];
+    m_vPolicyIDs[row] = m_vPolicyIDs[last];
+    m_vGTUHashes[row] = m_vGTUHashes[last];
+    m_vAttUUIDs[row] = m_vAttUUIDs[last];
+    m_mapRows[m_vUUIDs[row]] = row;
+  }
+
+  m_vUUIDs.pop_back();
+  for (auto &vt : m_vTimes)
+    vt.pop_back();
+  m_vEntryTypes.pop_back();
+  m_vStatus.pop_back();
+  m_vPolicyIDs.pop_back();
+  m_vGTUHashes.pop_back();
+  m_vAttUUIDs.pop_back();
+}
+
+void CEntryMetadata::ClearAllStatus()
+{
+  std::fill(m_vStatus.begin(), m_vStatus.end(),
+            static_cast<unsigned char>(CItemData::ES_CLEAN));
+}
+
+bool CEntryMetadata::GetTime(const CUUID &uuid, int whichtime, time_t &t) const
+{
+  const int col = TimeColumn(whichtime);
+  auto iter = m_mapRows.find(uuid);
+  if (col < 0 || iter == m_mapRows.end())
+    return false;
+
+  t = m_vTimes[col][iter->second];
+  return true;
+}
+
+bool CEntryMetadata::GetEntryType(const CUUID &uuid, CItemData::EntryType &et) const
+{
+  auto iter = m_mapRows.find(uuid);
+  if (iter == m_mapRows.end())
+    return false;
+
+  et = static_cast<CItemData::EntryType>(m_vEntryTypes[iter->second]);
+  return true;
+}
+
+bool CEntryMetadata::GetStatus(const CUUID &uuid, CItemData::EntryStatus &es) const
+{
+  auto iter = m_mapRows.find(uuid);
+  if (iter == m_mapRows.end())
+    return false;
+
+  es = static_cast<CItemData::EntryStatus>(m_vStatus[iter->second]);
+  return true;
+}
+
+void CEntryMetadata::FindByTime(int whichtime, time_t time1, time_t time2,
+                                int iFunction, UUIDVector &vuuids) const
+{
+  const int col = TimeColumn(whichtime);
+  if (col < 0)
+    return;
+
+  const std::vector<time_t> &vt = m_vTimes[col];
+  for (size_t row = 0; row < vt.size(); row++) {
+    if (PWSMatch::MatchDate(vt[row], time1, time2, iFunction))
+      vuuids.push_back(m_vUUIDs[row]);
+  }
+}
+
+void CEntryMetadata::FindByEntryType(CItemData::EntryType et, UUIDVector &vuuids) const
+{
+  const unsigned char c = static_cast<unsigned char>(et);
+  for (size_t row = 0; row < m_vEntryTypes.size(); row++) {
+    if (m_vEntryTypes[row] == c)
+      vuuids.push_back(m_vUUIDs[row]);
+  }
+}
+
+void CEntryMetadata::FindByStatus(CItemData::EntryStatus es, UUIDVector &vuuids) const
+{
+  const unsigned char c = static_cast<unsigned char>(es);
+  for (size_t row = 0; row < m_vStatus.size(); row++) {
+    if (m_vStatus[row] == c)
+      vuuids.push_back(m_vUUIDs[row]);
+  }
+}
+
+void CEntryMetadata::FindByAttachment(const CUUID &attuuid, UUIDVector &vuuids) const
+{
+  for (size_t row = 0; row < m_vAttUUIDs.size(); row++) {
+    if (m_vAttUUIDs[row] == attuuid)
+      vuuids.push_back(m_vUUIDs[row]);
+  }
+}
+
+void CEntryMetadata::FindByPolicyName(const StringX &sxPolicyName, UUIDVector &vuuids) const
+{
+  if (sxPolicyName.empty())
+    return;
+
+  const uint64 id = HashStrings(&sxPolicyName, 1) | 1;
+  for (size_t row = 0; row < m_vPolicyIDs.size(); row++) {
+    if (m_vPolicyIDs[row] == id)
+      vuuids.push_back(m_vUUIDs[row]);
+  }
+}
+
+void CEntryMetadata::FindByGTU(const StringX &group, const StringX &title,
+                               const StringX &user, UUIDVector &vuuids) const
+{
+  const StringX gtu[3] = {group, title, user};
+  const uint64 h = HashStrings(gtu, 3);
+  for (size_t row = 0; row < m_vGTUHashes.size(); row++) {
+    if (m_vGTUHashes[row] == h)
+      vuuids.push_back(m_vUUIDs[row]);
+  }
+}
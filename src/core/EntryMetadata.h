@@ -0,0 +1,92 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// EntryMetadata.h
+//-----------------------------------------------------------------------------
+
+#ifndef __ENTRYMETADATA_H
+#define __ENTRYMETADATA_H
+
+/*
+ * CEntryMetadata is a column-wise (struct of arrays) copy of the entry
+ * metadata that sorting, filtering and expiry checks need: the five
+ * timestamps, entry type and status, password policy name and attachment
+ * reference, plus a hash of group/title/user.
+ *
+ * Reading a time or a GTU from a CItemData means decrypting the field; this
+ * projection lets such queries run as a scan over contiguous arrays instead.
+ * Strings are kept only as keyed 64-bit hashes (random key per instance), so
+ * policy name and GTU lookups return candidates which the caller should
+ * confirm against the entry if a false positive matters.
+ *
+ * PWScore keeps one up to date via its Do* methods - anything that changes
+ * an entry in m_pwlist in place must call PWScore::RefreshEntryMetadata().
+ */
+
+#include "coredefs.h"
+
+#include <vector>
+
+class CEntryMetadata
+{
+public:
+  CEntryMetadata();
+  ~CEntryMetadata();
+
+  void Clear();
+  void Add(const CItemData &ci); // or replace, if already present
+  void Update(const CItemData &ci) {Add(ci);}
+  void Remove(const pws_os::CUUID &uuid);
+  void ClearAllStatus(); // as done to all entries on save
+
+  size_t size() const {return m_vUUIDs.size();}
+  bool Has(const pws_os::CUUID &uuid) const
+  {return m_mapRows.find(uuid) != m_mapRows.end();}
+
+  // Per-entry accessors, return false if the entry isn't known
+  // whichtime is one of CItemData::CTIME, PMTIME, ATIME, XTIME or RMTIME
+  bool GetTime(const pws_os::CUUID &uuid, int whichtime, time_t &t) const;
+  bool GetEntryType(const pws_os::CUUID &uuid, CItemData::EntryType &et) const;
+  bool GetStatus(const pws_os::CUUID &uuid, CItemData::EntryStatus &es) const;
+
+  // Scans - results are appended to vuuids
+  // Same semantics as CItemData::MatchesTime
+  void FindByTime(int whichtime, time_t time1, time_t time2, int iFunction,
+                  UUIDVector &vuuids) const;
+  void FindByEntryType(CItemData::EntryType et, UUIDVector &vuuids) const;
+  void FindByStatus(CItemData::EntryStatus es, UUIDVector &vuuids) const;
+  void FindByAttachment(const pws_os::CUUID &attuuid, UUIDVector &vuuids) const;
+  // Following return candidates, see above
+  void FindByPolicyName(const StringX &sxPolicyName, UUIDVector &vuuids) const;
+  void FindByGTU(const StringX &group, const StringX &title, const StringX &user,
+                 UUIDVector &vuuids) const;
+
+private:
+  CEntryMetadata(const CEntryMetadata &) = delete;
+  CEntryMetadata &operator=(const CEntryMetadata &) = delete;
+
+  enum {NUMTIMES = 5};
+  static int TimeColumn(int whichtime);
+  uint64 HashStrings(const StringX *psx, size_t n) const;
+
+  uint64 m_key[2];
+
+  std::map<pws_os::CUUID, size_t> m_mapRows;
+  std::vector<pws_os::CUUID> m_vUUIDs;
+  std::vector<time_t> m_vTimes[NUMTIMES];
+  std::vector<unsigned char> m_vEntryTypes;
+  std::vector<unsigned char> m_vStatus;
+  std::vector<uint64> m_vPolicyIDs; // 0 if no policy name
+  std::vector<uint64> m_vGTUHashes;
+  std::vector<pws_os::CUUID> m_vAttUUIDs; // NullUUID if no attachment
+};
+
+#endif /* __ENTRYMETADATA_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
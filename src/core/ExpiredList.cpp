@@ -34,6 +34,17 @@ ExpPWEntry::ExpPWEntry(const CItemData &ci)
   expirytttXTime = tttXTime;
 }
 
+ExpPWEntry::ExpPWEntry(const pws_os::CUUID &entry_uuid, time_t tttXTime,
+                       time_t tttPMTime, time_t tttCTime)
+  : uuid(entry_uuid)
+{
+  if (tttXTime > time_t(0) && tttXTime <= time_t(3650)) {
+    const time_t tttCPMTime = (tttPMTime == time_t(0)) ? tttCTime : tttPMTime;
+    tttXTime = static_cast<time_t>(static_cast<long>(tttCPMTime) + static_cast<long>(tttXTime) * 86400);
+  }
+  expirytttXTime = tttXTime;
+}
+
 void ExpiredList::Add(const CItemData &ci)
 {
   // Not valid for aliases or shortcuts!
@@ -19,6 +19,9 @@
 
 struct ExpPWEntry {
   ExpPWEntry(const CItemData &ci);
+  // For when the times are already known, saves decrypting them again
+  ExpPWEntry(const pws_os::CUUID &entry_uuid, time_t tttXTime,
+             time_t tttPMTime, time_t tttCTime);
   ExpPWEntry(const ExpPWEntry &ee) : uuid(ee.uuid), expirytttXTime(ee.expirytttXTime) {}
   ExpPWEntry &operator=(const ExpPWEntry &that) {
     if (this != &that) {
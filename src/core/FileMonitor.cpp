@@ -0,0 +1,98 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// FileMonitor.cpp
+//-----------------------------------------------------------------------------
+
+#include "FileMonitor.h"
+
+#include <chrono>
+#include <thread>
+
+CFileMonitor::CFileMonitor()
+  : m_bFullSig(false), m_bChanged(false)
+{
+}
+
+CFileMonitor::~CFileMonitor()
+{
+  Stop();
+}
+
+bool CFileMonitor::Start(const stringT &filename, bool bFullSig, ChangeFn fn)
+{
+  Stop();
+
+  if (!PWSFileWatch::IsSupported())
+    return false;
+
+  m_filename = filename;
+  m_bFullSig = bFullSig;
+  m_fn = fn;
+  m_bChanged = false;
+
+  std::promise<PWSFileSig> baseline;
+  m_baseline = baseline.get_future().share();
+  if (bFullSig) {
+    // Detached rather than std::async, whose future would block
+    // Stop() until the hash is done
+    std::thread([filename](std::promise<PWSFileSig> p) {
+                  p.set_value(PWSFileSig(filename, true));
+                }, std::move(baseline)).detach();
+  } else {
+    // Head & tail only - cheap enough to do here
+    baseline.set_value(PWSFileSig(filename));
+  }
+
+  return m_watch.Start(filename, [this]() {OnChange();});
+}
+
+void CFileMonitor::Stop()
+{
+  // Not under m_mutex - Stop() waits for the watch thread, which may be
+  // waiting for it in OnChange()
+  m_watch.Stop();
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_baseline = std::shared_future<PWSFileSig>();
+  m_fn = nullptr;
+}
+
+void CFileMonitor::OnChange()
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  if (m_bChanged || !m_baseline.valid())
+    return; // already reported, or stopping
+
+  if (DiffersFromBaseline()) {
+    m_bChanged = true;
+    if (m_fn)
+      m_fn();
+  }
+}
+
+bool CFileMonitor::HasChanged() const
+{
+  if (m_bChanged)
+    return true;
+  if (!m_watch.HasPending())
+    return false;
+
+  // Something's happened that the watch thread hasn't got to the bottom
+  // of yet - it may still be settling - so check now rather than miss it
+  std::lock_guard<std::mutex> guard(m_mutex);
+  return m_bChanged || (m_baseline.valid() && DiffersFromBaseline());
+}
+
+bool CFileMonitor::DiffersFromBaseline() const
+{
+  if (m_baseline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    return true; // can't tell whether the baseline saw the change
+
+  const PWSFileSig current(m_filename, m_bFullSig);
+  return m_baseline.get() != current;
+}
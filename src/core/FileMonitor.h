@@ -0,0 +1,79 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// FileMonitor.h
+//-----------------------------------------------------------------------------
+
+#ifndef __FILEMONITOR_H
+#define __FILEMONITOR_H
+
+/*
+ * CFileMonitor tracks whether the open database has been changed on disk
+ * by someone else, so that backup and save needn't re-read the file to
+ * find out.
+ *
+ * It takes a PWSFileSig of the file as a baseline when started, and uses
+ * PWSFileWatch to hear of changes. Each change reported is confirmed on the
+ * watch thread by comparing a fresh signature with the baseline, so that
+ * e.g. a sync client rewriting identical contents isn't a change.
+ *
+ * With bFullSig, the signatures hash the entire file rather than its head
+ * and tail; the baseline is then computed in the background, and a change
+ * seen before it's ready is conservatively taken as real.
+ *
+ * HasChanged() also catches a change made just before it's called, which
+ * the watch hasn't reported yet, by checking the signature there and then.
+ *
+ * Start() fails if the platform can't watch files, in which case callers
+ * should keep checking the signature themselves.
+ */
+
+#include "PWSfile.h"
+#include "os/filewatch.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+
+class CFileMonitor
+{
+public:
+  typedef std::function<void()> ChangeFn;
+
+  CFileMonitor();
+  ~CFileMonitor();
+
+  // fn is called on the watch thread, once, when a change is confirmed
+  bool Start(const stringT &filename, bool bFullSig, ChangeFn fn = nullptr);
+  void Stop();
+
+  bool IsActive() const {return m_watch.IsWatching();}
+  bool HasChanged() const;
+  bool IsFullSig() const {return m_bFullSig;}
+
+private:
+  CFileMonitor(const CFileMonitor &) = delete;
+  CFileMonitor &operator=(const CFileMonitor &) = delete;
+
+  void OnChange(); // on the watch thread
+  bool DiffersFromBaseline() const; // with m_mutex held
+
+  PWSFileWatch m_watch;
+  stringT m_filename;
+  bool m_bFullSig;
+  std::shared_future<PWSFileSig> m_baseline;
+  std::atomic<bool> m_bChanged;
+  mutable std::mutex m_mutex; // serialises OnChange with Start/Stop/HasChanged
+  ChangeFn m_fn;
+};
+
+#endif /* __FILEMONITOR_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -48,6 +48,9 @@ CItem& CItem::operator=(const CItem &that)
     memcpy(m_key, that.m_key, sizeof(m_key));
     delete m_blowfish;
     m_blowfish = nullptr;
+
+    if (m_decoded != nullptr)
+      m_decoded->values.clear();
   }
   return *this;
 }
@@ -123,6 +126,31 @@ size_t CItem::GetSize() const
   return length;
 }
 
+size_t CItem::GetMemoryUsage() const
+{
+  // Map node overhead is implementation-dependent, assume a typical
+  // red-black tree node: three pointers and a colour
+  const size_t NodeOverhead = 4 * sizeof(void *);
+  size_t usage = sizeof(*this);
+
+  for (FieldConstIter fiter = m_fields.begin(); fiter != m_fields.end(); fiter++)
+    usage += sizeof(*fiter) + NodeOverhead + fiter->second.GetSize();
+
+  usage += m_URFL.capacity() * sizeof(CItemField);
+  for (auto ufiter = m_URFL.begin(); ufiter != m_URFL.end(); ufiter++)
+    usage += ufiter->GetSize();
+
+  if (m_blowfish != nullptr)
+    usage += sizeof(BlowFish);
+  return usage;
+}
+
+void CItem::ReleaseCipher() const
+{
+  delete m_blowfish;
+  m_blowfish = nullptr;
+}
+
 BlowFish *CItem::MakeBlowFish() const
 {
   // Creating a BlowFish object's relatively expensive, so we use
@@ -165,10 +193,14 @@ void CItem::Clear()
 {
   m_fields.clear();
   m_URFL.clear();
+  if (m_decoded != nullptr)
+    m_decoded->values.clear();
 }
 
 void CItem::SetField(int ft, const unsigned char *value, size_t length)
 {
+  if (m_decoded != nullptr)
+    m_decoded->values.erase(ft);
   if (length != 0) {
     m_fields[ft].Set(value, length,
                      MakeBlowFish(),
@@ -179,6 +211,8 @@ void CItem::SetField(int ft, const unsigned char *value, size_t length)
 
 void CItem::SetField(int ft, const StringX &value)
 {
+  if (m_decoded != nullptr)
+    m_decoded->values.erase(ft);
   if (!value.empty()) {
     m_fields[ft].Set(value,
                      MakeBlowFish(),
@@ -303,8 +337,21 @@ uint8_t CItem::GetFieldAsByte(const int ft, uint8_t default_value) const
 
 StringX CItem::GetField(const int ft) const
 {
+  if (m_decoded != nullptr) {
+    auto diter = m_decoded->values.find(ft);
+    if (diter != m_decoded->values.end())
+      return diter->second;
+  }
+
   auto fiter = m_fields.find(ft);
-  return fiter == m_fields.end() ? _T("") : GetField(fiter->second);
+  if (fiter == m_fields.end())
+    return _T("");
+
+  StringX retval = GetField(fiter->second);
+  if (m_decoded != nullptr && ft >= 0 && ft < static_cast<int>(m_decoded->memoisable.size()) &&
+      m_decoded->memoisable.test(ft))
+    m_decoded->values.emplace(ft, retval);
+  return retval;
 }
 
 StringX CItem::GetField(const CItemField &field) const
@@ -314,6 +361,23 @@ StringX CItem::GetField(const CItemField &field) const
   return retval;
 }
 
+void CItem::GetField(int ft, SecureStringX &value) const
+{
+  if (m_decoded != nullptr) {
+    auto diter = m_decoded->values.find(ft);
+    if (diter != m_decoded->values.end()) {
+      value.assign(diter->second.data(), diter->second.length());
+      return;
+    }
+  }
+
+  auto fiter = m_fields.find(ft);
+  if (fiter == m_fields.end())
+    value.clear();
+  else
+    fiter->second.Get(value, MakeBlowFish());
+}
+
 void CItem::GetTime(int whichtime, time_t &t) const
 {
   ASSERT(IsTimeField(whichtime));
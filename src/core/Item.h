@@ -17,6 +17,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <bitset>
 
 //-----------------------------------------------------------------------------
 
@@ -41,9 +42,12 @@
 */
 
 class BlowFish;
+class CItemDelta;
 
 class CItem
 {
+  friend class CItemDelta; // diffs & applies field maps
+
 public:
   // field types, per formatV{2,3,4}.txt. Any value > 0xff is internal only!
   enum FieldType {
@@ -120,6 +124,8 @@ public:
     ATTIV = 0x72,
     CONTENT = 0x73,
     CONTENTHMAC = 0x74,
+    CONTENTCOMPRESSION = 0x76,    // optional, method & length of compressed content
+    COMPRESSEDCONTENT = 0x77,     // with CONTENTCOMPRESSION, in place of CONTENT's
     LAST_ATT,
 
     UNKNOWN_TESTING = 0xdf,       // for testing forward compatibility (unknown field handling)
@@ -168,7 +174,8 @@ public:
 
   CItem& operator=(const CItem& second);
   virtual void Clear();
-  void ClearField(int ft) {m_fields.erase(ft);}
+  void ClearField(int ft)
+  {m_fields.erase(ft); if (m_decoded != nullptr) m_decoded->values.erase(ft);}
 
   void CopyTime(int ft, const CItem & src)
   {
@@ -182,6 +189,12 @@ public:
 
   size_t GetSize() const;
   void GetSize(size_t &isize) const {isize = GetSize();}
+
+  // Approximate memory held, including the cipher if instantiated
+  size_t GetMemoryUsage() const;
+  // The cipher is created on first use and kept, which is costly for
+  // copies that are kept but rarely used, e.g., for undo.
+  void ReleaseCipher() const;
     
   void push_length(std::vector<char> &v, uint32 s) const;
   template< typename T> void push(std::vector<char> &v, char type, T value) const
@@ -202,6 +215,15 @@ public:
     }
   }
 
+  // Decoded values of text fields, memoised while a view (such as
+  // CItemData::DecodedView) is in scope. Only fields in 'memoisable'
+  // are kept, in securely allocated memory that's wiped when freed.
+  struct DecodedFields {
+    std::bitset<256> memoisable;
+    std::map<int, StringX, std::less<int>,
+             S_Alloc::SecureAlloc<std::pair<const int, StringX> > > values;
+  };
+
 protected:
   typedef std::map<int, CItemField> FieldMap;
   typedef FieldMap::const_iterator FieldConstIter;
@@ -212,6 +234,9 @@ protected:
   // Save unknown record fields on read to put back on write unchanged
   std::vector<CItemField> m_URFL;
 
+  // Owned by the view, not copied with the item
+  mutable DecodedFields *m_decoded = nullptr;
+
   void SetField(int ft, const unsigned char *value, size_t length);
   void SetField(int ft, const StringX &value);
   bool SetTextField(int ft, const unsigned char *value, size_t length);
@@ -226,6 +251,7 @@ protected:
   uint8_t GetFieldAsByte(const int ft, uint8_t default_value = 0) const;
   StringX GetField(int ft) const;
   StringX GetField(const CItemField &field) const;
+  void GetField(int ft, SecureStringX &value) const;
 
   void SetTime(int whichtime, time_t t);
   void GetTime(int whichtime, time_t &t) const;
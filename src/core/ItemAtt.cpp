@@ -15,6 +15,8 @@
 #include "PWSfile.h"
 #include "PWSfileV4.h"
 #include "PWScore.h"
+#include "PWSprefs.h"
+#include "Deflate.h"
 
 #include "os/typedefs.h"
 #include "os/pws_tchar.h"
@@ -26,6 +28,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <vector>
+
 using namespace std;
 using pws_os::CUUID;
 
@@ -33,18 +37,23 @@ using pws_os::CUUID;
 // Constructors
 
 CItemAtt::CItemAtt()
-  : m_entrystatus(ES_CLEAN), m_offset(-1L), m_refcount(0)
+  : m_entrystatus(ES_CLEAN), m_compression(CC_NONE), m_hasDigest(false),
+    m_offset(-1L), m_refcount(0)
 {
 }
 
 CItemAtt::CItemAtt(const CItemAtt &that) :
   CItem(that), m_entrystatus(that.m_entrystatus),
+  m_compression(that.m_compression), m_hasDigest(that.m_hasDigest),
   m_offset(that.m_offset), m_refcount(that.m_refcount)
 {
+  if (m_hasDigest)
+    memcpy(m_digest, that.m_digest, sizeof(m_digest));
 }
 
 CItemAtt::~CItemAtt()
 {
+  trashMemory(m_digest, sizeof(m_digest));
 }
 
 CItemAtt& CItemAtt::operator=(const CItemAtt &that)
@@ -52,6 +61,10 @@ CItemAtt& CItemAtt::operator=(const CItemAtt &that)
   if (this != &that) { // Check for self-assignment
     CItem::operator=(that);
     m_entrystatus = that.m_entrystatus;
+    m_compression = that.m_compression;
+    m_hasDigest = that.m_hasDigest;
+    if (m_hasDigest)
+      memcpy(m_digest, that.m_digest, sizeof(m_digest));
     m_offset = that.m_offset;
     m_refcount = that.m_refcount;
   }
@@ -128,6 +141,69 @@ void CItemAtt::SetCTime(time_t t)
 void CItemAtt::SetContent(const unsigned char *content, size_t clen)
 {
   SetField(CONTENT, content, clen);
+  PackContent();
+}
+
+void CItemAtt::SetCompression(ContentCompression cc)
+{
+  if (cc != m_compression) {
+    m_compression = cc;
+    PackContent();
+  }
+}
+
+void CItemAtt::PackContent()
+{
+  // The compressed content is kept alongside the content, so that
+  // saving doesn't recompress it each time. It's keyed by
+  // CONTENTCOMPRESSION, which is never set otherwise in the record.
+  ClearField(CONTENTCOMPRESSION);
+  if (m_compression == CC_NONE || !HasContent())
+    return;
+
+  VectorX<unsigned char> content;
+  GetField(CONTENT, content);
+  std::vector<unsigned char> packed;
+  if (PWSDeflate::Compress(content.data(), content.size(), packed)) {
+    CItem::SetField(CONTENTCOMPRESSION, packed.data(), packed.size());
+    trashMemory(packed.data(), packed.size());
+  }
+}
+
+void CItemAtt::GetContentDigest(unsigned char digest[SHA256::HASHLEN]) const
+{
+  if (!m_hasDigest) {
+    VectorX<unsigned char> content;
+    GetField(CONTENT, content);
+    SHA256 md;
+    md.Update(content.data(), content.size());
+    md.Final(m_digest);
+    m_hasDigest = true;
+  }
+  memcpy(digest, m_digest, sizeof(m_digest));
+}
+
+bool CItemAtt::IsDuplicateOf(const CItemAtt &that) const
+{
+  if (!HasContent() || GetContentLength() != that.GetContentLength() ||
+      GetTitle() != that.GetTitle() || GetFileName() != that.GetFileName() ||
+      GetMediaType() != that.GetMediaType())
+    return false;
+
+  unsigned char d1[SHA256::HASHLEN], d2[SHA256::HASHLEN];
+  GetContentDigest(d1);
+  that.GetContentDigest(d2);
+  return memcmp(d1, d2, sizeof(d1)) == 0;
+}
+
+size_t CItemAtt::GetStoredLength() const
+{
+  auto fiter = m_fields.find(CONTENTCOMPRESSION);
+
+  if (fiter != m_fields.end())
+    return fiter->second.GetLength();
+  else
+    return GetContentLength();
 }
 
 StringX CItemAtt::GetTime(int whichtime, PWSUtil::TMC result_format) const
@@ -206,6 +282,20 @@ int CItemAtt::Import(const stringT &fname)
   }
 
   SetField(CONTENT, data, flen);
+  // Only if asked for, as versions that don't know about compression
+  // can't read compressed attachments, and drop them when saving.
+  // Worth trying for any file then, as media types say little about
+  // how well the content will compress. Kept uncompressed if it doesn't.
+  m_compression = PWSprefs::GetInstance()->GetPref(PWSprefs::CompressAttachments) ?
+    CC_DEFLATE : CC_NONE;
+  PackContent();
+  // For finding other attachments with the same content (see PWScore::FindAttByContent)
+  {
+    SHA256 md;
+    md.Update(data, flen);
+    md.Final(m_digest);
+    m_hasDigest = true;
+  }
 
   // derive the file's path and name
   pws_os::splitpath(fname, sdrive, sdir, sfname, sextn);
@@ -302,11 +392,14 @@ bool CItemAtt::SetField(unsigned char type, const unsigned char *data,
     break;
   case CONTENT:
     CItem::SetField(type, data, len);
+    m_hasDigest = false;
     break;
   case ATTIV:
   case ATTEK:
   case ATTAK:
   case CONTENTHMAC:
+  case CONTENTCOMPRESSION:
+  case COMPRESSEDCONTENT:
     // These fields have no business in the record, created and used
     // solely for file i/o.
     ASSERT(0);
@@ -339,11 +432,15 @@ int CItemAtt::Read(PWSfile *in)
   unsigned char *content = nullptr;
   size_t content_len = 0;
   unsigned char expected_digest[SHA256::HASHLEN] = {0};
+  ContentCompression compression = CC_NONE; // optional, as is...
+  size_t unpacked_len = 0; // ...length of content after decompression
+  std::vector<unsigned char> packed; // the compressed content, if so
 
   unsigned char *utf8 = nullptr;
   size_t utf8Len = 0;
 
   Clear();
+  m_compression = CC_NONE;
 
   do {
     fieldLen = static_cast<signed long>(in->ReadField(type, utf8,
@@ -419,6 +516,25 @@ int CItemAtt::Read(PWSfile *in)
         memcpy(expected_digest, utf8, SHA256::HASHLEN);
         break;
       }
+      case CONTENTCOMPRESSION: {
+        ASSERT(compression == CC_NONE);
+        if (compression != CC_NONE || utf8Len != 1 + sizeof(uint32))
+          goto exit;
+        if (utf8[0] != CC_DEFLATE) {
+          status = PWSfile::UNSUPPORTED_VERSION;
+          goto exit;
+        }
+        compression = CC_DEFLATE;
+        unpacked_len = static_cast<size_t>(static_cast<uint32>(getInt32(utf8 + 1)));
+        break;
+      }
+      case COMPRESSEDCONTENT: {
+        ASSERT(packed.empty());
+        if (!packed.empty() || utf8Len == 0)
+          goto exit;
+        packed.assign(utf8, utf8 + utf8Len);
+        break;
+      }
       default: // "normal" fields
         if (!SetField(type, utf8, utf8Len))
           goto exit;
@@ -437,7 +553,26 @@ int CItemAtt::Read(PWSfile *in)
   // - Set Content field
   // - Clean-up
 
-  if (gotContent && gotAK && gotHMAC) {
+  if (compression != CC_NONE || !packed.empty()) {
+    // Compressed content is in a field of its own, instead of Content
+    // (see Write). No more than DEFLATE's maximum ratio, about 1:1032.
+    if (compression == CC_NONE || packed.empty() || gotContent ||
+        unpacked_len == 0 || unpacked_len / 1032 > packed.size()) {
+      status = PWSfile::READ_FAIL;
+    } else {
+      auto *unpacked = new unsigned char[unpacked_len];
+      if (PWSDeflate::Decompress(packed.data(), packed.size(), unpacked, unpacked_len)) {
+        SetField(CONTENT, unpacked, unpacked_len);
+        CItem::SetField(CONTENTCOMPRESSION, packed.data(), packed.size());
+        m_compression = compression;
+        status = PWSfile::SUCCESS;
+      } else {
+        status = PWSfile::READ_FAIL;
+      }
+      trashMemory(unpacked, unpacked_len);
+      delete[] unpacked;
+    }
+  } else if (gotContent && gotAK && gotHMAC) {
     unsigned char calculated_digest[SHA256::HASHLEN] = {0};
     HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
 
@@ -462,6 +597,10 @@ int CItemAtt::Read(PWSfile *in)
  exit:
   trashMemory(content, content_len);
   delete[] content;
+  if (!packed.empty())
+    trashMemory(packed.data(), packed.size());
+  trashMemory(EK, sizeof(EK));
+  trashMemory(AK, sizeof(AK));
   delete[] utf8; // if here via goto exit
 
   if (numread > 0) {
@@ -534,12 +673,31 @@ int CItemAtt::Write(PWSfile *out) const
     auto *out4 = dynamic_cast<PWSfileV4 *>(out);
     ASSERT(out4 != nullptr);
 
-    size_t clength = fiter->second.GetLength() + BlowFish::BLOCKSIZE;
-    auto *content = new unsigned char[clength];
-    CItem::GetField(fiter->second, content, clength);
-    out4->WriteContentFields(content, clength);
-    trashMemory(content, clength);
-    delete[] content;
+    auto piter = m_fields.find(CONTENTCOMPRESSION);
+    if (piter != m_fields.end()) {
+      // Method and uncompressed length, then the compressed bytes in a
+      // field of their own, instead of Content. Versions that don't know
+      // about compression skip both, and then the attachment for want of
+      // content, rather than taking the compressed bytes for it.
+      unsigned char buf[1 + sizeof(uint32)];
+      buf[0] = static_cast<unsigned char>(m_compression);
+      putInt32(buf + 1, static_cast<int32>(fiter->second.GetLength()));
+      out->WriteField(static_cast<unsigned char>(CONTENTCOMPRESSION), buf, sizeof(buf));
+
+      size_t plength = piter->second.GetLength() + BlowFish::BLOCKSIZE;
+      auto *packed = new unsigned char[plength];
+      CItem::GetField(piter->second, packed, plength);
+      out->WriteField(static_cast<unsigned char>(COMPRESSEDCONTENT), packed, plength);
+      trashMemory(packed, plength);
+      delete[] packed;
+    } else {
+      size_t clength = fiter->second.GetLength() + BlowFish::BLOCKSIZE;
+      auto *content = new unsigned char[clength];
+      CItem::GetField(fiter->second, content, clength);
+      out4->WriteContentFields(content, clength);
+      trashMemory(content, clength);
+      delete[] content;
+    }
   }
 
   if (out->WriteField(END, _T("")) > 0) {
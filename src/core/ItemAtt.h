@@ -16,6 +16,7 @@
 #include "Item.h"
 #include "../os/UUID.h"
 #include "StringX.h"
+#include "crypto/sha256.h"
 
 #include <time.h> // for time_t
 #include <bitset>
@@ -43,6 +44,9 @@ public:
   // according to section 3.4 of formatV4 specification.
   const static size_t MAX_SIZE = 4294967295U; // 2^32
 
+  // How content is stored on file. In memory it's always uncompressed.
+  enum ContentCompression {CC_NONE = 0, CC_DEFLATE = 1};
+
   // a bitset for indicating a subset of an item's fields: 
   typedef std::bitset<LAST_SEARCHABLE - START + 1> AttFieldBits;
 
@@ -85,6 +89,19 @@ public:
   size_t GetContentSize() const; // size needed for GetContent (!= len due to block cipher)
   bool GetContent(unsigned char *content, size_t csize) const;
 
+  // Compression is applied only if it makes the content smaller.
+  // Import() turns it on if the CompressAttachments preference is set,
+  // SetContent() honours the current setting.
+  void SetCompression(ContentCompression cc);
+  ContentCompression GetCompression() const {return m_compression;}
+  size_t GetStoredLength() const; // Number of bytes written to file
+
+  // SHA-256 of the content, computed by Import(), otherwise when first needed
+  void GetContentDigest(unsigned char digest[SHA256::HASHLEN]) const;
+  // Same content, title, file name and media type - UUID & times may differ.
+  // Such attachments are stored once, shared by all the entries referring to it.
+  bool IsDuplicateOf(const CItemAtt &that) const;
+
   StringX GetCTime() const { return GetTime(ATTCTIME, PWSUtil::TMC_LOCALE); }
 
   time_t GetCTime(time_t &t) const { CItem::GetTime(ATTCTIME, t); return t; }
@@ -121,6 +138,7 @@ public:
   unsigned GetRefcount() const {return m_refcount;}
   void IncRefcount() {m_refcount++;}
   void DecRefcount() {ASSERT(m_refcount > 0); m_refcount--;}
+  void SetRefcount(unsigned n) {m_refcount = n;} // for a copy of a shared one
 
   CItemAtt& operator=(const CItemAtt& second);
 
@@ -143,8 +161,12 @@ public:
 private:
   bool SetField(unsigned char type, const unsigned char *data, size_t len);
   size_t WriteIfSet(FieldType ft, PWSfile *out, bool isUTF8) const;
+  void PackContent(); // (re)compute the compressed content, if needed
 
   EntryStatus m_entrystatus;
+  ContentCompression m_compression;
+  mutable unsigned char m_digest[SHA256::HASHLEN]; // see GetContentDigest()
+  mutable bool m_hasDigest;
   long m_offset; // location on file, for lazy evaluation
   unsigned m_refcount; // how many CItemData objects refer to this?
 };
@@ -77,6 +77,23 @@ CItemData::~CItemData()
 {
 }
 
+CItemData::DecodedView::DecodedView(const CItemData &item)
+  : m_item(item), m_bActive(item.m_decoded == nullptr)
+{
+  if (m_bActive) {
+    for (auto ft : {GROUP, TITLE, USER, URL, EMAIL, POLICYNAME})
+      m_decoded.memoisable.set(ft);
+    m_item.m_decoded = &m_decoded;
+  }
+}
+
+CItemData::DecodedView::~DecodedView()
+{
+  if (m_bActive)
+    m_item.m_decoded = nullptr;
+  // m_decoded's values are wiped by their allocator
+}
+
 CItemData& CItemData::operator=(const CItemData &that)
 {
   if (this != &that) { // Check for self-assignment
@@ -2026,7 +2043,15 @@ bool CItemData::Matches(const stringT &stValue, int iObject,
 {
   ASSERT(iFunction != 0); // must be positive or negative!
 
-  auto matchCustomFields = [this, &stValue, iFunction]() -> bool {
+  return Matches(PWSMatch::StringMatcher(stValue.c_str(), iFunction), iObject);
+}
+
+bool CItemData::Matches(const PWSMatch::StringMatcher &matcher, int iObject) const
+{
+  const int iFunction = matcher.GetFunction();
+  ASSERT(iFunction != 0); // must be positive or negative!
+
+  auto matchCustomFields = [this, &matcher, iFunction]() -> bool {
     const CustomFieldList customFields = GetCustomFields();
     const bool bValue = !customFields.empty();
     if (iFunction == PWSMatch::MR_PRESENT || iFunction == PWSMatch::MR_NOTPRESENT) {
@@ -2036,8 +2061,7 @@ bool CItemData::Matches(const stringT &stValue, int iObject,
     // For custom fields we consider both the Name and the Value texts for matches
     // Differentiating between the two seems more trouble than it's worth.
     for (const CustomField &cf : customFields) {
-      if (PWSMatch::Match(stValue.c_str(), cf.GetName(), iFunction) ||
-          PWSMatch::Match(stValue.c_str(), cf.GetValue(), iFunction)) {
+      if (matcher.Match(cf.GetName()) || matcher.Match(cf.GetValue())) {
         return true;
       }
     }
@@ -2075,7 +2099,7 @@ bool CItemData::Matches(const stringT &stValue, int iObject,
     return PWSMatch::Match(bValue, iFunction);
   }
 
-  return PWSMatch::Match(stValue.c_str(), sx_Object, iFunction);
+  return matcher.Match(sx_Object);
 }
 
 bool CItemData::Matches(int num1, int num2, int iObject,
@@ -2154,29 +2178,7 @@ bool CItemData::MatchesTime(time_t time1, time_t time2, int iObject,
       return false;
   }
 
-  const bool bValue = (tValue != time_t(0));
-  if (iFunction == PWSMatch::MR_PRESENT || iFunction == PWSMatch::MR_NOTPRESENT) {
-    return PWSMatch::Match(bValue, iFunction);
-  }
-
-  if (!bValue)  // date empty - always return false for other comparisons
-    return false;
-  else {
-    time_t testtime = time_t(0);
-    if (tValue) {
-      struct tm st;
-      errno_t err;
-      err = localtime_s(&st, &tValue);
-      ASSERT(err == 0);
-      if (!err) {
-        st.tm_hour = 0;
-        st.tm_min = 0;
-        st.tm_sec = 0;
-        testtime = mktime(&st);
-      }
-    }
-    return PWSMatch::Match(time1, time2, testtime, iFunction);
-  }
+  return PWSMatch::MatchDate(tValue, time1, time2, iFunction);
 }
 
 bool CItemData::Matches(EntryType etype, int iFunction) const
@@ -76,6 +76,29 @@ public:
 
   ~CItemData();
 
+  // While in scope, the item's non-sensitive text fields (group, title,
+  // user, URL, e-mail, policy name) are decrypted at most once, and the
+  // getters return the memoised value. For code that reads the same
+  // fields over and over, e.g., sorting, comparing, filtering & exporting.
+  // Passwords, notes and other secrets are never memoised.
+  // The memoised values are wiped when the view goes out of scope.
+  // Nested views of the same item are harmless - the outermost one rules.
+  // The item must not be accessed from other threads meanwhile.
+  class DecodedView
+  {
+  public:
+    explicit DecodedView(const CItemData &item);
+    ~DecodedView();
+
+  private:
+    DecodedView(const DecodedView &) = delete;
+    DecodedView &operator=(const DecodedView &) = delete;
+
+    const CItemData &m_item;
+    DecodedFields m_decoded;
+    bool m_bActive; // false if nested in another view of m_item
+  };
+
   int Read(PWSfile *in);
   int Write(PWSfile *out) const;
   int Write(PWSfileV4 *out) const;
@@ -100,6 +123,10 @@ public:
   StringX GetName() const {return GetField(NAME);} // V17 - deprecated: replaced by GetTitle & GetUser
   StringX GetTitle() const {return GetField(TITLE);} // V20
   StringX GetUser() const  {return GetField(USER);}  // V20
+  // For comparisons in loops: no heap allocation for short values
+  void GetTitle(SecureStringX &s) const {GetField(TITLE, s);}
+  void GetUser(SecureStringX &s) const {GetField(USER, s);}
+  void GetGroup(SecureStringX &s) const {GetField(GROUP, s);}
   StringX GetPassword() const { return GetField(PASSWORD); }
   size_t GetPasswordLength() const { return GetField(PASSWORD).length(); }
 
@@ -287,6 +314,8 @@ public:
   // Predicate to determine if item matches given criteria
   bool Matches(const stringT &stValue, int iObject, 
                int iFunction) const;  // string values
+  bool Matches(const PWSMatch::StringMatcher &matcher,
+               int iObject) const;  // string values, compiled rule
   bool Matches(int num1, int num2, int iObject,
                int iFunction) const;  // integer values
   bool MatchesTime(time_t time1, time_t time2, int iObject,
@@ -419,6 +448,7 @@ public:
   void ClearPasskey();
 
 private:
+  friend class CItemDelta; // restores these as-is
   EntryType m_entrytype;
   EntryStatus m_entrystatus;
 
@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file ItemDelta.cpp
+//-----------------------------------------------------------------------------
+
+#include "ItemDelta.h"
+#include "PWSrand.h"
+#include "Util.h"
+#include "crypto/BlowFish.h"
+
+#include <memory>
+
+CItemDelta::CItemDelta(const CItemData &before, const CItemData &after)
+  : m_bURFLChanged(false)
+{
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+  std::unique_ptr<BlowFish> bf(MakeBlowFish());
+
+  // Both field maps are ordered by type, so walk them together
+  auto ib = before.m_fields.begin(), ia = after.m_fields.begin();
+  VectorX<unsigned char> vb, va;
+  while (ib != before.m_fields.end() || ia != after.m_fields.end()) {
+    if (ia == after.m_fields.end() ||
+        (ib != before.m_fields.end() && ib->first < ia->first)) {
+      m_changes.emplace_back(ib->first); // removed
+      m_changes.back().bPresent[0] = true;
+      Store(before, ib->second, bf.get(), m_changes.back().value[0]);
+      ib++;
+    } else if (ib == before.m_fields.end() || ia->first < ib->first) {
+      m_changes.emplace_back(ia->first); // added
+      m_changes.back().bPresent[1] = true;
+      Store(after, ia->second, bf.get(), m_changes.back().value[1]);
+      ia++;
+    } else {
+      Decrypt(before, ib->second, vb);
+      Decrypt(after, ia->second, va);
+      if (vb != va) { // changed
+        m_changes.emplace_back(ib->first);
+        Change &change = m_changes.back();
+        change.bPresent[0] = change.bPresent[1] = true;
+        Store(before, ib->second, bf.get(), change.value[0]);
+        Store(after, ia->second, bf.get(), change.value[1]);
+      }
+      ib++; ia++;
+    }
+  }
+
+  // Unknown fields rarely change, and are kept whole if they do
+  m_bURFLChanged = before.m_URFL.size() != after.m_URFL.size();
+  for (size_t i = 0; !m_bURFLChanged && i < before.m_URFL.size(); i++) {
+    Decrypt(before, before.m_URFL[i], vb);
+    Decrypt(after, after.m_URFL[i], va);
+    m_bURFLChanged = before.m_URFL[i].GetType() != after.m_URFL[i].GetType() ||
+                     vb != va;
+  }
+  if (m_bURFLChanged) {
+    const CItemData *pitems[2] = {&before, &after};
+    for (int i = 0; i < 2; i++) {
+      for (const auto &field : pitems[i]->m_URFL) {
+        m_URFL[i].emplace_back(field.GetType());
+        Store(*pitems[i], field, bf.get(), m_URFL[i].back());
+      }
+    }
+  }
+
+  m_et[0] = before.m_entrytype; m_et[1] = after.m_entrytype;
+  m_es[0] = before.m_entrystatus; m_es[1] = after.m_entrystatus;
+}
+
+CItemDelta::~CItemDelta()
+{
+  trashMemory(m_key, sizeof(m_key));
+}
+
+bool CItemDelta::Changes(int ft) const
+{
+  for (const auto &change : m_changes)
+    if (change.ft == ft)
+      return true;
+  return false;
+}
+
+size_t CItemDelta::GetMemoryUsage() const
+{
+  size_t usage = sizeof(*this) + m_changes.capacity() * sizeof(Change);
+  for (const auto &change : m_changes)
+    usage += change.value[0].GetSize() + change.value[1].GetSize();
+  for (const auto &urfl : m_URFL)
+    for (const auto &field : urfl)
+      usage += sizeof(field) + field.GetSize();
+  return usage;
+}
+
+BlowFish *CItemDelta::MakeBlowFish() const
+{
+  return BlowFish::MakeBlowFish(m_key, sizeof(m_key));
+}
+
+void CItemDelta::Decrypt(const CItem &src, const CItemField &field,
+                         VectorX<unsigned char> &v)
+{
+  if (field.IsEmpty())
+    v.clear();
+  else
+    src.GetField(field, v);
+}
+
+void CItemDelta::Store(const CItem &src, const CItemField &field,
+                       const BlowFish *bf, CItemField &out)
+{
+  VectorX<unsigned char> v;
+  Decrypt(src, field, v);
+  if (v.empty())
+    out = CItemField(field.GetType());
+  else
+    out.Set(v.data(), v.size(), bf, field.GetType());
+}
+
+void CItemDelta::Fetch(const CItemField &field, const BlowFish *bf,
+                       VectorX<unsigned char> &v)
+{
+  size_t length = roundUp(field.GetLength(), BlowFish::BLOCKSIZE);
+  v.resize(length);
+  if (length > 0)
+    field.Get(v.data(), length, bf);
+  v.resize(length);
+}
+
+void CItemDelta::Apply(CItemData &item, bool bRedo) const
+{
+  const int i = bRedo ? 1 : 0;
+  std::unique_ptr<BlowFish> bf(MakeBlowFish());
+  VectorX<unsigned char> v;
+
+  for (const auto &change : m_changes) {
+    if (change.bPresent[i]) {
+      Fetch(change.value[i], bf.get(), v);
+      // CItemData::SetField would parse these as from a file
+      item.CItem::SetField(change.ft, v.data(), v.size());
+    } else
+      item.ClearField(change.ft);
+  }
+
+  if (m_bURFLChanged) {
+    item.m_URFL.clear();
+    for (const auto &field : m_URFL[i]) {
+      Fetch(field, bf.get(), v);
+      item.SetUnknownField(field.GetType(), v.size(), v.data());
+    }
+  }
+
+  // Not SetEntryType(), which would also move the UUID between fields
+  item.m_entrytype = m_et[i];
+  item.m_entrystatus = m_es[i];
+}
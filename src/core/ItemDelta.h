@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ItemDelta.h
+//-----------------------------------------------------------------------------
+
+#ifndef __ITEMDELTA_H
+#define __ITEMDELTA_H
+
+#include "ItemData.h"
+
+#include <vector>
+
+/**
+ * CItemDelta records how two versions of an entry differ, for undo/redo.
+ *
+ * Rather than keeping copies of both versions, only the fields that
+ * differ are kept, with their before and after values. As with CItem,
+ * these are kept encrypted, here under the delta's own key. The cipher
+ * is only instantiated while the delta is being built or applied, as it
+ * is several times the size of a typical delta.
+ *
+ * Undo() turns an entry equal to the 'after' version into the 'before'
+ * one, Redo() the reverse. A delta from an empty CItemData holds the
+ * whole entry, for commands that need to recreate one.
+ */
+
+class BlowFish;
+
+class CItemDelta
+{
+public:
+  CItemDelta(const CItemData &before, const CItemData &after);
+  ~CItemDelta();
+
+  bool IsEmpty() const
+  {return m_changes.empty() && !m_bURFLChanged && m_et[0] == m_et[1] && m_es[0] == m_es[1];}
+  bool Changes(int ft) const;
+
+  void Undo(CItemData &item) const {Apply(item, false);}
+  void Redo(CItemData &item) const {Apply(item, true);}
+
+  // Approximate heap + object size, for undo memory accounting
+  size_t GetMemoryUsage() const;
+
+private:
+  CItemDelta(const CItemDelta &) = delete;
+  CItemDelta &operator=(const CItemDelta &) = delete;
+
+  struct Change {
+    explicit Change(int ft_) : ft(ft_), bPresent{false, false} {}
+    int ft;
+    bool bPresent[2]; // is the field in the before/after version?
+    CItemField value[2];
+  };
+
+  // Decrypt field from src (v is empty if the field is)
+  static void Decrypt(const CItem &src, const CItemField &field,
+                      VectorX<unsigned char> &v);
+  // Decrypt field from src, re-encrypt it under our key
+  static void Store(const CItem &src, const CItemField &field,
+                    const BlowFish *bf, CItemField &out);
+  // Decrypt field under our key
+  static void Fetch(const CItemField &field, const BlowFish *bf,
+                    VectorX<unsigned char> &v);
+  BlowFish *MakeBlowFish() const;
+
+  void Apply(CItemData &item, bool bRedo) const;
+
+  std::vector<Change> m_changes;
+  bool m_bURFLChanged;
+  std::vector<CItemField> m_URFL[2]; // only if unknown fields differ
+  CItemData::EntryType m_et[2];
+  CItemData::EntryStatus m_es[2];
+
+  unsigned char m_key[32];
+};
+
+#endif /* __ITEMDELTA_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -159,3 +159,24 @@ void CItemField::Get(StringX &value, const Fish *bf) const
     delete [] tempmem;
   }
 }
+
+void CItemField::Get(SecureStringX &value, const Fish *bf) const
+{
+  // Sanity check: length is 0 iff data ptr is nullptr
+  ASSERT((m_Length == 0 && m_Data == nullptr) ||
+         (m_Length > 0 && m_Data != nullptr && m_Length % sizeof(TCHAR) == 0));
+
+  value.clear();
+  if (m_Length > 0) {
+    // decrypt block by block, straight into value
+    const size_t nchars = m_Length / sizeof(TCHAR);
+    TCHAR block[8 / sizeof(TCHAR)];
+    value.reserve(nchars);
+    for (size_t x = 0; x < m_Length; x += 8) {
+      bf->Decrypt(m_Data + x, reinterpret_cast<unsigned char *>(block));
+      const size_t first = x / sizeof(TCHAR);
+      value.append(block, std::min(nchars - first, sizeof(block) / sizeof(TCHAR)));
+    }
+    trashMemory(static_cast<void *>(block), sizeof(block));
+  }
+}
@@ -12,6 +12,7 @@
 #define __ITEMFIELD_H
 
 #include "StringX.h"
+#include "SecureString.h"
 
 //-----------------------------------------------------------------------------
 
@@ -37,6 +38,7 @@ public:
   void Set(const unsigned char* value, size_t length, const Fish *bf, unsigned char type = 0xff);
 
   void Get(StringX &value, const Fish *bf) const;
+  void Get(SecureStringX &value, const Fish *bf) const; // no heap for short values
   void Get(unsigned char *value, size_t &length, const Fish *bf) const;
   unsigned char GetType() const {return m_Type;}
   size_t GetLength() const {return m_Length;}
@@ -14,8 +14,11 @@
 #include "core.h"
 
 #include "os/pws_tchar.h"
+#include "os/funcwrap.h"
 
 #include <time.h>
+#include <algorithm>
+#include <iterator>
 
 bool PWSMatch::Match(const StringX &stValue, const StringX &sx_Object,
                      const int &iFunction)
@@ -173,6 +176,110 @@ bool PWSMatch::Match(const StringX &stValue, const StringX &sx_Object,
   return true; // should never get here!
 }
 
+PWSMatch::StringMatcher::StringMatcher(const StringX &stValue, int iFunction)
+  : m_stValue(stValue), m_stNeedle(stValue), m_iFunction(iFunction),
+    m_rule(static_cast<MatchRule>(iFunction < 0 ? -iFunction : iFunction)),
+    m_bCaseSensitive(iFunction < 0)
+{
+  if (!m_bCaseSensitive)
+    ToLower(m_stNeedle);
+
+  // Horspool's bad character shifts, on the low byte of each character.
+  // Characters sharing a low byte end up with the smallest of their shifts,
+  // which is always safe.
+  const size_t n = m_stNeedle.length();
+  std::fill(std::begin(m_skip), std::end(m_skip), n);
+  for (size_t i = 0; i + 1 < n; i++)
+    m_skip[SkipIndex(m_stNeedle[i])] = n - 1 - i;
+}
+
+inline charT PWSMatch::StringMatcher::Fold(charT c) const
+{
+  // Same folding as ToLower()
+  return m_bCaseSensitive ? c : charT(_totlower(c));
+}
+
+bool PWSMatch::StringMatcher::EqualsAt(const StringX &sx_Object, size_t offset) const
+{
+  const size_t n = m_stNeedle.length();
+  for (size_t i = 0; i < n; i++) {
+    if (Fold(sx_Object[offset + i]) != m_stNeedle[i])
+      return false;
+  }
+  return true;
+}
+
+bool PWSMatch::StringMatcher::Contains(const StringX &sx_Object) const
+{
+  const size_t n = m_stNeedle.length();
+  const size_t m = sx_Object.length();
+  if (n == 0)
+    return true;
+
+  for (size_t pos = 0; pos + n <= m;) {
+    const charT last = Fold(sx_Object[pos + n - 1]);
+    if (last == m_stNeedle[n - 1] && EqualsAt(sx_Object, pos))
+      return true;
+    pos += m_skip[SkipIndex(last)];
+  }
+  return false;
+}
+
+bool PWSMatch::StringMatcher::Match(const StringX &sx_Object) const
+{
+  const StringX::size_type val_len = m_stNeedle.length();
+  const StringX::size_type obj_len = sx_Object.length();
+
+  switch (m_rule) {
+    case MR_EQUALS:
+      return obj_len == val_len && EqualsAt(sx_Object, 0);
+    case MR_NOTEQUAL:
+      return !(obj_len == val_len && EqualsAt(sx_Object, 0));
+    case MR_BEGINS:
+      return obj_len >= val_len && EqualsAt(sx_Object, 0);
+    case MR_NOTBEGIN:
+      return !(obj_len >= val_len && EqualsAt(sx_Object, 0));
+    // Following mirror Match(), where an object has to be longer than
+    // the value for it to end with it
+    case MR_ENDS:
+      return obj_len > val_len && EqualsAt(sx_Object, obj_len - val_len);
+    case MR_NOTEND:
+      return !(obj_len > val_len && EqualsAt(sx_Object, obj_len - val_len));
+    case MR_CONTAINS:
+      return Contains(sx_Object);
+    case MR_NOTCONTAIN:
+      return !Contains(sx_Object);
+    default:
+      return PWSMatch::Match(m_stValue, sx_Object, m_iFunction);
+  }
+}
+
+bool PWSMatch::MatchDate(time_t tValue, time_t time1, time_t time2, int iFunction)
+{
+  const bool bValue = (tValue != time_t(0));
+  if (iFunction == MR_PRESENT || iFunction == MR_NOTPRESENT) {
+    return Match(bValue, iFunction);
+  }
+
+  if (!bValue)  // date empty - always return false for other comparisons
+    return false;
+  else {
+    // Compare dates, not times: use midnight of the value's day
+    time_t testtime = time_t(0);
+    struct tm st;
+    errno_t err;
+    err = localtime_s(&st, &tValue);
+    ASSERT(err == 0);
+    if (!err) {
+      st.tm_hour = 0;
+      st.tm_min = 0;
+      st.tm_sec = 0;
+      testtime = mktime(&st);
+    }
+    return Match(time1, time2, testtime, iFunction);
+  }
+}
+
 bool PWSMatch::Match(const bool bValue, int iFunction)
 {
   if (bValue) {
@@ -56,6 +56,36 @@ namespace PWSMatch {
   // Generalised checking
   bool Match(const StringX &stValue, const StringX &sx_Object, const int &iFunction);
 
+  // Compiled form of the above, for matching the same value & rule against
+  // many objects: case folding of the value and the Boyer-Moore-Horspool
+  // skip table used for (NOT)CONTAINS are computed once, at construction.
+  // Rules other than (NOT)EQUALS, (NOT)BEGINS, (NOT)ENDS & (NOT)CONTAINS
+  // are passed on to Match().
+  class StringMatcher
+  {
+  public:
+    StringMatcher(const StringX &stValue, int iFunction);
+
+    bool Match(const StringX &sx_Object) const;
+    int GetFunction() const {return m_iFunction;}
+    bool IsFor(const StringX &stValue, int iFunction) const
+    {return iFunction == m_iFunction && stValue == m_stValue;}
+
+  private:
+    inline charT Fold(charT c) const;
+    static size_t SkipIndex(charT c) {return static_cast<size_t>(c) & 0xff;}
+
+    bool EqualsAt(const StringX &sx_Object, size_t offset) const;
+    bool Contains(const StringX &sx_Object) const;
+
+    StringX m_stValue;  // As given
+    StringX m_stNeedle; // Case folded if not case sensitive
+    int m_iFunction;
+    MatchRule m_rule;
+    bool m_bCaseSensitive;
+    size_t m_skip[256];
+  };
+
   template<typename T> bool Match(T v1, T v2, T value, int iFunction)
   {
     switch (iFunction) {
@@ -74,6 +104,8 @@ namespace PWSMatch {
   }
 
   bool Match(bool bValue, int iFunction);  // bool - if field present or not
+  // Date (day) comparison of a time value, as used by filters
+  bool MatchDate(time_t tValue, time_t time1, time_t time2, int iFunction);
 
   UINT GetRule(MatchRule rule);
   MatchRule GetRule(const StringX &sx_mnemonic);
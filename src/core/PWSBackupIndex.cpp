@@ -0,0 +1,189 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file PWSBackupIndex.cpp
+//-----------------------------------------------------------------------------
+
+#include "PWSBackupIndex.h"
+#include "StringX.h"
+#include "../os/dir.h"
+#include "../os/file.h"
+#include "../os/debug.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+  const char indexHeader[] = "PWSBackupIndex 1";
+
+  bool AllDigits(const stringT &s, size_t from, size_t n)
+  {
+    for (size_t i = from; i < from + n; i++)
+      if (s[i] < _T('0') || s[i] > _T('9'))
+        return false;
+    return true;
+  }
+
+  // "nnn"
+  bool IsNumbered(const stringT &suffix)
+  {
+    return suffix.length() == 3 && AllDigits(suffix, 0, 3);
+  }
+
+  // "YYYYMMDD_HHMMSS"
+  bool IsDateTime(const stringT &suffix)
+  {
+    return suffix.length() == 15 && AllDigits(suffix, 0, 8) &&
+      suffix[8] == _T('_') && AllDigits(suffix, 9, 6);
+  }
+
+  // Numbered backups first, as they were made before any switch to
+  // date-time ones when _999 was reached. Both sort as text.
+  bool OlderThan(const stringT &a, const stringT &b)
+  {
+    if (a.length() != b.length())
+      return a.length() < b.length();
+    return a < b;
+  }
+} // anonymous namespace
+
+PWSBackupIndex::PWSBackupIndex(const stringT &prefix)
+  : m_prefix(prefix)
+{
+  if (!Load() || !IsUpToDate())
+    Rebuild();
+}
+
+stringT PWSBackupIndex::GetIndexFileName(const stringT &prefix)
+{
+  return prefix + _T(".ibak.idx");
+}
+
+stringT PWSBackupIndex::GetBackupName(const stringT &suffix) const
+{
+  return m_prefix + _T("_") + suffix + _T(".ibak");
+}
+
+stringT PWSBackupIndex::NextNumber() const
+{
+  auto last = std::find_if(m_suffixes.rbegin(), m_suffixes.rend(), IsNumbered);
+  if (last == m_suffixes.rend())
+    return _T("001");
+  const int n = std::stoi(*last);
+  if (n >= 999)
+    return stringT();
+  stringT next;
+  Format(next, _T("%03d"), n + 1);
+  return next;
+}
+
+std::vector<stringT> PWSBackupIndex::Add(const stringT &suffix, size_t maxBackups)
+{
+  if (maxBackups == 0)
+    maxBackups = 1;
+  // a date-time suffix repeats if saved twice within a second
+  if (m_suffixes.empty() || m_suffixes.back() != suffix)
+    m_suffixes.push_back(suffix);
+
+  std::vector<stringT> excess;
+  if (m_suffixes.size() > maxBackups) {
+    const auto n = m_suffixes.size() - maxBackups;
+    for (auto iter = m_suffixes.begin(); iter != m_suffixes.begin() + n; iter++)
+      excess.push_back(GetBackupName(*iter));
+    m_suffixes.erase(m_suffixes.begin(), m_suffixes.begin() + n);
+  }
+  Save();
+  return excess;
+}
+
+bool PWSBackupIndex::Load()
+{
+  std::FILE *fd = pws_os::FOpen(GetIndexFileName(m_prefix), _T("r"));
+  if (fd == nullptr)
+    return false;
+
+  bool ok = false;
+  char line[64];
+  if (std::fgets(line, sizeof(line), fd) != nullptr &&
+      std::strncmp(line, indexHeader, sizeof(indexHeader) - 1) == 0) {
+    ok = true;
+    while (std::fgets(line, sizeof(line), fd) != nullptr) {
+      size_t len = std::strlen(line);
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        len--;
+      const stringT suffix(line, line + len);
+      if (!IsNumbered(suffix) && !IsDateTime(suffix)) {
+        ok = false;
+        break;
+      }
+      m_suffixes.push_back(suffix);
+    }
+  }
+  pws_os::FClose(fd, false);
+  if (!ok)
+    m_suffixes.clear();
+  return ok;
+}
+
+bool PWSBackupIndex::IsUpToDate() const
+{
+  if (m_suffixes.empty())
+    return false; // never written so, cheap to check
+  if (!pws_os::FileExists(GetBackupName(m_suffixes.back())))
+    return false;
+  // made by a version that didn't keep the index?
+  const stringT next = NextNumber();
+  return next.empty() || !pws_os::FileExists(GetBackupName(next));
+}
+
+void PWSBackupIndex::Rebuild()
+{
+  // Date-time backups are only rotated once recorded here. Earlier versions
+  // never deleted them, so any the listing finds are the user's to keep.
+  std::vector<stringT> recorded;
+  for (const auto &suffix : m_suffixes)
+    if (IsDateTime(suffix) && pws_os::FileExists(GetBackupName(suffix)))
+      recorded.push_back(suffix);
+  m_suffixes.clear();
+
+  // FindFiles returns names sans directory
+  stringT drv, dir, name, ext;
+  pws_os::splitpath(m_prefix, drv, dir, name, ext);
+  const stringT start = name + ext + _T("_");
+
+  std::vector<stringT> files;
+  pws_os::FindFiles(m_prefix + _T("_*.ibak"), files);
+  for (const auto &file : files) {
+    if (file.length() < start.length() + 5 || file.compare(0, start.length(), start) != 0)
+      continue;
+    const stringT suffix = file.substr(start.length(), file.length() - start.length() - 5);
+    if (IsNumbered(suffix))
+      m_suffixes.push_back(suffix);
+  }
+  m_suffixes.insert(m_suffixes.end(), recorded.begin(), recorded.end());
+  std::sort(m_suffixes.begin(), m_suffixes.end(), OlderThan);
+  pws_os::Trace(_T("PWSBackupIndex: rebuilt %ls with %d backups\n"),
+                m_prefix.c_str(), static_cast<int>(m_suffixes.size()));
+}
+
+void PWSBackupIndex::Save() const
+{
+  std::FILE *fd = pws_os::FOpen(GetIndexFileName(m_prefix), _T("w"));
+  if (fd == nullptr) {
+    // Not fatal: the next backup will rebuild it
+    pws_os::Trace(_T("PWSBackupIndex: can't write %ls\n"),
+                  GetIndexFileName(m_prefix).c_str());
+    return;
+  }
+  std::fprintf(fd, "%s\n", indexHeader);
+  for (const auto &suffix : m_suffixes) {
+    const std::string line(suffix.begin(), suffix.end()); // only digits and '_'
+    std::fprintf(fd, "%s\n", line.c_str());
+  }
+  pws_os::FClose(fd, false); // no need to sync, it's rebuilt if lost
+}
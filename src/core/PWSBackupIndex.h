@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+#ifndef _PWSBACKUPINDEX_H
+#define _PWSBACKUPINDEX_H
+
+/**
+ * \file PWSBackupIndex.h
+ *
+ * Rotation of the intermediate backups PWScore::BackupCurFile makes before
+ * each save, named <prefix>_nnn.ibak or <prefix>_YYYYMMDD_HHMMSS.ibak.
+ *
+ * The backups are recorded, oldest first, in a small index file beside
+ * them, <prefix>.ibak.idx, so that choosing the next name and the ones to
+ * prune doesn't need a listing of the backup directory, which can be slow
+ * on a network share holding thousands of files. The index is rebuilt from
+ * a listing when it's missing or unreadable, or found to be out of date:
+ * the latest backup it records is gone, or the next numbered one exists.
+ * Only numbered backups are picked up from the listing: date-time ones
+ * weren't rotated before there was an index, so only those it has recorded
+ * are ever deleted.
+ */
+
+#include "../os/typedefs.h"
+
+#include <vector>
+
+class PWSBackupIndex
+{
+public:
+  // prefix is the backups' directory and name, e.g. "/home/me/pwsafe"
+  explicit PWSBackupIndex(const stringT &prefix);
+
+  // Suffix of the next numbered backup: "001" after the last, or
+  // empty if that's "999"
+  stringT NextNumber() const;
+
+  // Records the backup with this suffix as the latest, and returns the
+  // names of those to be deleted to keep at most maxBackups, including it
+  std::vector<stringT> Add(const stringT &suffix, size_t maxBackups);
+
+  // Suffixes of the backups, oldest first
+  const std::vector<stringT> &GetSuffixes() const {return m_suffixes;}
+
+  static stringT GetIndexFileName(const stringT &prefix);
+
+private:
+  bool Load();
+  void Rebuild();
+  void Save() const;
+  bool IsUpToDate() const;
+  stringT GetBackupName(const stringT &suffix) const;
+
+  stringT m_prefix;
+  std::vector<stringT> m_suffixes;
+};
+
+#endif /* _PWSBACKUPINDEX_H */
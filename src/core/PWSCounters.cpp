@@ -0,0 +1,200 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file PWSCounters.cpp
+//-----------------------------------------------------------------------------
+
+#include "PWSCounters.h"
+#include "StringXStream.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+
+namespace {
+  // Names are stable, as support may have scripts reading the JSON
+  const char *counterNames[PWSCounters::NUM_COUNTERS] = {
+    "files_read", "files_written", "records_read", "records_written",
+    "bytes_decrypted", "bytes_encrypted",
+  };
+
+  const char *gaugeNames[PWSCounters::NUM_GAUGES] = {
+    "undo_commands", "undo_memory",
+  };
+
+  const char *timerNames[PWSCounters::NUM_TIMERS] = {
+    "read_file", "read_file_open", "read_file_records", "read_file_validate",
+    "write_file", "write_file_open", "write_file_records", "write_file_close",
+    "write_file_commit", "stretch_key", "search",
+  };
+
+  struct AtomicTimer {
+    std::atomic<uint64> count, totalNs, maxNs;
+    std::atomic<uint64> buckets[PWSCounters::NUM_BUCKETS];
+  };
+
+  // Zero initialized, being static
+  std::atomic<uint64> counters[PWSCounters::NUM_COUNTERS];
+  std::atomic<uint64> gauges[PWSCounters::NUM_GAUGES];
+  AtomicTimer timers[PWSCounters::NUM_TIMERS];
+
+  unsigned Bucket(uint64 ns)
+  {
+    uint64 us = ns / 1000;
+    unsigned i = 0;
+    while (us != 0 && i < PWSCounters::NUM_BUCKETS - 1) {
+      us >>= 1;
+      i++;
+    }
+    return i;
+  }
+
+  void AppendMs(std::string &s, uint64 ns)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f", ns / 1e6);
+    s += buf;
+  }
+}
+
+uint64 PWSCounters::Now()
+{
+  return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void PWSCounters::Add(Counter c, uint64 n)
+{
+  counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+void PWSCounters::Set(Gauge g, uint64 value)
+{
+  gauges[g].store(value, std::memory_order_relaxed);
+}
+
+void PWSCounters::Record(Timer t, uint64 ns)
+{
+  AtomicTimer &timer = timers[t];
+  timer.count.fetch_add(1, std::memory_order_relaxed);
+  timer.totalNs.fetch_add(ns, std::memory_order_relaxed);
+  timer.buckets[Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+  uint64 max = timer.maxNs.load(std::memory_order_relaxed);
+  while (ns > max &&
+         !timer.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    ;
+}
+
+void PWSCounters::Reset()
+{
+  for (auto &c : counters)
+    c = 0;
+  for (auto &t : timers) {
+    t.count = 0; t.totalNs = 0; t.maxNs = 0;
+    for (auto &b : t.buckets)
+      b = 0;
+  }
+}
+
+uint64 PWSCounters::Get(Counter c)
+{
+  return counters[c].load(std::memory_order_relaxed);
+}
+
+uint64 PWSCounters::Get(Gauge g)
+{
+  return gauges[g].load(std::memory_order_relaxed);
+}
+
+PWSCounters::TimerStats PWSCounters::Get(Timer t)
+{
+  const AtomicTimer &timer = timers[t];
+  TimerStats stats;
+  stats.count = timer.count.load(std::memory_order_relaxed);
+  stats.totalNs = timer.totalNs.load(std::memory_order_relaxed);
+  stats.maxNs = timer.maxNs.load(std::memory_order_relaxed);
+  for (int i = 0; i < NUM_BUCKETS; i++)
+    stats.buckets[i] = timer.buckets[i].load(std::memory_order_relaxed);
+  return stats;
+}
+
+const char *PWSCounters::GetName(Counter c) {return counterNames[c];}
+const char *PWSCounters::GetName(Gauge g) {return gaugeNames[g];}
+const char *PWSCounters::GetName(Timer t) {return timerNames[t];}
+
+StringX PWSCounters::GetSummary()
+{
+  oStringXStream os;
+  os << std::fixed << std::setprecision(1);
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    const uint64 n = Get(Counter(i));
+    if (n != 0)
+      os << counterNames[i] << _T(": ") << n << std::endl;
+  }
+  for (int i = 0; i < NUM_GAUGES; i++)
+    os << gaugeNames[i] << _T(": ") << Get(Gauge(i)) << std::endl;
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    const TimerStats stats = Get(Timer(i));
+    if (stats.count == 0)
+      continue;
+    os << timerNames[i] << _T(": ") << stats.count << _T(" in ")
+       << stats.totalNs / 1e6 << _T(" ms (average ")
+       << stats.totalNs / 1e6 / stats.count << _T(" ms, max ")
+       << stats.maxNs / 1e6 << _T(" ms)") << std::endl;
+  }
+  return os.str();
+}
+
+std::string PWSCounters::GetJSON()
+{
+  std::string json("{\n\"counters\":{");
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    json += (i == 0) ? "\"" : ",\"";
+    json += counterNames[i];
+    json += "\":" + std::to_string(Get(Counter(i)));
+  }
+  json += "},\n\"gauges\":{";
+  for (int i = 0; i < NUM_GAUGES; i++) {
+    json += (i == 0) ? "\"" : ",\"";
+    json += gaugeNames[i];
+    json += "\":" + std::to_string(Get(Gauge(i)));
+  }
+  json += "},\n\"timers\":{";
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    const TimerStats stats = Get(Timer(i));
+    json += (i == 0) ? "\n\"" : ",\n\"";
+    json += timerNames[i];
+    json += "\":{\"count\":" + std::to_string(stats.count);
+    json += ",\"total_ms\":";
+    AppendMs(json, stats.totalNs);
+    json += ",\"max_ms\":";
+    AppendMs(json, stats.maxNs);
+    // Only buckets that aren't empty, keyed by their upper bound in us
+    json += ",\"histogram_us\":{";
+    bool bFirst = true;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+      if (stats.buckets[b] == 0)
+        continue;
+      json += bFirst ? "\"" : ",\"";
+      bFirst = false;
+      json += (b == NUM_BUCKETS - 1) ? std::string("inf") : std::to_string(uint64(1) << b);
+      json += "\":" + std::to_string(stats.buckets[b]);
+    }
+    json += "}}";
+  }
+  json += "\n}\n}\n";
+  return json;
+}
+
+void PWSCounters::Timing::Stop()
+{
+  if (!m_bStopped) {
+    m_bStopped = true;
+    Record(m_timer, Now() - m_start);
+  }
+}
@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+#ifndef _PWSCOUNTERS_H
+#define _PWSCOUNTERS_H
+
+/**
+ * \file PWSCounters.h
+ *
+ * Process wide performance counters, always on, so that support can see
+ * how long opening, saving and searching take on a user's database
+ * without a debugger or a special build.
+ *
+ * There are three kinds:
+ * - Counters, which only go up (records read, bytes decrypted...)
+ * - Gauges, which hold the latest value set (undo memory...)
+ * - Timers, which keep a count, total, maximum and a histogram of the
+ *   durations recorded, in power of two microsecond buckets.
+ *
+ * All are atomics, so recording takes no locks. PWScore::GetPerfStats()
+ * and GetPerfStatsJSON() report them, with that core's gauges updated.
+ *
+ * Usage:
+ *   PWSCounters::Timing timing(PWSCounters::ReadFileOpen);
+ *   ... // open
+ *   timing.Next(PWSCounters::ReadFileRecords);
+ *   ... // read
+ *   // recorded when timing goes out of scope, or by timing.Stop()
+ */
+
+#include "../os/typedefs.h"
+#include "StringX.h"
+
+#include <string>
+
+class PWSCounters
+{
+public:
+  enum Counter {FilesRead, FilesWritten, RecordsRead, RecordsWritten,
+                BytesDecrypted, BytesEncrypted, NUM_COUNTERS};
+
+  enum Gauge {UndoCommands, UndoMemory, NUM_GAUGES};
+
+  enum Timer {ReadFileTotal, ReadFileOpen, ReadFileRecords, ReadFileValidate,
+              WriteFileTotal, WriteFileOpen, WriteFileRecords, WriteFileClose,
+              WriteFileCommit, StretchKey, Search, NUM_TIMERS};
+
+  // Bucket 0 is < 1us, bucket i (i > 0) is [2^(i-1), 2^i) us,
+  // the last one also holds anything longer.
+  enum {NUM_BUCKETS = 24};
+
+  struct TimerStats {
+    uint64 count;
+    uint64 totalNs;
+    uint64 maxNs;
+    uint64 buckets[NUM_BUCKETS];
+  };
+
+  static void Add(Counter c, uint64 n = 1);
+  static void Set(Gauge g, uint64 value);
+  static void Record(Timer t, uint64 ns);
+  static void Reset(); // all but the gauges
+
+  static uint64 Get(Counter c);
+  static uint64 Get(Gauge g);
+  static TimerStats Get(Timer t);
+
+  static const char *GetName(Counter c);
+  static const char *GetName(Gauge g);
+  static const char *GetName(Timer t);
+
+  // One line per counter, gauge or timer used so far
+  static StringX GetSummary();
+  // Everything, as a JSON object (UTF-8)
+  static std::string GetJSON();
+
+  // Records the time from construction (or Next()) to Stop() (or destruction)
+  class Timing
+  {
+  public:
+    explicit Timing(Timer t) : m_timer(t), m_start(Now()), m_bStopped(false) {}
+    ~Timing() {Stop();}
+    void Stop();
+    void Next(Timer t) {Stop(); m_timer = t; m_start = Now(); m_bStopped = false;}
+
+  private:
+    Timing(const Timing &) = delete;
+    Timing &operator=(const Timing &) = delete;
+
+    Timer m_timer;
+    uint64 m_start;
+    bool m_bStopped;
+  };
+
+private:
+  static uint64 Now(); // ns
+};
+
+#endif /* _PWSCOUNTERS_H */
@@ -959,10 +959,17 @@ void PWSFilterManager::CreateGroups()
   vfiltergroup group;
   vfiltergroups groups;
 
+  // Prepare string rules once, rather than per entry in PassesFiltering
+  m_vMatchers.clear();
+  m_vMatchers.reserve(m_currentfilter.vMfldata.size());
+
   // Do the main filters
   for (auto iter = m_currentfilter.vMfldata.begin();
        iter != m_currentfilter.vMfldata.end(); iter++) {
     const st_FilterRow &st_fldata = *iter;
+    const auto ifunction = static_cast<int>(st_fldata.rule);
+    m_vMatchers.push_back(PWSMatch::StringMatcher(st_fldata.fstring,
+                                                  st_fldata.fcase ? -ifunction : ifunction));
 
     if (st_fldata.bFilterActive) {
       if (st_fldata.ltype == LC_OR && !group.empty()) {
@@ -1106,6 +1113,26 @@ void PWSFilterManager::SetFilterFindEntries(const UUIDVector *pvFoundUUIDs)
     m_vFltrFoundUUIDs = *pvFoundUUIDs;
 }
 
+// Only rules that require the value to be present can be decided by the
+// search index, and only on the fields it covers
+static bool IsRuleNarrowedByIndex(PWSMatch::MatchType mt, FieldType ft,
+                                  int ifunction, const PWScore &core)
+{
+  if (mt != PWSMatch::MT_STRING || core.GetSearchIndex() == nullptr ||
+      !CSearchIndex::IsIndexedField(ft))
+    return false;
+
+  switch (ifunction) {
+    case PWSMatch::MR_EQUALS:
+    case PWSMatch::MR_BEGINS:
+    case PWSMatch::MR_ENDS:
+    case PWSMatch::MR_CONTAINS:
+      return true;
+    default:
+      return false;
+  }
+}
+
 bool PWSFilterManager::PassesFiltering(const CItemData &ci, const PWScore &core)
 {
   bool thistest_rc;
@@ -1122,6 +1149,7 @@ bool PWSFilterManager::PassesFiltering(const CItemData &ci, const PWScore &core)
   }
 
   const CItemData::EntryType entrytype = ci.GetEntryType();
+  CItemData::DecodedView view(ci); // several rows may test the same field
 
   for (auto groups_iter = m_vMflgroups.begin();
        groups_iter != m_vMflgroups.end(); groups_iter++) {
@@ -1254,8 +1282,22 @@ bool PWSFilterManager::PassesFiltering(const CItemData &ci, const PWScore &core)
           // Note: purpose drop through to standard 'string' processing
           [[fallthrough]];
         case PWSMatch::MT_STRING:
-          thistest_rc = pci->Matches(st_fldata.fstring.c_str(), static_cast<int>(ft),
-                                 st_fldata.fcase ? -ifunction : ifunction);
+          if (IsRuleNarrowedByIndex(mt, ft, ifunction, core) &&
+              !core.GetSearchIndex()->MayContain(pci->GetUUID(),
+                                                 static_cast<CItemData::FieldType>(ft),
+                                                 st_fldata.fstring.c_str())) {
+            // Index says the value isn't there - no need to decrypt the field
+            thistest_rc = false;
+          } else {
+            const int iMatchFunction = st_fldata.fcase ? -ifunction : ifunction;
+            // Filter may have been changed since CreateGroups was last called
+            if (static_cast<size_t>(num) < m_vMatchers.size() &&
+                m_vMatchers[num].IsFor(st_fldata.fstring, iMatchFunction))
+              thistest_rc = pci->Matches(m_vMatchers[num], static_cast<int>(ft));
+            else
+              thistest_rc = pci->Matches(st_fldata.fstring.c_str(), static_cast<int>(ft),
+                                         iMatchFunction);
+          }
           tests++;
           break;
         case PWSMatch::MT_INTEGER:
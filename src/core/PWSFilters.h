@@ -413,6 +413,9 @@ class PWSFilterManager {
 
    vfiltergroups m_vMflgroups, m_vHflgroups, m_vPflgroups, m_vAflgroups;
 
+   // Compiled string rules of m_currentfilter.vMfldata, set up by CreateGroups
+   std::vector<PWSMatch::StringMatcher> m_vMatchers;
+
    // predefined filters, set up at c'tor
    st_filters m_expirefilter, m_unsavedfilter, m_lastfoundfilter;
 
@@ -15,9 +15,11 @@ using namespace std;
 #define NUM_LOG_ENTRIES 256
 
 PWSLog *PWSLog::self = nullptr;
+std::mutex PWSLog::selfMutex;
 
 PWSLog *PWSLog::GetLog()
 {
+  std::lock_guard<std::mutex> guard(selfMutex);
   if (self == nullptr) {
     self = new PWSLog();
     // The following sets the queue size once, avoiding
@@ -29,6 +31,7 @@ PWSLog *PWSLog::GetLog()
 
 void PWSLog::DeleteLog()
 {
+  std::lock_guard<std::mutex> guard(selfMutex);
   delete self;
   self = nullptr;
 }
@@ -39,9 +42,11 @@ void PWSLog::Add(const stringT &sLogRecord)
   stringT sTimeStamp;
   PWSUtil::GetTimeStamp(sTimeStamp);
 
+  const stringT sRecord = sTimeStamp + sb + sLogRecord;
+  std::lock_guard<std::mutex> guard(m_mutex);
   // m_log preloaded, so pop_front is always valid (see GetLog).
   m_log.pop_front();
-  m_log.push_back(sTimeStamp + sb + sLogRecord);
+  m_log.push_back(sRecord);
 }
 
 stringT PWSLog::DumpLog() const
@@ -52,6 +57,8 @@ stringT PWSLog::DumpLog() const
   // Start with header for Userstream
   stLog << sHeader;
 
+  std::lock_guard<std::mutex> guard(m_mutex);
+
   // Then total number of records
   stLog << m_log.size() << _T(" ");
 
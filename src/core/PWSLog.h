@@ -14,6 +14,7 @@
 
 #include <cassert>
 #include <deque>
+#include <mutex>
 
 #define PWS_LOGIT_CONCAT(str) PWS_LOGIT_HEADER L ## str
 
@@ -25,13 +26,15 @@
                                                               __FILE__, __FUNCTION__, __VA_ARGS__))
 
 
+// Add() may be called from any thread, e.g., by a background save
 class PWSLog
 {
 public:
   virtual ~PWSLog() {}
 
   static PWSLog *GetLog(); // singleton
-  static void SetInstance(PWSLog *custom) { assert(self == nullptr); self = custom; }
+  static void SetInstance(PWSLog *custom)
+  { std::lock_guard<std::mutex> guard(selfMutex); assert(self == nullptr); self = custom; }
   static void DeleteLog();
   
   virtual void Add(const stringT &sLogRecord);
@@ -41,6 +44,8 @@ protected:
   PWSLog() {}
 private:
   static PWSLog *self;
+  static std::mutex selfMutex; // for creating self
+  mutable std::mutex m_mutex; // for m_log
   std::deque<stringT> m_log;
 };
 
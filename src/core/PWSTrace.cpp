@@ -0,0 +1,220 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file PWSTrace.cpp
+//-----------------------------------------------------------------------------
+
+#include "PWSTrace.h"
+#include "../os/env.h"
+#include "../os/file.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> PWSTrace::s_bEnabled(false);
+
+namespace {
+  const size_t RING_SIZE = 2048; // events per thread
+
+  struct Event {
+    const char *name;
+    int64 arg;
+    uint64 start, dur; // ns
+  };
+
+  // A ring slot, read while its thread may be overwriting it. A seqlock:
+  // seq is 2n+1 while event n is being written to it, 2n+2 once it's
+  // there, so a reader knows it copied all of event n if seq was 2n+2
+  // both before and after. The fields are atomic so that a torn read is
+  // merely discarded rather than a data race.
+  struct Slot {
+    std::atomic<uint64> seq{0};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<int64> arg{0};
+    std::atomic<uint64> start{0}, dur{0};
+
+    void Write(uint64 n, const Event &event)
+    {
+      seq.store(2 * n + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      name.store(event.name, std::memory_order_relaxed);
+      arg.store(event.arg, std::memory_order_relaxed);
+      start.store(event.start, std::memory_order_relaxed);
+      dur.store(event.dur, std::memory_order_relaxed);
+      seq.store(2 * n + 2, std::memory_order_release);
+    }
+
+    bool Read(uint64 n, Event &event) const
+    {
+      if (seq.load(std::memory_order_acquire) != 2 * n + 2)
+        return false; // overwritten, or being written
+      event.name = name.load(std::memory_order_relaxed);
+      event.arg = arg.load(std::memory_order_relaxed);
+      event.start = start.load(std::memory_order_relaxed);
+      event.dur = dur.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return seq.load(std::memory_order_relaxed) == 2 * n + 2;
+    }
+  };
+
+  // Written only by the thread using it. head counts events ever
+  // recorded, the latest RING_SIZE of which are kept.
+  struct Ring {
+    Slot slots[RING_SIZE];
+    std::atomic<uint64> head{0};
+    std::atomic<bool> bInUse{false};
+    unsigned tid = 0;
+  };
+
+  // Rings aren't freed when their thread ends, so that what it recorded
+  // can still be exported, but are reused by later threads.
+  struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    uint64 cutoff = 0; // see Clear()
+  };
+
+  Registry &GetRegistry()
+  {
+    static Registry *registry = new Registry; // never deleted, threads may outlive statics
+    return *registry;
+  }
+
+  struct RingHolder {
+    Ring *ring = nullptr;
+    ~RingHolder() {if (ring != nullptr) ring->bInUse = false;}
+  };
+
+  Ring *GetRing()
+  {
+    thread_local RingHolder holder;
+    if (holder.ring == nullptr) {
+      Registry &registry = GetRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (auto &ring : registry.rings) {
+        if (!ring->bInUse) {
+          holder.ring = ring.get();
+          break;
+        }
+      }
+      if (holder.ring == nullptr) {
+        registry.rings.emplace_back(new Ring);
+        holder.ring = registry.rings.back().get();
+        holder.ring->tid = static_cast<unsigned>(registry.rings.size());
+      }
+      holder.ring->bInUse = true;
+    }
+    return holder.ring;
+  }
+
+  void AppendMicroseconds(std::string &s, uint64 ns)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu.%03u",
+             static_cast<unsigned long long>(ns / 1000), static_cast<unsigned>(ns % 1000));
+    s += buf;
+  }
+}
+
+uint64 PWSTrace::Now()
+{
+  static const auto epoch = std::chrono::steady_clock::now();
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch).count();
+  return static_cast<uint64>(ns) + 1;
+}
+
+void PWSTrace::Enable(bool bEnable)
+{
+  Now(); // start the clock
+  s_bEnabled = bEnable;
+}
+
+void PWSTrace::Clear()
+{
+  Registry &registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.cutoff = Now();
+}
+
+stringT PWSTrace::EnableFromEnvironment()
+{
+  const stringT filename = pws_os::getenv("PWS_TRACE", false);
+  if (!filename.empty())
+    Enable(true);
+  return filename;
+}
+
+void PWSTrace::Span::End()
+{
+  if (!IsEnabled())
+    return;
+  Ring *ring = GetRing();
+  const uint64 head = ring->head.load(std::memory_order_relaxed);
+  const Event event = {m_name, m_arg, m_start, Now() - m_start};
+  ring->slots[head % RING_SIZE].Write(head, event);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+std::string PWSTrace::GetChromeTrace()
+{
+  std::string json("{\"traceEvents\":[");
+  bool bFirst = true;
+  std::vector<Event> events;
+
+  Registry &registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto &ring : registry.rings) {
+    // Copy without stopping the ring's thread, dropping whatever it
+    // overwrites meanwhile, see Slot.
+    const uint64 head = ring->head.load(std::memory_order_acquire);
+    const uint64 first = head > RING_SIZE ? head - RING_SIZE : 0;
+    events.clear();
+    for (uint64 i = first; i < head; i++) {
+      Event event;
+      if (ring->slots[i % RING_SIZE].Read(i, event))
+        events.push_back(event);
+    }
+
+    for (const Event &event : events) {
+      if (event.start < registry.cutoff)
+        continue;
+      if (!bFirst)
+        json += ",";
+      bFirst = false;
+      json += "\n{\"name\":\"";
+      json += event.name;
+      json += "\",\"cat\":\"pwsafe\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+      json += std::to_string(ring->tid);
+      json += ",\"ts\":";
+      AppendMicroseconds(json, event.start);
+      json += ",\"dur\":";
+      AppendMicroseconds(json, event.dur);
+      if (event.arg >= 0) {
+        json += ",\"args\":{\"n\":";
+        json += std::to_string(event.arg);
+        json += "}";
+      }
+      json += "}";
+    }
+  }
+  json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return json;
+}
+
+bool PWSTrace::ExportChromeTrace(const stringT &filename)
+{
+  const std::string json = GetChromeTrace();
+  FILE *fp = pws_os::FOpen(filename, _T("wb"));
+  if (fp == nullptr)
+    return false;
+  const bool bOK = fwrite(json.data(), 1, json.size(), fp) == json.size();
+  return pws_os::FClose(fp, true) == 0 && bOK;
+}
@@ -0,0 +1,75 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+#ifndef _PWSTRACE_H
+#define _PWSTRACE_H
+
+/**
+ * \file PWSTrace.h
+ *
+ * Timing of hot paths, for profiling real sessions.
+ *
+ * Unlike PWS_LOGIT, which formats strings, a span just records its
+ * name (a string literal), start, duration and an optional count in a
+ * fixed size binary event, in a ring buffer belonging to the thread.
+ * Recording takes no locks, and while tracing is off, a span costs a
+ * single flag test.
+ *
+ * ExportChromeTrace() writes what the rings hold in the Chrome trace
+ * event format, for chrome://tracing or https://ui.perfetto.dev
+ *
+ * Usage:
+ *   PWSTrace::Span span("ReadFile");
+ *   ...
+ *   span.SetArg(numEntries); // optional
+ */
+
+#include "../os/typedefs.h"
+
+#include <atomic>
+#include <string>
+
+class PWSTrace
+{
+public:
+  static void Enable(bool bEnable);
+  static bool IsEnabled() {return s_bEnabled.load(std::memory_order_relaxed);}
+  static void Clear(); // discard what's been recorded so far
+
+  // Chrome trace event JSON (UTF-8) for what the rings hold
+  static std::string GetChromeTrace();
+  static bool ExportChromeTrace(const stringT &filename);
+
+  // Starts & enables tracing if the PWS_TRACE environment variable is set,
+  // returning its value, the file to export to.
+  static stringT EnableFromEnvironment();
+
+  class Span
+  {
+  public:
+    explicit Span(const char *name)
+      : m_name(name), m_arg(-1), m_start(IsEnabled() ? Now() : 0) {}
+    ~Span() {if (m_start != 0) End();}
+    void SetArg(int64 arg) {m_arg = arg;}
+
+  private:
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+    void End();
+
+    const char *m_name;
+    int64 m_arg;
+    uint64 m_start;
+  };
+
+private:
+  static uint64 Now(); // ns, never 0
+  static std::atomic<bool> s_bEnabled;
+};
+
+#endif /* _PWSTRACE_H */
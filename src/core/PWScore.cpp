@@ -12,8 +12,11 @@
 #include "core.h"
 #include "crypto/TwoFish.h"
 #include "PWSprefs.h"
+#include "PWSBackupIndex.h"
 #include "PWHistory.h"
 #include "PWSLog.h"
+#include "PWSCounters.h"
+#include "PWSTrace.h"
 #include "PWSrand.h"
 #include "Util.h"
 #include "SysInfo.h"
@@ -41,6 +44,8 @@
 #include <set>
 #include <iterator>
 #include <map>
+#include <atomic>
+#include <memory>
 
 const TCHAR *PWScore::GROUPTITLEUSERINCHEVRONS = _T("\xab%ls\xbb \xab%ls\xbb \xab%ls\xbb");
 
@@ -53,6 +58,7 @@ stringT PWScore::StatusText(int s)
    {CANT_GET_LOCK, _T("Couldn't acquire lock")},
    {DB_HAS_CHANGED, _T("Database has changed")},
    {CANT_OPEN_FILE, _T("Can't open file")},
+   {OUT_OF_MEMORY, _T("Not enough memory")},
    {USER_CANCEL, _T("User cancelled")},
    {WRONG_PASSWORD, _T("Wrong password")},
    {BAD_DIGEST, _T("Bad digest")},
@@ -90,6 +96,24 @@ Reporter *PWScore::m_pReporter = nullptr;
 
 //-----------------------------------------------------------------
 
+// What a successful CheckPasskey found, so that a ReadFile of the same
+// file with the same passkey can skip the key stretching.
+struct st_VerifiedKey {
+  StringX filename;
+  PWSfile::VERSION version;
+  PWSKeyMaterial km;
+  bool bACP; // passkey was encoded in the ANSI code page
+  std::vector<unsigned char> passkey; // see PWScore::EncryptPassKey()
+
+  st_VerifiedKey() : version(PWSfile::UNKNOWN_VERSION), bACP(false) {}
+  ~st_VerifiedKey() {if (!passkey.empty()) trashMemory(passkey.data(), passkey.size());}
+
+  bool Matches(const StringX &a_filename, const std::vector<unsigned char> &a_passkey) const
+  {
+    return a_filename == filename && a_passkey == passkey;
+  }
+};
+
 PWScore::PWScore() :
                      m_isAuxCore(false),
                      m_currfile(_T("")),
@@ -103,6 +127,11 @@ PWScore::PWScore() :
                      m_nRecordsWithUnknownFields(0),
                      m_DBCurrentState(CLEAN),
                      m_pFileSig(nullptr),
+                     m_bSearchIndexEnabled(false),
+                     m_bFileWatchEnabled(false), m_bFullFileSig(false),
+                     m_pAsyncSave(nullptr), m_nAsyncSaveStatus(SUCCESS),
+                     m_nChangeCount(0),
+                     m_nKeyMaterialGen(0), m_pVerifiedKey(nullptr),
                      m_iAppHotKey(0)
 {
   // following should ideally be wrapped in a mutex
@@ -120,6 +149,12 @@ PWScore::PWScore() :
 
 PWScore::~PWScore()
 {
+  m_FileMonitor.Stop(); // before anything its callback might use goes away
+  FinishAsyncSave();
+  if (m_pruneThread.joinable())
+    m_pruneThread.join();
+  delete m_pVerifiedKey;
+
   // do NOT trash m_session_*, as there may be other cores around
   // relying on it. Trashing the ciphertext encrypted with it is enough
   const unsigned int BS = TwoFish::BLOCKSIZE;
@@ -220,6 +255,7 @@ void PWScore::DoAddEntry(const CItemData &item, const CItemAtt *att)
   // Also "UndoDeleteEntry" !
   ASSERT(m_pwlist.find(item.GetUUID()) == m_pwlist.end());
   m_pwlist[item.GetUUID()] = item;
+  UpdateSearchIndex(item);
 
   if (item.NumberUnknownFields() > 0)
     IncrementNumRecordsWithUnknownFields();
@@ -245,6 +281,8 @@ void PWScore::DoAddEntry(const CItemData &item, const CItemAtt *att)
 
   if (iKBShortcut != 0)
     VERIFY(AddKBShortcut(iKBShortcut, item.GetUUID()));
+
+  m_EntryMetadata.Add(m_pwlist[item.GetUUID()]);
 }
 
 bool PWScore::ConfirmDelete(const CItemData *pci, const StringX &sxGroup)
@@ -346,6 +384,8 @@ void PWScore::DoDeleteEntry(const CItemData &item)
       VERIFY(DelKBShortcut(iKBShortcut, item.GetUUID()));
 
     m_pwlist.erase(pos); // at last!
+    RemoveSearchIndexEntry(entry_uuid);
+    m_EntryMetadata.Remove(entry_uuid);
 
     if (item.NumberUnknownFields() > 0)
       DecrementNumRecordsWithUnknownFields();
@@ -369,6 +409,8 @@ void PWScore::DoReplaceEntry(const CItemData &old_ci, const CItemData &new_ci)
   // Assumes that old_uuid == new_uuid
   ASSERT(old_ci.GetUUID() == new_ci.GetUUID());
   m_pwlist[old_ci.GetUUID()] = new_ci;
+  UpdateSearchIndex(new_ci);
+  m_EntryMetadata.Update(new_ci);
   if (old_ci.GetEntryType() != new_ci.GetEntryType() || old_ci.GetStatus() != new_ci.GetStatus() ||
       old_ci.IsProtected() != new_ci.IsProtected())
     GUIRefreshEntry(new_ci);
@@ -419,9 +461,14 @@ void PWScore::DoDeleteAttachment(const CItemAtt &att)
 {
   /**
    * Note that we do NOT erase reference uuid in owner record(s)
+   * An attachment shared by other entries stays for them.
    */
 
-  RemoveAtt(att.GetUUID());
+  CItemAtt &cur_att = GetAtt(att.GetUUID());
+  if (cur_att.GetRefcount() > 1)
+    cur_att.DecRefcount();
+  else
+    RemoveAtt(att.GetUUID());
 }
 
 void PWScore::DoReplaceAttachment(const CItemAtt &old_cia, const CItemAtt &new_cia)
@@ -442,9 +489,16 @@ void PWScore::ClearDBData()
   }
   m_passkey = nullptr;
 
+  CompleteAsyncSave(); // whatever it wrote is no longer of interest
+  m_nAsyncSaveStatus = SUCCESS;
+  ClearKeyMaterial();
+
   //Composed of ciphertext, so doesn't need to be overwritten
   m_pwlist.clear();
   m_attlist.clear();
+  m_SearchIndex.Clear();
+  m_EntryMetadata.Clear();
+  m_FileMonitor.Stop();
 
   // Clear out out dependents mappings
   m_base2aliases_mmap.clear();
@@ -508,6 +562,44 @@ void PWScore::NewFile(const StringX &passkey)
   m_ReadFileVersion = PWSfile::VCURRENT;
 }
 
+// We're writing a V40 file, and the record has a V3-style attachment.
+// Here's where we convert it to a V4-style attachment.
+// *** NOTE: This requires the attachments be written out after the data items! ***
+static void ConvertV3Attachment(PWScore *pcore, CItemData &ci)
+{
+  CItemAtt att;
+  att.CreateUUID();
+
+  att.SetTitle(ci.GetAttTitle());
+  att.SetFileName(ci.GetAttFileName());
+  att.SetMediaType(ci.GetAttMediaType());
+
+  // Get V3 content and copy it
+  const std::vector<unsigned char> v3content = ci.GetAttContent();
+  att.SetContent(v3content.data(), v3content.size());
+
+  // Set file times
+  time_t v3mtime(0);
+  ci.GetAttModificationTime(v3mtime);
+  att.SetFileMTime(v3mtime);
+  att.SetFileCTime(v3mtime); // V3 has no creation time
+  att.SetFileATime(v3mtime); // V3 has no access time
+
+  ci.ClearV3Attachment(); // so that the fields won't be written out
+
+  // Don't write the same attachment more than once
+  pws_os::CUUID shared_uuid;
+  if (pcore->FindAttByContent(att, shared_uuid)) {
+    ci.SetAttUUID(shared_uuid);
+    pcore->GetAtt(shared_uuid).IncRefcount();
+  } else {
+    ci.SetAttUUID(att.GetUUID());
+    att.IncRefcount();
+    pcore->PutAtt(att);
+  }
+  pcore->RefreshEntryMetadata(ci);
+}
+
 // functor object type for for_each:
 // Writes out all records to a PasswordSafe database of any version
 struct RecordWriter {
@@ -531,35 +623,7 @@ struct RecordWriter {
     }
 
     if (m_version == PWSfile::V40 && p.second.IsAttMediaTypeSet())
-    {
-      // We're writing a V40 file, and the record has a V3-style attachment.
-      // Here's where we convert it to a V4-style attachment.
-      // *** NOTE: This requires the attachments be written out after the data items! ***
-      const CItemData& ci = p.second;
-      CItemAtt att;
-      att.CreateUUID();
-
-      att.SetTitle(ci.GetAttTitle());
-      att.SetFileName(ci.GetAttFileName());
-      att.SetMediaType(ci.GetAttMediaType());
-
-      // Get V3 content and copy it
-      const std::vector<unsigned char> v3content = ci.GetAttContent();
-      att.SetContent(v3content.data(), v3content.size());
-
-      // Set file times
-      time_t v3mtime(0);
-      ci.GetAttModificationTime(v3mtime);
-      att.SetFileMTime(v3mtime);
-      att.SetFileCTime(v3mtime); // V3 has no creation time
-      att.SetFileATime(v3mtime); // V3 has no access time
-
-
-      p.second.ClearV3Attachment(); // so that the fields won't be written out
-      p.second.SetAttUUID(att.GetUUID());
-      att.IncRefcount();
-      m_pcore->PutAtt(att); // See NOTE above
-    }
+      ConvertV3Attachment(m_pcore, p.second); // See NOTE there
 
     m_pout->WriteRecord(p.second);
     p.second.ClearStatus();
@@ -572,18 +636,135 @@ private:
   const PWSfile::VERSION m_version;
 };
 
+// Sets where to write filename (empty for stdout): writename is a temporary
+// file from pws_os::CreateReplacement for CommitTempFile to swap in for
+// target, or target itself where that can't be done. Returns false if the
+// temporary file can't be created.
+static bool GetWriteNames(const StringX &filename, StringX &target, StringX &writename)
+{
+  target = writename = filename;
+  if (filename.empty())
+    return true;
+  stringT realname, tmpname;
+  if (!pws_os::CreateReplacement(stringT(filename.c_str()), realname, tmpname))
+    return false;
+  target = realname.c_str();
+  writename = tmpname.empty() ? target : StringX(tmpname.c_str());
+  return true;
+}
+
+// Replaces filename by tmpname, which has been written alongside it and
+// synced (see pws_os::FClose). The rename is atomic and then synced too,
+// so that after a crash the file is either the old one or the new one.
+static bool CommitTempFile(const StringX &tmpname, const StringX &filename)
+{
+  PWSCounters::Timing timing(PWSCounters::WriteFileCommit);
+  if (!pws_os::ReplaceAFile(stringT(tmpname.c_str()), stringT(filename.c_str())))
+    return false;
+  if (!pws_os::SyncDir(filename.c_str())) // saved, if not yet durably
+    pws_os::Trace(_T("SyncDir(%ls) failed\n"), filename.c_str());
+  return true;
+}
+
+// What's written to the file by WriteFile and by a background save: the
+// database's own, or the background save's copy of it
+struct st_SaveContents {
+  PWSfileHeader &hdr; // updated with the time saved, etc.
+  const UnknownFieldList &UHFL;
+  uint32 hashIters;
+  const PWSKDFParams &kdfParams;
+  const PWSFilters &MapDBFilters;
+  const PSWDPolicyMap &MapPSWDPLC;
+  const std::vector<StringX> &vEmptyGroups;
+  ItemList &pwlist;
+  const AttList &attlist;
+  PWSKeyMaterial &keyMaterial;
+  bool bUpdateKeyMaterial; // with what the file used, for next time
+};
+
+// Writes contents to out, made by PWSfile::MakePWSfile. Returns the status
+// from Open() if that fails, else FAILURE on a write error.
+// pcore's only needed for what RecordWriter converts, which a background
+// save has done beforehand.
+static int WriteContents(PWSfile *out, const StringX &passkey, PWSfile::VERSION version,
+                         st_SaveContents &contents, PWScore *pcore,
+                         PWSCounters::Timing &phase)
+{
+  out->SetHeader(contents.hdr);
+  out->SetUnknownHeaderFields(contents.UHFL);
+  out->SetNHashIters(contents.hashIters);
+  out->SetKDFParams(contents.kdfParams);
+  out->SetDBFilters(contents.MapDBFilters);
+  out->SetPasswordPolicies(contents.MapPSWDPLC);
+  out->SetEmptyGroups(contents.vEmptyGroups);
+  out->SetKeyMaterial(&contents.keyMaterial);
+
+  try { // exception thrown on write error
+    const int status = out->Open(passkey);
+    if (status != PWSfile::SUCCESS)
+      return status;
+
+    if (contents.bUpdateKeyMaterial)
+      out->GetKeyMaterial(contents.keyMaterial);
+
+    phase.Next(PWSCounters::WriteFileRecords);
+    RecordWriter write_record(out, pcore, version);
+    for_each(contents.pwlist.begin(), contents.pwlist.end(), write_record);
+
+    // Write attachments (only from V4)
+    if (version >= PWSfile::V40)
+      for_each(contents.attlist.begin(), contents.attlist.end(),
+               [&](const std::pair<CUUID const, CItemAtt> &p)
+               {
+                 p.second.Write(out);
+               } );
+
+    // Update header if V30 or later (no headers before V30)
+    if (version >= PWSfile::V30)
+      contents.hdr = out->GetHeader(); // update time saved, etc.
+  }
+
+  catch (...) {
+    out->Close();
+    return PWScore::FAILURE;
+  }
+
+  phase.Next(PWSCounters::WriteFileClose);
+  const int status = out->Close(); // and sync
+  phase.Stop();
+  return (status == PWSfile::SUCCESS) ? status : PWScore::FAILURE;
+}
+
 int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
                        bool bUpdateSig)
 {
   PWS_LOGIT_ARGS("bUpdateSig=%ls", bUpdateSig ? L"true" : L"false");
+  PWSTrace::Span span("WriteFile");
+  span.SetArg(static_cast<int64>(m_pwlist.size()));
+  PWSCounters::Timing total(PWSCounters::WriteFileTotal);
+
+  CompleteAsyncSave(); // don't race a background save to the same file
 
   int status;
+  PWSCounters::Timing phase(PWSCounters::WriteFileOpen);
+
+  // Write to a temporary file alongside the real one, which then replaces
+  // it, so that the file is never missing or half written, even when
+  // BackupCurFile has left it in place
+  StringX target, writename;
+  if (!GetWriteNames(filename, target, writename))
+    return CANT_OPEN_FILE;
+  auto discard_temp = [&writename, &target]() {
+    if (writename != target && pws_os::FileExists(writename.c_str()))
+      pws_os::DeleteAFile(writename.c_str());
+  };
 
-  PWSfile *out = PWSfile::MakePWSfile(filename, GetPassKey(), version,
+  PWSfile *out = PWSfile::MakePWSfile(writename, GetPassKey(), version,
                                       PWSfile::Write, status);
 
   if (status != PWSfile::SUCCESS) {
     delete out;
+    discard_temp();
     return status;
   }
 
@@ -592,6 +773,7 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
     // about to be invalidated but NOT if a user initiated Backup
     delete m_pFileSig;
     m_pFileSig = nullptr;
+    m_FileMonitor.Stop(); // our own writes aren't news
   }
 
   // If writing in a prior version format (ie. exporting) - save the header
@@ -601,58 +783,30 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
   m_hdr.m_whatlastsaved = m_AppNameAndVersion.c_str();
   m_hdr.m_RUEList = m_RUEList;
 
-  out->SetHeader(m_hdr);
-  out->SetUnknownHeaderFields(m_UHFL);
-  out->SetNHashIters(GetHashIters());
-  out->SetDBFilters(m_MapDBFilters);
-  out->SetPasswordPolicies(m_MapPSWDPLC);
-  out->SetEmptyGroups(m_vEmptyGroups);
-
-  try { // exception thrown on write error
-    pws_os::setenv("PWS_PK_CP_ACP", ""); // safety, in case someone tries to set this globally
-    status = out->Open(GetPassKey());
-
-    if (status != PWSfile::SUCCESS) {
-      delete out;
-
-      if (version < m_ReadFileVersion) // Exporting - restore saved header
-        m_hdr = saved_hdr;
-
-      return status;
-    }
-
-    RecordWriter write_record(out, this, version);
-    for_each(m_pwlist.begin(), m_pwlist.end(), write_record);
-
-    // Write attachments (only from V4)
-    if (version >= PWSfile::V40)
-      for_each(m_attlist.begin(), m_attlist.end(),
-               [&](const std::pair<CUUID const, CItemAtt> &p)
-               {
-                 p.second.Write(out);
-               } );
+  // Keep the key material used for next time, unless exporting
+  st_SaveContents contents = {m_hdr, m_UHFL, GetHashIters(), m_KDFParams,
+                              m_MapDBFilters, m_MapPSWDPLC, m_vEmptyGroups, m_pwlist, m_attlist,
+                              m_KeyMaterial,
+                              version >= m_ReadFileVersion || !m_KeyMaterial.IsValid()};
 
-    // Update header if V30 or later (no headers before V30)
-    if (version >= PWSfile::V30) {
-      m_hdr = out->GetHeader(); // update time saved, etc.
-    }
-  }
+  pws_os::setenv("PWS_PK_CP_ACP", ""); // safety, in case someone tries to set this globally
+  status = WriteContents(out, GetPassKey(), version, contents, this, phase);
+  delete out;
 
-  catch (...) {
-    out->Close();
-    delete out;
+  if (status != PWSfile::SUCCESS) {
+    PWS_LOGIT_ARGS("write failed, status: %d", status);
+    discard_temp();
 
     if (version < m_ReadFileVersion) // Exporting - restore saved header
       m_hdr = saved_hdr;
 
-    return FAILURE;
+    return status;
   }
+  m_EntryMetadata.ClearAllStatus(); // as done by RecordWriter
 
-  status = out->Close();
-  delete out;
-
-  if (status != PWSfile::SUCCESS) {
-    PWS_LOGIT_ARGS("out->Close() failed, status: %d", status);
+  if (writename != target && !CommitTempFile(writename, target)) {
+    PWS_LOGIT_ARGS0("rename failed");
+    discard_temp();
 
     if (version < m_ReadFileVersion) // Exporting - restore saved header
       m_hdr = saved_hdr;
@@ -660,6 +814,9 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
     return FAILURE;
   }
 
+  PWSCounters::Add(PWSCounters::FilesWritten);
+  PWSCounters::Add(PWSCounters::RecordsWritten, m_pwlist.size());
+
   // Update info if we're saving or upgrading.
   if (version >= m_ReadFileVersion) {
     // Set/Reset everything as "unchanged"
@@ -671,48 +828,251 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
   }
 
   // Create new signature if required
-  if (bUpdateSig)
+  if (bUpdateSig) {
     m_pFileSig = new PWSFileSig(filename.c_str());
+    StartFileMonitor(filename);
+  }
 
   // If not exporting, set to clean
-  if (version == m_ReadFileVersion) {
-    // Set current state to CLEAN
-    m_DBCurrentState = CLEAN;
-
-    std::vector<DBStates>::iterator iter;
-
-    if (m_redo_DBState_iter != m_vDBState.end()) {
-      // Update command after of this one to be {before = CLEAN, after = DIRTY}
-      m_redo_DBState_iter->before = CLEAN;
-      m_redo_DBState_iter->after = DIRTY;
-
-      // Update all additional commands after of the next one to be
-      // {before = DIRTY, after = DIRTY}
-      iter = m_redo_DBState_iter + 1;
-      for (; iter != m_vDBState.end(); iter++) {
-        iter->before = DIRTY;
-        iter->after = DIRTY;
-      }
+  if (version == m_ReadFileVersion)
+    MarkSavedClean();
+
+  return SUCCESS;
+}
+
+void PWScore::MarkSavedClean()
+{
+  // Set current state to CLEAN
+  m_DBCurrentState = CLEAN;
+
+  std::vector<DBStates>::iterator iter;
+
+  if (m_redo_DBState_iter != m_vDBState.end()) {
+    // Update command after of this one to be {before = CLEAN, after = DIRTY}
+    m_redo_DBState_iter->before = CLEAN;
+    m_redo_DBState_iter->after = DIRTY;
+
+    // Update all additional commands after of the next one to be
+    // {before = DIRTY, after = DIRTY}
+    iter = m_redo_DBState_iter + 1;
+    for (; iter != m_vDBState.end(); iter++) {
+      iter->before = DIRTY;
+      iter->after = DIRTY;
     }
+  }
 
-    if (m_undo_DBState_iter != m_vDBState.end()) {
-      // Update command before this one to be {before = DIRTY, after = CLEAN}
-      m_undo_DBState_iter->before = DIRTY;
-      m_undo_DBState_iter->after = CLEAN;
+  if (m_undo_DBState_iter != m_vDBState.end()) {
+    // Update command before this one to be {before = DIRTY, after = CLEAN}
+    m_undo_DBState_iter->before = DIRTY;
+    m_undo_DBState_iter->after = CLEAN;
 
-      // Update all additional commands before the previous one to be
-      // {before = DIRTY, after = DIRTY}
-      iter = m_undo_DBState_iter;
-      while (iter != m_vDBState.begin()) {
-        iter--;
-        iter->before = DIRTY;
-        iter->after = DIRTY;
-      }
+    // Update all additional commands before the previous one to be
+    // {before = DIRTY, after = DIRTY}
+    iter = m_undo_DBState_iter;
+    while (iter != m_vDBState.begin()) {
+      iter--;
+      iter->before = DIRTY;
+      iter->after = DIRTY;
     }
   }
+}
+
+// Everything a background save needs, copied when it starts so that the
+// database can carry on being used (and changed) while it's being written.
+struct st_AsyncSave {
+  StringX filename;
+  PWSfile::VERSION version;
+  StringX passkey;
+  ItemList pwlist;
+  AttList attlist;
+  PWSfileHeader hdr;
+  UnknownFieldList UHFL;
+  uint32 hashIters;
+  PWSKDFParams kdfParams;
+  PWSKeyMaterial keyMaterial; // updated by the save thread
+  unsigned long nKeyMaterialGen; // PWScore::m_nKeyMaterialGen when copied
+  PWSFilters MapDBFilters;
+  PSWDPolicyMap MapPSWDPLC;
+  std::vector<StringX> vEmptyGroups;
+  std::vector<Observer *> observers;
+  unsigned long nChangeCount; // PWScore::m_nChangeCount when copied
+
+  // Results, set by the save thread
+  std::atomic<bool> bDone;
+  int status;
+  PWSFileSig *pFileSig;
+
+  st_AsyncSave() : version(PWSfile::UNKNOWN_VERSION), hashIters(0),
+    nKeyMaterialGen(0), nChangeCount(0), bDone(false), status(PWScore::FAILURE), pFileSig(nullptr) {}
+  ~st_AsyncSave() {delete pFileSig;}
+
+  void Write(); // runs on the save thread
+};
+
+void st_AsyncSave::Write()
+{
+  // Write to a temporary file alongside the real one, so that a failed
+  // save leaves the database as it was
+  StringX target, tmpname;
+  PWSCounters::Timing total(PWSCounters::WriteFileTotal);
+  PWSCounters::Timing phase(PWSCounters::WriteFileOpen);
+
+  PWSfile *out = nullptr;
+  if (GetWriteNames(filename, target, tmpname))
+    out = PWSfile::MakePWSfile(tmpname, passkey, version, PWSfile::Write, status);
+  else
+    status = PWScore::CANT_OPEN_FILE;
+
+  if (status == PWSfile::SUCCESS) {
+    st_SaveContents contents = {hdr, UHFL, hashIters, kdfParams, MapDBFilters,
+                                MapPSWDPLC, vEmptyGroups, pwlist, attlist,
+                                keyMaterial, true};
+    status = WriteContents(out, passkey, version, contents, nullptr, phase);
+    if (status == PWSfile::SUCCESS)
+      PWSCounters::Add(PWSCounters::RecordsWritten, pwlist.size());
+  }
+  delete out;
+
+  // Done with the copy - don't keep it around until the UI gets to us
+  pwlist.clear();
+  attlist.clear();
+  passkey = _T("");
+
+  if (status == PWSfile::SUCCESS) {
+    PWSCounters::Add(PWSCounters::FilesWritten);
+    if (tmpname == target || CommitTempFile(tmpname, target))
+      pFileSig = new PWSFileSig(filename.c_str());
+    else
+      status = PWScore::CANT_OPEN_FILE;
+  }
+
+  if (status != PWSfile::SUCCESS && tmpname != target &&
+      pws_os::FileExists(tmpname.c_str()))
+    pws_os::DeleteAFile(tmpname.c_str());
+
+  bDone = true;
+
+  for (auto &obs : observers)
+    obs->DatabaseSaved(filename, status);
+}
+
+int PWScore::WriteFileAsync(const StringX &filename, PWSfile::VERSION version)
+{
+  PWS_LOGIT;
+
+  // Exports change the header restore logic in WriteFile - keep them there
+  if (version < PWSfile::V30 || version < m_ReadFileVersion)
+    return FAILURE;
+
+  CompleteAsyncSave(); // only one at a time
+
+  // Any V3 attachments are converted here rather than on the copy, so that
+  // the V4 attachments belong to the database and not just to the file
+  if (version == PWSfile::V40) {
+    for (auto &p : m_pwlist)
+      if (p.second.IsAttMediaTypeSet())
+        ConvertV3Attachment(this, p.second);
+  }
+
+  st_AsyncSave *pas = new st_AsyncSave;
+  pas->filename = filename;
+  pas->version = version;
+  pas->passkey = GetPassKey();
+  pas->pwlist = m_pwlist;
+  pas->attlist = m_attlist;
+  pas->hdr = m_hdr;
+  pas->hdr.m_prefString = PWSprefs::GetInstance()->Store();
+  pas->hdr.m_whatlastsaved = m_AppNameAndVersion.c_str();
+  pas->hdr.m_RUEList = m_RUEList;
+  pas->UHFL = m_UHFL;
+  pas->hashIters = GetHashIters();
+  pas->kdfParams = m_KDFParams;
+  pas->keyMaterial = m_KeyMaterial;
+  pas->nKeyMaterialGen = m_nKeyMaterialGen;
+  pas->MapDBFilters = m_MapDBFilters;
+  pas->MapPSWDPLC = m_MapPSWDPLC;
+  pas->vEmptyGroups = m_vEmptyGroups;
+  pas->observers = m_Observers;
+  pas->nChangeCount = m_nChangeCount;
+
+  // As in WriteFile, the previous sig's about to be invalidated
+  delete m_pFileSig;
+  m_pFileSig = nullptr;
+  m_FileMonitor.Stop(); // our own writes aren't news
+
+  pws_os::setenv("PWS_PK_CP_ACP", ""); // safety, in case someone tries to set this globally
+
+  m_pAsyncSave = pas;
+  m_saveThread = std::thread(&st_AsyncSave::Write, pas);
   return SUCCESS;
 }
 
+bool PWScore::IsSaveInProgress() const
+{
+  return m_pAsyncSave != nullptr && !m_pAsyncSave->bDone;
+}
+
+int PWScore::FinishAsyncSave()
+{
+  CompleteAsyncSave();
+  const int status = m_nAsyncSaveStatus;
+  m_nAsyncSaveStatus = SUCCESS; // reported
+  return status;
+}
+
+int PWScore::CompleteAsyncSave()
+{
+  if (m_pAsyncSave == nullptr)
+    return SUCCESS;
+
+  if (m_saveThread.joinable())
+    m_saveThread.join();
+
+  st_AsyncSave *pas = m_pAsyncSave;
+  m_pAsyncSave = nullptr;
+  const int status = pas->status;
+
+  if (status == SUCCESS) {
+    if (pas->nChangeCount == m_nChangeCount) {
+      // Nothing changed while we were writing - same as WriteFile
+      m_hdr = pas->hdr;
+      SetInitialValues();
+      for (auto &p : m_pwlist)
+        p.second.ClearStatus();
+      m_EntryMetadata.ClearAllStatus();
+      m_ReadFileVersion = pas->version;
+      MarkSavedClean();
+    } else {
+      // Keep what's been changed since, but record what's now on disk.
+      // The database stays dirty, so the next save picks up the changes.
+      m_hdr.m_nCurrentMajorVersion = pas->hdr.m_nCurrentMajorVersion;
+      m_hdr.m_nCurrentMinorVersion = pas->hdr.m_nCurrentMinorVersion;
+      m_hdr.m_file_uuid = pas->hdr.m_file_uuid;
+      m_hdr.m_whenlastsaved = pas->hdr.m_whenlastsaved;
+      m_hdr.m_lastsavedby = pas->hdr.m_lastsavedby;
+      m_hdr.m_lastsavedon = pas->hdr.m_lastsavedon;
+      m_hdr.m_whatlastsaved = pas->hdr.m_whatlastsaved;
+      m_ReadFileVersion = pas->version;
+    }
+
+    if (pas->nKeyMaterialGen == m_nKeyMaterialGen) // passkey & iterations unchanged
+      m_KeyMaterial = pas->keyMaterial;
+
+    m_pFileSig = pas->pFileSig;
+    pas->pFileSig = nullptr;
+    StartFileMonitor(pas->filename);
+  } else if (pws_os::FileExists(pas->filename.c_str())) {
+    // Original left as it was - keep an eye on it again
+    m_pFileSig = new PWSFileSig(pas->filename.c_str());
+    StartFileMonitor(pas->filename);
+  }
+
+  if (status != SUCCESS)
+    m_nAsyncSaveStatus = status; // until the UI gets it
+  delete pas;
+  return status;
+}
+
 // functor object type for for_each:
 // Writes out subset of records to a PasswordSafe database at the current version
 // Used by Export entry or Export Group
@@ -870,6 +1230,7 @@ void PWScore::ClearCommands()
 
   // Clear DB states
   m_vDBState.clear();
+  m_UndoMemoryUsage = 0;
   m_undo_DBState_iter = m_redo_DBState_iter = m_vDBState.end();
 }
 
@@ -924,6 +1285,8 @@ int PWScore::Execute(Command *pcmd)
     // Now remove old commands past this one from vector
     m_vpcommands.erase(m_redo_iter, m_vpcommands.end());
     // Now remove old DB change states past this one from vector
+    for (auto iter = m_redo_DBState_iter; iter != m_vDBState.end(); iter++)
+      m_UndoMemoryUsage -= iter->memory;
     m_vDBState.erase(m_redo_DBState_iter, m_vDBState.end());
   }
 
@@ -935,13 +1298,16 @@ int PWScore::Execute(Command *pcmd)
 
   // Execute it
   int rc = pcmd->Execute();
+  m_nChangeCount++;
 
   // Save current before & after DB states
   // Note: commands should always change something but check
   DBStates cmdDBStates;
   cmdDBStates.before = m_DBCurrentState;
   cmdDBStates.after = pcmd->WasDBChanged() ? DIRTY : CLEAN;
+  cmdDBStates.memory = pcmd->GetMemoryUsage();
   m_vDBState.push_back(cmdDBStates);
+  m_UndoMemoryUsage += cmdDBStates.memory;
 
   // Set current state
   m_DBCurrentState = cmdDBStates.after;
@@ -953,6 +1319,8 @@ int PWScore::Execute(Command *pcmd)
   m_undo_iter--;
   m_undo_DBState_iter--;
 
+  TrimCommands();
+
   // If user has set Save Immediately, then Execute() changes the DB and it should be
   // saved (with or without an intermediate backup)
   NotifyDBModified();
@@ -973,6 +1341,10 @@ void PWScore::Undo()
 
   // Undo it
   (*m_undo_iter)->Undo();
+  m_UndoMemoryUsage -= m_undo_DBState_iter->memory;
+  m_undo_DBState_iter->memory = (*m_undo_iter)->GetMemoryUsage();
+  m_UndoMemoryUsage += m_undo_DBState_iter->memory;
+  m_nChangeCount++;
 
   // Reset command & DBstate iterator so that we know next command to undo
   if (m_undo_iter == m_vpcommands.begin()) {
@@ -1005,6 +1377,10 @@ void PWScore::Redo()
 
   // Redo it
   (*m_redo_iter)->Redo();
+  m_UndoMemoryUsage -= m_redo_DBState_iter->memory;
+  m_redo_DBState_iter->memory = (*m_redo_iter)->GetMemoryUsage();
+  m_UndoMemoryUsage += m_redo_DBState_iter->memory;
+  m_nChangeCount++;
 
   // Need to reset current DB state based on the command's after state
   m_DBCurrentState = m_redo_DBState_iter->after;
@@ -1023,6 +1399,77 @@ void PWScore::Redo()
   NotifyGUINeedsUpdating(UpdateGUICommand::GUI_UPDATE_STATUSBAR, CUUID::NullUUID());
 }
 
+void PWScore::SetUndoMemoryLimit(size_t limit)
+{
+  m_UndoMemoryLimit = limit;
+  m_bUndoMemoryLimitSet = true;
+  TrimCommands();
+}
+
+size_t PWScore::GetUndoMemoryLimit() const
+{
+  if (m_bUndoMemoryLimitSet)
+    return m_UndoMemoryLimit;
+  return size_t(PWSprefs::GetInstance()->GetPref(PWSprefs::UndoMaxMemSize)) * 1024;
+}
+
+size_t PWScore::GetUndoMemoryUsage() const
+{
+  // As of when each command was last executed or undone, see TrimCommands
+  return m_UndoMemoryUsage;
+}
+
+void PWScore::SetPerfGauges() const
+{
+  PWSCounters::Set(PWSCounters::UndoCommands, m_vpcommands.size());
+  PWSCounters::Set(PWSCounters::UndoMemory, GetUndoMemoryUsage());
+}
+
+StringX PWScore::GetPerfStats() const
+{
+  SetPerfGauges();
+  return PWSCounters::GetSummary();
+}
+
+std::string PWScore::GetPerfStatsJSON() const
+{
+  SetPerfGauges();
+  return PWSCounters::GetJSON();
+}
+
+void PWScore::TrimCommands()
+{
+  // Only commands that can be undone are dropped, oldest first, and
+  // never the latest, so that the last change can always be undone.
+  // Redo commands are left alone, as each depends on those before it.
+  const size_t limit = GetUndoMemoryLimit();
+  if (limit == 0 || m_undo_iter == m_vpcommands.end())
+    return;
+
+  // What each command used when last run, totalled as they're executed
+  // and undone, rather than asking them all again, keeps this cheap when
+  // thousands of commands are executed
+  const size_t nundo = std::distance(m_vpcommands.begin(), m_undo_iter) + 1;
+  size_t ndrop = 0;
+  while (m_UndoMemoryUsage > limit && ndrop + 1 < nundo) {
+    m_UndoMemoryUsage -= m_vDBState[ndrop].memory;
+    delete m_vpcommands[ndrop];
+    ndrop++;
+  }
+  if (ndrop == 0)
+    return;
+
+  // Erasing invalidates the iterators, so recreate them by position
+  const size_t iundo = nundo - 1 - ndrop;
+  const size_t iredo = std::distance(m_vpcommands.begin(), m_redo_iter) - ndrop;
+  m_vpcommands.erase(m_vpcommands.begin(), m_vpcommands.begin() + ndrop);
+  m_vDBState.erase(m_vDBState.begin(), m_vDBState.begin() + ndrop);
+  m_undo_iter = m_vpcommands.begin() + iundo;
+  m_undo_DBState_iter = m_vDBState.begin() + iundo;
+  m_redo_iter = m_vpcommands.begin() + iredo;
+  m_redo_DBState_iter = m_vDBState.begin() + iredo;
+}
+
 Command * PWScore::GetRedoCommand()
 {
   ASSERT(m_redo_iter != m_vpcommands.end());
@@ -1050,12 +1497,44 @@ int PWScore::CheckPasskey(const StringX &filename, const StringX &passkey)
   int status;
 
   if (!filename.empty()) {
-    status = PWSfile::CheckPasskey(filename, passkey, m_ReadFileVersion);
-    if (status == PWSfile::WRONG_PASSWORD) {
-      // See if passkey was encoded incorrectly
-      pws_os::setenv("PWS_PK_CP_ACP", "1");
-      status = PWSfile::CheckPasskey(filename, passkey, m_ReadFileVersion);
-      pws_os::setenv("PWS_PK_CP_ACP", ""); // no unsetenv() in Windows...
+    // Try the UTF-8 and (if different) ANSI code page encodings of the
+    // passkey at the same time, as each can take a while
+    struct Attempt {
+      int status;
+      PWSfile::VERSION version;
+      PWSKeyMaterial km;
+      Attempt() : status(PWSfile::WRONG_PASSWORD), version(PWSfile::UNKNOWN_VERSION) {}
+    } utf8, acp;
+
+    auto check = [&filename, &passkey](bool bACP, Attempt &a) {
+      SetPasskeyACP(bACP);
+      a.status = PWSfile::CheckPasskey(filename, passkey, a.version, &a.km);
+      SetPasskeyACP(false);
+    };
+
+    const bool bTryACP = PasskeyEncodingsDiffer(passkey);
+    std::thread acp_thread;
+    if (bTryACP)
+      acp_thread = std::thread(check, true, std::ref(acp));
+    check(false, utf8);
+    if (bTryACP)
+      acp_thread.join();
+
+    // See if passkey was encoded incorrectly
+    const bool bACP = utf8.status == PWSfile::WRONG_PASSWORD && bTryACP;
+    const Attempt &result = bACP ? acp : utf8;
+    status = result.status;
+    m_ReadFileVersion = result.version;
+
+    delete m_pVerifiedKey;
+    m_pVerifiedKey = nullptr;
+    if (status == PWSfile::SUCCESS && result.km.IsValid()) {
+      m_pVerifiedKey = new st_VerifiedKey;
+      m_pVerifiedKey->filename = filename;
+      m_pVerifiedKey->version = result.version;
+      m_pVerifiedKey->km = result.km;
+      m_pVerifiedKey->bACP = bACP;
+      m_pVerifiedKey->passkey = EncryptPassKey(passkey);
     }
   } else { // can happen if tries to export b4 save
     size_t t_passkey_len = passkey.length();
@@ -1160,15 +1639,22 @@ void PWScore::ProcessReadEntry(CItemData &ci_temp,
     }
   } // non-zero shortcut
 
+  // Times etc. are decrypted once here, expiry check uses the copies
+  const CUUID &entry_uuid = ci_temp.GetUUID();
+  m_EntryMetadata.Add(ci_temp);
+
   // Possibly expired?
   time_t tttXTime;
-  ci_temp.GetXTime(tttXTime);
+  m_EntryMetadata.GetTime(entry_uuid, CItemData::XTIME, tttXTime);
   if (tttXTime != time_t(0)) {
-    m_ExpireCandidates.push_back(ExpPWEntry(ci_temp));
+    time_t tttPMTime, tttCTime;
+    m_EntryMetadata.GetTime(entry_uuid, CItemData::PMTIME, tttPMTime);
+    m_EntryMetadata.GetTime(entry_uuid, CItemData::CTIME, tttCTime);
+    m_ExpireCandidates.push_back(ExpPWEntry(entry_uuid, tttXTime, tttPMTime, tttCTime));
   }
 
   // Finally, add it to the list!
-  m_pwlist.insert(std::make_pair(ci_temp.GetUUID(), ci_temp));
+  m_pwlist.insert(std::make_pair(entry_uuid, ci_temp));
 }
 
 static void ReportReadErrors(CReport *pRpt,
@@ -1219,17 +1705,36 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
   PWS_LOGIT_ARGS("bValidate=%ls; iMAXCHARS=%d; pRpt=%p",
                  bValidate ? L"true" : L"false", iMAXCHARS,
                  pRpt);
+  PWSTrace::Span span("ReadFile");
+  PWSCounters::Timing total(PWSCounters::ReadFileTotal);
 
   int status;
   st_ValidateResults st_vr;
   std::vector<st_GroupTitleUser> vGTU_INVALID_UUID, vGTU_DUPLICATE_UUID;
 
+  CompleteAsyncSave(); // may be re-reading what it just wrote
+
   // Clear any old expired password entries
   m_ExpireCandidates.clear();
 
   // Clear any old entry keyboard shortcuts
   m_KBShortcutMap.clear();
 
+  // If CheckPasskey has just verified this passkey for this file, use what
+  // it derived rather than stretching the passkey all over again
+  std::unique_ptr<st_VerifiedKey> pvk(m_pVerifiedKey);
+  m_pVerifiedKey = nullptr;
+  if (pvk) {
+    std::vector<unsigned char> passkey = EncryptPassKey(a_passkey);
+    if (!pvk->Matches(a_filename, passkey))
+      pvk.reset();
+    if (!passkey.empty())
+      trashMemory(passkey.data(), passkey.size());
+  }
+  if (pvk)
+    m_ReadFileVersion = pvk->version;
+
+  PWSCounters::Timing phase(PWSCounters::ReadFileOpen);
   PWSfile *in = PWSfile::MakePWSfile(a_filename, a_passkey, m_ReadFileVersion,
                                      PWSfile::Read, status, m_pAsker, m_pReporter);
 
@@ -1238,12 +1743,18 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
     return status;
   }
 
+  if (pvk)
+    in->SetKeyMaterial(&pvk->km);
+
+  // Saves are always UTF-8 - don't let them reuse an ANSI code page key
+  bool bACP = pvk && pvk->bACP;
   status = in->Open(a_passkey);
   if (status == PWSfile::WRONG_PASSWORD) {
     // See if passkey was encoded incorrectly
     pws_os::setenv("PWS_PK_CP_ACP", "1");
     status = in->Open(a_passkey);
     pws_os::setenv("PWS_PK_CP_ACP", ""); // no unsetenv() in Windows...
+    bACP = true;
   }
 
   // in the old times we could open even 1.x files
@@ -1301,11 +1812,14 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
   ClearDBData(); // Before overwriting old data, but after opening the file...
 
   SetPassKey(a_passkey); // so user won't be prompted for saves
+  if (!bACP)
+    in->GetKeyMaterial(m_KeyMaterial); // so saves needn't stretch it again
 
   CItemData ci_temp;
   bool go = true;
 
   m_hashIters = in->GetNHashIters();
+  m_KDFParams = in->GetKDFParams();
   if (in->GetDBFilters() != nullptr) m_MapDBFilters = *in->GetDBFilters();
   if (in->GetPasswordPolicies() != nullptr) m_MapPSWDPLC = *in->GetPasswordPolicies();
   if (in->GetEmptyGroups() != nullptr) m_vEmptyGroups = *in->GetEmptyGroups();
@@ -1320,6 +1834,7 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
     pRpt->StartReport(IDSC_RPTVALIDATE, m_currfile.c_str());
   }
 
+  phase.Next(PWSCounters::ReadFileRecords);
   do {
     ci_temp.Clear(); // Rather than creating a new one each time.
     status = in->ReadRecord(ci_temp);
@@ -1367,6 +1882,10 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
   int closeStatus = in->Close(); // in V3 & later this checks integrity
   delete in;
 
+  PWSCounters::Add(PWSCounters::FilesRead);
+  PWSCounters::Add(PWSCounters::RecordsRead, m_pwlist.size());
+  phase.Next(PWSCounters::ReadFileValidate);
+
   ReportReadErrors(pRpt, vGTU_INVALID_UUID, vGTU_DUPLICATE_UUID);
 
   // Validate rest of things in the database (excluding duplicate UUIDs fixed above
@@ -1382,11 +1901,16 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
   if (pRpt != nullptr)
     pRpt->EndReport();
 
+  // Entries are final now that Validate has had its say
+  if (m_bSearchIndexEnabled)
+    m_SearchIndex.Build(m_pwlist);
+
   // Setup file signature for checking file integrity upon backup.
   // Goal is to prevent overwriting a good backup with a corrupt file.
   if (a_filename == m_currfile) {
     delete m_pFileSig;
     m_pFileSig = new PWSFileSig(a_filename.c_str());
+    StartFileMonitor(a_filename);
   }
 
   // Make return code negative if validation errors
@@ -1412,78 +1936,11 @@ static const StringX MakeDateTimeString()
   return retval;
 }
 
-static void ManageIncBackupFiles(const stringT &cs_filenamebase,
-                                 size_t maxnumincbackups, stringT &cs_newname)
+static void DeleteExcessBackups(std::vector<stringT> excess)
 {
-  /**
-   * make sure we've no more than maxnumincbackups backup files,
-   * and return the base name of the next backup file
-   * (sans the suffix, which will be added by caller)
-   *
-   * When the _999.ibak file exists, we switch to date-time filename format in response to BR1547.
-   * TODO: maintain maxnumincbackups for date-time files as well.
-   */
-
-  if (maxnumincbackups >= 999) {
-    pws_os::Trace(_T("Maxnumincbackups: truncating maxnumincbackups to 998"));
-    maxnumincbackups = 998;
-  }
-
-  using std::vector;
-
-  stringT cs_filenamemask(cs_filenamebase);
-  vector<stringT> files;
-  vector<unsigned int> file_nums;
-
-  cs_filenamemask += _T("_???.ibak");
-
-  pws_os::FindFiles(cs_filenamemask, files);
-
-  for (auto iter : files) {
-    stringT ibak_number_str = iter.substr(iter.length() - 8, 3);
-    if (ibak_number_str.find_first_not_of(_T("0123456789")) != stringT::npos)
-      continue;
-    istringstreamT is(ibak_number_str);
-    unsigned int n;
-    is >> n;
-    file_nums.push_back(n);
-  }
-
-  if (file_nums.empty()) {
-    cs_newname = cs_filenamebase + _T("_001");
-    return;
-  }
-
-  sort(file_nums.begin(), file_nums.end());
-  size_t num_found = file_nums.size();
-
-  // nnn is the number of the file in the returned value: cs_filebasename_nnn
-  size_t nnn = file_nums.back();
-  nnn++;
-  if (nnn > 999) {
-    /**
-     * If we have a _999 file, there's no elegant solution, especially if the user chose to save 999 backups [BR1547]
-     * So in that case we switch to date/time format, both in returned value and in the preference.
-     */
-
-    Format(cs_newname, L"%ls_%ls", cs_filenamebase.c_str(), MakeDateTimeString().c_str());
-    PWSprefs::GetInstance()->SetPref(PWSprefs::BackupSuffix, PWSprefs::BKSFX_DateTime);
-    return;
-  }
-
-  Format(cs_newname, L"%ls_%03d", cs_filenamebase.c_str(), nnn);
-
-  int i = 0;
-  stringT excess_file;
-  while (num_found >= maxnumincbackups) {
-    nnn = file_nums[i];
-    Format(excess_file, L"%ls_%03d.ibak", cs_filenamebase.c_str(), nnn);
-    i++;
-    num_found--;
-    if (!pws_os::DeleteAFile(excess_file)) {
+  for (const auto &excess_file : excess) {
+    if (!pws_os::DeleteAFile(excess_file))
       pws_os::Trace(L"DeleteFile(%ls) failed", excess_file.c_str());
-      continue;
-    }
   }
 }
 
@@ -1495,11 +1952,21 @@ bool PWScore::BackupCurFile(unsigned int maxNumIncBackups, int backupSuffix,
   const stringT path(m_currfile.c_str());
   stringT drv, dir, name, ext;
 
+  CompleteAsyncSave(); // so that m_pFileSig is that of the latest save
+  if (m_pruneThread.joinable()) // done with the previous backup's rotation
+    m_pruneThread.join();
+
   // Check if the file we're about to backup is unchanged since
   // we opened it, to avoid overwriting a good file with a bad one
   if (m_pFileSig != nullptr) {
-    PWSFileSig curSig(m_currfile.c_str());
-    bool passed = (curSig == *m_pFileSig);
+    bool passed;
+    if (m_FileMonitor.IsActive()) {
+      // Watch has been keeping an eye on it - no need to re-read
+      passed = !m_FileMonitor.HasChanged();
+    } else {
+      PWSFileSig curSig(m_currfile.c_str());
+      passed = (curSig == *m_pFileSig);
+    }
     if (!passed) // XXX yell scream & shout
       return false;
   }
@@ -1529,17 +1996,31 @@ bool PWScore::BackupCurFile(unsigned int maxNumIncBackups, int backupSuffix,
   }
 
   // Add on suffix
+  // Numbered and date-time backups are rotated via their index, which
+  // is only updated once the backup's been made
+  std::unique_ptr<PWSBackupIndex> pIndex;
+  stringT suffix;
   switch (backupSuffix) { // case values from order in listbox.
     case 1: // YYYYMMDD_HHMMSS suffix
-      {
-        cs_temp += _T("_");
-        StringX nf = cs_temp.c_str() + MakeDateTimeString();
-                     
-        bu_fname = nf.c_str();
-        break;
-      }
     case 2: // _nnn suffix
-      ManageIncBackupFiles(cs_temp, maxNumIncBackups, bu_fname);
+      pIndex.reset(new PWSBackupIndex(cs_temp));
+      if (backupSuffix == 2) {
+        if (maxNumIncBackups >= 999) {
+          pws_os::Trace(_T("Maxnumincbackups: truncating maxnumincbackups to 998"));
+          maxNumIncBackups = 998;
+        }
+        suffix = pIndex->NextNumber();
+        if (suffix.empty()) {
+          /**
+           * If we have a _999 file, there's no elegant solution, especially if the user chose to save 999 backups [BR1547]
+           * So in that case we switch to date/time format, both in returned value and in the preference.
+           */
+          PWSprefs::GetInstance()->SetPref(PWSprefs::BackupSuffix, PWSprefs::BKSFX_DateTime);
+        }
+      }
+      if (suffix.empty())
+        suffix = MakeDateTimeString().c_str();
+      bu_fname = cs_temp + _T("_") + suffix;
       break;
     case 0: // no suffix
     default:
@@ -1549,9 +2030,27 @@ bool PWScore::BackupCurFile(unsigned int maxNumIncBackups, int backupSuffix,
 
   bu_fname +=  _T(".ibak");
 
-  // Current file becomes backup
-  // Directories along the specified backup path are created as needed
-  return pws_os::RenameFile(m_currfile.c_str(), bu_fname);
+  // Current file becomes backup. Where the filesystem supports it, the
+  // backup's a clone sharing its data, which costs next to nothing and
+  // leaves the file in place until WriteFile replaces it.
+  // Otherwise it's renamed.
+  bool brc = pws_os::CloneFile(m_currfile.c_str(), bu_fname);
+  if (!brc) {
+    // Directories along the specified backup path are created as needed
+    // The rename is ours, not news - WriteFile restarts the watch
+    m_FileMonitor.Stop();
+    brc = pws_os::RenameFile(m_currfile.c_str(), bu_fname);
+    if (!brc && m_pFileSig != nullptr)
+      StartFileMonitor(m_currfile);
+  }
+
+  if (brc && pIndex) {
+    std::vector<stringT> excess = pIndex->Add(suffix, maxNumIncBackups);
+    // Deleting them can wait - don't hold up the save
+    if (!excess.empty())
+      m_pruneThread = std::thread(DeleteExcessBackups, std::move(excess));
+  }
+  return brc;
 }
 
 void PWScore::ChangePasskey(const StringX &newPasskey)
@@ -1563,11 +2062,16 @@ void PWScore::ChangePasskey(const StringX &newPasskey)
 
 // functor object type for find_if:
 struct FieldsMatch {
-  bool operator()(const std::pair<CUUID, CItemData> &p) {
+  bool operator()(const std::pair<CUUID const, CItemData> &p) {
     const CItemData &item = p.second;
-    return (m_group == item.GetGroup() &&
-            m_title == item.GetTitle() &&
-            m_user  == item.GetUser());
+    item.GetGroup(m_value);
+    if (m_value != m_group)
+      return false;
+    item.GetTitle(m_value);
+    if (m_value != m_title)
+      return false;
+    item.GetUser(m_value);
+    return m_value == m_user;
   }
   FieldsMatch(const FieldsMatch&) = default;
   FieldsMatch(const StringX &a_group, const StringX &a_title,
@@ -1576,24 +2080,25 @@ struct FieldsMatch {
 
 private:
   FieldsMatch& operator=(const FieldsMatch&) = delete;
-  const StringX &m_group;
-  const StringX &m_title;
-  const StringX &m_user;
+  // Decrypting into these rather than StringX saves an allocation per field
+  const SecureStringX m_group, m_title, m_user;
+  SecureStringX m_value;
 };
 
 // Finds stuff based on group, title & user fields only
 ItemListIter PWScore::Find(const StringX &a_group,const StringX &a_title,
                            const StringX &a_user)
 {
+  // Not via the entry metadata: entries changed in place (as the UIs do)
+  // without a call to RefreshEntryMetadata() would have stale hashes
   FieldsMatch fields_match(a_group, a_title, a_user);
-
   return find_if(m_pwlist.begin(), m_pwlist.end(), fields_match);
 }
 
 struct TitleMatch {
-  bool operator()(const std::pair<CUUID, CItemData> &p) {
-    const CItemData &item = p.second;
-    return (m_title == item.GetTitle());
+  bool operator()(const std::pair<CUUID const, CItemData> &p) {
+    p.second.GetTitle(m_value);
+    return m_value == m_title;
   }
 
   TitleMatch(const TitleMatch&) = default;
@@ -1602,7 +2107,8 @@ struct TitleMatch {
 
 private:
   TitleMatch& operator=(const TitleMatch&) = delete;
-  const StringX &m_title;
+  const SecureStringX m_title;
+  SecureStringX m_value;
 };
 
 ItemListIter PWScore::GetUniqueBase(const StringX &a_title, bool &bMultiple)
@@ -1635,10 +2141,19 @@ ItemListIter PWScore::GetUniqueBase(const StringX &a_title, bool &bMultiple)
 }
 
 struct GroupTitle_TitleUserMatch {
-  bool operator()(const std::pair<CUUID, CItemData> &p) {
+  bool operator()(const std::pair<CUUID const, CItemData> &p) {
     const CItemData &item = p.second;
-    return ((m_gt == item.GetGroup() && m_tu == item.GetTitle()) ||
-            (m_gt == item.GetTitle() && m_tu == item.GetUser()));
+    item.GetTitle(m_title);
+    if (m_title == m_tu) {
+      item.GetGroup(m_value);
+      if (m_value == m_gt)
+        return true;
+    }
+    if (m_title == m_gt) {
+      item.GetUser(m_value);
+      return m_value == m_tu;
+    }
+    return false;
   }
 
   GroupTitle_TitleUserMatch(const GroupTitle_TitleUserMatch&) = default;
@@ -1648,8 +2163,9 @@ struct GroupTitle_TitleUserMatch {
 
 private:
   GroupTitle_TitleUserMatch& operator=(const GroupTitle_TitleUserMatch&) = delete;
-  const StringX &m_gt;
-  const StringX &m_tu;
+  const SecureStringX m_gt;
+  const SecureStringX m_tu;
+  SecureStringX m_title, m_value;
 };
 
 ItemListIter PWScore::GetUniqueBase(const StringX &grouptitle,
@@ -1724,6 +2240,7 @@ void PWScore::SetPassKey(const StringX &new_passkey)
 {
   // Only used when opening files and for new files
   const unsigned int BS = TwoFish::BLOCKSIZE;
+  ClearKeyMaterial(); // derived from the old one
   // if changing, clear old
   if (m_passkey_len > 0) {
     trashMemory(m_passkey, ((m_passkey_len + (BS -1)) / BS) * BS);
@@ -1738,6 +2255,20 @@ void PWScore::SetPassKey(const StringX &new_passkey)
   EncryptPassword(reinterpret_cast<const unsigned char *>(plaintext), m_passkey_len, m_passkey);
 }
 
+std::vector<unsigned char> PWScore::EncryptPassKey(const StringX &passkey) const
+{
+  // Encrypted as SetPassKey does, with the length up front as that's
+  // otherwise lost in the padding
+  const unsigned int BS = TwoFish::BLOCKSIZE;
+  const size_t len = passkey.length() * sizeof(TCHAR);
+  std::vector<unsigned char> retval(sizeof(len) + ((len + (BS - 1)) / BS) * BS);
+  memcpy(retval.data(), &len, sizeof(len));
+  if (len > 0)
+    EncryptPassword(reinterpret_cast<const unsigned char *>(passkey.c_str()), len,
+                    retval.data() + sizeof(len));
+  return retval;
+}
+
 StringX PWScore::GetPassKey() const
 {
   StringX retval(_T(""));
@@ -1808,30 +2339,15 @@ bool PWScore::HasRUEListChanged() const
 
 static void collectGroups(const StringX &sxg, std::set<stringT> &setGroups)
 {
-  StringX sxGroup(sxg);
-  if (sxGroup.find(_T('.')) == StringX::npos) {
-    // We have exactly one group
-    setGroups.insert(sxGroup.c_str());
-  } else {
-    // We have > 1 group. Tokenize:
-    StringX sxPath, token;
-    std::vector<StringX> vTokens;
-    size_t pos = 0;
-    while ((pos = sxGroup.find(_T('.'))) != StringX::npos) {
-      token = sxGroup.substr(0, pos);
-      vTokens.push_back(token);
-      sxGroup.erase(0, pos + 1);
-    }
-    vTokens.push_back(sxGroup); // rightmost subgroup, e.g., "b" in "a.b"
-    ASSERT(vTokens.size() >= 2);
-    sxPath = vTokens[0];
-
-    setGroups.insert(sxPath.c_str());
-    for (size_t i = 1; i < vTokens.size(); i++) {
-      sxPath += StringX(_T(".")) + vTokens[i];
-      setGroups.insert(sxPath.c_str());
-    }
-  } // > 1 group
+  // Each prefix ending before a '.' is a group, as is the whole,
+  // e.g., "a", "a.b" & "a.b.c" for "a.b.c".
+  // No need to split into segments and rebuild the paths from them.
+  size_t pos = 0;
+  while ((pos = sxg.find(_T('.'), pos)) != StringX::npos) {
+    setGroups.emplace(sxg.c_str(), pos);
+    pos++;
+  }
+  setGroups.emplace(sxg.c_str(), sxg.length());
 }
 
 // GetAllGroups - returns an array of all unique group prefix names
@@ -1978,6 +2494,8 @@ private:
 bool PWScore::GetEntriesUsingNamedPasswordPolicy(const StringX &sxPolicyName,
               std::vector<st_GroupTitleUser> &ventries)
 {
+  // Not via m_EntryMetadata: it can't tell what it's missing, should an
+  // entry's policy name have been changed in place
   AddEntry add_entry(sxPolicyName, ventries);
   std::for_each(m_pwlist.begin(), m_pwlist.end(), add_entry);
 
@@ -1989,6 +2507,8 @@ bool PWScore::GetEntriesUsingNamedPasswordPolicy(const StringX &sxPolicyName,
 
 void PWScore::ParseDependants()
 {
+  PWSTrace::Span span("ParseDependants");
+  span.SetArg(static_cast<int64>(m_pwlist.size()));
   UUIDVector Possible_Aliases, Possible_Shortcuts;
 
   for (ItemListIter iter = m_pwlist.begin(); iter != m_pwlist.end(); iter++) {
@@ -2186,6 +2706,7 @@ void PWScore::DoAddDependentEntry(const CUUID &base_uuid,
     // Mark base entry as a base entry - must be a normal entry or already an alias base
     ASSERT(biter->second.IsNormal() || biter->second.IsAliasBase());
     biter->second.SetAliasBase();
+    m_EntryMetadata.Update(biter->second);
     if (baseWasNormal) {
       // Allow fail as new entry might not yet be in the GUI
       GUIRefreshEntry(biter->second, true);
@@ -2194,6 +2715,7 @@ void PWScore::DoAddDependentEntry(const CUUID &base_uuid,
     // Mark base entry as a base entry - must be a normal entry or already a shortcut base
     ASSERT(biter->second.IsNormal() || biter->second.IsShortcutBase());
     biter->second.SetShortcutBase();
+    m_EntryMetadata.Update(biter->second);
     if (baseWasNormal) {
       // Allow fail as new entry might not yet be in the GUI
       GUIRefreshEntry(biter->second, true);
@@ -2242,6 +2764,7 @@ void PWScore::DoRemoveDependentEntry(const CUUID &base_uuid,
     auto iter = m_pwlist.find(base_uuid);
     if (iter != m_pwlist.end()) {
       iter->second.SetNormal();
+      m_EntryMetadata.Update(iter->second);
 
       // If base was being deleted, it might have been removed from the GUI
       // before we get here dealing with its last dependent
@@ -2278,8 +2801,10 @@ void PWScore::DoRemoveAllDependentEntries(const CUUID &base_uuid,
 
   // Reset base entry to normal
   auto iter = m_pwlist.find(base_uuid);
-  if (iter != m_pwlist.end())
+  if (iter != m_pwlist.end()) {
     iter->second.SetNormal();
+    m_EntryMetadata.Update(iter->second);
+  }
 }
 
 bool PWScore::DoMoveDependentEntries(const CUUID &from_baseuuid,
@@ -2416,6 +2941,8 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
             // Invalid - delete!
             if (pmapDeletedItems != nullptr)
               pmapDeletedItems->insert(ItemList_Pair(*paiter, *pci_curitem));
+            RemoveSearchIndexEntry(iter->first);
+            m_EntryMetadata.Remove(iter->first);
             m_pwlist.erase(iter);
             continue;
           }
@@ -2440,6 +2967,8 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
             // Invalid - delete!
             if (pmapDeletedItems != nullptr)
               pmapDeletedItems->insert(ItemList_Pair(*paiter, *pci_curitem));
+            RemoveSearchIndexEntry(iter->first);
+            m_EntryMetadata.Remove(iter->first);
             m_pwlist.erase(iter);
             continue;
           }
@@ -2466,6 +2995,7 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
               pmapSaveTypePW->insert(SaveTypePWMap_Pair(*paiter, st_typepw));
             }
             pci_curitem->SetAlias();
+            m_EntryMetadata.Update(*pci_curitem);
             num_warnings++;
           }
         }
@@ -2486,6 +3016,7 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
           }
           iter->second.SetShortcutBase();
         }
+        m_EntryMetadata.Update(iter->second);
 
         pmmap->insert(ItemMMap_Pair(base_uuid, entry_uuid));
         if (type == CItemData::ET_ALIAS) {
@@ -2506,6 +3037,7 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
           pci_curitem->SetPassword(_T("[Shortcut]"));
           pci_curitem->SetShortcut();
         }
+        m_EntryMetadata.Update(*pci_curitem);
       } else {
         // Specified base does not exist!
         if (pRpt != nullptr) {
@@ -2530,6 +3062,7 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
             pmapSaveTypePW->insert(SaveTypePWMap_Pair(*paiter, st_typepw));
           }
           pci_curitem->SetNormal(); // but can make invalid alias a normal entry
+          m_EntryMetadata.Update(*pci_curitem);
         }
 
         num_warnings++;
@@ -2549,6 +3082,8 @@ void PWScore::UndoAddDependentEntries(ItemList *pmapDeletedItems,
        add_iter != pmapDeletedItems->end();
        add_iter++) {
     m_pwlist[add_iter->first] = add_iter->second;
+    UpdateSearchIndex(add_iter->second);
+    m_EntryMetadata.Add(add_iter->second);
   }
 
   for (restore_iter = pmapSaveTypePW->begin();
@@ -2563,6 +3098,7 @@ void PWScore::UndoAddDependentEntries(ItemList *pmapDeletedItems,
     pci_changeditem->SetEntryType(pst_typepw->et);
     if (!pst_typepw->sxpw.empty())
       pci_changeditem->SetPassword(pst_typepw->sxpw);
+    m_EntryMetadata.Update(*pci_changeditem);
   }
 }
 
@@ -2594,6 +3130,7 @@ void PWScore::ResetAllAliasPasswords(const CUUID &base_uuid)
     if (alias_itr != m_pwlist.end()) {
       alias_itr->second.SetPassword(csBasePassword);
       alias_itr->second.SetNormal();
+      m_EntryMetadata.Update(alias_itr->second);
       GUIRefreshEntry(alias_itr->second);
     }
   }
@@ -2997,7 +3534,10 @@ int PWScore::DoUpdatePasswordHistory(int iAction, int new_default_max,
     ItemListIter listPos;
     for (listPos = m_pwlist.begin(); listPos != m_pwlist.end(); listPos++) {
       CItemData &curitem = listPos->second;
+      const CItemData::EntryStatus es = curitem.GetStatus();
       (*updater)(curitem);
+      if (curitem.GetStatus() != es)
+        m_EntryMetadata.Update(curitem);
     }
   }
   delete updater;
@@ -3013,6 +3553,7 @@ void PWScore::UndoUpdatePasswordHistory(SavePWHistoryMap &mapSavedHistory)
     if (listPos != m_pwlist.end()) {
       listPos->second.SetPWHistory(itr->second.pwh);
       listPos->second.SetStatus(itr->second.es);
+      m_EntryMetadata.Update(listPos->second);
     }
   }
 }
@@ -3153,6 +3694,7 @@ void PWScore::GetDBProperties(st_DBProperties &st_dbp)
 
   st_dbp.db_name = m_hdr.m_DB_Name;
   st_dbp.db_description = m_hdr.m_DB_Description;
+  st_dbp.perfstats = GetPerfStats();
 }
 
 StringX PWScore::GetHeaderItem(PWSfile::HeaderType ht)
@@ -3244,16 +3786,21 @@ bool PWScore::ChangeMode(stringT &locker, int &iErrorCode)
 
     // It was R-O, better check no-one has changed anything from in-memory copy
     // The one calculated when we read it in is 'm_pFileSig' (R-O - so we haven't changed it)
-    // This is the new one
-    PWSFileSig newFileSig = PWSFileSig(m_currfile.c_str());
-    if (newFileSig.IsValid() && *m_pFileSig != newFileSig) {
-      // Oops - someone else has changed this user will need to close and open properly.
-      // Or the file signature is invalid e.g. file not there or fie size too small.
-      // Tell them the bad news after unlocking file and not changing mode
-      iErrorCode = DB_HAS_CHANGED;
+    if (m_FileMonitor.IsActive()) {
+      // Watch has been keeping an eye on it - no need to re-read
+      iErrorCode = m_FileMonitor.HasChanged() ? DB_HAS_CHANGED : 0;
     } else {
-      // Other error - e.g. can't open file or it is too small.
-      iErrorCode = newFileSig.GetErrorCode();
+      // This is the new one
+      PWSFileSig newFileSig = PWSFileSig(m_currfile.c_str());
+      if (newFileSig.IsValid() && *m_pFileSig != newFileSig) {
+        // Oops - someone else has changed this user will need to close and open properly.
+        // Or the file signature is invalid e.g. file not there or fie size too small.
+        // Tell them the bad news after unlocking file and not changing mode
+        iErrorCode = DB_HAS_CHANGED;
+      } else {
+        // Other error - e.g. can't open file or it is too small.
+        iErrorCode = newFileSig.GetErrorCode();
+      }
     }
     if (iErrorCode != 0) {
       pws_os::UnlockFile(m_currfile.c_str(), m_lockFileHandle);
@@ -3494,9 +4041,88 @@ uint32 PWScore::GetHashIters() const
 
 void PWScore::SetHashIters(uint32 value)
 {
+  if (value != m_hashIters)
+    ClearKeyMaterial();
   m_hashIters = value;
 }
 
+void PWScore::SetKDFParams(const PWSKDFParams &kdf)
+{
+  if (kdf != m_KDFParams)
+    ClearKeyMaterial();
+  m_KDFParams = kdf;
+}
+
+static PWSfile::VERSION KDFVersion(PWSfile::VERSION version)
+{
+  // New databases and older formats will be saved as V3
+  return (version == PWSfile::V40) ? PWSfile::V40 : PWSfile::V30;
+}
+
+bool PWScore::UsesHashIters() const
+{
+  return KDFVersion(m_ReadFileVersion) != PWSfile::V40 ||
+    m_KDFParams.kdf != PWSKDFParams::ARGON2ID;
+}
+
+double PWScore::GetUnlockTime() const
+{
+  if (!UsesHashIters())
+    return PWSfile::TimeKeyStretch(m_KDFParams);
+  return PWSfile::TimeKeyStretch(KDFVersion(m_ReadFileVersion), GetHashIters());
+}
+
+uint32 PWScore::CalibrateHashIters(unsigned targetMs) const
+{
+  if (!UsesHashIters())
+    return GetHashIters();
+  return PWSfile::CalibrateHashIters(KDFVersion(m_ReadFileVersion), targetMs);
+}
+
+void PWScore::ClearKeyMaterial()
+{
+  m_KeyMaterial.Clear();
+  m_nKeyMaterialGen++;
+}
+
+void PWScore::SetSearchIndexEnabled(bool bEnable)
+{
+  if (bEnable == m_bSearchIndexEnabled)
+    return;
+
+  m_bSearchIndexEnabled = bEnable;
+  if (bEnable)
+    m_SearchIndex.Build(m_pwlist);
+  else
+    m_SearchIndex.Clear();
+}
+
+void PWScore::SetFileWatchEnabled(bool bEnable, bool bFullSig)
+{
+  if (bEnable == m_bFileWatchEnabled && bFullSig == m_bFullFileSig)
+    return;
+
+  m_bFileWatchEnabled = bEnable;
+  m_bFullFileSig = bFullSig;
+  if (bEnable && m_pFileSig != nullptr)
+    StartFileMonitor(m_currfile); // takes current contents as the baseline
+  else
+    m_FileMonitor.Stop();
+}
+
+void PWScore::StartFileMonitor(const StringX &filename)
+{
+  if (!m_bFileWatchEnabled)
+    return;
+
+  // Called on the watch thread - observers must cope (see UIinterface.h)
+  m_FileMonitor.Start(filename.c_str(), m_bFullFileSig,
+                      [this]() {
+                        for (auto &obs : m_Observers)
+                          obs->DatabaseFileChanged();
+                      });
+}
+
 void PWScore::RemoveAtt(const pws_os::CUUID &attuuid)
 {
   // Should be a Command setting new CommandDBChange enum value
@@ -3505,6 +4131,17 @@ void PWScore::RemoveAtt(const pws_os::CUUID &attuuid)
   m_attlist.erase(m_attlist.find(attuuid));
 }
 
+bool PWScore::FindAttByContent(const CItemAtt &att, pws_os::CUUID &attuuid) const
+{
+  for (auto &p : m_attlist) {
+    if (p.first != att.GetUUID() && p.second.IsDuplicateOf(att)) {
+      attuuid = p.first;
+      return true;
+    }
+  }
+  return false;
+}
+
 AttList::size_type PWScore::GetNumAtts() const
 {
   if (GetReadFileVersion() == PWSfile::V40)
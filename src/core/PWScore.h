@@ -22,9 +22,14 @@
 #include "CommandInterface.h"
 #include "DBCompareData.h"
 #include "ExpiredList.h"
+#include "SearchIndex.h"
+#include "EntryMetadata.h"
+#include "FileMonitor.h"
 
 #include "coredefs.h"
 
+#include <thread>
+
 // Parameter list for ParseAliasPassword
 struct BaseEntryParms {
   // All fields except "InputType" are 'output'.
@@ -57,6 +62,7 @@ struct st_DBProperties {
   StringX unknownfields;
   StringX db_name;
   StringX db_description;
+  StringX perfstats; // see PWSCounters, not a property of the file
 
   st_DBProperties& operator=(const st_DBProperties& other)
   {
@@ -70,6 +76,7 @@ struct st_DBProperties {
       numemptygroups = other.numemptygroups;
       numentries = other.numentries;
       numgroups = other.numgroups;
+      perfstats = other.perfstats;
       unknownfields = other.unknownfields;
       whatlastsaved = other.whatlastsaved;
       whenlastsaved = other.whenlastsaved;
@@ -116,6 +123,7 @@ public:
     CANT_GET_LOCK = 3,
     DB_HAS_CHANGED = 4,
     CANT_OPEN_FILE = PWSfile::CANT_OPEN_FILE, // -10
+    OUT_OF_MEMORY = PWSfile::OUT_OF_MEMORY,   // -11
     USER_CANCEL = -9,                         // -9
     WRONG_PASSWORD = PWSfile::WRONG_PASSWORD, //  5
     BAD_DIGEST = PWSfile::BAD_DIGEST,         //  6
@@ -201,6 +209,22 @@ public:
   int WriteV2File(const StringX &filename)
   {return WriteFile(filename, PWSfile::V20, false);}
 
+  // Background save: the database is copied as it is now and written out
+  // on a separate thread to a temporary file, which then replaces filename.
+  // Observer::DatabaseSaved is called from that thread when done; the UI then
+  // calls FinishAsyncSave() (on its own thread) to pick up the result.
+  // Changes made while the write is in progress leave the database dirty,
+  // so that the next save includes them.
+  // Only for saves in the current format - returns FAILURE (and does nothing)
+  // if version is older than the one read, or pre-V30.
+  int WriteCurFileAsync() {return WriteFileAsync(m_currfile, m_ReadFileVersion);}
+  int WriteFileAsync(const StringX &filename, PWSfile::VERSION version);
+  bool IsSaveInProgress() const;
+  // Waits for any background save, returns its status (SUCCESS if none).
+  // A failed one that another call (e.g., WriteFile) had to wait for is
+  // still reported here, once.
+  int FinishAsyncSave();
+
   // R/O file status
   void SetReadOnly(bool state) {m_bIsReadOnly = state;}
   bool IsReadOnly() const {return m_bIsReadOnly;}
@@ -374,6 +398,17 @@ public:
   Command * GetRedoCommand();
   Command * GetUndoCommand();
 
+  // Undo history is trimmed, oldest first, to keep the memory held by
+  // commands within a limit, in bytes (0 for none). Unless set here, this
+  // is the UndoMaximumMemorySize preference (in KB).
+  void SetUndoMemoryLimit(size_t limit);
+  size_t GetUndoMemoryLimit() const;
+  size_t GetUndoMemoryUsage() const;
+
+  // Performance counters (see PWSCounters), with the gauges set from this core
+  StringX GetPerfStats() const;
+  std::string GetPerfStatsJSON() const;
+
   // Find in m_pwlist by group, title and user name, exact match
   ItemListIter Find(const StringX &a_group,
                     const StringX &a_title, const StringX &a_user);
@@ -472,6 +507,30 @@ public:
   size_t GetExpirySize() {return m_ExpireCandidates.size();}
   ExpiredList GetExpired(int idays) {return m_ExpireCandidates.GetExpired(idays);}
 
+  // Search index over non-sensitive text fields - off by default.
+  // Enabling builds it from the current entries, it's then kept up to date
+  // by ReadFile and the Command path. Returns nullptr if not enabled.
+  void SetSearchIndexEnabled(bool bEnable);
+  bool IsSearchIndexEnabled() const {return m_bSearchIndexEnabled;}
+  const CSearchIndex *GetSearchIndex() const
+  {return m_bSearchIndexEnabled ? &m_SearchIndex : nullptr;}
+
+  // Column-wise copy of entry times, type, status etc. - always kept.
+  // Callers that change an entry in place (e.g. SetATime) must refresh it.
+  const CEntryMetadata &GetEntryMetadata() const {return m_EntryMetadata;}
+  void RefreshEntryMetadata(const CItemData &ci)
+  {if (m_EntryMetadata.Has(ci.GetUUID())) m_EntryMetadata.Update(ci);}
+
+  // Watch the current database file for changes made by others - off by
+  // default, and a no-op where the platform can't. While watching, backup
+  // and mode change rely on the watch instead of re-reading the file.
+  // bFullSig: confirm changes by hashing the whole file (in the background)
+  // rather than just its head and tail.
+  // Observers hear of a change via DatabaseFileChanged(), on another thread.
+  void SetFileWatchEnabled(bool bEnable, bool bFullSig = false);
+  bool IsFileWatchEnabled() const {return m_bFileWatchEnabled;}
+  bool HasDBFileChangedExternally() const {return m_FileMonitor.HasChanged();}
+
   // Yubi support:
   const unsigned char *GetYubiSK() const;
   void SetYubiSK(const unsigned char *);
@@ -496,12 +555,29 @@ public:
 
   uint32 GetHashIters() const;
   void SetHashIters(uint32 value);
+  // V4 only: Argon2id rather than PBKDF2, as read from the file, and kept
+  // when saving it. Hash iterations only apply to PBKDF2.
+  const PWSKDFParams &GetKDFParams() const {return m_KDFParams;}
+  void SetKDFParams(const PWSKDFParams &kdf);
+  // False for a V4 database whose passkey is stretched with Argon2id, for
+  // which hash iterations have no effect, so neither has calibrating them.
+  bool UsesHashIters() const;
+  // For the current database's format, how long unlocking with the current
+  // hash iterations (or Argon2id costs) takes on this machine (ms), and how
+  // many iterations would take about targetMs. Both run the key stretching,
+  // so take a while.
+  // The latter doesn't change anything - use DBPrefsCommand to apply it.
+  // Only if UsesHashIters(), else it returns the current hash iterations.
+  double GetUnlockTime() const;
+  uint32 CalibrateHashIters(unsigned targetMs) const;
 
   const CItemAtt &GetAtt(const pws_os::CUUID &attuuid) const {return m_attlist.find(attuuid)->second;}
   CItemAtt &GetAtt(const pws_os::CUUID &attuuid) {return m_attlist[attuuid];}
   void PutAtt(const CItemAtt &att) {m_attlist[att.GetUUID()] = att;}
   void RemoveAtt(const pws_os::CUUID &attuuid);
   bool HasAtt(const pws_os::CUUID &attuuid) const {return m_attlist.find(attuuid) != m_attlist.end();}
+  // Finds an attachment that att can share, see CItemAtt::IsDuplicateOf()
+  bool FindAttByContent(const CItemAtt &att, pws_os::CUUID &attuuid) const;
   AttList::size_type GetNumAtts() const;
   std::set<StringX> GetAllMediaTypes() const;
   
@@ -601,6 +677,8 @@ private:
   // Following used by SetPassKey
   void EncryptPassword(const unsigned char *plaintext, size_t len,
                        unsigned char *ciphertext) const;
+  // As m_passkey, for comparing passkeys without keeping them (see CheckPasskey)
+  std::vector<unsigned char> EncryptPassKey(const StringX &passkey) const;
 
   int MergeDependents(PWScore *pothercore, MultiCommands *pmulticmds,
                       const uuid_array_t &base_uuid, const uuid_array_t &new_base_uuid, 
@@ -613,6 +691,7 @@ private:
   size_t m_passkey_len; // Length of cleartext passkey
 
   uint32 m_hashIters; // for new or currently open db.
+  PWSKDFParams m_KDFParams; // ditto
 
   static unsigned char m_session_key[32];
   static bool m_session_initialized;
@@ -679,12 +758,18 @@ private:
   std::vector<Command *> m_vpcommands;
   std::vector<Command *>::iterator m_undo_iter;
   std::vector<Command *>::iterator m_redo_iter;
+  size_t m_UndoMemoryLimit = 0;
+  size_t m_UndoMemoryUsage = 0; // sum of m_vDBState's memory, kept as it changes
+  bool m_bUndoMemoryLimitSet = false;
+  void TrimCommands();
+  void SetPerfGauges() const;
   
   // DB clean/dirty states - before and after command execution.
   enum DBState { CLEAN, DIRTY };
   struct DBStates {
     DBState before;
     DBState after;
+    size_t memory; // command's GetMemoryUsage() when last executed or undone, for TrimCommands
   };
 
   std::vector<DBStates> m_vDBState;
@@ -707,6 +792,35 @@ private:
   void RemoveExpiryEntry(const CItemData &ci)
   {m_ExpireCandidates.Remove(ci);}
 
+  CSearchIndex m_SearchIndex;
+  bool m_bSearchIndexEnabled;
+  void UpdateSearchIndex(const CItemData &ci)
+  {if (m_bSearchIndexEnabled) m_SearchIndex.Update(ci);}
+  void RemoveSearchIndexEntry(const pws_os::CUUID &uuid)
+  {if (m_bSearchIndexEnabled) m_SearchIndex.Remove(uuid);}
+
+  CEntryMetadata m_EntryMetadata;
+
+  CFileMonitor m_FileMonitor;
+  bool m_bFileWatchEnabled;
+  bool m_bFullFileSig;
+  void StartFileMonitor(const StringX &filename);
+
+  struct st_AsyncSave *m_pAsyncSave; // defined in PWScore.cpp
+  std::thread m_saveThread;
+  int m_nAsyncSaveStatus; // of a failed background save, until FinishAsyncSave reports it
+  int CompleteAsyncSave(); // FinishAsyncSave, for the core's own use
+  std::thread m_pruneThread; // deletes backups in excess, see BackupCurFile
+  unsigned long m_nChangeCount; // bumped by Execute/Undo/Redo
+  void MarkSavedClean(); // update DB states after a save
+
+  // Result of stretching the passkey, reused by saves until the passkey or
+  // number of hash iterations changes (see PWSKeyMaterial)
+  PWSKeyMaterial m_KeyMaterial;
+  unsigned long m_nKeyMaterialGen; // bumped whenever it's cleared
+  void ClearKeyMaterial();
+  struct st_VerifiedKey *m_pVerifiedKey; // from CheckPasskey, for ReadFile
+
   stringT GetXMLPWPolicies(const OrderedItemList *pOIL = nullptr);
   PSWDPolicyMap m_MapPSWDPLC;
   PSWDPolicyMap m_InitialMapPSWDPLC;  // Needed for HavePasswordPolicyNamesChanged
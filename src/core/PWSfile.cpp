@@ -12,11 +12,16 @@
 #include "SysInfo.h"
 #include "core.h"
 #include "os/file.h"
+#include "os/mem.h"
 
 #include "crypto/sha1.h" // for simple encrypt/decrypt
 #include "PWSrand.h"
+#include "CipherPipeline.h"
+#include "PWSCounters.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
 
 PWSfile *PWSfile::MakePWSfile(const StringX &a_filename, const StringX &passkey,
                               VERSION &version, RWmode mode, int &status,
@@ -109,7 +114,7 @@ PWSfile::PWSfile(const StringX &filename, RWmode mode, VERSION v)
   : m_filename(filename), m_passkey(_T("")), m_fd(nullptr),
   m_curversion(v), m_rw(mode), m_defusername(_T("")),
   m_fish(nullptr), m_terminal(nullptr), m_status(SUCCESS),
-  m_nRecordsWithUnknownFields(0)
+  m_nRecordsWithUnknownFields(0), m_pKeyMaterial(nullptr)
 {
 }
 
@@ -144,6 +149,12 @@ void PWSfile::FOpen()
   }
   m_fd = pws_os::FOpen(m_filename.c_str(), m);
   if(m_fd) {
+    if (m_rw == Write && m_fd != stdout) {
+      // Records are written a block at a time - buffer them all, or most,
+      // so that they go out in a few large writes before the sync on close
+      m_writeBuf.resize(WRITE_BUFSIZE);
+      std::setvbuf(m_fd, m_writeBuf.data(), _IOFBF, m_writeBuf.size());
+    }
     m_fileLength = pws_os::fileLength(m_fd);
   }
   else {
@@ -169,7 +180,9 @@ size_t PWSfile::WriteCBC(unsigned char type, const unsigned char *data,
                          size_t length)
 {
   ASSERT(m_fish != nullptr && m_IV != nullptr);
-  return _writecbc(m_fd, data, length, type, m_fish, m_IV);
+  const size_t numWritten = _writecbc(m_fd, data, length, type, m_fish, m_IV);
+  PWSCounters::Add(PWSCounters::BytesEncrypted, numWritten);
+  return numWritten;
 }
 
 size_t PWSfile::ReadCBC(unsigned char &type, unsigned char* &data,
@@ -182,6 +195,7 @@ size_t PWSfile::ReadCBC(unsigned char &type, unsigned char* &data,
   ASSERT(m_fish != nullptr && m_IV != nullptr);
   retval = _readcbc(m_fd, buffer, buffer_len, type,
     m_fish, m_IV, m_terminal, m_fileLength);
+  PWSCounters::Add(PWSCounters::BytesDecrypted, retval);
 
   if (buffer_len > 0) {
     if (buffer_len < length || data == nullptr)
@@ -202,7 +216,41 @@ size_t PWSfile::ReadCBC(unsigned char &type, unsigned char* &data,
   return retval;
 }
 
-int PWSfile::CheckPasskey(const StringX &filename, const StringX &passkey, VERSION &version)
+double PWSfile::TimeKeyStretch(VERSION version, uint32 nHashIters)
+{
+  ASSERT(version == V30 || version == V40);
+  return (version == V40) ? PWSfileV4::TimeKeyStretch(nHashIters) :
+    PWSfileV3::TimeKeyStretch(nHashIters);
+}
+
+double PWSfile::TimeKeyStretch(const PWSKDFParams &kdf)
+{
+  ASSERT(kdf.kdf == PWSKDFParams::ARGON2ID);
+  return PWSfileV4::TimeKeyStretch(kdf);
+}
+
+uint32 PWSfile::CalibrateHashIters(VERSION version, unsigned targetMs)
+{
+  // Time is linear in iterations, so measure enough of them to get a
+  // reliable rate (doubling until it takes a while) and scale that
+  const double minSampleMs = 50;
+  uint32 n = MIN_HASH_ITERATIONS / 16;
+  double ms = TimeKeyStretch(version, n);
+  while (ms < minSampleMs && n < MAX_USABLE_HASH_ITERS) {
+    n *= 2;
+    ms = TimeKeyStretch(version, n);
+  }
+
+  const double iters = double(n) * targetMs / std::max(ms, 0.001);
+  if (iters <= MIN_HASH_ITERATIONS)
+    return MIN_HASH_ITERATIONS;
+  if (iters >= MAX_USABLE_HASH_ITERS)
+    return MAX_USABLE_HASH_ITERS;
+  return static_cast<uint32>(iters);
+}
+
+int PWSfile::CheckPasskey(const StringX &filename, const StringX &passkey,
+                          VERSION &version, PWSKeyMaterial *pkm)
 {
   /**
    * We start with V3 because it's the quickest to rule out
@@ -215,11 +263,21 @@ int PWSfile::CheckPasskey(const StringX &filename, const StringX &passkey, VERSI
 
   int status;
   version = UNKNOWN_VERSION;
-  status = PWSfileV3::CheckPasskey(filename, passkey);
+  unsigned char Ptag[SHA256::HASHLEN];
+  unsigned char salt[PWSKeyMaterial::SALTLEN];
+  uint32 nIter = 0;
+  status = PWSfileV3::CheckPasskey(filename, passkey, nullptr, Ptag, &nIter, salt);
   if (status == SUCCESS) {
     version = V30;
+    if (pkm != nullptr) {
+      pkm->Clear();
+      pkm->m_version = V30;
+      pkm->m_nHashIters = nIter;
+      memcpy(pkm->m_salt, salt, sizeof(salt));
+      memcpy(pkm->m_key, Ptag, sizeof(Ptag));
+    }
   } else {
-    status = PWSfileV4::CheckPasskey(filename, passkey);
+    status = PWSfileV4::CheckPasskey(filename, passkey, nullptr, nullptr, nullptr, pkm);
     if (status == SUCCESS)
       version = V40;
     else {
@@ -228,6 +286,7 @@ int PWSfile::CheckPasskey(const StringX &filename, const StringX &passkey, VERSI
         version = V20; // or V17?
     }
   }
+  trashMemory(Ptag, sizeof(Ptag));
   return status;
 }
 
@@ -309,8 +368,10 @@ static stringT ErrorMessages()
 #define BUFSIZ 2048
 #endif
 
-bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess)
+bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess,
+                      const CryptOptions &options, CryptStats *pStats)
 {
+  const auto start = std::chrono::steady_clock::now();
   FILE* out = nullptr;
   Fish *fish = nullptr;
   bool status = true;
@@ -324,6 +385,7 @@ bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess
   unsigned int BS = 0;
   const unsigned char* bufp = nullptr;
   bool isBigFile = false;
+  unsigned nThreads = 1;
 
   
   FILE *in = pws_os::FOpen(fn, _T("rb"));
@@ -376,47 +438,80 @@ bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess
 
   unsigned char buf[BUFSIZ];
   bufp = buf;
-  nread = fread(buf, 1, BUFSIZ, in);
   orig_filelen = file_len;
 
-  try {
-    //write first block: length + dummy type +  bytes of data
-    size_t nwritten = _writecbc1st(out, &bufp, &file_len, 0, fish, ivthing, isBigFile);
-    if (nwritten != BS) {
+  if (options.bPipelined) {
+    try {
+      // No data goes in the length block, as only TwoFish would take
+      // some, and that's only used for big files
+      if (_writecbc1st(out, &bufp, &file_len, 0, fish, ivthing, isBigFile) != BS) {
+        status = false;
+        goto exit;
+      }
+    } catch (...) {
+      errno = EIO;
       status = false;
       goto exit;
     }
-    // write rest of first buffer
-    nread -= orig_filelen - file_len;
-    nwritten = _writecbcRest(out, bufp, nread, fish, ivthing);
-    if (nwritten < nread) {
+    ASSERT(file_len == orig_filelen);
+
+    CipherPipeline pipeline(fish, ivthing, options.bufferSize != 0 ?
+                            options.bufferSize : size_t(CipherPipeline::DEFAULT_BUFSIZE));
+    if (!pipeline.Encrypt(in, out)) {
       status = false;
       goto exit;
     }
-
-
-    do { // main read/encrypt/write loop
+    nThreads = pipeline.GetCipherThreads();
+  } else {
+    try {
       nread = fread(buf, 1, BUFSIZ, in);
-      if (ferror(in)) { // this is how to detect fread errors
-       status = false;
+
+      //write first block: length + dummy type +  bytes of data
+      size_t nwritten = _writecbc1st(out, &bufp, &file_len, 0, fish, ivthing, isBigFile);
+      if (nwritten != BS) {
+        status = false;
+        goto exit;
+      }
+      // write rest of first buffer
+      nread -= orig_filelen - file_len;
+      nwritten = _writecbcRest(out, bufp, nread, fish, ivthing);
+      if (nwritten < nread) {
+        status = false;
         goto exit;
       }
 
-      if (nread == 0) // save writing a block or two.
-        break;
 
-      _writecbcRest(out, buf, nread, fish, ivthing);
+      do { // main read/encrypt/write loop
+        nread = fread(buf, 1, BUFSIZ, in);
+        if (ferror(in)) { // this is how to detect fread errors
+         status = false;
+          goto exit;
+        }
+
+        if (nread == 0) // save writing a block or two.
+          break;
+
+        _writecbcRest(out, buf, nread, fish, ivthing);
     
-    } while (!feof(in));
+      } while (!feof(in));
 
-  } catch (...) { // _writecbc* throws an exception if it fails to write
-    errno = EIO;
-    status = false;
-    goto exit;
-  } // catch
+    } catch (...) { // _writecbc* throws an exception if it fails to write
+      errno = EIO;
+      status = false;
+      goto exit;
+    } // catch
+  }
 
   status = (pws_os::FClose(out, true) == 0); out = nullptr;
 
+  if (status)
+    PWSCounters::Add(PWSCounters::BytesEncrypted, orig_filelen);
+  if (status && pStats != nullptr) {
+    pStats->nBytes = orig_filelen;
+    pStats->dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pStats->nThreads = nThreads;
+  }
+
  exit:
   if (!status)
     errmess = ErrorMessages();
@@ -428,8 +523,10 @@ bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess
   return status;
 }
 
-bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess)
+bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess,
+                      const CryptOptions &options, CryptStats *pStats)
 {
+  const auto start = std::chrono::steady_clock::now();
   Fish *fish = nullptr;
   ulong64 file_len;
   bool status = true;
@@ -526,6 +623,20 @@ bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess
       goto exit;
     }
 
+    if (options.bPipelined) {
+      CipherPipeline pipeline(fish, ivthing, options.bufferSize != 0 ?
+                              options.bufferSize : size_t(CipherPipeline::DEFAULT_BUFSIZE),
+                              options.nThreads);
+      status = pipeline.Decrypt(in, out, plaintext_length);
+      if (status)
+        PWSCounters::Add(PWSCounters::BytesDecrypted, plaintext_length);
+      if (status && pStats != nullptr) {
+        pStats->nBytes = plaintext_length;
+        pStats->nThreads = pipeline.GetCipherThreads();
+      }
+      goto exit;
+    }
+
     // now iterate over rest of file
     unsigned char buf[BUFSIZ];
     size_t nleft = plaintext_length;
@@ -551,6 +662,12 @@ bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess
     if (nleft != 0) {
       // truncated ciphertext?
       status = false;
+    } else {
+      PWSCounters::Add(PWSCounters::BytesDecrypted, plaintext_length);
+      if (pStats != nullptr) {
+        pStats->nBytes = plaintext_length;
+        pStats->nThreads = 1;
+      }
     }
   } // write decrypted
  exit:
@@ -560,6 +677,8 @@ bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess
     errmess = ErrorMessages();
   pws_os::FClose(in, false);
   pws_os::FClose(out, true);
+  if (status && pStats != nullptr)
+    pStats->dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
   return status;
 }
@@ -577,9 +696,54 @@ bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess
 // was modified at offset X, then everything from X to the end of the file will
 // be modified and the digests would be different.
 
-PWSFileSig::PWSFileSig(const stringT &fname)
+PWSKeyMaterial::PWSKeyMaterial()
+{
+  pws_os::mlock(this, sizeof(*this));
+  Clear();
+}
+
+PWSKeyMaterial::PWSKeyMaterial(const PWSKeyMaterial &that)
+{
+  pws_os::mlock(this, sizeof(*this));
+  *this = that;
+}
+
+PWSKeyMaterial &PWSKeyMaterial::operator=(const PWSKeyMaterial &that)
+{
+  if (this != &that) {
+    m_version = that.m_version;
+    m_nHashIters = that.m_nHashIters;
+    memcpy(m_salt, that.m_salt, sizeof(m_salt));
+    memcpy(m_key, that.m_key, sizeof(m_key));
+    memcpy(m_ell, that.m_ell, sizeof(m_ell));
+    memcpy(m_kw_k, that.m_kw_k, sizeof(m_kw_k));
+    memcpy(m_kw_l, that.m_kw_l, sizeof(m_kw_l));
+  }
+  return *this;
+}
+
+PWSKeyMaterial::~PWSKeyMaterial()
+{
+  Clear();
+  pws_os::munlock(this, sizeof(*this));
+}
+
+void PWSKeyMaterial::Clear()
+{
+  m_version = PWSfile::UNKNOWN_VERSION;
+  m_nHashIters = 0;
+  trashMemory(m_salt, sizeof(m_salt));
+  trashMemory(m_key, sizeof(m_key));
+  trashMemory(m_ell, sizeof(m_ell));
+  trashMemory(m_kw_k, sizeof(m_kw_k));
+  trashMemory(m_kw_l, sizeof(m_kw_l));
+}
+
+PWSFileSig::PWSFileSig(const stringT &fname, bool bFullFile)
+  : m_bFullFile(bFullFile)
 {
   const long THRESHOLD = 2048; // if file's longer than this, hash only head & tail
+  const size_t CHUNKSIZE = 65536; // for full file hashing
 
   m_length = 0;
   m_iErrorCode = PWSfile::SUCCESS;
@@ -591,7 +755,20 @@ PWSFileSig::PWSFileSig(const stringT &fname)
     // Not the right place to be worried about min size, as this is format
     // version specific (and we're in PWSFile).
     // An empty file, though, should be failed.
-    if (m_length > 0) {
+    if (m_length > 0 && m_bFullFile) {
+      std::vector<unsigned char> buf(CHUNKSIZE);
+      ulong64 total = 0;
+      size_t nread;
+      while ((nread = fread(buf.data(), 1, buf.size(), fp)) > 0) {
+        hash.Update(buf.data(), nread);
+        total += nread;
+      }
+      // File changed length under us (or read error) - can't trust this
+      if (ferror(fp) || total != m_length)
+        m_iErrorCode = PWSfile::READ_FAIL;
+      else
+        hash.Final(m_digest);
+    } else if (m_length > 0) {
       unsigned char buf[THRESHOLD];
       if (m_length <= THRESHOLD) {
         if (fread(buf, size_t(m_length), 1, fp) == 1) {
@@ -618,6 +795,7 @@ PWSFileSig::PWSFileSig(const stringT &fname)
 
 PWSFileSig::PWSFileSig(const PWSFileSig &pfs)
 {
+  m_bFullFile = pfs.m_bFullFile;
   m_length = pfs.m_length;
   m_iErrorCode = pfs.m_iErrorCode;
   memcpy(m_digest, pfs.m_digest, sizeof(m_digest));
@@ -626,6 +804,7 @@ PWSFileSig::PWSFileSig(const PWSFileSig &pfs)
 PWSFileSig &PWSFileSig::operator=(const PWSFileSig &that)
 {
   if (this != &that) {
+    m_bFullFile = that.m_bFullFile;
     m_length = that.m_length;
     m_iErrorCode = that.m_iErrorCode;
     memcpy(m_digest, that.m_digest, sizeof(m_digest));
@@ -633,12 +812,13 @@ PWSFileSig &PWSFileSig::operator=(const PWSFileSig &that)
   return *this;
 }
 
-bool PWSFileSig::operator==(const PWSFileSig &that)
+bool PWSFileSig::operator==(const PWSFileSig &that) const
 {
   // Check this first as digest may otherwise be invalid
   if (m_iErrorCode != 0 || that.m_iErrorCode != 0)
     return false;
 
-  return (m_length == that.m_length &&
+  return (m_bFullFile == that.m_bFullFile &&
+          m_length == that.m_length &&
           memcmp(m_digest, that.m_digest, sizeof(m_digest)) == 0);
 }
@@ -41,6 +41,25 @@
 
 class Fish;
 class Asker;
+struct PWSKeyMaterial;
+
+// How a new V4 key block is to stretch the passkey: with PBKDF2, for the
+// number of iterations given to PWSfile::SetNHashIters(), or with Argon2id
+// and its costs (see formatV4.txt).
+struct PWSKDFParams {
+  enum KDF {PBKDF2 = 0, ARGON2ID = 1};
+
+  PWSKDFParams() : kdf(PBKDF2), tCost(0), mCostKiB(0), parallelism(0) {}
+  PWSKDFParams(uint32 t, uint32 m, uint32 p)
+    : kdf(ARGON2ID), tCost(t), mCostKiB(m), parallelism(p) {}
+  bool operator==(const PWSKDFParams &that) const
+  {return kdf == that.kdf && tCost == that.tCost &&
+      mCostKiB == that.mCostKiB && parallelism == that.parallelism;}
+  bool operator!=(const PWSKDFParams &that) const {return !(*this == that);}
+
+  KDF kdf;
+  uint32 tCost, mCostKiB, parallelism; // Argon2id only
+};
 
 class PWSfile
 {
@@ -62,7 +81,8 @@ public:
     READ_FAIL,                               //  9
     WRITE_FAIL,                              //  10
     WRONG_RECORD,                            // 11
-    CANT_OPEN_FILE = -10                     //  -10 - see PWScore.h
+    CANT_OPEN_FILE = -10,                    //  -10 - see PWScore.h
+    OUT_OF_MEMORY = -11                      //  -11 - see PWScore.h
   };
 
   /**
@@ -101,12 +121,39 @@ public:
                               Asker *pAsker = nullptr, Reporter *pReporter = nullptr);
 
   static VERSION ReadVersion(const StringX &filename, const StringX &passkey);
+  // If pkm isn't null, it gets the key material (V3 and later), with which
+  // a file opened for read needn't stretch the passkey again.
   static int CheckPasskey(const StringX &filename, const StringX &passkey,
-                          VERSION &version);
+                          VERSION &version, PWSKeyMaterial *pkm = nullptr);
+
+  // Key stretching calibration. nHashIters is as for Set/GetNHashIters(),
+  // i.e., in V3 terms whatever the version (V30 or V40).
+  // TimeKeyStretch returns how many ms stretching a passkey takes here,
+  // CalibrateHashIters how many iterations would take about targetMs,
+  // within MIN_HASH_ITERATIONS..MAX_USABLE_HASH_ITERS.
+  static double TimeKeyStretch(VERSION version, uint32 nHashIters);
+  static double TimeKeyStretch(const PWSKDFParams &kdf); // V4 Argon2id
+  static uint32 CalibrateHashIters(VERSION version, unsigned targetMs);
 
   // Following for 'legacy' use of pwsafe as file encryptor/decryptor
-  static bool Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess);
-  static bool Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess);
+  struct CryptOptions {
+    CryptOptions() : bPipelined(true), bufferSize(0), nThreads(0) {}
+    bool bPipelined;   // see CipherPipeline, else a block at a time
+    size_t bufferSize; // per pipeline stage, 0 for the default
+    unsigned nThreads; // for decryption, 0 for one per processor
+  };
+  struct CryptStats {
+    CryptStats() : nBytes(0), dSeconds(0), nThreads(0) {}
+    ulong64 nBytes;    // plaintext
+    double dSeconds;
+    unsigned nThreads; // most en/decrypting at once
+  };
+  static bool Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess,
+                      const CryptOptions &options = CryptOptions(),
+                      CryptStats *pStats = nullptr);
+  static bool Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess,
+                      const CryptOptions &options = CryptOptions(),
+                      CryptStats *pStats = nullptr);
   static size_t fileThresholdSize; // files this size and above encrypted differently - configurable for testing
 
   virtual ~PWSfile();
@@ -132,6 +179,17 @@ public:
   // Following implemented in V3 and later
   virtual uint32 GetNHashIters() const {return 0;}
   virtual void SetNHashIters(uint32 ) {}
+  // Following implemented in V4 and later: what the passkey's key block
+  // uses (after a read) or a new one is to use (write)
+  virtual PWSKDFParams GetKDFParams() const {return PWSKDFParams();}
+  virtual void SetKDFParams(const PWSKDFParams &) {}
+
+  // Key stretching results, so that a later save or read needn't redo it.
+  // Set before Open() - only used if it matches the version, number of
+  // iterations and (for read) salt, and must have come from the same passkey.
+  // Get after a successful Open(), returns false if not available.
+  void SetKeyMaterial(const PWSKeyMaterial *pkm) {m_pKeyMaterial = pkm;}
+  virtual bool GetKeyMaterial(PWSKeyMaterial &) const {return false;}
 
   void SetDBFilters(const PWSFilters &MapDBFilters) { m_MapDBFilters = MapDBFilters;}
   const PWSFilters *GetDBFilters() const {return &m_MapDBFilters;}
@@ -157,6 +215,7 @@ public:
 protected:
   PWSfile(const StringX &filename, RWmode mode, VERSION v = UNKNOWN_VERSION);
   void FOpen(); // calls right variant of m_fd = fopen(m_filename);
+  enum {WRITE_BUFSIZE = 256 * 1024};
   virtual size_t WriteCBC(unsigned char type, const StringX &data) = 0;
   virtual size_t WriteCBC(unsigned char type, const unsigned char *data,
                           size_t length);
@@ -184,33 +243,66 @@ protected:
   PSWDPolicyMap m_MapPSWDPLC;
   std::vector<StringX> m_vEmptyGroups;
   ulong64 m_fileLength;
+  std::vector<char> m_writeBuf; // for m_fd, when writing
   Asker *m_pAsker;
   Reporter *m_pReporter;
+  const PWSKeyMaterial *m_pKeyMaterial;
 
 private:
   PWSfile& operator=(const PWSfile&) = delete; // Do not implement
 };
 
+// What key stretching (V3 StretchKey, V4 pbkdf2) derives from the passkey,
+// with the salt and number of iterations used. The V4 fields are those of
+// the key block that the passkey opens.
+// Memory is locked and wiped on destruction/Clear().
+struct PWSKeyMaterial {
+  enum {SALTLEN = 32, KEYLEN = 32, KWLEN = KEYLEN + 8};
+
+  PWSKeyMaterial();
+  PWSKeyMaterial(const PWSKeyMaterial &that);
+  PWSKeyMaterial &operator=(const PWSKeyMaterial &that);
+  ~PWSKeyMaterial();
+
+  void Clear();
+  bool IsValid() const {return m_version != PWSfile::UNKNOWN_VERSION;}
+  bool Matches(PWSfile::VERSION version, uint32 nHashIters) const
+  {return m_version == version && m_nHashIters == nHashIters;}
+
+  PWSfile::VERSION m_version; // UNKNOWN_VERSION if empty
+  uint32 m_nHashIters;        // as stored in the file
+  unsigned char m_salt[SALTLEN];
+  unsigned char m_key[KEYLEN]; // V3: stretched passkey P', V4: K
+  unsigned char m_ell[KEYLEN]; // V4: L
+  unsigned char m_kw_k[KWLEN], m_kw_l[KWLEN]; // V4: K, L wrapped
+};
+
 // A quick way to determine if two files are equal,
 // or if a given file has been modified. For large files,
 // this may miss changes made to the middle. This is due
 // to a performance trade-off.
+// With bFullFile, the whole file is hashed (streamed, so memory use
+// doesn't grow with file size) - better done off the UI thread.
+// Signatures of different kinds never compare equal.
 class PWSFileSig
 {
 public:
-  PWSFileSig(const stringT &fname);
+  PWSFileSig(const stringT &fname, bool bFullFile = false);
   PWSFileSig(const PWSFileSig &pfs);
   PWSFileSig &operator=(const PWSFileSig &that);
 
-  bool IsValid() {return m_iErrorCode == PWSfile::SUCCESS;}
-  int GetErrorCode() {return m_iErrorCode;}
+  bool IsValid() const {return m_iErrorCode == PWSfile::SUCCESS;}
+  int GetErrorCode() const {return m_iErrorCode;}
+
+  bool operator==(const PWSFileSig &that) const;
+  bool operator!=(const PWSFileSig &that) const {return !(*this == that);}
 
-  bool operator==(const PWSFileSig &that);
-  bool operator!=(const PWSFileSig &that) {return !(*this == that);}
+  bool IsFullFile() const {return m_bFullFile;}
 
 private:
   ulong64 m_length; // -1 if file doesn't exist or zero length
   unsigned char m_digest[SHA256::HASHLEN];
   int m_iErrorCode;
+  bool m_bFullFile;
 };
 #endif /* __PWSFILE_H */
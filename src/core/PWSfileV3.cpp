@@ -13,6 +13,8 @@
 #include "PWSFilters.h"
 #include "PWSdirs.h"
 #include "PWSLog.h"
+#include "PWSCounters.h"
+#include "PWSTrace.h"
 #include "core.h"
 
 #include "os/debug.h"
@@ -30,6 +32,7 @@
 #include <iomanip>
 #include <type_traits> // for static_assert
 #include <algorithm> // for sort
+#include <chrono>
 
 using namespace std;
 using pws_os::CUUID;
@@ -66,7 +69,7 @@ static unsigned char TERMINAL_BLOCK[TwoFish::BLOCKSIZE] = {
   'P', 'W', 'S', '3', '-', 'E', 'O', 'F'};
 
 PWSfileV3::PWSfileV3(const StringX &filename, RWmode mode, VERSION version)
-: PWSfile(filename, mode, version), m_nHashIters(0)
+: PWSfile(filename, mode, version), m_nHashIters(0), m_bHavePtag(false)
 {
   m_IV = m_ipthing;
   m_terminal = TERMINAL_BLOCK;
@@ -74,6 +77,23 @@ PWSfileV3::PWSfileV3(const StringX &filename, RWmode mode, VERSION version)
 
 PWSfileV3::~PWSfileV3()
 {
+  trashMemory(m_ptag, sizeof(m_ptag));
+}
+
+bool PWSfileV3::GetKeyMaterial(PWSKeyMaterial &km) const
+{
+  static_assert(int(PWSKeyMaterial::SALTLEN) == int(PWSaltLength) &&
+                int(PWSKeyMaterial::KEYLEN) == int(SHA256::HASHLEN),
+                "PWSKeyMaterial doesn't fit V3");
+  if (!m_bHavePtag)
+    return false;
+
+  km.Clear();
+  km.m_version = V30;
+  km.m_nHashIters = m_nHashIters;
+  memcpy(km.m_salt, m_salt, sizeof(m_salt));
+  memcpy(km.m_key, m_ptag, sizeof(m_ptag));
+  return true;
 }
 
 int PWSfileV3::Open(const StringX &passkey)
@@ -202,7 +222,9 @@ err:
 
 int PWSfileV3::CheckPasskey(const StringX &filename,
                             const StringX &passkey, FILE *a_fd,
-                            unsigned char *aPtag, uint32 *nITER)
+                            unsigned char *aPtag, uint32 *nITER,
+                            unsigned char *aSalt,
+                            const PWSKeyMaterial *pKnown)
 {
   PWS_LOGIT;
 
@@ -228,6 +250,8 @@ int PWSfileV3::CheckPasskey(const StringX &filename,
     retval = READ_FAIL;
     goto err;
   }
+  if (aSalt != nullptr)
+    memcpy(aSalt, salt, sizeof(salt));
 
   unsigned char Nb[sizeof(uint32)];
   if (fread(Nb, 1, sizeof(Nb), fd) != sizeof(Nb)) {
@@ -244,7 +268,14 @@ int PWSfileV3::CheckPasskey(const StringX &filename,
     if (nITER != nullptr)
       *nITER = N;
 
-    StretchKey(salt, sizeof(salt), passkey, N, usedPtag);
+    // If we already know what this passkey stretches to with this salt
+    // (see PWScore::CheckPasskey), there's no need to do it again.
+    // The HPtag check below still applies.
+    if (pKnown != nullptr && pKnown->Matches(V30, N) &&
+        memcmp(pKnown->m_salt, salt, sizeof(salt)) == 0)
+      memcpy(usedPtag, pKnown->m_key, SHA256::HASHLEN);
+    else
+      StretchKey(salt, sizeof(salt), passkey, N, usedPtag);
   }
   unsigned char HPtag[SHA256::HASHLEN];
   H.Update(usedPtag, SHA256::HASHLEN);
@@ -312,6 +343,9 @@ void PWSfileV3::StretchKey(const unsigned char *salt, unsigned long saltLen,
                            const StringX &passkey,
                            unsigned int N, unsigned char *Ptag)
 {
+  PWSTrace::Span span("StretchKey");
+  span.SetArg(N);
+  PWSCounters::Timing timing(PWSCounters::StretchKey);
   /*
   * P' is the "stretched key" of the user's passphrase and the SALT, as defined
   * by the hash-function-based key stretching algorithm in
@@ -342,6 +376,19 @@ void PWSfileV3::StretchKey(const unsigned char *salt, unsigned long saltLen,
   }
 }
 
+double PWSfileV3::TimeKeyStretch(uint32 nHashIters)
+{
+  // Any passkey and salt will do, only the time matters
+  const unsigned char salt[PWSaltLength] = {0};
+  unsigned char Ptag[SHA256::HASHLEN];
+
+  const auto start = std::chrono::steady_clock::now();
+  StretchKey(salt, sizeof(salt), _T("calibration"), nHashIters, Ptag);
+  const std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
 // Following specific for PWSfileV3::WriteHeader
 #define SAFE_FWRITE(p, sz, cnt, stream) \
   { \
@@ -357,37 +404,45 @@ int PWSfileV3::WriteHeader()
   // prevent "uninitialized" compile errors, as we use
   // goto for error handling
   size_t numWritten;
-  unsigned char salt[PWSaltLength];
 
   m_status = SUCCESS;
 
   // See formatV3.txt for explanation of what's written here and why
-  uint32 NumHashIters;
   if (m_nHashIters < MIN_HASH_ITERATIONS)
-    NumHashIters = MIN_HASH_ITERATIONS;
-  else
-    NumHashIters = m_nHashIters;
+    m_nHashIters = MIN_HASH_ITERATIONS;
+  const uint32 NumHashIters = m_nHashIters;
+
+  // If we've been given the result of stretching this passkey with these
+  // many iterations, reuse it (and its salt) rather than stretching again.
+  // K and L are still new for every save.
+  const bool bKeyMaterial = m_pKeyMaterial != nullptr &&
+                            m_pKeyMaterial->Matches(V30, NumHashIters);
 
   SAFE_FWRITE(V3TAG, 1, sizeof(V3TAG), m_fd);
 
   static_assert(int(PWSaltLength) == int(SHA256::HASHLEN),
                 "can't call HashRandom256");
 
-  HashRandom256(salt);
-  SAFE_FWRITE(salt, 1, sizeof(salt), m_fd);
+  if (bKeyMaterial)
+    memcpy(m_salt, m_pKeyMaterial->m_salt, sizeof(m_salt));
+  else
+    HashRandom256(m_salt);
+  SAFE_FWRITE(m_salt, 1, sizeof(m_salt), m_fd);
 
   unsigned char Nb[sizeof(NumHashIters)];
   putInt32(Nb, NumHashIters);
   SAFE_FWRITE(Nb, 1, sizeof(Nb), m_fd);
 
-  unsigned char Ptag[SHA256::HASHLEN];
-
-  StretchKey(salt, sizeof(salt), m_passkey, NumHashIters, Ptag);
+  if (bKeyMaterial)
+    memcpy(m_ptag, m_pKeyMaterial->m_key, sizeof(m_ptag));
+  else
+    StretchKey(m_salt, sizeof(m_salt), m_passkey, NumHashIters, m_ptag);
+  m_bHavePtag = true;
 
   {
     unsigned char HPtag[SHA256::HASHLEN];
     SHA256 H;
-    H.Update(Ptag, sizeof(Ptag));
+    H.Update(m_ptag, sizeof(m_ptag));
     H.Final(HPtag);
     SAFE_FWRITE(HPtag, 1, sizeof(HPtag), m_fd);
   }
@@ -396,7 +451,7 @@ int PWSfileV3::WriteHeader()
     unsigned char B1B2[sizeof(m_key)];
     unsigned char L[32]; // for HMAC
     ASSERT(sizeof(B1B2) == 32); // Generalize later
-    TwoFish TF(Ptag, sizeof(Ptag));
+    TwoFish TF(m_ptag, sizeof(m_ptag));
     TF.Encrypt(m_key, B1B2);
     TF.Encrypt(m_key + 16, B1B2 + 16);
     SAFE_FWRITE(B1B2, 1, sizeof(B1B2), m_fd);
@@ -600,14 +655,14 @@ int PWSfileV3::ReadHeader()
 {
   PWS_LOGIT;
 
-  unsigned char Ptag[SHA256::HASHLEN];
   m_status = CheckPasskey(m_filename, m_passkey, m_fd,
-                          Ptag, &m_nHashIters);
+                          m_ptag, &m_nHashIters, m_salt, m_pKeyMaterial);
 
   if (m_status != SUCCESS) {
     Close();
     return m_status;
   }
+  m_bHavePtag = true;
 
   unsigned char B1B2[sizeof(m_key)];
   ASSERT(sizeof(B1B2) == 32); // Generalize later
@@ -615,7 +670,7 @@ int PWSfileV3::ReadHeader()
     Close();
     return READ_FAIL;
   }
-  TwoFish TF(Ptag, sizeof(Ptag));
+  TwoFish TF(m_ptag, sizeof(m_ptag));
   TF.Decrypt(B1B2, m_key);
   TF.Decrypt(B1B2 + 16, m_key + 16);
 
@@ -25,8 +25,11 @@ public:
   static int CheckPasskey(const StringX &filename,
                           const StringX &passkey,
                           FILE *a_fd = nullptr,
-                          unsigned char *aPtag = nullptr, uint32 *nIter = nullptr);
+                          unsigned char *aPtag = nullptr, uint32 *nIter = nullptr,
+                          unsigned char *aSalt = nullptr,
+                          const PWSKeyMaterial *pKnown = nullptr);
   static bool IsV3x(const StringX &filename, VERSION &v);
+  static double TimeKeyStretch(uint32 nHashIters); // see PWSfile
 
   PWSfileV3(const StringX &filename, RWmode mode, VERSION version);
   ~PWSfileV3();
@@ -40,11 +43,16 @@ public:
   virtual uint32 GetNHashIters() const {return m_nHashIters;}
   virtual void SetNHashIters(uint32 N) {m_nHashIters = N;}
 
+  virtual bool GetKeyMaterial(PWSKeyMaterial &km) const;
+
  private:
   enum {PWSaltLength = 32}; // per format spec
   uint32 m_nHashIters;
   unsigned char m_ipthing[TwoFish::BLOCKSIZE]; // for CBC
   unsigned char m_key[32];
+  unsigned char m_salt[PWSaltLength];
+  unsigned char m_ptag[SHA256::HASHLEN]; // stretched passkey, P'
+  bool m_bHavePtag;
   HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> m_hmac;
   CUTF8Conv m_utf8conv;
   virtual size_t WriteCBC(unsigned char type, const StringX &data);
@@ -14,8 +14,11 @@
 #include "PWSFilters.h"
 #include "PWSdirs.h"
 #include "PWSLog.h"
+#include "PWSCounters.h"
+#include "PWSTrace.h"
 #include "core.h"
 #include "crypto/pbkdf2.h"
+#include "crypto/argon2.h"
 #include "crypto/KeyWrap.h"
 #include "PWStime.h"
 #include "crypto/TwoFish.h"
@@ -37,11 +40,34 @@
 #include <errno.h>
 #include <iomanip>
 #include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <type_traits> // for static_assert
 
 using namespace std;
 using pws_os::CUUID;
 
+namespace {
+  // Calls fn(i) for each i in [0, n), from as many threads as make sense
+  template<typename F> void ParallelFor(size_t n, F fn)
+  {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+      for (size_t i = next++; i < n; i = next++)
+        fn(i);
+    };
+    const size_t nThreads = std::min(n, size_t(std::max(1U, std::thread::hardware_concurrency())));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nThreads; t++)
+      threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+      t.join();
+  }
+}
+
 PWSfileV4::CKeyBlocks::KeyBlock::KeyBlock(const KeyBlock &kb)
 {
   memcpy(m_salt, kb.m_salt, PWSaltLength);
@@ -85,7 +111,8 @@ PWSfileV4::CKeyBlocks& PWSfileV4::CKeyBlocks::operator=(const PWSfileV4::CKeyBlo
 
 PWSfileV4::PWSfileV4(const StringX &filename, RWmode mode, VERSION version)
   : PWSfile(filename, mode, version),
-    m_effectiveFileLength(0), m_nHashIters(MIN_V4_HASH_ITERATIONS)
+    m_effectiveFileLength(0), m_nHashIters(MIN_V4_HASH_ITERATIONS),
+    m_iKeyBlock(-1)
 {
   m_IV = m_ipthing;
   m_terminal = nullptr;
@@ -123,9 +150,35 @@ int PWSfileV4::Open(const StringX &passkey)
     HashRandom256(m_nonce); // Generate nonce
     if (m_nHashIters < MIN_V4_HASH_ITERATIONS) // here we silently upgrade files to the new MIN_V4_HASH_ITERATIONS value
       m_nHashIters = MIN_V4_HASH_ITERATIONS;
-    if (!m_keyblocks.GetKeys(passkey, m_nHashIters, m_key, m_ell)) {
-      PWSfile::Close();
-      return WRONG_PASSWORD;
+    // Key material from an extended key block has no iteration count,
+    // but its KDF's parameters are in the salt
+    CKeyBlocks::KeyBlock kb;
+    const bool bHaveKeyMaterial = m_keyblocks.empty() && m_pKeyMaterial != nullptr &&
+      m_pKeyMaterial->m_version == V40;
+    if (bHaveKeyMaterial) {
+      memcpy(kb.m_salt, m_pKeyMaterial->m_salt, sizeof(kb.m_salt));
+      kb.m_nHashIters = m_pKeyMaterial->m_nHashIters;
+    }
+    if (bHaveKeyMaterial && kb.GetKDFParams() == m_kdfParams &&
+        (kb.IsExtended() || kb.m_nHashIters == m_nHashIters)) {
+      // Single user, and we've been given the key block for this passkey
+      // along with what it wraps - no need to derive it again
+      memcpy(kb.m_kw_k, m_pKeyMaterial->m_kw_k, sizeof(kb.m_kw_k));
+      memcpy(kb.m_kw_l, m_pKeyMaterial->m_kw_l, sizeof(kb.m_kw_l));
+      m_keyblocks.m_kbs.push_back(kb);
+      memcpy(m_key, m_pKeyMaterial->m_key, sizeof(m_key));
+      memcpy(m_ell, m_pKeyMaterial->m_ell, sizeof(m_ell));
+      m_iKeyBlock = 0;
+    } else {
+      const bool bSingleUser = m_keyblocks.empty();
+      const int keyStatus = m_keyblocks.GetKeys(passkey, m_nHashIters, m_kdfParams,
+                                                m_key, m_ell);
+      if (keyStatus != SUCCESS) {
+        PWSfile::Close();
+        return keyStatus;
+      }
+      if (bSingleUser)
+        m_iKeyBlock = 0; // added by GetKeys
     }
     if (WriteKeyBlocks()) {
       status = WriteHeader();
@@ -146,6 +199,28 @@ int PWSfileV4::Open(const StringX &passkey)
   return status;
 }
 
+bool PWSfileV4::GetKeyMaterial(PWSKeyMaterial &km) const
+{
+  static_assert(int(PWSKeyMaterial::SALTLEN) == int(CKeyBlocks::PWSaltLength) &&
+                int(PWSKeyMaterial::KEYLEN) == int(KLEN) &&
+                int(PWSKeyMaterial::KWLEN) == int(CKeyBlocks::KWLEN),
+                "PWSKeyMaterial doesn't fit V4");
+  // Key blocks are cleared on Close() after a read
+  if (m_iKeyBlock < 0 || unsigned(m_iKeyBlock) >= m_keyblocks.size())
+    return false;
+
+  const CKeyBlocks::KeyBlock &kb = m_keyblocks[m_iKeyBlock];
+  km.Clear();
+  km.m_version = V40;
+  km.m_nHashIters = kb.m_nHashIters;
+  memcpy(km.m_salt, kb.m_salt, sizeof(kb.m_salt));
+  memcpy(km.m_key, m_key, sizeof(m_key));
+  memcpy(km.m_ell, m_ell, sizeof(m_ell));
+  memcpy(km.m_kw_k, kb.m_kw_k, sizeof(kb.m_kw_k));
+  memcpy(km.m_kw_l, kb.m_kw_l, sizeof(kb.m_kw_l));
+  return true;
+}
+
 int PWSfileV4::Close()
 {
   PWS_LOGIT;
@@ -206,7 +281,8 @@ int PWSfileV4::SanityCheck(FILE *stream)
 
 int PWSfileV4::CheckPasskey(const StringX &filename,
                             const StringX &passkey, FILE *a_fd,
-                            unsigned char *, uint32 *)
+                            unsigned char *, uint32 *,
+                            PWSKeyMaterial *pkm)
 {
   PWS_LOGIT;
 
@@ -224,6 +300,8 @@ int PWSfileV4::CheckPasskey(const StringX &filename,
     PWSfileV4 pv4(filename, Read, V40);
     pv4.m_fd = fd;
     retval = pv4.ParseKeyBlocks(passkey);
+    if (retval == SUCCESS && pkm != nullptr)
+      pv4.GetKeyMaterial(*pkm);
     pv4.m_fd = nullptr; // s.t. d'tor doesn't fclose()
   }
   if (a_fd == nullptr) // if we opened the file, we close it...
@@ -304,13 +382,13 @@ size_t PWSfileV4::WriteContentFields(const unsigned char *content, size_t len)
   // Create hmac with AK
   HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
   hmac.Init(AK, sizeof(AK));
-  trashMemory(AK, sizeof(AK));
 
   // write actual content using EK
   _writecbcRest(m_fd, content, len, &fish, IV); // length already written
 
   // update content's HMAC
   hmac.Update(content, static_cast<unsigned long>(len));
+  trashMemory(AK, sizeof(AK));
 
   // write content's HMAC
   unsigned char digest[SHA256::HASHLEN];
@@ -329,7 +407,39 @@ size_t PWSfileV4::ReadContent(const Fish *fish,  unsigned char *cbcbuffer,
   size_t blen = roundUp(clen, BS);
 
   content = new unsigned char[blen]; // caller's responsible for delete[]
-  return _readcbc(m_fd, content, blen, fish, cbcbuffer);
+  if (blen <= CONTENT_RANGE)
+    return _readcbc(m_fd, content, blen, fish, cbcbuffer);
+
+  // Decrypting a CBC block only needs the ciphertext block before it,
+  // so big content is read in one go and decrypted a range at a time,
+  // with each range's IV taken before any of it's overwritten
+  const size_t nread = fread(content, 1, blen, m_fd);
+  if (nread != blen)
+    return nread - nread % BS;
+
+  const size_t rangeLen = CONTENT_RANGE; // a multiple of BS
+  const size_t nRanges = (blen + rangeLen - 1) / rangeLen;
+  std::vector<unsigned char> ivs(nRanges * BS);
+  memcpy(ivs.data(), cbcbuffer, BS);
+  for (size_t r = 1; r < nRanges; r++)
+    memcpy(ivs.data() + r * BS, content + r * rangeLen - BS, BS);
+  memcpy(cbcbuffer, content + blen - BS, BS);
+
+  ParallelFor(nRanges, [&](size_t r) {
+    unsigned char *iv = ivs.data() + r * BS;
+    unsigned char tmp[16];
+    ASSERT(BS <= sizeof(tmp));
+    unsigned char *p = content + r * rangeLen;
+    const unsigned char *end = content + std::min(blen, (r + 1) * rangeLen);
+    for (; p < end; p += BS) {
+      memcpy(tmp, p, BS);
+      fish->Decrypt(p, p);
+      for (unsigned int i = 0; i < BS; i++)
+        p[i] ^= iv[i];
+      memcpy(iv, tmp, BS);
+    }
+  });
+  return blen;
 }
 
 size_t PWSfileV4::ReadCBC(unsigned char &type, unsigned char* &data,
@@ -400,6 +510,9 @@ void PWSfileV4::StretchKey(const unsigned char *salt, unsigned long saltLen,
                            const StringX &passkey,
                            unsigned int N, unsigned char *Ptag, unsigned long PtagLen)
 {
+  PWSTrace::Span span("StretchKey");
+  span.SetArg(N);
+  PWSCounters::Timing timing(PWSCounters::StretchKey);
   /*
   * P' is the "stretched key" of the user's passphrase and the SALT, as defined
   * by the hash-function-based key stretching algorithm PBKDF2, with SHA-256
@@ -421,6 +534,34 @@ void PWSfileV4::StretchKey(const unsigned char *salt, unsigned long saltLen,
 #endif
 }
 
+double PWSfileV4::TimeKeyStretch(uint32 nHashIters)
+{
+  // Any passkey and salt will do, only the time matters
+  const unsigned char salt[CKeyBlocks::PWSaltLength] = {0};
+  unsigned char Ptag[SHA256::HASHLEN];
+
+  const auto start = std::chrono::steady_clock::now();
+  StretchKey(salt, sizeof(salt), _T("calibration"), nHashIters / HASH_FACTOR,
+             Ptag, sizeof(Ptag));
+  const std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+double PWSfileV4::TimeKeyStretch(const PWSKDFParams &kdf)
+{
+  const unsigned char salt[CKeyBlocks::XSaltLength] = {0};
+  const unsigned char passkey[] = "calibration";
+  unsigned char Ptag[SHA256::HASHLEN];
+
+  const auto start = std::chrono::steady_clock::now();
+  argon2id(passkey, sizeof(passkey) - 1, salt, sizeof(salt),
+           kdf.tCost, kdf.mCostKiB, kdf.parallelism, Ptag, sizeof(Ptag));
+  const std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
 /**
  * Format version history:
  *
@@ -432,58 +573,189 @@ void PWSfileV4::StretchKey(const unsigned char *salt, unsigned long saltLen,
 
 const short VersionNum = 0x0402;
 
-struct PWSfileV4::CKeyBlocks::KeyBlockFinder {
-  KeyBlockFinder(const KeyBlockFinder&) = default;
-  KeyBlockFinder(const StringX &passkey) : passkey(passkey) {}
+bool PWSfileV4::CKeyBlocks::KeyBlock::IsSupported() const
+{
+  if (!IsExtended())
+    return true;
+  if (m_salt[XTypeOffset] != KDF_ARGON2ID || m_salt[XVersionOffset] != 0x13)
+    return false;
+  const PWSKDFParams kdf = GetKDFParams();
+  return kdf.tCost <= MAX_ARGON2_T_COST && kdf.mCostKiB <= MAX_ARGON2_M_COST_KIB &&
+    kdf.parallelism <= MAX_ARGON2_PARALLELISM;
+}
 
-  bool operator()(const KeyBlock &kb) {
-    unsigned char Ptag[SHA256::HASHLEN];
-    unsigned char K[PWSfileV4::KLEN];
-    PWSfileV4::StretchKey(kb.m_salt, sizeof(kb.m_salt), passkey, kb.m_nHashIters,
-                          Ptag, sizeof(Ptag));
+PWSKDFParams PWSfileV4::CKeyBlocks::KeyBlock::GetKDFParams() const
+{
+  if (GetKDF() != KDF_ARGON2ID)
+    return PWSKDFParams();
+  const unsigned char *params = m_salt + XParamsOffset;
+  return PWSKDFParams(getInt32(params), getInt32(params + 4), getInt32(params + 8));
+}
+
+int PWSfileV4::CKeyBlocks::DeriveKey(const KeyBlock &kb,
+                                     const unsigned char *pstr, size_t passLen,
+                                     unsigned char Ptag[SHA256::HASHLEN],
+                                     const std::atomic<bool> *cancel)
+{
+  PWSTrace::Span span("StretchKey");
+  span.SetArg(kb.m_nHashIters);
+  PWSCounters::Timing timing(PWSCounters::StretchKey);
+  if (!kb.IsExtended()) {
+    unsigned long PtagLen = SHA256::HASHLEN;
+    HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
+    pbkdf2(pstr, static_cast<unsigned long>(passLen), kb.m_salt, sizeof(kb.m_salt),
+           static_cast<int>(kb.m_nHashIters), &hmac, Ptag, &PtagLen, cancel);
+    return (PtagLen == SHA256::HASHLEN) ? PWSfile::SUCCESS : PWSfile::FAILURE; // else cancelled
+  }
+
+  if (!kb.IsSupported())
+    return PWSfile::FAILURE;
+
+  // Each may take up to MAX_ARGON2_M_COST_KIB of memory, and a thread per
+  // lane, so only one is derived at a time, whatever the number of key
+  // blocks, files or threads trying them. PBKDF2 ones carry on meanwhile.
+  static std::mutex argon2Mutex;
+  std::lock_guard<std::mutex> lock(argon2Mutex);
+  if (cancel != nullptr && *cancel)
+    return PWSfile::FAILURE;
+  const PWSKDFParams kdf = kb.GetKDFParams();
+  if (argon2id(pstr, passLen, kb.m_salt, XSaltLength,
+               kdf.tCost, kdf.mCostKiB, kdf.parallelism,
+               Ptag, SHA256::HASHLEN,
+               nullptr, 0, nullptr, 0, cancel))
+    return PWSfile::SUCCESS;
+  // The parameters are within range (see IsSupported), so unless
+  // cancelled, the memory couldn't be allocated
+  return (cancel != nullptr && *cancel) ? PWSfile::FAILURE : PWSfile::OUT_OF_MEMORY;
+}
+
+int PWSfileV4::CKeyBlocks::TryKeyBlock(const KeyBlock &kb,
+                                       const unsigned char *pstr, size_t passLen,
+                                       unsigned char K[KLEN], unsigned char L[KLEN],
+                                       const std::atomic<bool> *cancel)
+{
+  unsigned char Ptag[SHA256::HASHLEN];
+  int status = DeriveKey(kb, pstr, passLen, Ptag, cancel);
+  if (status == PWSfile::SUCCESS) {
     // Try to unwrap K
     TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
     KeyWrap kwK(&Fish);
-    
-    bool retval = kwK.Unwrap(kb.m_kw_k, K, sizeof(kb.m_kw_k));
-    if (retval) {
-      trashMemory(Ptag, sizeof(Ptag));
-      trashMemory(K, sizeof(K));
+    if (!kwK.Unwrap(kb.m_kw_k, K, sizeof(kb.m_kw_k))) {
+      status = PWSfile::WRONG_PASSWORD;
+    } else {
+      KeyWrap kwL(&Fish);
+      if (!kwL.Unwrap(kb.m_kw_l, L, sizeof(kb.m_kw_l))) {
+        ASSERT(0); // Shouldn't happen if K unwrapped OK
+        status = PWSfile::WRONG_PASSWORD;
+      }
     }
-    return retval;
   }
-private:
-  KeyBlockFinder& operator=(const KeyBlockFinder&) = delete; // Do not implement
-  const StringX &passkey;
-};
+  trashMemory(Ptag, sizeof(Ptag));
+  return status;
+}
+
+int PWSfileV4::CKeyBlocks::FindKeyBlock(const StringX &passkey,
+                                        unsigned char *K, unsigned char *L,
+                                        std::vector<bool> *pMatches) const
+{
+  /**
+   * Each key block needs a full stretch of the passkey, and with a shared
+   * database, ours may well be the last of many. So rather than trying them
+   * one after the other, we have a few threads take the next untried one
+   * until they run out. Once one fits, those after it are cancelled (and
+   * those before it left to finish, so that we get the same answer as
+   * trying them in order would).
+   */
+  const unsigned n = size();
+  if (pMatches != nullptr)
+    pMatches->assign(n, false);
+  if (n == 0)
+    return KB_NOT_FOUND;
+
+  // Converted here, as the encoding may have been set for this thread only
+  size_t passLen = 0;
+  unsigned char *pstr = nullptr;
+  ConvertPasskey(passkey, pstr, passLen);
+
+  std::mutex mtx; // protects found, K, L and *pMatches
+  unsigned found = n;
+  std::atomic<bool> outOfMemory(false);
+  std::atomic<unsigned> next(0);
+  std::unique_ptr<std::atomic<bool>[]> cancel(new std::atomic<bool>[n]);
+  for (unsigned i = 0; i < n; i++)
+    cancel[i] = false;
+
+  auto worker = [&]() {
+    unsigned char k[KLEN], l[KLEN];
+    for (unsigned i = next++; i < n; i = next++) {
+      if (cancel[i])
+        continue;
+      const int status = TryKeyBlock(m_kbs[i], pstr, passLen, k, l, &cancel[i]);
+      if (status == PWSfile::OUT_OF_MEMORY)
+        outOfMemory = true;
+      if (status != PWSfile::SUCCESS)
+        continue;
+      std::lock_guard<std::mutex> lock(mtx);
+      if (pMatches != nullptr)
+        (*pMatches)[i] = true;
+      if (i < found) {
+        found = i;
+        if (K != nullptr)
+          memcpy(K, k, KLEN);
+        if (L != nullptr)
+          memcpy(L, l, KLEN);
+        if (pMatches == nullptr)
+          for (unsigned j = i + 1; j < n; j++)
+            cancel[j] = true;
+      }
+    }
+    trashMemory(k, sizeof(k));
+    trashMemory(l, sizeof(l));
+  };
+
+  const unsigned nThreads = std::min(n, std::max(1U, std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < nThreads; t++)
+    threads.emplace_back(worker);
+  worker(); // this thread does its share too
+  for (auto &t : threads)
+    t.join();
+
+#ifdef UNICODE
+  trashMemory(pstr, passLen);
+  delete[] pstr;
+#endif
+  if (found < n)
+    return static_cast<int>(found);
+  return outOfMemory ? KB_NO_MEMORY : KB_NOT_FOUND;
+}
 
-bool PWSfileV4::CKeyBlocks::GetKeys(const StringX &passkey, uint32 nHashIters,
-                                     unsigned char K[KLEN], unsigned char L[KLEN])
+int PWSfileV4::CKeyBlocks::GetKeys(const StringX &passkey, uint32 nHashIters,
+                                   const PWSKDFParams &kdf,
+                                   unsigned char K[KLEN], unsigned char L[KLEN])
 {
-  // Note that nHashIters is only used if m_kbs is empty
+  // Note that nHashIters and kdf are only used if m_kbs is empty
   // Which will happen if this file is used 'single user'
   // and not with an externally managed CKeyBlocks.
   
-  if (m_kbs.empty())
-    AddKeyBlock(passkey, passkey, nHashIters);
-
-  KeyBlockFinder find_kb(passkey);
-  auto kb_iter = find_if(m_kbs.begin(), m_kbs.end(), find_kb);
-  if (kb_iter == m_kbs.end())
-    return false;
+  if (m_kbs.empty()) {
+    KeyBlock kb;
+    if (kdf.kdf == PWSKDFParams::ARGON2ID) {
+      if (!SetArgon2Salt(kb, kdf.tCost, kdf.mCostKiB, kdf.parallelism))
+        return PWSfile::FAILURE;
+    } else {
+      kb.m_nHashIters = nHashIters;
+      HashRandom256(kb.m_salt);
+    }
+    const int status = AddKeyBlock(passkey, passkey, kb);
+    if (status != PWSfile::SUCCESS)
+      return status;
+  }
 
-  unsigned char Ptag[SHA256::HASHLEN];
-  PWSfileV4::StretchKey(kb_iter->m_salt, sizeof(kb_iter->m_salt),
-                        passkey, kb_iter->m_nHashIters,
-                        Ptag, sizeof(Ptag));
-  TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-  KeyWrap kwK(&Fish);
-  if (!kwK.Unwrap(kb_iter->m_kw_k, K, sizeof(kb_iter->m_kw_k)))
-    ASSERT(0);
-  KeyWrap kwL(&Fish);
-  if (!kwL.Unwrap(kb_iter->m_kw_l, L, sizeof(kb_iter->m_kw_l)))
-    ASSERT(0);
-  return true;
+  const int index = FindKeyBlock(passkey, K, L);
+  if (index >= 0)
+    return PWSfile::SUCCESS;
+  return (index == KB_NO_MEMORY) ? PWSfile::OUT_OF_MEMORY : PWSfile::WRONG_PASSWORD;
 }
 
 void PWSfileV4::ComputeEndKB(const unsigned char hnonce[SHA256::HASHLEN],
@@ -824,29 +1096,21 @@ int PWSfileV4::ReadKeyBlock()
   return SUCCESS;
 }
 
-int PWSfileV4::TryKeyBlock(unsigned index, const StringX &passkey,
-                           unsigned char K[KLEN], unsigned char L[KLEN],
-                           uint32 &nHashIters)
+bool PWSfileV4::UseKeyMaterial(unsigned index)
 {
-  CKeyBlocks::KeyBlock &kb = m_keyblocks.at(index);
-  unsigned char Ptag[SHA256::HASHLEN];
-
-  StretchKey(kb.m_salt, sizeof(kb.m_salt), passkey, kb.m_nHashIters,
-             Ptag, sizeof(Ptag));
-  // Try to unwrap K
-  TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-  KeyWrap kwK(&Fish);
+  // If we've been told what this key block wraps (see PWScore::CheckPasskey),
+  // there's no need to stretch the passkey. VerifyKeyBlocks() still checks L.
+  const CKeyBlocks::KeyBlock &kb = m_keyblocks.at(index);
+  if (m_pKeyMaterial == nullptr ||
+      !m_pKeyMaterial->Matches(V40, kb.m_nHashIters) ||
+      memcmp(m_pKeyMaterial->m_salt, kb.m_salt, sizeof(kb.m_salt)) != 0 ||
+      memcmp(m_pKeyMaterial->m_kw_k, kb.m_kw_k, sizeof(kb.m_kw_k)) != 0 ||
+      memcmp(m_pKeyMaterial->m_kw_l, kb.m_kw_l, sizeof(kb.m_kw_l)) != 0)
+    return false;
 
-  if (!kwK.Unwrap(kb.m_kw_k, K, sizeof(kb.m_kw_k)))
-    return WRONG_PASSWORD;
-      
-  KeyWrap kwL(&Fish);
-  if (!kwL.Unwrap(kb.m_kw_l, L, sizeof(kb.m_kw_l))) {
-    ASSERT(0); // Shouln't happen if K unwrapped OK
-    return WRONG_PASSWORD;
-  }
-  nHashIters = kb.m_nHashIters;
-  return SUCCESS;
+  memcpy(m_key, m_pKeyMaterial->m_key, KLEN);
+  memcpy(m_ell, m_pKeyMaterial->m_ell, KLEN);
+  return true;
 }
 
 bool PWSfileV4::VerifyKeyBlocks()
@@ -885,7 +1149,8 @@ int PWSfileV4::ParseKeyBlocks(const StringX &passkey)
    * and find one that works.
    * "All" means running until Hash(m_nonce) detected
    * or EOF.
-   * "works" means TryKeyBlock returns true.
+   * "works" means the passkey unwraps it (see CKeyBlocks::FindKeyBlock).
+   * Key blocks we already have the key material for work without that.
    * Once we have a working keyblock, we can verify the integrity
    * of all keyblocks.
    * Consider that we'll hit EOF if file's wrong type/corrupt
@@ -910,52 +1175,103 @@ int PWSfileV4::ParseKeyBlocks(const StringX &passkey)
     }
   } while (!EndKeyBlocks(calc_hnonce));
 
-  for (unsigned i = 0; i < m_keyblocks.size(); i++) {
-    status = TryKeyBlock(i, passkey, m_key, m_ell, m_nHashIters);
-    if (status == SUCCESS) {
-      if (!VerifyKeyBlocks())
-        status = BAD_DIGEST;
-      break;
-    }
+  int index = -1;
+  for (unsigned i = 0; i < m_keyblocks.size() && index < 0; i++)
+    if (UseKeyMaterial(i))
+      index = static_cast<int>(i);
+  if (index < 0)
+    index = m_keyblocks.FindKeyBlock(passkey, m_key, m_ell);
+  if (index == CKeyBlocks::KB_NO_MEMORY)
+    return OUT_OF_MEMORY; // rather than claim the passkey's wrong
+  if (index < 0) {
+    // If there's a key block we don't know how to open, it may well be ours
+    for (unsigned i = 0; i < m_keyblocks.size(); i++)
+      if (!m_keyblocks[i].IsSupported())
+        return UNSUPPORTED_VERSION;
+    return WRONG_PASSWORD;
   }
-  return status;
+
+  m_iKeyBlock = index;
+  // An extended key block has no iteration count, so there's only the
+  // default for PBKDF2 to report
+  m_kdfParams = m_keyblocks[index].GetKDFParams();
+  if (!m_keyblocks[index].IsExtended())
+    m_nHashIters = m_keyblocks[index].m_nHashIters;
+  return VerifyKeyBlocks() ? SUCCESS : BAD_DIGEST;
 }
 
 bool PWSfileV4::CKeyBlocks::AddKeyBlock(const StringX &current_passkey,
                                         const StringX &new_passkey,
                                         uint nHashIters)
 {
-  unsigned char Ptag[SHA256::HASHLEN];
-  unsigned char K[KLEN];
-  unsigned char L[KLEN];
   KeyBlock kb;
   kb.m_nHashIters = nHashIters;
   HashRandom256(kb.m_salt);
+  return AddKeyBlock(current_passkey, new_passkey, kb) == PWSfile::SUCCESS;
+}
+
+bool PWSfileV4::CKeyBlocks::AddArgon2KeyBlock(const StringX &current_passkey,
+                                              const StringX &new_passkey,
+                                              uint32 tCost, uint32 mCostKiB,
+                                              uint32 parallelism)
+{
+  KeyBlock kb;
+  return SetArgon2Salt(kb, tCost, mCostKiB, parallelism) &&
+    AddKeyBlock(current_passkey, new_passkey, kb) == PWSfile::SUCCESS;
+}
+
+bool PWSfileV4::CKeyBlocks::SetArgon2Salt(KeyBlock &kb, uint32 tCost, uint32 mCostKiB,
+                                          uint32 parallelism)
+{
+  // Same limits as argon2id() itself and IsSupported(), so that the key block is usable
+  if (tCost < 1 || parallelism < 1 || mCostKiB < 8 * parallelism ||
+      tCost > MAX_ARGON2_T_COST || mCostKiB > MAX_ARGON2_M_COST_KIB ||
+      parallelism > MAX_ARGON2_PARALLELISM)
+    return false;
+
+  kb.m_nHashIters = 0; // marks an extended key block
+  memset(kb.m_salt, 0, sizeof(kb.m_salt));
+  PWSrand::GetInstance()->GetRandomData(kb.m_salt, XSaltLength);
+  kb.m_salt[XTypeOffset] = KDF_ARGON2ID;
+  kb.m_salt[XVersionOffset] = 0x13;
+  putInt32(kb.m_salt + XParamsOffset, tCost);
+  putInt32(kb.m_salt + XParamsOffset + 4, mCostKiB);
+  putInt32(kb.m_salt + XParamsOffset + 8, parallelism);
+  return true;
+}
+
+int PWSfileV4::CKeyBlocks::AddKeyBlock(const StringX &current_passkey,
+                                       const StringX &new_passkey,
+                                       KeyBlock &kb)
+{
+  unsigned char Ptag[SHA256::HASHLEN];
+  unsigned char K[KLEN];
+  unsigned char L[KLEN];
 
   if (m_kbs.empty()) { // we get to generate new K and L
     PWSrand::GetInstance()->GetRandomData(K, KLEN);
     PWSrand::GetInstance()->GetRandomData(L, KLEN);
-
-    StretchKey(kb.m_salt, sizeof(kb.m_salt), current_passkey, kb.m_nHashIters,
-               Ptag, sizeof(Ptag));
   } else { // we need to get K & L from current
-    KeyBlockFinder find_kb(current_passkey);
-    auto kb_iter = find_if(m_kbs.begin(), m_kbs.end(), find_kb);
-    if (kb_iter == m_kbs.end())
-      return false;
-    PWSfileV4::StretchKey(kb_iter->m_salt, sizeof(kb_iter->m_salt),
-                          current_passkey, kb_iter->m_nHashIters,
-                          Ptag, sizeof(Ptag));
-    TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-    KeyWrap kwK(&Fish);
-    kwK.Unwrap(kb_iter->m_kw_k, K, sizeof(kb_iter->m_kw_k));
-    KeyWrap kwL(&Fish);
-    kwL.Unwrap(kb_iter->m_kw_l, L, sizeof(kb_iter->m_kw_l));
+    const int index = FindKeyBlock(current_passkey, K, L);
+    if (index < 0)
+      return (index == KB_NO_MEMORY) ? PWSfile::OUT_OF_MEMORY : PWSfile::WRONG_PASSWORD;
+  }
 
-    StretchKey(kb.m_salt, sizeof(kb.m_salt), new_passkey, kb.m_nHashIters,
-               Ptag, sizeof(Ptag));
+  const StringX &passkey = m_kbs.empty() ? current_passkey : new_passkey;
+  size_t passLen = 0;
+  unsigned char *pstr = nullptr;
+  ConvertPasskey(passkey, pstr, passLen);
+  const int status = DeriveKey(kb, pstr, passLen, Ptag);
+#ifdef UNICODE
+  trashMemory(pstr, passLen);
+  delete[] pstr;
+#endif
+  if (status != PWSfile::SUCCESS) { // e.g., not enough memory for Argon2
+    trashMemory(K, KLEN);
+    trashMemory(L, KLEN);
+    return status;
   }
-    
+
   TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
 
   KeyWrap kwK(&Fish);
@@ -968,7 +1284,7 @@ bool PWSfileV4::CKeyBlocks::AddKeyBlock(const StringX &current_passkey,
   trashMemory(K, KLEN);
   trashMemory(L, KLEN);
   m_kbs.push_back(kb);
-  return true;
+  return PWSfile::SUCCESS;
 }
 
 bool PWSfileV4::CKeyBlocks::RemoveKeyBlock(const StringX &passkey)
@@ -978,12 +1294,16 @@ bool PWSfileV4::CKeyBlocks::RemoveKeyBlock(const StringX &passkey)
   if (m_kbs.size() <= 1)
     return false;
 
-  KeyBlockFinder find_kb(passkey);
-  const auto old_size = m_kbs.size();
-  m_kbs.erase(remove_if(m_kbs.begin(), m_kbs.end(), find_kb),
-               m_kbs.end());
+  std::vector<bool> matches;
+  if (FindKeyBlock(passkey, nullptr, nullptr, &matches) < 0)
+    return false;
 
-  return (m_kbs.size() != old_size);
+  std::vector<KeyBlock> kbs;
+  for (unsigned i = 0; i < m_kbs.size(); i++)
+    if (!matches[i])
+      kbs.push_back(m_kbs[i]);
+  m_kbs.swap(kbs);
+  return true;
 }
 
 int PWSfileV4::ReadHeader()
@@ -18,6 +18,7 @@
 #include "crypto/hmac.h"
 #include "UTF8Conv.h"
 
+#include <atomic>
 #include <vector>
 
 class PWSfileV4 : public PWSfile
@@ -29,8 +30,11 @@ public:
   static int CheckPasskey(const StringX &filename,
                           const StringX &passkey,
                           FILE *a_fd = nullptr,
-                          unsigned char *aPtag = nullptr, uint32 *nIter = nullptr);
+                          unsigned char *aPtag = nullptr, uint32 *nIter = nullptr,
+                          PWSKeyMaterial *pkm = nullptr);
   static bool IsV4x(const StringX &filename, const StringX &passkey, VERSION &v);
+  static double TimeKeyStretch(uint32 nHashIters); // see PWSfile
+  static double TimeKeyStretch(const PWSKDFParams &kdf);
 
   PWSfileV4(const StringX &filename, RWmode mode, VERSION version);
   ~PWSfileV4();
@@ -52,8 +56,16 @@ public:
   size_t ReadContent(const Fish *fish, unsigned char *cbcbuffer,
                      unsigned char *&content, size_t clen);
 
+  // ReadContent decrypts content longer than this a range of this
+  // length at a time, on several threads
+  enum {CONTENT_RANGE = 1024 * 1024};
+
   uint32 GetNHashIters() const {return m_nHashIters * HASH_FACTOR;} // we're fine with rounding errors
   void SetNHashIters(uint32 N) {m_nHashIters = N / HASH_FACTOR;}
+  PWSKDFParams GetKDFParams() const {return m_kdfParams;}
+  void SetKDFParams(const PWSKDFParams &kdf) {m_kdfParams = kdf;}
+
+  virtual bool GetKeyMaterial(PWSKeyMaterial &km) const;
   
   // Following for low-level details that changed between format versions
   virtual size_t timeFieldLen() const {return 5;} // Experimental
@@ -70,26 +82,83 @@ public:
     CKeyBlocks & operator=(const CKeyBlocks &that);
     bool AddKeyBlock(const StringX &current_passkey, const StringX &new_passkey,
                      uint nHashIters = MIN_V4_HASH_ITERATIONS);
+    // Same, but the passkey is stretched with Argon2id rather than PBKDF2.
+    // Fails if the parameters are out of range (see argon2.h) or above
+    // the maximums below.
+    // Versions of PasswordSafe before this was added can't open such a key block,
+    // but can still use the others in the same file.
+    bool AddArgon2KeyBlock(const StringX &current_passkey, const StringX &new_passkey,
+                           uint32 tCost, uint32 mCostKiB, uint32 parallelism);
     bool RemoveKeyBlock(const StringX &passkey); // fails if m_keyblocks.size() <= 1...
     // ... or if passkey doesn't match.
+
+    // Argon2id costs above these aren't accepted from a file, as they could
+    // make opening it take forever or exhaust memory
+    static constexpr uint32 MAX_ARGON2_T_COST = 64;
+    static constexpr uint32 MAX_ARGON2_M_COST_KIB = 4 * 1024 * 1024; // 4 GiB
+    static constexpr uint32 MAX_ARGON2_PARALLELISM = 64;
   private:
     friend class PWSfileV4;
-    struct KeyBlockFinder; // fwd decl for functor
     // V4 Format constants:
     enum {PWSaltLength = 32,KWLEN = (KLEN + 8)};
+    // Extended key blocks (ITER == 0) keep their KDF and its parameters
+    // in the salt field, see formatV4.txt
+    enum {XSaltLength = 16, XTypeOffset = 16, XVersionOffset = 17,
+          XParamsOffset = 20};
+    enum KDF {KDF_PBKDF2 = 0, KDF_ARGON2ID = 1};
     struct KeyBlock { // See formatV4.txt
     KeyBlock() : m_nHashIters(MIN_V4_HASH_ITERATIONS) {}
       KeyBlock(const KeyBlock &kb);
       KeyBlock &operator=(const KeyBlock &kb);
+      bool IsExtended() const {return m_nHashIters == 0;}
+      unsigned char GetKDF() const
+      {return IsExtended() ? m_salt[XTypeOffset] : static_cast<unsigned char>(KDF_PBKDF2);}
+      bool IsSupported() const; // false if written by a newer version, or costs too much
+      PWSKDFParams GetKDFParams() const;
       unsigned char m_salt[PWSaltLength];
       uint32 m_nHashIters;
       unsigned char m_kw_k[KWLEN];
       unsigned char m_kw_l[KWLEN];
     };
     std::vector<KeyBlock> m_kbs;
+
+    // Returns a PWSfile status: SUCCESS, or WRONG_PASSWORD if current_passkey
+    // doesn't fit, or as DeriveKey
+    int AddKeyBlock(const StringX &current_passkey, const StringX &new_passkey,
+                    KeyBlock &kb); // kb's salt and KDF already set
+    // Makes kb an Argon2id one, false if the costs are out of range
+    static bool SetArgon2Salt(KeyBlock &kb, uint32 tCost, uint32 mCostKiB,
+                              uint32 parallelism);
+    // Derives the key that wraps K and L from the passkey as converted
+    // by ConvertPasskey(), per the key block's KDF. Returns a PWSfile
+    // status: SUCCESS, OUT_OF_MEMORY if there's not enough for Argon2id,
+    // FAILURE if cancelled or the KDF isn't supported.
+    // Argon2id key blocks are derived one at a time, see the .cpp.
+    static int DeriveKey(const KeyBlock &kb,
+                         const unsigned char *pstr, size_t passLen,
+                         unsigned char Ptag[SHA256::HASHLEN],
+                         const std::atomic<bool> *cancel = nullptr);
     
-    bool GetKeys(const StringX &passkey, uint32 nHashIters,
-                 unsigned char K[KLEN], unsigned char L[KLEN]); // not const
+    // Returns a PWSfile status, OUT_OF_MEMORY rather than WRONG_PASSWORD
+    // if a key block couldn't be tried for want of memory
+    int GetKeys(const StringX &passkey, uint32 nHashIters, const PWSKDFParams &kdf,
+                unsigned char K[KLEN], unsigned char L[KLEN]); // not const
+
+    // Returns index of the first key block that passkey opens, KB_NOT_FOUND
+    // if none, or KB_NO_MEMORY if none did but some couldn't be tried for
+    // want of memory, and if found, what it wraps in K and L (if not null).
+    // Key blocks are tried concurrently - if pMatches is null, the rest are
+    // abandoned once one fits, otherwise all are tried and it gets which fit.
+    enum {KB_NOT_FOUND = -1, KB_NO_MEMORY = -2};
+    int FindKeyBlock(const StringX &passkey,
+                     unsigned char *K = nullptr, unsigned char *L = nullptr,
+                     std::vector<bool> *pMatches = nullptr) const;
+    // passkey as converted by ConvertPasskey(). Returns a PWSfile status:
+    // SUCCESS, WRONG_PASSWORD if it doesn't fit, or as DeriveKey.
+    static int TryKeyBlock(const KeyBlock &kb,
+                           const unsigned char *pstr, size_t passLen,
+                           unsigned char K[KLEN], unsigned char L[KLEN],
+                           const std::atomic<bool> *cancel = nullptr);
 
     KeyBlock &operator[](unsigned i) {return m_kbs[i];}
     const KeyBlock &operator[](unsigned i) const {return m_kbs[i];}
@@ -115,6 +184,8 @@ public:
   ulong64 m_effectiveFileLength; // for read = fileLength - |HMAC|
   Cipher m_cipher;
   uint32 m_nHashIters; // mainly for single-user compatibility.
+  PWSKDFParams m_kdfParams; // ditto
+  int m_iKeyBlock; // the one our passkey opens, -1 if unknown
   unsigned char m_ipthing[TwoFish::BLOCKSIZE]; // for CBC
   HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> m_hmac; // L
   CUTF8Conv m_utf8conv;
@@ -122,9 +193,7 @@ public:
   struct KeyBlockWriter;
   int ParseKeyBlocks(const StringX &passkey);
   int ReadKeyBlock(); // can return SUCCESS or END_OF_FILE
-  int TryKeyBlock(unsigned index, const StringX &passkey,
-                  unsigned char K[KLEN], unsigned char L[KLEN],
-                  uint32 &nHashIters);
+  bool UseKeyMaterial(unsigned index); // from m_pKeyMaterial, if it fits
   void ComputeEndKB(const unsigned char hnonce[SHA256::HASHLEN],
                     unsigned char digest[SHA256::HASHLEN]);
   bool EndKeyBlocks(const unsigned char calc_hnonce[SHA256::HASHLEN]);
@@ -141,6 +141,7 @@ const PWSprefs::boolPref PWSprefs::m_bool_prefs[NumBoolPrefs] = {
   {_T("ExcludeFromClipboardHistory"), true, ptDatabase},    // database
   {_T("FindToolBarActive"), false, ptApplication},          // application
   {_T("ExcludeFromScreenCapture"), true, ptDatabase},       // database
+  {_T("CompressAttachments"), false, ptApplication},        // application
 
 };
 
@@ -192,6 +193,8 @@ const PWSprefs::intPref PWSprefs::m_int_prefs[NumIntPrefs] = {
   {_T("DNDMaximumMemorySize"), 14000, ptApplication, -1, INT_MAX},   // application
   {_T("DisplayMode"), DisplayModeSystem, ptApplication,
                            minDisplayMode, maxDisplayMode},         // application
+  // In KB, 0 for no limit
+  {_T("UndoMaximumMemorySize"), 65536, ptApplication, 0, INT_MAX},  // application
 };
 
 const PWSprefs::stringPref PWSprefs::m_string_prefs[NumStringPrefs] = {
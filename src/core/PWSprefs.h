@@ -137,6 +137,7 @@ public:
     ExcludeFromClipboardHistory, // Windows only
     FindToolBarActive, // To persist Find toolbar's visibility
     ExcludeFromScreenCapture,
+    CompressAttachments,
     NumBoolPrefs};
 
   enum IntPrefs {Column1Width, Column2Width, Column3Width, Column4Width,
@@ -150,7 +151,7 @@ public:
     AutotypeSelectAllKeyCode, AutotypeSelectAllModMask, //X only
     TreeFontPtSz, PasswordFontPtSz, NotesFontPtSz, AddEditFontPtSz, VKFontPtSz,
     WindowTransparency, DefaultExpiryDays, DNDMaxMemSize,
-    DisplayMode,
+    DisplayMode, UndoMaxMemSize,
     NumIntPrefs};
 
   enum StringPrefs {CurrentBackup, CurrentFile, LastView, DefaultUsername,
@@ -0,0 +1,229 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SearchIndex.cpp
+//-----------------------------------------------------------------------------
+
+#include "SearchIndex.h"
+#include "PWSrand.h"
+#include "Util.h"
+#include "SecureString.h"
+#include "crypto/siphash.h"
+
+#include <algorithm>
+
+namespace {
+  const CItemData::FieldType IndexedFields[] = {
+    CItemData::GROUP, CItemData::TITLE, CItemData::USER,
+    CItemData::NOTES, CItemData::URL, CItemData::EMAIL,
+  };
+
+  StringX GetIndexedValue(const CItemData &ci, CItemData::FieldType ft)
+  {
+    switch (ft) {
+      case CItemData::GROUP: return ci.GetGroup();
+      case CItemData::TITLE: return ci.GetTitle();
+      case CItemData::USER:  return ci.GetUser();
+      case CItemData::NOTES: return ci.GetNotes();
+      case CItemData::URL:   return ci.GetURL();
+      case CItemData::EMAIL: return ci.GetEmail();
+      default:
+        ASSERT(0);
+        return StringX();
+    }
+  }
+}
+
+CSearchIndex::CSearchIndex()
+  : m_numStale(0), m_numPostings(0)
+{
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+}
+
+CSearchIndex::~CSearchIndex()
+{
+  Clear();
+  trashMemory(m_key, sizeof(m_key));
+}
+
+bool CSearchIndex::IsIndexedField(int ft)
+{
+  return std::find(std::begin(IndexedFields), std::end(IndexedFields), ft) !=
+    std::end(IndexedFields);
+}
+
+void CSearchIndex::Clear()
+{
+  m_mapSlots.clear();
+  m_vSlotUUIDs.clear();
+  m_vSlotDigests.clear();
+  m_vFreeSlots.clear();
+  m_postings.clear();
+  m_numStale = m_numPostings = 0;
+}
+
+void CSearchIndex::Build(const ItemList &pwlist)
+{
+  Clear();
+  m_vSlotUUIDs.reserve(pwlist.size());
+  m_vSlotDigests.reserve(pwlist.size());
+  for (const auto &it : pwlist)
+    Add(it.second);
+}
+
+uint32 CSearchIndex::Digest(unsigned char ft, const charT *tri) const
+{
+  // wchar_t is 16 bits on Windows, 32 elsewhere - use 32 for all
+  const uint32 w[4] = {ft, uint32(tri[0]), uint32(tri[1]), uint32(tri[2])};
+  unsigned char buf[sizeof(w)];
+  for (size_t i = 0; i < sizeof(buf); i++)
+    buf[i] = static_cast<unsigned char>(w[i / 4] >> (8 * (i % 4)));
+  return static_cast<uint32>(SipHash::Hash(m_key, buf, sizeof(buf)));
+}
+
+void CSearchIndex::GetDigests(unsigned char ft, const StringX &sxValue,
+                              std::vector<uint32> &digests) const
+{
+  if (sxValue.length() < MIN_QUERY_LENGTH)
+    return;
+
+  SecureStringX sxLower(sxValue); // no allocation for most values
+  ToLower(sxLower);
+  const charT *p = sxLower.c_str();
+  for (size_t i = 0; i + 2 < sxLower.length(); i++)
+    digests.push_back(Digest(ft, p + i));
+}
+
+void CSearchIndex::Add(const CItemData &ci)
+{
+  const pws_os::CUUID uuid = ci.GetUUID();
+  if (m_mapSlots.find(uuid) != m_mapSlots.end())
+    Remove(uuid);
+
+  std::vector<uint32> digests;
+  for (auto ft : IndexedFields)
+    GetDigests(static_cast<unsigned char>(ft), GetIndexedValue(ci, ft), digests);
+
+  std::sort(digests.begin(), digests.end());
+  digests.erase(std::unique(digests.begin(), digests.end()), digests.end());
+
+  uint32 slot;
+  if (m_vFreeSlots.empty()) {
+    slot = static_cast<uint32>(m_vSlotUUIDs.size());
+    m_vSlotUUIDs.push_back(uuid);
+    m_vSlotDigests.push_back(std::vector<uint32>());
+  } else {
+    slot = m_vFreeSlots.back();
+    m_vFreeSlots.pop_back();
+    m_vSlotUUIDs[slot] = uuid;
+  }
+
+  for (auto d : digests)
+    m_postings[d].push_back(slot);
+  m_numPostings += digests.size();
+
+  m_vSlotDigests[slot].swap(digests);
+  m_mapSlots[uuid] = slot;
+}
+
+void CSearchIndex::Remove(const pws_os::CUUID &uuid)
+{
+  auto iter = m_mapSlots.find(uuid);
+  if (iter == m_mapSlots.end())
+    return;
+
+  const uint32 slot = iter->second;
+  m_mapSlots.erase(iter);
+
+  // Postings still refer to this slot - they're filtered out on lookup
+  // as the slot no longer holds their digest, and dropped on compaction.
+  m_numStale += m_vSlotDigests[slot].size();
+  std::vector<uint32>().swap(m_vSlotDigests[slot]);
+  m_vSlotUUIDs[slot] = pws_os::CUUID::NullUUID();
+  m_vFreeSlots.push_back(slot);
+
+  if (m_numStale > m_numPostings - m_numStale)
+    Compact();
+}
+
+void CSearchIndex::Compact()
+{
+  m_postings.clear();
+  m_numPostings = m_numStale = 0;
+  for (uint32 slot = 0; slot < m_vSlotDigests.size(); slot++) {
+    for (auto d : m_vSlotDigests[slot])
+      m_postings[d].push_back(slot);
+    m_numPostings += m_vSlotDigests[slot].size();
+  }
+}
+
+bool CSearchIndex::SlotHasAll(uint32 slot, const std::vector<uint32> &digests) const
+{
+  const std::vector<uint32> &sd = m_vSlotDigests[slot];
+  if (sd.empty())
+    return false;
+
+  for (auto d : digests) {
+    if (!std::binary_search(sd.begin(), sd.end(), d))
+      return false;
+  }
+  return true;
+}
+
+bool CSearchIndex::GetCandidates(const StringX &sxValue, CItemData::FieldType ft,
+                                 UUIDSet &candidates) const
+{
+  if (!IsIndexedField(ft) || sxValue.length() < MIN_QUERY_LENGTH)
+    return false;
+
+  std::vector<uint32> digests;
+  GetDigests(static_cast<unsigned char>(ft), sxValue, digests);
+
+  // Walk the shortest posting list, checking the others via the slots
+  const std::vector<uint32> *pshortest = nullptr;
+  for (auto d : digests) {
+    auto iter = m_postings.find(d);
+    if (iter == m_postings.end())
+      return true; // no entry can match
+    if (pshortest == nullptr || iter->second.size() < pshortest->size())
+      pshortest = &iter->second;
+  }
+
+  ASSERT(pshortest != nullptr);
+  for (auto slot : *pshortest) {
+    if (SlotHasAll(slot, digests))
+      candidates.insert(m_vSlotUUIDs[slot]);
+  }
+  return true;
+}
+
+bool CSearchIndex::GetCandidates(const StringX &sxValue,
+                                 const CItemData::FieldBits &bsFields,
+                                 UUIDSet &candidates) const
+{
+  bool bNarrowed = false;
+  for (auto ft : IndexedFields) {
+    if (bsFields.test(ft) && GetCandidates(sxValue, ft, candidates))
+      bNarrowed = true;
+  }
+  return bNarrowed;
+}
+
+bool CSearchIndex::MayContain(const pws_os::CUUID &uuid, CItemData::FieldType ft,
+                              const StringX &sxValue) const
+{
+  if (!IsIndexedField(ft) || sxValue.length() < MIN_QUERY_LENGTH)
+    return true;
+
+  auto iter = m_mapSlots.find(uuid);
+  if (iter == m_mapSlots.end())
+    return true; // not indexed, can't tell
+
+  std::vector<uint32> digests;
+  GetDigests(static_cast<unsigned char>(ft), sxValue, digests);
+  return SlotHasAll(iter->second, digests);
+}
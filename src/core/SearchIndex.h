@@ -0,0 +1,98 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SearchIndex.h
+//-----------------------------------------------------------------------------
+
+#ifndef __SEARCHINDEX_H
+#define __SEARCHINDEX_H
+
+/*
+ * CSearchIndex is an in-memory trigram index over the non-sensitive text
+ * fields of the entries in a database (group, title, user, URL, email and
+ * notes). It is used to narrow the set of entries that have to be decrypted
+ * and compared when searching or filtering on one of these fields.
+ *
+ * As with CItemData, nothing is kept in the clear: each (field, trigram)
+ * pair is reduced to a 32-bit keyed digest (SipHash-2-4, with a random key
+ * generated per index), so the index reveals neither the indexed text nor
+ * which entries share a trigram across databases or sessions.
+ *
+ * The index is conservative: digests are computed on lower-cased text, and
+ * a query is only ever narrowed to a *superset* of the real matches. Callers
+ * must still confirm each candidate against the real field value.
+ */
+
+#include "coredefs.h"
+
+#include <unordered_map>
+#include <vector>
+
+class CSearchIndex
+{
+public:
+  CSearchIndex();
+  ~CSearchIndex();
+
+  void Clear();
+  void Build(const ItemList &pwlist);
+
+  void Add(const CItemData &ci);
+  void Remove(const pws_os::CUUID &uuid);
+  void Update(const CItemData &ci) {Remove(ci.GetUUID()); Add(ci);}
+
+  size_t GetNumEntries() const {return m_mapSlots.size();}
+  bool IsIndexed(const pws_os::CUUID &uuid) const
+  {return m_mapSlots.find(uuid) != m_mapSlots.end();}
+
+  static bool IsIndexedField(int ft);
+
+  // Following return false if the index cannot narrow the search (value too
+  // short, field not indexed), in which case candidates is left untouched.
+  bool GetCandidates(const StringX &sxValue, CItemData::FieldType ft,
+                     UUIDSet &candidates) const;
+  bool GetCandidates(const StringX &sxValue, const CItemData::FieldBits &bsFields,
+                     UUIDSet &candidates) const;
+
+  // Returns false only if the entry definitely does not contain sxValue
+  // (case-insensitively) in field ft.
+  bool MayContain(const pws_os::CUUID &uuid, CItemData::FieldType ft,
+                  const StringX &sxValue) const;
+
+  enum {MIN_QUERY_LENGTH = 3};
+
+private:
+  CSearchIndex(const CSearchIndex &) = delete;
+  CSearchIndex &operator=(const CSearchIndex &) = delete;
+
+  uint32 Digest(unsigned char ft, const charT *tri) const;
+  void GetDigests(unsigned char ft, const StringX &sxValue,
+                  std::vector<uint32> &digests) const;
+  bool SlotHasAll(uint32 slot, const std::vector<uint32> &digests) const;
+  void Compact();
+
+  uint64 m_key[2];
+
+  // Each indexed entry owns a slot, holding its sorted set of digests.
+  // Slots of removed entries are recycled.
+  std::map<pws_os::CUUID, uint32> m_mapSlots;
+  std::vector<pws_os::CUUID> m_vSlotUUIDs;
+  std::vector<std::vector<uint32> > m_vSlotDigests;
+  std::vector<uint32> m_vFreeSlots;
+
+  // Inverted index: digest -> slots. Stale slots are tolerated (and filtered
+  // against m_vSlotDigests on lookup) until Compact() rebuilds the postings.
+  std::unordered_map<uint32, std::vector<uint32> > m_postings;
+  size_t m_numStale;
+  size_t m_numPostings;
+};
+
+#endif /* __SEARCHINDEX_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
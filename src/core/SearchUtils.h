@@ -18,17 +18,31 @@
 
 #include "ItemData.h"
 #include "PWHistory.h"
+#include "SearchIndex.h"
+#include "PWSCounters.h"
+#include "PWSTrace.h"
 
 
 template <class Iter, class Accessor, class Callback>
 void FindMatches(const StringX& searchText, bool fCaseSensitive,
                  const CItemData::FieldBits& bsFields, bool fUseSubgroups, const stringT& subgroupText,
                  CItemData::FieldType subgroupObject, PWSMatch::MatchRule subgroupFunction,
-                 bool subgroupFunctionCaseSensitive, Iter begin, Iter end, Accessor afn, Callback cb)
+                 bool subgroupFunctionCaseSensitive, Iter begin, Iter end, Accessor afn, Callback cb,
+                 const CSearchIndex *pIndex = nullptr)
 {
   if (searchText.empty())
     return;
 
+  PWSTrace::Span span("Search");
+  PWSCounters::Timing timing(PWSCounters::Search);
+  int64 nMatches = 0;
+
+  // If an index is provided, indexed fields of indexed entries that aren't
+  // candidates can't match, and needn't be decrypted
+  UUIDSet candidates;
+  const bool bNarrowed = pIndex != nullptr &&
+    pIndex->GetCandidates(searchText, bsFields, candidates);
+
   typedef StringX (CItemData::*ItemDataFuncT)() const;
 
   struct {
@@ -46,21 +60,28 @@ void FindMatches(const StringX& searchText, bool fCaseSensitive,
     {CItemData::XTIME_INT, &CItemData::GetXTimeInt},
   };
 
+  // Restriction is the same for all entries, prepare it once
+  const int fn = (subgroupFunctionCaseSensitive? -subgroupFunction: subgroupFunction);
+  const PWSMatch::StringMatcher subgroupMatcher(subgroupText.c_str(), fn);
+
   bool keep_going = true;
   for ( Iter itr = begin; itr != end && keep_going; ++itr) {
-    const int fn = (subgroupFunctionCaseSensitive? -subgroupFunction: subgroupFunction);
-    if (fUseSubgroups && !afn(itr).Matches(stringT(subgroupText.c_str()), subgroupObject, fn))
+    if (fUseSubgroups && !afn(itr).Matches(subgroupMatcher, subgroupObject))
       continue;
 
+    const bool bSkipIndexed = bNarrowed && pIndex->IsIndexed(afn(itr).GetUUID()) &&
+      candidates.find(afn(itr).GetUUID()) == candidates.end();
+
     bool found = false;
     for (size_t idx = 0; idx < NumberOf(ItemDataFields) && !found; ++idx) {
-      if (bsFields.test(ItemDataFields[idx].type)) {
+      if (bsFields.test(ItemDataFields[idx].type) &&
+          !(bSkipIndexed && CSearchIndex::IsIndexedField(ItemDataFields[idx].type))) {
         const StringX str = (afn(itr).*ItemDataFields[idx].func)();
         found = fCaseSensitive? str.find(searchText) != StringX::npos: FindNoCase(searchText, str);
       }
     }
 
-    if (!found && bsFields.test(CItemData::NOTES)) {
+    if (!found && bsFields.test(CItemData::NOTES) && !bSkipIndexed) {
       StringX str = afn(itr).GetNotes();
       found = fCaseSensitive? str.find(searchText) != StringX::npos: FindNoCase(searchText, str);
     }
@@ -77,9 +98,11 @@ void FindMatches(const StringX& searchText, bool fCaseSensitive,
     }
 
     if (found) {
+      nMatches++;
       cb(itr, &keep_going);
     }
   }
+  span.SetArg(nMatches);
 }
 
 
@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file SecureString.cpp
+//-----------------------------------------------------------------------------
+
+#include "SecureString.h"
+#include "Util.h"
+
+namespace {
+  const uint32 REPLACEMENT_CHAR = 0xfffd;
+
+  bool IsHighSurrogate(uint32 c) {return c >= 0xd800 && c <= 0xdbff;}
+  bool IsLowSurrogate(uint32 c) {return c >= 0xdc00 && c <= 0xdfff;}
+
+  void AppendUTF8(uint32 c, SecureStringU8 &utf8)
+  {
+    char buf[4];
+    size_t n;
+    if (c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+      c = REPLACEMENT_CHAR;
+    if (c < 0x80) {
+      buf[0] = static_cast<char>(c);
+      n = 1;
+    } else if (c < 0x800) {
+      buf[0] = static_cast<char>(0xc0 | (c >> 6));
+      buf[1] = static_cast<char>(0x80 | (c & 0x3f));
+      n = 2;
+    } else if (c < 0x10000) {
+      buf[0] = static_cast<char>(0xe0 | (c >> 12));
+      buf[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      buf[2] = static_cast<char>(0x80 | (c & 0x3f));
+      n = 3;
+    } else {
+      buf[0] = static_cast<char>(0xf0 | (c >> 18));
+      buf[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+      buf[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      buf[3] = static_cast<char>(0x80 | (c & 0x3f));
+      n = 4;
+    }
+    utf8.append(buf, n);
+    trashMemory(buf, sizeof(buf));
+  }
+
+  void AppendWide(uint32 c, StringX &s)
+  {
+    if (sizeof(wchar_t) == 2 && c >= 0x10000) {
+      c -= 0x10000;
+      s += static_cast<wchar_t>(0xd800 + (c >> 10));
+      s += static_cast<wchar_t>(0xdc00 + (c & 0x3ff));
+    } else
+      s += static_cast<wchar_t>(c);
+  }
+}
+
+void ToSecureUTF8(const wchar_t *s, size_t n, SecureStringU8 &utf8)
+{
+  utf8.clear();
+  utf8.reserve(n); // right for ASCII, a good start otherwise
+  for (size_t i = 0; i < n; i++) {
+    uint32 c = static_cast<uint32>(s[i]);
+    if (sizeof(wchar_t) == 2 && IsHighSurrogate(c) &&
+        i + 1 < n && IsLowSurrogate(static_cast<uint32>(s[i + 1]))) {
+      c = 0x10000 + ((c - 0xd800) << 10) + (static_cast<uint32>(s[i + 1]) - 0xdc00);
+      i++;
+    }
+    AppendUTF8(c, utf8);
+  }
+}
+
+void FromSecureUTF8(const SecureStringU8 &utf8, StringX &s)
+{
+  s.clear();
+  s.reserve(utf8.length());
+  const auto *p = reinterpret_cast<const unsigned char *>(utf8.data());
+  const size_t n = utf8.length();
+  size_t i = 0;
+  while (i < n) {
+    const unsigned char b = p[i];
+    uint32 c;
+    size_t extra;
+    uint32 min; // smallest value that needs this many bytes
+    if (b < 0x80) {
+      c = b; extra = 0; min = 0;
+    } else if ((b & 0xe0) == 0xc0) {
+      c = b & 0x1f; extra = 1; min = 0x80;
+    } else if ((b & 0xf0) == 0xe0) {
+      c = b & 0x0f; extra = 2; min = 0x800;
+    } else if ((b & 0xf8) == 0xf0) {
+      c = b & 0x07; extra = 3; min = 0x10000;
+    } else {
+      AppendWide(REPLACEMENT_CHAR, s);
+      i++;
+      continue;
+    }
+
+    size_t j = 1;
+    for (; j <= extra && i + j < n && (p[i + j] & 0xc0) == 0x80; j++)
+      c = (c << 6) | (p[i + j] & 0x3f);
+    if (j <= extra || c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+      c = REPLACEMENT_CHAR; // truncated, overlong or out of range
+    AppendWide(c, s);
+    i += j;
+  }
+}
@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+#ifndef __SECURESTRING_H
+#define __SECURESTRING_H
+
+/**
+ * \file SecureString.h
+ *
+ * Secure strings with inline storage for short values.
+ *
+ * StringX only scrubs memory it gets from its allocator. Short values
+ * live in the standard library's own small-string buffer, which isn't
+ * wiped, and anything longer costs a heap allocation. SecureBasicString
+ * keeps up to N-1 characters inline, and wipes the inline buffer whenever
+ * the contents are cleared, moved elsewhere or destroyed. Longer values
+ * use SecureAlloc, as StringX does.
+ *
+ * It's meant for the short-lived, mostly short strings of hot paths
+ * (titles, user names, group segments, hashing buffers), not as a
+ * replacement for StringX: only what these need is implemented.
+ *
+ * SecureStringU8 holds UTF-8, which typically needs a quarter of the
+ * memory of wchar_t on non-Windows platforms (half on Windows).
+ */
+
+#include "StringX.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+template <typename T, size_t N>
+class SecureBasicString
+{
+  static_assert(N > 1, "SecureBasicString needs room for a terminating null");
+
+public:
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef T *iterator;
+  typedef const T *const_iterator;
+  static const size_type npos = static_cast<size_type>(-1);
+
+  SecureBasicString() : m_p(m_buf), m_len(0), m_cap(N - 1) {m_buf[0] = T(0);}
+  SecureBasicString(const T *s) : SecureBasicString() {append(s, Length(s));}
+  SecureBasicString(const T *s, size_type n) : SecureBasicString() {append(s, n);}
+  template <class Tr, class A>
+  explicit SecureBasicString(const std::basic_string<T, Tr, A> &s)
+    : SecureBasicString() {append(s.data(), s.length());}
+  SecureBasicString(const SecureBasicString &that)
+    : SecureBasicString() {append(that.m_p, that.m_len);}
+  SecureBasicString(SecureBasicString &&that) noexcept
+    : SecureBasicString() {Take(that);}
+
+  ~SecureBasicString() {Release();}
+
+  SecureBasicString &operator=(const SecureBasicString &that)
+  {
+    if (this != &that)
+      assign(that.m_p, that.m_len);
+    return *this;
+  }
+  SecureBasicString &operator=(SecureBasicString &&that) noexcept
+  {
+    if (this != &that) {
+      Release();
+      Take(that);
+    }
+    return *this;
+  }
+  SecureBasicString &operator=(const T *s) {return assign(s, Length(s));}
+
+  SecureBasicString &assign(const T *s, size_type n)
+  {
+    clear();
+    return append(s, n);
+  }
+
+  size_type size() const {return m_len;}
+  size_type length() const {return m_len;}
+  size_type capacity() const {return m_cap;}
+  bool empty() const {return m_len == 0;}
+  bool IsInline() const {return m_p == m_buf;}
+
+  const T *c_str() const {return m_p;}
+  const T *data() const {return m_p;}
+  T *data() {return m_p;}
+  const T &operator[](size_type i) const {return m_p[i];}
+  T &operator[](size_type i) {return m_p[i];}
+  const_iterator begin() const {return m_p;}
+  const_iterator end() const {return m_p + m_len;}
+  iterator begin() {return m_p;}
+  iterator end() {return m_p + m_len;}
+
+  void clear()
+  {
+    // void * as trashMemory's LPTSTR overload counts characters, not bytes
+    trashMemory(static_cast<void *>(m_p), m_len * sizeof(T));
+    m_len = 0;
+    m_p[0] = T(0);
+  }
+
+  void reserve(size_type n)
+  {
+    if (n <= m_cap)
+      return;
+    T *p = S_Alloc::SecureAlloc<T>().allocate(n + 1);
+    std::memcpy(p, m_p, (m_len + 1) * sizeof(T));
+    const size_type len = m_len;
+    Release(); // wipes what we're leaving behind
+    m_p = p; m_len = len; m_cap = n;
+  }
+
+  SecureBasicString &append(const T *s, size_type n)
+  {
+    if (m_len + n > m_cap)
+      reserve(std::max(m_len + n, 2 * m_cap));
+    std::memcpy(m_p + m_len, s, n * sizeof(T));
+    m_len += n;
+    m_p[m_len] = T(0);
+    return *this;
+  }
+  SecureBasicString &append(const SecureBasicString &that) {return append(that.m_p, that.m_len);}
+  SecureBasicString &operator+=(const SecureBasicString &that) {return append(that.m_p, that.m_len);}
+  SecureBasicString &operator+=(const T *s) {return append(s, Length(s));}
+  SecureBasicString &operator+=(T c) {return append(&c, 1);}
+  void push_back(T c) {append(&c, 1);}
+
+  int compare(const SecureBasicString &that) const
+  {
+    const size_type n = std::min(m_len, that.m_len);
+    for (size_type i = 0; i < n; i++) {
+      if (m_p[i] != that.m_p[i])
+        return m_p[i] < that.m_p[i] ? -1 : 1;
+    }
+    return m_len == that.m_len ? 0 : (m_len < that.m_len ? -1 : 1);
+  }
+
+  // e.g., Str<StringX>()
+  template <class S> S Str() const {return S(m_p, m_len);}
+
+private:
+  static size_type Length(const T *s)
+  {
+    size_type n = 0;
+    while (s[n] != T(0))
+      n++;
+    return n;
+  }
+
+  // Free any heap storage, wipe the inline buffer, and revert to it
+  void Release()
+  {
+    if (m_p != m_buf)
+      S_Alloc::SecureAlloc<T>().deallocate(m_p, m_cap + 1);
+    trashMemory(static_cast<void *>(m_buf), sizeof(m_buf));
+    m_p = m_buf; m_len = 0; m_cap = N - 1;
+    m_buf[0] = T(0);
+  }
+
+  // Assumes we're empty & inline. Leaves that empty, nothing left to wipe.
+  void Take(SecureBasicString &that)
+  {
+    if (that.IsInline()) {
+      append(that.m_p, that.m_len);
+      that.clear();
+    } else {
+      m_p = that.m_p; m_len = that.m_len; m_cap = that.m_cap;
+      that.m_p = that.m_buf; that.m_len = 0; that.m_cap = N - 1;
+      that.m_buf[0] = T(0);
+    }
+  }
+
+  T m_buf[N];
+  T *m_p;
+  size_type m_len, m_cap;
+};
+
+template <typename T, size_t N>
+bool operator==(const SecureBasicString<T, N> &a, const SecureBasicString<T, N> &b)
+{return a.length() == b.length() && a.compare(b) == 0;}
+
+template <typename T, size_t N>
+bool operator!=(const SecureBasicString<T, N> &a, const SecureBasicString<T, N> &b)
+{return !(a == b);}
+
+template <typename T, size_t N>
+bool operator<(const SecureBasicString<T, N> &a, const SecureBasicString<T, N> &b)
+{return a.compare(b) < 0;}
+
+// Sized so that most titles, user names and group segments fit inline
+typedef SecureBasicString<wchar_t, 32> SecureStringX;
+typedef SecureBasicString<char, 64> SecureStringU8;
+
+// Conversion between wchar_t (UTF-16 on Windows, UTF-32 elsewhere) and UTF-8.
+// Invalid input (e.g., unpaired surrogates) becomes U+FFFD.
+void ToSecureUTF8(const wchar_t *s, size_t n, SecureStringU8 &utf8);
+inline void ToSecureUTF8(const StringX &s, SecureStringU8 &utf8)
+{ToSecureUTF8(s.data(), s.length(), utf8);}
+void FromSecureUTF8(const SecureStringU8 &utf8, StringX &s);
+
+#endif /* __SECURESTRING_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
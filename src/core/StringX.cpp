@@ -10,6 +10,7 @@
 #include <string.h>
 #include <cstdarg>
 #include "StringX.h"
+#include "SecureString.h"
 #include "Util.h"
 #include "os/pws_str.h"
 
@@ -204,6 +205,7 @@ template int CompareCase(const StringX &s1, const StringX &s2);
 template int CompareCase(const stringT &s1, const stringT &s2);
 template void ToLower(StringX &s);
 template void ToLower(stringT &s);
+template void ToLower(SecureStringX &s);
 template void ToUpper(StringX &s);
 template void ToUpper(stringT &s);
 template StringX &Trim(StringX &s, const TCHAR *set);
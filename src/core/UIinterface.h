@@ -52,6 +52,16 @@ public:
   // UpdateWizard: called to update text in Wizard during export Text/XML.
   virtual void UpdateWizard(const stringT &) {}
 
+  // DatabaseFileChanged: the open database has been changed on disk by
+  // someone else (see PWScore::SetFileWatchEnabled). Called from a
+  // background thread - implementations must hand off to the GUI thread.
+  virtual void DatabaseFileChanged() {}
+
+  // DatabaseSaved: a background save (PWScore::WriteFileAsync) has finished,
+  // status is as returned by PWScore::WriteFile. Called from the save
+  // thread - the UI should call PWScore::FinishAsyncSave on its own thread.
+  virtual void DatabaseSaved(const StringX &, int) {}
+
   virtual ~Observer() {}
 };
 
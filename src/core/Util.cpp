@@ -118,11 +118,36 @@ void burnStack(unsigned long len)
     burnStack(len - sizeof(buf));
 }
 
+static thread_local bool tl_bPasskeyACP = false;
+
+void SetPasskeyACP(bool bACP)
+{
+  tl_bPasskeyACP = bACP;
+}
+
+bool PasskeyEncodingsDiffer(const StringX &text)
+{
+  LPCTSTR txtstr = text.c_str();
+  const size_t txtlen = text.length();
+  const size_t utf8len = pws_os::wcstombs(nullptr, 0, txtstr, txtlen, true);
+  const size_t acplen = pws_os::wcstombs(nullptr, 0, txtstr, txtlen, false);
+  if (utf8len != acplen)
+    return true;
+
+  std::vector<char> utf8(utf8len + 1), acp(acplen + 1);
+  pws_os::wcstombs(utf8.data(), utf8.size(), txtstr, txtlen, true);
+  pws_os::wcstombs(acp.data(), acp.size(), txtstr, txtlen, false);
+  const bool retval = memcmp(utf8.data(), acp.data(), utf8len) != 0;
+  trashMemory(utf8.data(), utf8.size());
+  trashMemory(acp.data(), acp.size());
+  return retval;
+}
+
 void ConvertPasskey(const StringX &text,
                    unsigned char *&txt,
                    size_t &txtlen)
 {
-  bool isUTF8 = pws_os::getenv("PWS_PK_CP_ACP", false).empty();
+  bool isUTF8 = !tl_bPasskeyACP && pws_os::getenv("PWS_PK_CP_ACP", false).empty();
   LPCTSTR txtstr = text.c_str();
   txtlen = text.length();
 
@@ -47,6 +47,12 @@ extern void burnStack(unsigned long len); // borrowed from libtomcrypt
 
 extern void ConvertPasskey(const StringX &text,
                           unsigned char *&txt, size_t &txtlen);
+// ConvertPasskey encodes as UTF-8, unless PWS_PK_CP_ACP is set in the
+// environment or SetPasskeyACP(true) was called on the same thread, in
+// which case the ANSI code page is used (as by some old versions).
+extern void SetPasskeyACP(bool bACP);
+// True iff the two encodings of text differ, i.e., worth trying both
+extern bool PasskeyEncodingsDiffer(const StringX &text);
 
 extern void GenRandhash(const StringX &passkey,
                         const unsigned char *m_randstuff,
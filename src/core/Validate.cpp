@@ -13,12 +13,15 @@
 #include "ItemData.h"
 #include "UTF8Conv.h"
 #include "PWSLog.h"
+#include "PWSTrace.h"
 #include "Validate.h"
 
 #include "os/debug.h"
 
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <array>
 
 // For Validate only
 struct st_GroupTitleUser2 {
@@ -80,6 +83,9 @@ static bool GTUCompareV2(const st_GroupTitleUser2 &gtu1, const st_GroupTitleUser
 
 bool PWScore::Validate(const size_t iMAXCHARS, CReport *pRpt, st_ValidateResults &st_vr)
 {
+  PWSTrace::Span span("Validate");
+  span.SetArg(static_cast<int64>(m_pwlist.size()));
+
   /*
      1. Check PWH is valid
      2. Check that the 2 mandatory fields are present (Title & Password)
@@ -90,6 +96,7 @@ bool PWScore::Validate(const size_t iMAXCHARS, CReport *pRpt, st_ValidateResults
      6. For attachments (V4):
      6.1 Check that each ATTREF in a data entry has a corresponding ItemAtt
      6.2 Check that each ItemAtt has a corresponding "owner" ItemData
+     6.3 Share attachments that are duplicates of one another
 
      Note:
      m_pwlist is implemented as a map keyed on UUIDs, each entry is
@@ -259,6 +266,7 @@ bool PWScore::Validate(const size_t iMAXCHARS, CReport *pRpt, st_ValidateResults
       // We assume that this is run during file read. If not, then we
       // need to run using the Command mechanism for Undo/Redo.
       m_pwlist[fixedItem.GetUUID()] = fixedItem;
+      m_EntryMetadata.Update(fixedItem);
     }
   } // iteration over m_pwlist
 
@@ -302,6 +310,44 @@ bool PWScore::Validate(const size_t iMAXCHARS, CReport *pRpt, st_ValidateResults
   for (auto &orphan : orphans)
     m_attlist.erase(orphan);
 
+  // Merge duplicate attachments (6.3), e.g., the same certificate
+  // attached to many entries before they could share it.
+  // Not an error, so not reported, and the entries aren't marked as modified.
+  // Only attachments with the same content digest need comparing.
+  std::map<pws_os::CUUID, pws_os::CUUID> duplicates; // duplicate -> kept
+  std::map<std::array<unsigned char, SHA256::HASHLEN>, std::vector<pws_os::CUUID>> kept;
+  for (auto &att : m_attlist) {
+    std::array<unsigned char, SHA256::HASHLEN> digest;
+    att.second.GetContentDigest(digest.data());
+    std::vector<pws_os::CUUID> &same_digest = kept[digest];
+    auto kept_iter = std::find_if(same_digest.begin(), same_digest.end(),
+                                  [this, &att](const pws_os::CUUID &uuid) {
+                                    return m_attlist[uuid].IsDuplicateOf(att.second);
+                                  });
+    if (kept_iter != same_digest.end())
+      duplicates[att.first] = *kept_iter;
+    else
+      same_digest.push_back(att.first);
+  }
+
+  if (!duplicates.empty()) {
+    for (auto &p : m_pwlist) {
+      CItemData &ci = p.second;
+      if (!ci.HasAttRef())
+        continue;
+      auto dup_iter = duplicates.find(ci.GetAttUUID());
+      if (dup_iter != duplicates.end()) {
+        ci.SetAttUUID(dup_iter->second);
+        m_attlist[dup_iter->second].IncRefcount();
+        m_EntryMetadata.Update(ci);
+      }
+    }
+    for (auto &dup : duplicates)
+      m_attlist.erase(dup.first);
+    pws_os::Trace(_T("Validate: %d duplicate attachments merged\n"),
+                  static_cast<int>(duplicates.size()));
+  }
+
   if (st_vr.TotalIssues() != 0 && pRpt != nullptr) {
     // Only report problems if a. There are some and b. We have a report file
     if ((st_vr.num_invalid_UUIDs == 0 && st_vr.num_duplicate_UUIDs == 0)) {
@@ -0,0 +1,358 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// Implementation of Argon2id (RFC 9106), version 0x13
+// Follows the structure of the reference implementation,
+// https://github.com/P-H-C/phc-winner-argon2
+
+#include "argon2.h"
+#include "blake2b.h"
+#include "bitops.h"
+#include "../Util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace {
+  const uint32 ARGON2_VERSION = 0x13;
+  const uint32 ARGON2_ID = 2; // type y
+  const uint32 SYNC_POINTS = 4; // slices per pass
+  const uint32 QWORDS_IN_BLOCK = 128; // 1 KiB blocks
+  const uint32 BLOCK_BYTES = QWORDS_IN_BLOCK * 8;
+
+  struct Block {
+    ulong64 v[QWORDS_IN_BLOCK];
+  };
+
+  inline ulong64 rotr64(ulong64 x, unsigned n)
+  {
+    return (x >> n) | (x << (64 - n));
+  }
+
+  inline ulong64 fBlaMka(ulong64 x, ulong64 y)
+  {
+    return x + y + 2 * (x & 0xffffffffULL) * (y & 0xffffffffULL);
+  }
+
+  inline void GB(ulong64 &a, ulong64 &b, ulong64 &c, ulong64 &d)
+  {
+    a = fBlaMka(a, b); d = rotr64(d ^ a, 32);
+    c = fBlaMka(c, d); b = rotr64(b ^ c, 24);
+    a = fBlaMka(a, b); d = rotr64(d ^ a, 16);
+    c = fBlaMka(c, d); b = rotr64(b ^ c, 63);
+  }
+
+  // The BLAKE2b round function, without message
+  inline void P(ulong64 &v0,  ulong64 &v1,  ulong64 &v2,  ulong64 &v3,
+                ulong64 &v4,  ulong64 &v5,  ulong64 &v6,  ulong64 &v7,
+                ulong64 &v8,  ulong64 &v9,  ulong64 &v10, ulong64 &v11,
+                ulong64 &v12, ulong64 &v13, ulong64 &v14, ulong64 &v15)
+  {
+    GB(v0, v4, v8,  v12); GB(v1, v5, v9,  v13);
+    GB(v2, v6, v10, v14); GB(v3, v7, v11, v15);
+    GB(v0, v5, v10, v15); GB(v1, v6, v11, v12);
+    GB(v2, v7, v8,  v13); GB(v3, v4, v9,  v14);
+  }
+
+  // Compression function G: next = G(prev, ref), or next ^= G(prev, ref)
+  void FillBlock(const Block &prev, const Block &ref, Block &next, bool withXor)
+  {
+    Block R, tmp;
+    for (uint32 i = 0; i < QWORDS_IN_BLOCK; i++)
+      R.v[i] = tmp.v[i] = ref.v[i] ^ prev.v[i];
+    if (withXor)
+      for (uint32 i = 0; i < QWORDS_IN_BLOCK; i++)
+        tmp.v[i] ^= next.v[i];
+
+    for (int i = 0; i < 8; i++) { // rows
+      ulong64 *r = R.v + 16 * i;
+      P(r[0], r[1], r[2],  r[3],  r[4],  r[5],  r[6],  r[7],
+        r[8], r[9], r[10], r[11], r[12], r[13], r[14], r[15]);
+    }
+    for (int i = 0; i < 8; i++) { // columns
+      ulong64 *r = R.v + 2 * i;
+      P(r[0],  r[1],  r[16], r[17], r[32],  r[33],  r[48],  r[49],
+        r[64], r[65], r[80], r[81], r[96], r[97], r[112], r[113]);
+    }
+
+    for (uint32 i = 0; i < QWORDS_IN_BLOCK; i++)
+      next.v[i] = tmp.v[i] ^ R.v[i];
+    trashMemory(&R, sizeof(R));
+    trashMemory(&tmp, sizeof(tmp));
+  }
+
+  // Variable-length hash function H'
+  void Hprime(unsigned char *out, size_t outlen, const unsigned char *in, size_t inlen)
+  {
+    unsigned char lenbuf[4];
+    STORE32L(static_cast<ulong32>(outlen), lenbuf);
+
+    if (outlen <= BLAKE2b::MAXHASHLEN) {
+      BLAKE2b H(static_cast<unsigned int>(outlen));
+      H.Update(lenbuf, sizeof(lenbuf));
+      H.Update(in, inlen);
+      H.Final(out);
+      return;
+    }
+
+    unsigned char V[BLAKE2b::MAXHASHLEN];
+    BLAKE2b H1;
+    H1.Update(lenbuf, sizeof(lenbuf));
+    H1.Update(in, inlen);
+    H1.Final(V);
+    memcpy(out, V, BLAKE2b::MAXHASHLEN / 2);
+    out += BLAKE2b::MAXHASHLEN / 2;
+    size_t toproduce = outlen - BLAKE2b::MAXHASHLEN / 2;
+
+    while (toproduce > BLAKE2b::MAXHASHLEN) {
+      BLAKE2b H;
+      H.Update(V, sizeof(V));
+      H.Final(V);
+      memcpy(out, V, BLAKE2b::MAXHASHLEN / 2);
+      out += BLAKE2b::MAXHASHLEN / 2;
+      toproduce -= BLAKE2b::MAXHASHLEN / 2;
+    }
+
+    BLAKE2b H(static_cast<unsigned int>(toproduce));
+    H.Update(V, sizeof(V));
+    H.Final(out);
+    trashMemory(V, sizeof(V));
+  }
+
+  void LoadBlock(Block &b, const unsigned char *in)
+  {
+    for (uint32 i = 0; i < QWORDS_IN_BLOCK; i++)
+      LOAD64L(b.v[i], in + 8 * i);
+  }
+
+  void StoreBlock(unsigned char *out, const Block &b)
+  {
+    for (uint32 i = 0; i < QWORDS_IN_BLOCK; i++)
+      STORE64L(b.v[i], out + 8 * i);
+  }
+
+  void UpdateLE32(BLAKE2b &H, uint32 x)
+  {
+    unsigned char buf[4];
+    STORE32L(x, buf);
+    H.Update(buf, sizeof(buf));
+  }
+
+  struct Instance {
+    std::vector<Block> memory;
+    uint32 passes;
+    uint32 lanes;
+    uint32 memoryBlocks; // m'
+    uint32 laneLength;
+    uint32 segmentLength;
+
+    void FillSegment(uint32 pass, uint32 lane, uint32 slice);
+    uint32 IndexAlpha(uint32 pass, uint32 slice, uint32 index,
+                      uint32 pseudoRand, bool sameLane) const;
+  };
+
+  void NextAddresses(Block &address, Block &input, const Block &zero)
+  {
+    input.v[6]++;
+    FillBlock(zero, input, address, false);
+    FillBlock(zero, address, address, false);
+  }
+
+  uint32 Instance::IndexAlpha(uint32 pass, uint32 slice, uint32 index,
+                              uint32 pseudoRand, bool sameLane) const
+  {
+    // Blocks that may be referenced: all those already computed in this
+    // lane (in this pass and the last), except the previous one, and those
+    // in finished segments of other lanes
+    uint32 area;
+    if (pass == 0) {
+      if (slice == 0)
+        area = index - 1;
+      else if (sameLane)
+        area = slice * segmentLength + index - 1;
+      else
+        area = slice * segmentLength - (index == 0 ? 1 : 0);
+    } else {
+      if (sameLane)
+        area = laneLength - segmentLength + index - 1;
+      else
+        area = laneLength - segmentLength - (index == 0 ? 1 : 0);
+    }
+
+    ulong64 rel = pseudoRand;
+    rel = (rel * rel) >> 32;
+    rel = area - 1 - ((area * rel) >> 32);
+
+    uint32 start = 0;
+    if (pass != 0)
+      start = (slice == SYNC_POINTS - 1) ? 0 : (slice + 1) * segmentLength;
+    return static_cast<uint32>((start + rel) % laneLength);
+  }
+
+  void Instance::FillSegment(uint32 pass, uint32 lane, uint32 slice)
+  {
+    // Argon2id: data-independent addressing for the first half of the first pass
+    const bool dataIndependent = (pass == 0 && slice < SYNC_POINTS / 2);
+    Block zero, input, address;
+    memset(&zero, 0, sizeof(zero));
+    memset(&input, 0, sizeof(input));
+    memset(&address, 0, sizeof(address));
+    if (dataIndependent) {
+      input.v[0] = pass;
+      input.v[1] = lane;
+      input.v[2] = slice;
+      input.v[3] = memoryBlocks;
+      input.v[4] = passes;
+      input.v[5] = ARGON2_ID;
+    }
+
+    uint32 start = 0;
+    if (pass == 0 && slice == 0) {
+      start = 2; // first two blocks already there
+      if (dataIndependent)
+        NextAddresses(address, input, zero);
+    }
+
+    uint32 curr = lane * laneLength + slice * segmentLength + start;
+    uint32 prev = (curr % laneLength == 0) ? curr + laneLength - 1 : curr - 1;
+
+    for (uint32 i = start; i < segmentLength; i++, curr++, prev++) {
+      if (curr % laneLength == 1)
+        prev = curr - 1;
+
+      ulong64 pseudoRand;
+      if (dataIndependent) {
+        if (i % QWORDS_IN_BLOCK == 0)
+          NextAddresses(address, input, zero);
+        pseudoRand = address.v[i % QWORDS_IN_BLOCK];
+      } else {
+        pseudoRand = memory[prev].v[0];
+      }
+
+      uint32 refLane = static_cast<uint32>((pseudoRand >> 32) % lanes);
+      if (pass == 0 && slice == 0)
+        refLane = lane;
+      const uint32 refIndex = IndexAlpha(pass, slice, i,
+                                         static_cast<uint32>(pseudoRand & 0xffffffffULL),
+                                         refLane == lane);
+
+      FillBlock(memory[prev], memory[laneLength * refLane + refIndex],
+                memory[curr], pass != 0);
+    }
+    trashMemory(&address, sizeof(address));
+  }
+}
+
+bool argon2id(const unsigned char *password, size_t password_len,
+              const unsigned char *salt,     size_t salt_len,
+              uint32 t_cost, uint32 m_cost,  uint32 parallelism,
+              unsigned char *out,            size_t outlen,
+              const unsigned char *secret,   size_t secret_len,
+              const unsigned char *ad,       size_t ad_len,
+              const std::atomic<bool> *cancel)
+{
+  if (t_cost < 1 || parallelism < 1 || parallelism > 0xffffff ||
+      salt_len < 8 || outlen < 4 ||
+      m_cost < 2 * SYNC_POINTS * parallelism)
+    return false;
+
+  Instance inst;
+  inst.passes = t_cost;
+  inst.lanes = parallelism;
+  inst.segmentLength = m_cost / (parallelism * SYNC_POINTS);
+  inst.laneLength = inst.segmentLength * SYNC_POINTS;
+  inst.memoryBlocks = inst.laneLength * parallelism;
+  try {
+    inst.memory.resize(inst.memoryBlocks);
+  } catch (const std::exception &) {
+    return false;
+  }
+
+  // H0, followed by room for the block and lane numbers
+  unsigned char h0[BLAKE2b::MAXHASHLEN + 8];
+  {
+    BLAKE2b H;
+    UpdateLE32(H, parallelism);
+    UpdateLE32(H, static_cast<uint32>(outlen));
+    UpdateLE32(H, m_cost);
+    UpdateLE32(H, t_cost);
+    UpdateLE32(H, ARGON2_VERSION);
+    UpdateLE32(H, ARGON2_ID);
+    UpdateLE32(H, static_cast<uint32>(password_len));
+    H.Update(password, password_len);
+    UpdateLE32(H, static_cast<uint32>(salt_len));
+    H.Update(salt, salt_len);
+    UpdateLE32(H, static_cast<uint32>(secret_len));
+    if (secret_len != 0)
+      H.Update(secret, secret_len);
+    UpdateLE32(H, static_cast<uint32>(ad_len));
+    if (ad_len != 0)
+      H.Update(ad, ad_len);
+    H.Final(h0);
+  }
+
+  unsigned char blockbytes[BLOCK_BYTES];
+  for (uint32 lane = 0; lane < parallelism; lane++) {
+    for (uint32 j = 0; j < 2; j++) {
+      STORE32L(j, h0 + BLAKE2b::MAXHASHLEN);
+      STORE32L(lane, h0 + BLAKE2b::MAXHASHLEN + 4);
+      Hprime(blockbytes, sizeof(blockbytes), h0, sizeof(h0));
+      LoadBlock(inst.memory[lane * inst.laneLength + j], blockbytes);
+    }
+  }
+
+  // Lanes are independent within a slice, so fill them concurrently,
+  // with at most as many threads as there are cores
+  const uint32 nThreads = std::min(parallelism,
+                                   std::max(1U, std::thread::hardware_concurrency()));
+  bool cancelled = false;
+  for (uint32 pass = 0; pass < t_cost && !cancelled; pass++) {
+    for (uint32 slice = 0; slice < SYNC_POINTS && !cancelled; slice++) {
+      if (cancel != nullptr && *cancel) {
+        cancelled = true;
+        break;
+      }
+      std::atomic<uint32> nextLane(0);
+      auto worker = [&inst, &nextLane, pass, slice, parallelism]() {
+        for (uint32 lane = nextLane++; lane < parallelism; lane = nextLane++)
+          inst.FillSegment(pass, lane, slice);
+      };
+      std::vector<std::thread> threads;
+      for (uint32 t = 1; t < nThreads; t++)
+        threads.emplace_back(worker);
+      worker();
+      for (auto &t : threads)
+        t.join();
+    }
+  }
+
+  if (cancelled) {
+    trashMemory(inst.memory.data(), inst.memory.size() * sizeof(Block));
+    trashMemory(h0, sizeof(h0));
+    trashMemory(blockbytes, sizeof(blockbytes));
+    return false;
+  }
+
+  // Tag is H' of the XOR of the last block of each lane
+  Block final_block = inst.memory[inst.laneLength - 1];
+  for (uint32 lane = 1; lane < parallelism; lane++) {
+    const Block &last = inst.memory[lane * inst.laneLength + inst.laneLength - 1];
+    for (uint32 i = 0; i < QWORDS_IN_BLOCK; i++)
+      final_block.v[i] ^= last.v[i];
+  }
+  StoreBlock(blockbytes, final_block);
+  Hprime(out, outlen, blockbytes, sizeof(blockbytes));
+
+  trashMemory(inst.memory.data(), inst.memory.size() * sizeof(Block));
+  trashMemory(&final_block, sizeof(final_block));
+  trashMemory(blockbytes, sizeof(blockbytes));
+  trashMemory(h0, sizeof(h0));
+  return true;
+}
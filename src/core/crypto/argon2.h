@@ -0,0 +1,43 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// Interface for Argon2id (RFC 9106), version 0x13
+// Memory-hard password hashing, used for V4 key blocks (see formatV4.txt)
+
+#ifndef __ARGON2_H
+#define __ARGON2_H
+
+#include "../../os/typedefs.h"
+
+#include <atomic>
+#include <cstddef>
+
+/**
+   @param password          The password
+   @param password_len      The length of the password (octets)
+   @param salt              The salt, at least 8 octets
+   @param salt_len          The length of the salt (octets)
+   @param t_cost            Number of passes over memory, >= 1
+   @param m_cost            Memory to use, in KiB, >= 8 * parallelism
+   @param parallelism       Number of lanes, 1..0xffffff. Lanes are filled concurrently.
+   @param out               [out] The tag
+   @param outlen            Length of the tag (octets), >= 4
+   @param secret, ad        Optional secret value K and associated data X
+   @param cancel            If not null, checked between segments - set it to
+                            abandon the computation
+   @return                  false if the parameters are out of range, memory
+                            can't be allocated or cancel was set,
+                            in which case out is unchanged
+*/
+bool argon2id(const unsigned char *password, size_t password_len,
+              const unsigned char *salt,     size_t salt_len,
+              uint32 t_cost, uint32 m_cost,  uint32 parallelism,
+              unsigned char *out,            size_t outlen,
+              const unsigned char *secret = nullptr, size_t secret_len = 0,
+              const unsigned char *ad = nullptr,     size_t ad_len = 0,
+              const std::atomic<bool> *cancel = nullptr);
+#endif /* __ARGON2_H */
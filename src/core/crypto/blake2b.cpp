@@ -0,0 +1,142 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// blake2b.cpp
+// BLAKE2b, straight from RFC 7693
+//-----------------------------------------------------------------------------
+#include "blake2b.h"
+#include "bitops.h"
+#include "../Util.h"
+
+#include <cstring>
+
+static const ulong64 IV[8] = {
+  0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+  0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+  0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+  0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+static const unsigned char SIGMA[12][16] = {
+  { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+  {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3},
+  {11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4},
+  { 7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8},
+  { 9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13},
+  { 2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9},
+  {12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11},
+  {13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10},
+  { 6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5},
+  {10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0},
+  { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+  {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3},
+};
+
+static inline ulong64 rotr64(ulong64 x, unsigned n)
+{
+  return (x >> n) | (x << (64 - n));
+}
+
+static inline void G(ulong64 v[16], int a, int b, int c, int d, ulong64 x, ulong64 y)
+{
+  v[a] = v[a] + v[b] + x;
+  v[d] = rotr64(v[d] ^ v[a], 32);
+  v[c] = v[c] + v[d];
+  v[b] = rotr64(v[b] ^ v[c], 24);
+  v[a] = v[a] + v[b] + y;
+  v[d] = rotr64(v[d] ^ v[a], 16);
+  v[c] = v[c] + v[d];
+  v[b] = rotr64(v[b] ^ v[c], 63);
+}
+
+BLAKE2b::BLAKE2b(unsigned int hashlen)
+  : curlen(0), outlen(hashlen)
+{
+  ASSERT(hashlen >= 1 && hashlen <= MAXHASHLEN);
+  for (int i = 0; i < 8; i++)
+    h[i] = IV[i];
+  h[0] ^= 0x01010000ULL ^ hashlen; // no key, fanout = depth = 1
+  t[0] = t[1] = 0;
+  memset(buf, 0, sizeof(buf));
+}
+
+BLAKE2b::~BLAKE2b()
+{
+  trashMemory(h, sizeof(h));
+  trashMemory(buf, sizeof(buf));
+}
+
+void BLAKE2b::Compress(bool last)
+{
+  ulong64 v[16], m[16];
+  for (int i = 0; i < 8; i++) {
+    v[i] = h[i];
+    v[i + 8] = IV[i];
+  }
+  v[12] ^= t[0];
+  v[13] ^= t[1];
+  if (last)
+    v[14] = ~v[14];
+
+  for (int i = 0; i < 16; i++)
+    LOAD64L(m[i], buf + 8 * i);
+
+  for (int i = 0; i < 12; i++) {
+    const unsigned char *s = SIGMA[i];
+    G(v, 0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+    G(v, 1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+    G(v, 2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+    G(v, 3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+    G(v, 0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7,  8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4,  9, 14, m[s[14]], m[s[15]]);
+  }
+
+  for (int i = 0; i < 8; i++)
+    h[i] ^= v[i] ^ v[i + 8];
+
+  trashMemory(v, sizeof(v));
+  trashMemory(m, sizeof(m));
+}
+
+void BLAKE2b::Update(const unsigned char *in, size_t inlen)
+{
+  // The last block is compressed in Final(), with the 'last' flag set,
+  // so only compress a full buffer when there's more to come
+  while (inlen > 0) {
+    if (curlen == BLOCKSIZE) {
+      t[0] += BLOCKSIZE;
+      if (t[0] < BLOCKSIZE)
+        t[1]++;
+      Compress(false);
+      curlen = 0;
+    }
+    size_t n = BLOCKSIZE - curlen;
+    if (n > inlen)
+      n = inlen;
+    memcpy(buf + curlen, in, n);
+    curlen += n;
+    in += n;
+    inlen -= n;
+  }
+}
+
+void BLAKE2b::Final(unsigned char *digest)
+{
+  t[0] += curlen;
+  if (t[0] < curlen)
+    t[1]++;
+  memset(buf + curlen, 0, BLOCKSIZE - curlen);
+  Compress(true);
+
+  unsigned char out[MAXHASHLEN];
+  for (int i = 0; i < 8; i++)
+    STORE64L(h[i], out + 8 * i);
+  memcpy(digest, out, outlen);
+  trashMemory(out, sizeof(out));
+}
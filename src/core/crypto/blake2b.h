@@ -0,0 +1,42 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// blake2b.h
+// BLAKE2b (RFC 7693), unkeyed, as needed by Argon2
+//-----------------------------------------------------------------------------
+#ifndef __BLAKE2B_H
+#define __BLAKE2B_H
+
+#include "../../os/typedefs.h"
+
+#include <cstddef>
+
+class BLAKE2b
+{
+public:
+  static const unsigned int MAXHASHLEN = 64;
+  static const unsigned int BLOCKSIZE = 128;
+  explicit BLAKE2b(unsigned int hashlen = MAXHASHLEN); // 1..MAXHASHLEN
+  ~BLAKE2b();
+  void Update(const unsigned char *in, size_t inlen);
+  void Final(unsigned char *digest); // hashlen bytes
+
+private:
+  void Compress(bool last);
+
+  ulong64 h[8];
+  ulong64 t[2]; // bytes compressed so far
+  unsigned char buf[BLOCKSIZE];
+  size_t curlen;
+  unsigned int outlen;
+};
+
+#endif /* __BLAKE2B_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -9,6 +9,7 @@
 // Based on LibTomCrypt by
 // Tom St Denis, tomstdenis@iahu.ca, http://libtomcrypt.org
 
+#include "pbkdf2.h"
 #include "bitops.h"
 #include "hmac.h"
 
@@ -24,11 +25,13 @@
                             (see hmac.h for details)
    @param out               [out] The destination for this algorithm
    @param outlen            [in/out] The max size and resulting size of the algorithm output
+   @param cancel            [optional] Checked every so often - if set, gives up with *outlen = 0
 */
 void pbkdf2(const unsigned char *password, unsigned long password_len, 
             const unsigned char *salt,     unsigned long salt_len,
             int iteration_count,           HMAC_BASE *hmac,
-            unsigned char *out,            unsigned long *outlen)
+            unsigned char *out,            unsigned long *outlen,
+            const std::atomic<bool> *cancel)
 {
   int itts;
   ulong32  blkno;
@@ -72,6 +75,13 @@ void pbkdf2(const unsigned char *password, unsigned long password_len,
     /* now compute repeated and XOR it in buf[1] */
     memcpy(buf[1], buf[0], x);
     for (itts = 1; itts < iteration_count; ++itts) {
+      if (cancel != nullptr && (itts & 0x3ff) == 0 &&
+          cancel->load(std::memory_order_relaxed)) {
+        *outlen = 0;
+        std::memset(buf[0], 0, BlockSize * 2);
+        delete[] buf[0];
+        return;
+      }
       hmac->Doit(password, password_len, buf[0], x, buf[0]);
       for (y = 0; y < x; y++) {
         buf[1][y] ^= buf[0][y];
@@ -14,6 +14,9 @@
 
 #ifndef __PBKDF2_H
 #define __PBKDF2_H
+
+#include <atomic>
+
 class HMAC_BASE;
 /**
    @param password          The input password (or key)
@@ -25,9 +28,11 @@ class HMAC_BASE;
                             (see hmac.h for details)
    @param out               [out] The destination for this algorithm
    @param outlen            [in/out] The max size and resulting size of the algorithm output
+   @param cancel            [optional] Checked every so often - if set, gives up with *outlen = 0
 */
 void pbkdf2(const unsigned char *password, unsigned long password_len, 
             const unsigned char *salt,     unsigned long salt_len,
             int iteration_count,           HMAC_BASE *hmac,
-            unsigned char *out,            unsigned long *outlen);
+            unsigned char *out,            unsigned long *outlen,
+            const std::atomic<bool> *cancel = nullptr);
 #endif /* __PBKDF2_H */
@@ -0,0 +1,76 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file siphash.h
+// SipHash-2-4 keyed hash (Aumasson & Bernstein), for in-memory lookup
+// tables that shouldn't expose what they were built from.
+// Not a MAC for anything written to disk - use HMAC for that.
+
+//-----------------------------------------------------------------------------
+#ifndef __SIPHASH_H
+#define __SIPHASH_H
+
+#include "../../os/typedefs.h"
+
+#include <cstddef>
+
+class SipHash
+{
+public:
+  enum {KEYLEN = 16};
+
+  // key is two 64 bit words
+  static uint64 Hash(const uint64 key[2], const unsigned char *data, size_t len)
+  {
+    uint64 v0 = key[0] ^ 0x736f6d6570736575ULL;
+    uint64 v1 = key[1] ^ 0x646f72616e646f6dULL;
+    uint64 v2 = key[0] ^ 0x6c7967656e657261ULL;
+    uint64 v3 = key[1] ^ 0x7465646279746573ULL;
+
+    const size_t nblocks = len / 8;
+    for (size_t i = 0; i < nblocks; i++) {
+      const uint64 m = Load(data + 8 * i, 8);
+      v3 ^= m;
+      Round(v0, v1, v2, v3);
+      Round(v0, v1, v2, v3);
+      v0 ^= m;
+    }
+
+    const uint64 b = (uint64(len) << 56) | Load(data + 8 * nblocks, len % 8);
+    v3 ^= b;
+    Round(v0, v1, v2, v3);
+    Round(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++)
+      Round(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+
+private:
+  static uint64 Rotl(uint64 x, int b) {return (x << b) | (x >> (64 - b));}
+
+  // Little-endian load of up to 8 bytes, whatever the host byte order
+  static uint64 Load(const unsigned char *p, size_t n)
+  {
+    uint64 r = 0;
+    for (size_t i = 0; i < n; i++)
+      r |= uint64(p[i]) << (8 * i);
+    return r;
+  }
+
+  static void Round(uint64 &v0, uint64 &v1, uint64 &v2, uint64 &v3)
+  {
+    v0 += v1; v1 = Rotl(v1, 13); v1 ^= v0; v0 = Rotl(v0, 32);
+    v2 += v3; v3 = Rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = Rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = Rotl(v1, 17); v1 ^= v2; v2 = Rotl(v2, 32);
+  }
+};
+
+#endif /* __SIPHASH_H */
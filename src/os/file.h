@@ -23,7 +23,22 @@ namespace pws_os {
   extern bool FileExists(const stringT &filename, bool &bReadOnly);
   extern bool RenameFile(const stringT &oldname, const stringT &newname);
   extern bool CopyAFile(const stringT &from, const stringT &to); // creates dirs as needed!
+  // Makes to a copy-on-write clone of from, sharing its data until either
+  // changes, where the filesystem supports it. Otherwise (or if to exists)
+  // returns false, leaving things as they were.
+  extern bool CloneFile(const stringT &from, const stringT &to);
   extern bool DeleteAFile(const stringT &filename);
+  // Atomically replaces to by from, which must be in the same directory:
+  // at no time is there no file named to. Unlike RenameFile, no fallbacks.
+  extern bool ReplaceAFile(const stringT &from, const stringT &to);
+  // Prepares to save filename via ReplaceAFile: target gets the file that's
+  // really written, following symlinks, and tmpname an empty file created
+  // next to it, with target's permissions, owner and extended attributes.
+  // If that can't be done (the directory isn't writable, or the owner can't
+  // be kept), tmpname is empty and target should be written in place.
+  // Returns false only if tmpname can't be created for another reason.
+  extern bool CreateReplacement(const stringT &filename, stringT &target,
+                                stringT &tmpname);
   extern void FindFiles(const stringT &filter, std::vector<stringT> &res);
   extern bool LockFile(const stringT &filename, stringT &locker,
                        HANDLE &lockFileHandle);
@@ -32,7 +47,10 @@ namespace pws_os {
   extern void TryUnlockFile(const stringT &filename, HANDLE &lockFileHandle);
 
   extern std::FILE *FOpen(const stringT &filename, const TCHAR *mode);
-  extern int FClose(std::FILE *fd, const bool &bIsWrite);
+  extern int FClose(std::FILE *fd, const bool &bIsWrite); // bIsWrite: sync to disk first
+  // Syncs the directory holding filename, so that its creation or renaming
+  // there survives a crash, where the OS doesn't see to that itself
+  extern bool SyncDir(const stringT &filename);
   extern size_t fileLength(std::FILE *fp);
   extern bool GetFileTimes(const stringT &filename,
       time_t &ctime, time_t &mtime, time_t &atime);
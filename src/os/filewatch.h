@@ -0,0 +1,61 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+/**
+ * Interface for watching a single file for changes made by others.
+ *
+ * Once started, a platform-dependant background thread calls the
+ * registered function whenever the file is written to, replaced (e.g.,
+ * by a rename over it, as sync clients do) or removed. The function is
+ * called on that thread, not the caller's, and bursts of events are
+ * coalesced into one call.
+ *
+ * Where the platform has no suitable facility, IsSupported() returns
+ * false and Start() fails - callers should fall back to polling.
+ */
+
+#ifndef __FILEWATCH_H
+#define __FILEWATCH_H
+
+#include "typedefs.h"
+
+#include <functional>
+
+struct st_filewatch_impl; // helper structure, platform-dependant
+
+class PWSFileWatch {
+public:
+  typedef std::function<void()> ChangeFn;
+
+  PWSFileWatch();
+  ~PWSFileWatch(); // stops the watch
+
+  static bool IsSupported();
+
+  // Stops any current watch first
+  bool Start(const stringT &filename, ChangeFn fn);
+  // Returns after the watch thread has exited, so the function
+  // won't be called again - don't call from within the function!
+  void Stop();
+  bool IsWatching() const;
+  // Whether there may be a change that the function hasn't been called for
+  // yet: events not yet read, or seen and waiting for things to settle
+  bool HasPending() const;
+
+private:
+  PWSFileWatch(const PWSFileWatch &) = delete;
+  PWSFileWatch &operator=(const PWSFileWatch &) = delete;
+
+  st_filewatch_impl *pImpl;
+};
+
+#endif /* __FILEWATCH_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -23,6 +23,9 @@
 #include <fnmatch.h>
 
 #include <CoreFoundation/CoreFoundation.h>
+#include <sys/clonefile.h>
+#include <copyfile.h>
+#include <memory>
 
 #include "../file.h"
 #include "../env.h"
@@ -101,6 +104,84 @@ bool pws_os::RenameFile(const stringT &oldname, const stringT &newname)
   return (status == 0);
 }
 
+bool pws_os::ReplaceAFile(const stringT &from, const stringT &to)
+{
+  char *fromfn = createFileSystemRepresentation(from);
+  char *tofn = createFileSystemRepresentation(to);
+  const int status = ::rename(fromfn, tofn); // atomic, per POSIX
+  delete[] fromfn;
+  delete[] tofn;
+  return (status == 0);
+}
+
+bool pws_os::CreateReplacement(const stringT &filename, stringT &target,
+                               stringT &tmpname)
+{
+  char *fn = createFileSystemRepresentation(filename);
+  // Replace what a symlink points to, not the link
+  string path(fn);
+  char *real = ::realpath(fn, NULL);
+  delete[] fn;
+  if (real != NULL) {
+    path = real;
+    free(real);
+  }
+  const size_t wN = ::mbstowcs(NULL, path.c_str(), 0) + 1;
+  std::unique_ptr<wchar_t[]> wpath = std::make_unique<wchar_t[]>(wN);
+  ::mbstowcs(wpath.get(), path.c_str(), wN);
+  target = wpath.get();
+  tmpname.clear();
+
+  const string::size_type last_slash = path.find_last_of('/');
+  const string dir = (last_slash == string::npos) ? string(1, '.') :
+    path.substr(0, last_slash == 0 ? 1 : last_slash);
+  if (::access(dir.c_str(), W_OK) != 0)
+    return true; // in place, as we can't add a file there
+
+  struct stat st;
+  const bool exists = (::stat(path.c_str(), &st) == 0);
+  const string tmppath = path + ".tmp";
+  ::unlink(tmppath.c_str()); // left by a crash
+  const int fd = ::open(tmppath.c_str(), O_WRONLY | O_CREAT | O_EXCL,
+                        exists ? (st.st_mode & 07777) : 0600);
+  if (fd < 0)
+    return false;
+
+  bool same = true;
+  if (exists) {
+    // Only root can give a file away - a group we're in is fine
+    if ((st.st_uid != ::geteuid() || ::fchown(fd, -1, st.st_gid) != 0) &&
+        ::fchown(fd, st.st_uid, st.st_gid) != 0) {
+      same = false;
+    } else {
+      const int src = ::open(path.c_str(), O_RDONLY);
+      same = src >= 0 && ::fchmod(fd, st.st_mode & 07777) == 0 &&
+        ::fcopyfile(src, fd, NULL, COPYFILE_ACL | COPYFILE_XATTR) == 0;
+      if (src >= 0)
+        ::close(src);
+    }
+  }
+  ::close(fd);
+  if (!same) {
+    ::unlink(tmppath.c_str());
+    return true; // in place, which keeps all that
+  }
+
+  tmpname = target + _T(".tmp");
+  return true;
+}
+
+bool pws_os::CloneFile(const stringT &from, const stringT &to)
+{
+  // APFS; fails with ENOTSUP elsewhere
+  char *fromfn = createFileSystemRepresentation(from);
+  char *tofn = createFileSystemRepresentation(to);
+  const int status = ::clonefile(fromfn, tofn, 0);
+  delete[] fromfn;
+  delete[] tofn;
+  return (status == 0);
+}
+
 bool pws_os::CopyAFile(const stringT &from, const stringT &to)
 {
   const char *szfrom = NULL;
@@ -332,16 +413,40 @@ std::FILE *pws_os::FOpen(const stringT &filename, const TCHAR *mode)
 int pws_os::FClose(std::FILE *fd, const bool &bIsWrite)
 {
   if (fd != NULL) {
+    int rc = 0;
     if (bIsWrite) {
-      // Flush the data buffers
-      fflush(fd);
+      // Flush the data buffers, and have them written to disk - fsync
+      // alone leaves them in the drive's cache on macOS.
+      // EINVAL is for what can't be synced (a pipe as stdout) - no matter.
+      rc = fflush(fd);
+      if (rc == 0 && ::fcntl(fileno(fd), F_FULLFSYNC) == -1 &&
+          ::fsync(fileno(fd)) != 0 && errno != EINVAL)
+        rc = EOF;
     }
     // Now close file
-    return fclose(fd);
+    const int crc = fclose(fd);
+    return (rc != 0) ? rc : crc;
   }
   return 0;
 }
 
+bool pws_os::SyncDir(const stringT &filename)
+{
+  char *fn = createFileSystemRepresentation(filename);
+  const string path(fn);
+  delete[] fn;
+  const string::size_type last_slash = path.find_last_of('/');
+  const string dir = (last_slash == string::npos) ? string(1, '.') :
+    path.substr(0, last_slash == 0 ? 1 : last_slash);
+
+  const int dirfd = ::open(dir.c_str(), O_RDONLY);
+  if (dirfd < 0)
+    return false;
+  const bool retval = (::fsync(dirfd) == 0);
+  ::close(dirfd);
+  return retval;
+}
+
 size_t pws_os::fileLength(std::FILE *fp)
 {
   int fd = fileno(fp);
@@ -11,10 +11,12 @@
  */
 #include <sys/types.h>
 #include <sys/stat.h>  // stat, chmod
+#include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h> // unlink
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cerrno>
 #include <cassert>
 #include <fstream>
@@ -28,6 +30,11 @@
 #include <fnmatch.h>
 #if !defined(__FreeBSD__) && !defined(__OpenBSD__)
 #include <malloc.h> // for free
+
+#ifdef __linux__
+#include <linux/fs.h> // FICLONE
+#include <sys/xattr.h>
+#endif
 #endif
 
 #include "../file.h"
@@ -111,6 +118,48 @@ bool pws_os::RenameFile(const stringT &oldname, const stringT &newname)
     return true;
 }
 
+// Makes to a reflink of from, with from's permissions, if the filesystem
+// can (btrfs, XFS, bcachefs...). to may already exist only if bOverwrite.
+static bool Reflink(const char *from, const char *to, bool bOverwrite)
+{
+#ifdef FICLONE
+  const int src = ::open(from, O_RDONLY);
+  if (src < 0)
+    return false;
+  bool retval = false;
+  struct stat st;
+  if (::fstat(src, &st) == 0) {
+    const int flags = O_WRONLY | O_CREAT | (bOverwrite ? O_TRUNC : O_EXCL);
+    const int dst = ::open(to, flags, st.st_mode & 07777);
+    if (dst >= 0) {
+      retval = (::ioctl(dst, FICLONE, src) == 0);
+      ::close(dst);
+      if (!retval)
+        ::unlink(to);
+    }
+  }
+  ::close(src);
+  return retval;
+#else
+  UNREFERENCED_PARAMETER(from);
+  UNREFERENCED_PARAMETER(to);
+  UNREFERENCED_PARAMETER(bOverwrite);
+  return false;
+#endif
+}
+
+bool pws_os::CloneFile(const stringT &from, const stringT &to)
+{
+  size_t fromN = wcstombs(nullptr, from.c_str(), 0) + 1;
+  std::unique_ptr<char[]> fromfn = std::make_unique<char[]>(fromN);
+  wcstombs(fromfn.get(), from.c_str(), fromN);
+  size_t toN = wcstombs(nullptr, to.c_str(), 0) + 1;
+  std::unique_ptr<char[]> tofn = std::make_unique<char[]>(toN);
+  wcstombs(tofn.get(), to.c_str(), toN);
+
+  return Reflink(fromfn.get(), tofn.get(), false);
+}
+
 bool pws_os::CopyAFile(const stringT &from, const stringT &to)
 {
   const char *szfrom = nullptr;
@@ -139,6 +188,12 @@ bool pws_os::CopyAFile(const stringT &from, const stringT &to)
       start = stop + 1;
     } while (stop != stringT::npos);
 
+    if (Reflink(szfrom, szto, true)) { // free, where the filesystem can
+      delete[] szfrom;
+      delete[] szto;
+      return true;
+    }
+
     ifstream src(szfrom, ios_base::in|ios_base::binary);
     ofstream dst(szto, ios_base::out|ios_base::binary);
     const size_t BUFSIZE = 2048;
@@ -157,6 +212,101 @@ bool pws_os::CopyAFile(const stringT &from, const stringT &to)
   return retval;
 }
 
+bool pws_os::ReplaceAFile(const stringT &from, const stringT &to)
+{
+  size_t fromN = wcstombs(nullptr, from.c_str(), 0) + 1;
+  std::unique_ptr<char[]> fromfn = std::make_unique<char[]>(fromN);
+  wcstombs(fromfn.get(), from.c_str(), fromN);
+  size_t toN = wcstombs(nullptr, to.c_str(), 0) + 1;
+  std::unique_ptr<char[]> tofn = std::make_unique<char[]>(toN);
+  wcstombs(tofn.get(), to.c_str(), toN);
+
+  return ::rename(fromfn.get(), tofn.get()) == 0; // atomic, per POSIX
+}
+
+// Copies from's extended attributes (including any ACL) to the file open
+// on fd. Returns false if any can't be, e.g. security ones.
+static bool CopyXattrs(const char *from, int fd)
+{
+#ifdef __linux__
+  const ssize_t len = ::listxattr(from, nullptr, 0);
+  if (len <= 0)
+    return len == 0 || errno == ENOTSUP;
+  std::vector<char> names(len);
+  if (::listxattr(from, names.data(), names.size()) != len)
+    return false;
+  for (const char *name = names.data(); name < names.data() + len;
+       name += strlen(name) + 1) {
+    const ssize_t vlen = ::getxattr(from, name, nullptr, 0);
+    if (vlen < 0)
+      return false;
+    std::vector<char> value(vlen);
+    if (::getxattr(from, name, value.data(), value.size()) != vlen ||
+        ::fsetxattr(fd, name, value.data(), value.size(), 0) != 0)
+      return false;
+  }
+#else
+  UNREFERENCED_PARAMETER(from);
+  UNREFERENCED_PARAMETER(fd);
+#endif
+  return true;
+}
+
+bool pws_os::CreateReplacement(const stringT &filename, stringT &target,
+                               stringT &tmpname)
+{
+  size_t N = wcstombs(nullptr, filename.c_str(), 0) + 1;
+  std::unique_ptr<char[]> fn = std::make_unique<char[]>(N);
+  wcstombs(fn.get(), filename.c_str(), N);
+
+  // Replace what a symlink points to, not the link
+  string path(fn.get());
+  char *real = ::realpath(fn.get(), nullptr);
+  if (real != nullptr) {
+    path = real;
+    free(real);
+  }
+  const size_t wN = ::mbstowcs(nullptr, path.c_str(), 0) + 1;
+  std::unique_ptr<wchar_t[]> wpath = std::make_unique<wchar_t[]>(wN);
+  ::mbstowcs(wpath.get(), path.c_str(), wN);
+  target = wpath.get();
+  tmpname.clear();
+
+  const string::size_type last_slash = path.find_last_of('/');
+  const string dir = (last_slash == string::npos) ? string(1, '.') :
+    path.substr(0, last_slash == 0 ? 1 : last_slash);
+  if (::access(dir.c_str(), W_OK) != 0)
+    return true; // in place, as we can't add a file there
+
+  struct stat st;
+  const bool exists = (::stat(path.c_str(), &st) == 0);
+  const string tmppath = path + ".tmp";
+  ::unlink(tmppath.c_str()); // left by a crash
+  const int fd = ::open(tmppath.c_str(), O_WRONLY | O_CREAT | O_EXCL,
+                        exists ? (st.st_mode & 07777) : 0600);
+  if (fd < 0)
+    return false;
+
+  bool same = true;
+  if (exists) {
+    // Only root can give a file away - a group we're in is fine
+    if ((st.st_uid != ::geteuid() || ::fchown(fd, -1, st.st_gid) != 0) &&
+        ::fchown(fd, st.st_uid, st.st_gid) != 0)
+      same = false;
+    else if (::fchmod(fd, st.st_mode & 07777) != 0 || // not per umask, nor chown's
+             !CopyXattrs(path.c_str(), fd))
+      same = false;
+  }
+  ::close(fd);
+  if (!same) {
+    ::unlink(tmppath.c_str());
+    return true; // in place, which keeps all that
+  }
+
+  tmpname = target + _T(".tmp");
+  return true;
+}
+
 bool pws_os::DeleteAFile(const stringT &filename)
 {
   size_t fnsize = wcstombs(nullptr, filename.c_str(), 0) + 1;
@@ -409,16 +559,40 @@ std::FILE *pws_os::FOpen(const stringT &filename, const TCHAR *mode)
 int pws_os::FClose(std::FILE *fd, const bool &bIsWrite)
 {
   if (fd != nullptr) {
+    int rc = 0;
     if (bIsWrite) {
-      // Flush the data buffers
-      fflush(fd);
+      // Flush the data buffers, and have the kernel write them to disk,
+      // so that a file renamed into place afterwards is whole after a crash.
+      // EINVAL is for what can't be synced (a pipe as stdout) - no matter.
+      rc = fflush(fd);
+      if (rc == 0 && ::fsync(fileno(fd)) != 0 && errno != EINVAL)
+        rc = EOF;
     }
     // Now close file
-    return fclose(fd);
+    const int crc = fclose(fd);
+    return (rc != 0) ? rc : crc;
   }
   return 0;
 }
 
+bool pws_os::SyncDir(const stringT &filename)
+{
+  size_t N = wcstombs(nullptr, filename.c_str(), 0) + 1;
+  std::unique_ptr<char[]> fn = std::make_unique<char[]>(N);
+  wcstombs(fn.get(), filename.c_str(), N);
+  const string path(fn.get());
+  const string::size_type last_slash = path.find_last_of('/');
+  const string dir = (last_slash == string::npos) ? string(1, '.') :
+    path.substr(0, last_slash == 0 ? 1 : last_slash);
+
+  const int dirfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dirfd < 0)
+    return false;
+  const bool retval = (::fsync(dirfd) == 0);
+  ::close(dirfd);
+  return retval;
+}
+
 size_t pws_os::fileLength(std::FILE *fp)
 {
   if (fp == nullptr)
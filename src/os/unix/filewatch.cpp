@@ -0,0 +1,226 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+/**
+ * \file Linux-specific implementation of filewatch.h, using inotify.
+ * Other Unix flavours (and macOS, which shares this file) get a stub.
+ */
+
+#include "../filewatch.h"
+
+#ifdef __linux__
+#include "../utf8conv.h"
+#include "../debug.h"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <thread>
+
+// How long to wait for things to settle after an event before reporting,
+// so that a save made of many writes (or write + rename) is one change
+static const int SETTLE_MS = 250;
+
+struct st_filewatch_impl {
+  int ifd = -1;
+  int wd = -1;
+  int pipefd[2] = {-1, -1}; // written to on Stop()
+  std::string name; // file name, without the directory
+  PWSFileWatch::ChangeFn fn;
+  std::thread thread;
+  // For HasPending(): bReading is set while events are read from ifd,
+  // bPending from when one for the file is read until fn() has returned
+  std::atomic<bool> bReading{false};
+  std::atomic<bool> bPending{false};
+
+  void Run();
+  bool HasTargetEvent(); // drains the inotify fd
+  void Close();
+};
+
+bool st_filewatch_impl::HasTargetEvent()
+{
+  // Buffer for at least one event with the longest name, suitably aligned
+  alignas(struct inotify_event) char buf[8 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+  bool found = false;
+
+  for (;;) {
+    const ssize_t n = ::read(ifd, buf, sizeof(buf));
+    if (n <= 0)
+      break; // EAGAIN - drained
+
+    for (char *p = buf; p < buf + n; ) {
+      const struct inotify_event *pev = reinterpret_cast<const struct inotify_event *>(p);
+      if (pev->mask & (IN_IGNORED | IN_Q_OVERFLOW))
+        found = true; // directory gone or events lost - assume the worst
+      else if (pev->len > 0 && name == pev->name)
+        found = true;
+      p += sizeof(struct inotify_event) + pev->len;
+    }
+  }
+  return found;
+}
+
+void st_filewatch_impl::Run()
+{
+  bPending = false;
+  for (;;) {
+    struct pollfd fds[2] = {{ifd, POLLIN, 0}, {pipefd[0], POLLIN, 0}};
+    const int rc = ::poll(fds, 2, bPending ? SETTLE_MS : -1);
+    if (rc < 0) {
+      if (errno == EINTR)
+        continue;
+      pws_os::Trace(_T("PWSFileWatch: poll failed: %d\n"), errno);
+      return;
+    }
+    if (fds[1].revents != 0)
+      return; // Stop()
+    if (rc == 0) { // quiet for SETTLE_MS
+      fn();
+      bPending = false;
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      bReading = true;
+      if (HasTargetEvent())
+        bPending = true;
+      bReading = false;
+    }
+  }
+}
+
+void st_filewatch_impl::Close()
+{
+  if (thread.joinable()) {
+    const char c = 0;
+    if (::write(pipefd[1], &c, 1) == 1)
+      thread.join();
+    else
+      thread.detach(); // shouldn't happen, but don't hang
+  }
+  if (ifd != -1)
+    ::close(ifd); // also removes wd
+  for (int &fd : pipefd) {
+    if (fd != -1)
+      ::close(fd);
+    fd = -1;
+  }
+  ifd = wd = -1;
+}
+
+PWSFileWatch::PWSFileWatch()
+  : pImpl(new st_filewatch_impl)
+{
+}
+
+PWSFileWatch::~PWSFileWatch()
+{
+  Stop();
+  delete pImpl;
+}
+
+bool PWSFileWatch::IsSupported()
+{
+  return true;
+}
+
+bool PWSFileWatch::Start(const stringT &filename, ChangeFn fn)
+{
+  Stop();
+
+  // Watch the directory rather than the file, as a file replaced by a
+  // rename is a new inode, which a watch on the old one never hears of
+  const std::string path = pws_os::tomb(filename);
+  const std::string::size_type slash = path.find_last_of('/');
+  const std::string dir = (slash == std::string::npos) ? std::string(".") :
+    (slash == 0 ? std::string("/") : path.substr(0, slash));
+  pImpl->name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+  pImpl->fn = fn;
+
+  pImpl->ifd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (pImpl->ifd == -1)
+    return false;
+
+  pImpl->wd = ::inotify_add_watch(pImpl->ifd, dir.c_str(),
+                                  IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE |
+                                  IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+  if (pImpl->wd == -1 || ::pipe2(pImpl->pipefd, O_CLOEXEC) == -1) {
+    pImpl->Close();
+    return false;
+  }
+
+  pImpl->thread = std::thread(&st_filewatch_impl::Run, pImpl);
+  return true;
+}
+
+void PWSFileWatch::Stop()
+{
+  pImpl->Close();
+}
+
+bool PWSFileWatch::IsWatching() const
+{
+  return pImpl->thread.joinable();
+}
+
+bool PWSFileWatch::HasPending() const
+{
+  if (!IsWatching())
+    return false;
+  // In this order, as the watch thread sets bReading before it drains
+  // ifd and clears it after setting bPending
+  struct pollfd pfd = {pImpl->ifd, POLLIN, 0};
+  if (::poll(&pfd, 1, 0) > 0)
+    return true;
+  return pImpl->bReading || pImpl->bPending;
+}
+
+#else /* !__linux__ */
+
+struct st_filewatch_impl {
+};
+
+PWSFileWatch::PWSFileWatch()
+  : pImpl(nullptr)
+{
+}
+
+PWSFileWatch::~PWSFileWatch()
+{
+}
+
+bool PWSFileWatch::IsSupported()
+{
+  return false;
+}
+
+bool PWSFileWatch::Start(const stringT &, ChangeFn)
+{
+  return false;
+}
+
+void PWSFileWatch::Stop()
+{
+}
+
+bool PWSFileWatch::IsWatching() const
+{
+  return false;
+}
+
+bool PWSFileWatch::HasPending() const
+{
+  return false;
+}
+
+#endif /* __linux__ */
@@ -142,6 +142,47 @@ extern bool pws_os::CopyAFile(const stringT &from, const stringT &to)
   return FileOP(from, to, FO_COPY);
 }
 
+bool pws_os::CloneFile(const stringT &, const stringT &)
+{
+  return false; // not implemented - callers copy or rename instead
+}
+
+bool pws_os::ReplaceAFile(const stringT &from, const stringT &to)
+{
+  // Unlike RenameFile's delete & move, never leaves to missing
+  return MoveFileEx(unquote(from).c_str(), unquote(to).c_str(),
+                    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+bool pws_os::CreateReplacement(const stringT &filename, stringT &target,
+                               stringT &tmpname)
+{
+  target = unquote(filename);
+  tmpname = target + _T(".tmp");
+  DeleteFile(tmpname.c_str()); // left by a crash
+  HANDLE h = CreateFile(tmpname.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW,
+                        FILE_ATTRIBUTE_NORMAL, NULL);
+  if (h == INVALID_HANDLE_VALUE) {
+    const DWORD err = GetLastError();
+    tmpname.clear();
+    return err == ERROR_ACCESS_DENIED; // in place, if the folder's read-only to us
+  }
+  CloseHandle(h);
+
+  // MoveFileEx keeps the new file's security, so give it the old one's
+  DWORD len = 0;
+  GetFileSecurity(target.c_str(), DACL_SECURITY_INFORMATION, NULL, 0, &len);
+  if (len != 0) {
+    std::vector<BYTE> sd(len);
+    if (!GetFileSecurity(target.c_str(), DACL_SECURITY_INFORMATION, sd.data(), len, &len) ||
+        !SetFileSecurity(tmpname.c_str(), DACL_SECURITY_INFORMATION, sd.data())) {
+      DeleteFile(tmpname.c_str());
+      tmpname.clear(); // in place, which keeps it
+    }
+  }
+  return true;
+}
+
 bool pws_os::DeleteAFile(const stringT &filename)
 {
   return DeleteFile(unquote(filename).c_str()) == TRUE;
@@ -450,6 +491,11 @@ int pws_os::FClose(std::FILE *fd, const bool &bIsWrite)
   }
 }
 
+bool pws_os::SyncDir(const stringT &)
+{
+  return true; // NTFS journals renames, there's no syncing a directory
+}
+
 size_t pws_os::fileLength(std::FILE *fp) {
   if (fp != nullptr) {
     auto pos = _ftelli64(fp);
@@ -0,0 +1,51 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+
+/**
+ * \file Windows-specific implementation of filewatch.h - not yet
+ * implemented (ReadDirectoryChangesW would be the way), so callers
+ * fall back to checking the file signature.
+ */
+
+#include "../filewatch.h"
+
+struct st_filewatch_impl {
+};
+
+PWSFileWatch::PWSFileWatch()
+  : pImpl(nullptr)
+{
+}
+
+PWSFileWatch::~PWSFileWatch()
+{
+}
+
+bool PWSFileWatch::IsSupported()
+{
+  return false;
+}
+
+bool PWSFileWatch::Start(const stringT &, ChangeFn)
+{
+  return false;
+}
+
+void PWSFileWatch::Stop()
+{
+}
+
+bool PWSFileWatch::IsWatching() const
+{
+  return false;
+}
+
+bool PWSFileWatch::HasPending() const
+{
+  return false;
+}
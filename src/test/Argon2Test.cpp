@@ -0,0 +1,114 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// Argon2Test.cpp: Unit test for BLAKE2b and Argon2id implementations
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/crypto/argon2.h"
+#include "core/crypto/blake2b.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <string>
+
+namespace {
+  std::string ToHex(const unsigned char *p, size_t n)
+  {
+    static const char digits[] = "0123456789abcdef";
+    std::string retval;
+    for (size_t i = 0; i < n; i++) {
+      retval += digits[p[i] >> 4];
+      retval += digits[p[i] & 0x0f];
+    }
+    return retval;
+  }
+}
+
+TEST(BLAKE2bTest, blake2b_test)
+{
+  static const struct {
+    const char *msg;
+    const char *hash;
+  } tests[] = { // RFC 7693 Appendix A, and the reference implementation
+    { "abc",
+      "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d1"
+      "7d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923" },
+    { "",
+      "786a02f742015903c6c6fd852552d272912f4740e15847618a86e217f71f5419"
+      "d25e1031afee585313896444934eb04b903a685b1448b755d56f701afe9be2ce" },
+  };
+
+  unsigned char tmp[BLAKE2b::MAXHASHLEN];
+  for (size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+    BLAKE2b md;
+    md.Update(reinterpret_cast<const unsigned char *>(tests[i].msg),
+              strlen(tests[i].msg));
+    md.Final(tmp);
+    EXPECT_EQ(tests[i].hash, ToHex(tmp, sizeof(tmp))) << "test vector " << i;
+  }
+}
+
+TEST(BLAKE2bTest, incremental)
+{
+  // Spanning several blocks, including an exact multiple of the block size
+  unsigned char msg[3 * BLAKE2b::BLOCKSIZE];
+  for (size_t i = 0; i < sizeof(msg); i++)
+    msg[i] = static_cast<unsigned char>(i);
+
+  for (size_t len : {size_t(BLAKE2b::BLOCKSIZE), size_t(BLAKE2b::BLOCKSIZE + 1), sizeof(msg)}) {
+    unsigned char h1[32], h2[32];
+    BLAKE2b md1(32), md2(32);
+    md1.Update(msg, len);
+    md1.Final(h1);
+    for (size_t i = 0; i < len; i++)
+      md2.Update(msg + i, 1);
+    md2.Final(h2);
+    EXPECT_EQ(ToHex(h1, sizeof(h1)), ToHex(h2, sizeof(h2))) << "length " << len;
+  }
+}
+
+TEST(Argon2Test, argon2id_test)
+{
+  // RFC 9106 section 5.3
+  unsigned char password[32], salt[16], secret[8], ad[12];
+  memset(password, 0x01, sizeof(password));
+  memset(salt, 0x02, sizeof(salt));
+  memset(secret, 0x03, sizeof(secret));
+  memset(ad, 0x04, sizeof(ad));
+
+  unsigned char tag[32];
+  ASSERT_TRUE(argon2id(password, sizeof(password), salt, sizeof(salt),
+                       3, 32, 4, tag, sizeof(tag),
+                       secret, sizeof(secret), ad, sizeof(ad)));
+  EXPECT_EQ("0d640df58d78766c08c037a34a8b53c9d01ef0452d75b65eb52520e96b01e659",
+            ToHex(tag, sizeof(tag)));
+}
+
+TEST(Argon2Test, argon2id_reference)
+{
+  // From the reference implementation's test suite
+  const unsigned char password[] = "password";
+  const unsigned char salt[] = "somesalt";
+  unsigned char tag[32];
+  ASSERT_TRUE(argon2id(password, 8, salt, 8, 2, 65536, 1, tag, sizeof(tag)));
+  EXPECT_EQ("09316115d5cf24ed5a15a31a3ba326e5cf32edc24702987c02b6566f61913cf7",
+            ToHex(tag, sizeof(tag)));
+}
+
+TEST(Argon2Test, bad_parameters)
+{
+  const unsigned char password[] = "password";
+  const unsigned char salt[] = "somesalt";
+  unsigned char tag[32];
+  EXPECT_FALSE(argon2id(password, 8, salt, 8, 0, 64, 1, tag, sizeof(tag))); // t_cost
+  EXPECT_FALSE(argon2id(password, 8, salt, 8, 1, 31, 4, tag, sizeof(tag))); // m_cost < 8p
+  EXPECT_FALSE(argon2id(password, 8, salt, 8, 1, 64, 0, tag, sizeof(tag))); // parallelism
+  EXPECT_FALSE(argon2id(password, 8, salt, 7, 1, 64, 1, tag, sizeof(tag))); // salt too short
+  EXPECT_FALSE(argon2id(password, 8, salt, 8, 1, 64, 1, tag, 3)); // tag too short
+}
@@ -0,0 +1,181 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// AsyncSaveTest.cpp: Unit test for PWScore background save
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWScore.h"
+#include "os/file.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <filesystem>
+
+namespace {
+  class SaveObserver : public Observer
+  {
+  public:
+    SaveObserver() : ncalls(0), status(-1) {}
+    void DatabaseSaved(const StringX &, int st) override {status = st; ncalls++;}
+
+    std::atomic<int> ncalls;
+    std::atomic<int> status;
+  };
+}
+
+class AsyncSaveTest : public ::testing::Test
+{
+protected:
+  AsyncSaveTest() : fname(_T("asyncsavetest.psafe3")), passkey(_T("Sync0r5wim")) {}
+  void SetUp();
+  void TearDown();
+
+  CItemData MakeItem(const StringX &title);
+
+  const stringT fname;
+  const StringX passkey;
+  PWScore core;
+  SaveObserver observer;
+};
+
+void AsyncSaveTest::SetUp()
+{
+  core.NewFile(passkey);
+  core.SetReadOnly(false);
+  core.RegisterObserver(&observer);
+  core.Execute(AddEntryCommand::Create(&core, MakeItem(_T("first"))));
+}
+
+void AsyncSaveTest::TearDown()
+{
+  core.FinishAsyncSave();
+  core.UnregisterObserver(&observer);
+  pws_os::DeleteAFile(fname);
+}
+
+CItemData AsyncSaveTest::MakeItem(const StringX &title)
+{
+  CItemData ci;
+  ci.CreateUUID();
+  ci.SetTitle(title);
+  ci.SetPassword(_T("password"));
+  return ci;
+}
+
+TEST_F(AsyncSaveTest, Save)
+{
+  ASSERT_TRUE(core.HasDBChanged());
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFileAsync(fname.c_str(), PWSfile::V30));
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(core.IsSaveInProgress());
+  EXPECT_EQ(1, observer.ncalls);
+  EXPECT_EQ(PWScore::SUCCESS, observer.status);
+  EXPECT_FALSE(core.HasDBChanged());
+  EXPECT_FALSE(pws_os::FileExists(fname + _T(".tmp")));
+
+  PWScore core2;
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(1U, core2.GetNumEntries());
+
+  // Nothing pending - nothing to do
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_EQ(1, observer.ncalls);
+}
+
+TEST_F(AsyncSaveTest, ChangedWhileSaving)
+{
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFileAsync(fname.c_str(), PWSfile::V30));
+  // Goes into the database, but not into the save in progress
+  core.Execute(AddEntryCommand::Create(&core, MakeItem(_T("second"))));
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_TRUE(core.HasDBChanged());
+  EXPECT_EQ(2U, core.GetNumEntries());
+
+  PWScore core2;
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(1U, core2.GetNumEntries());
+
+  // Next save picks it up
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFileAsync(fname.c_str(), PWSfile::V30));
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(core.HasDBChanged());
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(2U, core2.GetNumEntries());
+}
+
+TEST_F(AsyncSaveTest, Failures)
+{
+  // Exports stay synchronous
+  EXPECT_EQ(PWScore::FAILURE, core.WriteFileAsync(fname.c_str(), PWSfile::V20));
+  EXPECT_FALSE(core.IsSaveInProgress());
+
+  const StringX badname(_T("no-such-dir/asyncsavetest.psafe3"));
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFileAsync(badname, PWSfile::V30));
+  EXPECT_NE(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_EQ(1, observer.ncalls);
+  EXPECT_NE(PWScore::SUCCESS, observer.status);
+  EXPECT_TRUE(core.HasDBChanged());
+  EXPECT_FALSE(pws_os::FileExists(badname.c_str()));
+
+  // Still reported when something else had to wait for it
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFileAsync(badname, PWSfile::V30));
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V30));
+  EXPECT_NE(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave()); // but only once
+}
+
+TEST_F(AsyncSaveTest, SyncSaveIsAllOrNothing)
+{
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V30));
+  core.Execute(AddEntryCommand::Create(&core, MakeItem(_T("second"))));
+
+  // Can't write the temporary file - the saved one is untouched
+  const stringT tmpname = fname + _T(".tmp");
+  ASSERT_TRUE(std::filesystem::create_directory(tmpname));
+  EXPECT_NE(PWScore::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V30));
+  std::filesystem::remove(tmpname);
+  PWScore core2;
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(1U, core2.GetNumEntries());
+
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V30));
+  EXPECT_FALSE(pws_os::FileExists(tmpname));
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(2U, core2.GetNumEntries());
+}
+
+#ifndef WIN32
+TEST_F(AsyncSaveTest, SaveKeepsLinkAndPermissions)
+{
+  namespace fs = std::filesystem;
+  const stringT linkname(_T("asyncsavetest-link.psafe3"));
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V30));
+  fs::permissions(fname, fs::perms::owner_read | fs::perms::owner_write |
+                  fs::perms::group_read);
+  fs::create_symlink(fname, linkname);
+
+  // Both ways of saving replace the file linked to, and not the link
+  core.Execute(AddEntryCommand::Create(&core, MakeItem(_T("second"))));
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFile(linkname.c_str(), PWSfile::V30));
+  core.Execute(AddEntryCommand::Create(&core, MakeItem(_T("third"))));
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFileAsync(linkname.c_str(), PWSfile::V30));
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+
+  EXPECT_TRUE(fs::is_symlink(linkname));
+  EXPECT_EQ(fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read,
+            fs::status(fname).permissions());
+  EXPECT_FALSE(pws_os::FileExists(fname + _T(".tmp")));
+  PWScore core2;
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(3U, core2.GetNumEntries());
+  fs::remove(linkname);
+}
+#endif
@@ -121,6 +121,94 @@ TEST_F(CommandsTest,DeleteEntryWithAttachment)
   core.ClearCommands();
 }
 
+TEST_F(CommandsTest, SharedAttachment)
+{
+  PWScore core;
+  const unsigned char content[] = "-----BEGIN CERTIFICATE-----\nMIIB...\n";
+  CItemAtt ai1, ai2;
+  ai1.CreateUUID();
+  ai1.SetTitle(L"server cert");
+  ai1.SetContent(content, sizeof(content));
+  ai2 = ai1;
+  ai2.CreateUUID(); // same attachment, added to another entry
+  ai2.SetCTime(1665220859);
+
+  CItemData ci1, ci2;
+  ci1.CreateUUID();
+  ci1.SetTitle(L"web01");
+  ci1.SetPassword(L"pass1");
+  ci2.CreateUUID();
+  ci2.SetTitle(L"web02");
+  ci2.SetPassword(L"pass2");
+
+  core.Execute(AddEntryCommand::Create(&core, ci1, pws_os::CUUID::NullUUID(), &ai1));
+  core.Execute(AddEntryCommand::Create(&core, ci2, pws_os::CUUID::NullUUID(), &ai2));
+  EXPECT_FALSE(core.HasAtt(ai2.GetUUID()));
+  const CItemData &ci2_shared = core.GetEntry(core.Find(ci2.GetUUID()));
+  EXPECT_EQ(ai1.GetUUID(), ci2_shared.GetAttUUID());
+  EXPECT_EQ(2U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+
+  // Deleting one entry's attachment leaves the other's
+  core.Execute(DeleteAttachmentCommand::Create(&core, ci2_shared));
+  ASSERT_TRUE(core.HasAtt(ai1.GetUUID()));
+  EXPECT_EQ(1U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+  core.Undo();
+  EXPECT_EQ(2U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+
+  core.Undo(); // adding ci2
+  EXPECT_EQ(1U, core.GetNumEntries());
+  EXPECT_EQ(1U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+  core.Redo();
+  EXPECT_EQ(2U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+
+  // Different title - not shared
+  CItemAtt ai3(ai1);
+  ai3.CreateUUID();
+  ai3.SetTitle(L"another cert");
+  EXPECT_FALSE(ai3.IsDuplicateOf(ai1));
+  pws_os::CUUID uuid;
+  EXPECT_FALSE(core.FindAttByContent(ai3, uuid));
+  ai3.SetTitle(L"server cert");
+  EXPECT_TRUE(core.FindAttByContent(ai3, uuid));
+  EXPECT_EQ(ai1.GetUUID(), uuid);
+
+  // Editing one entry's attachment leaves the other's as is
+  const CItemAtt shared_att = core.GetAtt(ai1.GetUUID());
+  CItemAtt edited_att(shared_att);
+  edited_att.SetTitle(L"renamed cert");
+  auto *editcmd = EditAttachmentCommand::Create(&core, shared_att, edited_att,
+                                                &core.GetEntry(core.Find(ci2.GetUUID())));
+  core.Execute(editcmd);
+  const pws_os::CUUID copy_uuid = editcmd->GetAttUUID();
+  ASSERT_NE(ai1.GetUUID(), copy_uuid);
+  EXPECT_EQ(copy_uuid, core.GetEntry(core.Find(ci2.GetUUID())).GetAttUUID());
+  EXPECT_EQ(ai1.GetUUID(), core.GetEntry(core.Find(ci1.GetUUID())).GetAttUUID());
+  EXPECT_EQ(L"server cert", core.GetAtt(ai1.GetUUID()).GetTitle());
+  EXPECT_EQ(L"renamed cert", core.GetAtt(copy_uuid).GetTitle());
+  EXPECT_EQ(1U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+  EXPECT_EQ(1U, core.GetAtt(copy_uuid).GetRefcount());
+  EXPECT_EQ(2U, core.GetNumAtts());
+
+  core.Undo();
+  EXPECT_FALSE(core.HasAtt(copy_uuid));
+  EXPECT_EQ(ai1.GetUUID(), core.GetEntry(core.Find(ci2.GetUUID())).GetAttUUID());
+  EXPECT_EQ(2U, core.GetAtt(ai1.GetUUID()).GetRefcount());
+  core.Redo();
+  EXPECT_EQ(copy_uuid, core.GetEntry(core.Find(ci2.GetUUID())).GetAttUUID());
+  EXPECT_EQ(L"renamed cert", core.GetAtt(copy_uuid).GetTitle());
+
+  // No longer shared, so edited in place
+  edited_att = core.GetAtt(ai1.GetUUID());
+  edited_att.SetTitle(L"web01 cert");
+  editcmd = EditAttachmentCommand::Create(&core, core.GetAtt(ai1.GetUUID()), edited_att,
+                                          &core.GetEntry(core.Find(ci1.GetUUID())));
+  core.Execute(editcmd);
+  EXPECT_EQ(ai1.GetUUID(), editcmd->GetAttUUID());
+  EXPECT_EQ(L"web01 cert", core.GetAtt(ai1.GetUUID()).GetTitle());
+
+  core.ClearCommands();
+}
+
 TEST_F(CommandsTest, CreateShortcutEntry)
 {
   PWScore core;
@@ -375,6 +463,9 @@ TEST_F(CommandsTest, UpdatePassword)
   iter = core.Find(it.GetUUID());
   CItemData it4(core.GetEntry(iter));
   EXPECT_EQ(it4.GetPassword(), sxOldPassword);
+  time_t tUndoPMtime;
+  it4.GetPMTime(tUndoPMtime);
+  EXPECT_EQ(tPMtime, tUndoPMtime);
 
   {
     PWHistList pwhl(it4.GetPWHistory(), PWSUtil::TMC_ASC_UNKNOWN);
@@ -391,8 +482,8 @@ TEST_F(CommandsTest, UpdatePassword)
   CItemData it5(core.GetEntry(iter));
   EXPECT_EQ(it5.GetPassword(), sxNewPassword);
 
-  // New password change time is that of when Redo is performed & not original time
-  it5.GetPMTime(tPMtime);
+  // Redo restores the entry as the change left it, including its history
+  EXPECT_EQ(it3, it5);
 
   {
     PWHistList pwhl(it5.GetPWHistory(), PWSUtil::TMC_ASC_UNKNOWN);
@@ -447,3 +538,100 @@ TEST_F(CommandsTest, UpdateEntry)
   // Get core to delete any existing commands
   core.ClearCommands();
 }
+
+TEST_F(CommandsTest, EditEntryUndoRedo)
+{
+  PWScore core;
+  CItemData it;
+  it.CreateUUID();
+  it.SetGroup(L"Old.Group");
+  it.SetTitle(L"Sh1ftyTitle");
+  it.SetUser(L"someone");
+  it.SetPassword(L"Unch4ngedPassw0rd");
+  it.SetNotes(L"These notes go away");
+
+  core.Execute(AddEntryCommand::Create(&core, it));
+
+  CItemData it2(it);
+  it2.SetGroup(L"New.Group");
+  it2.SetTitle(L"Sh1ftierTitle");
+  it2.SetNotes(L"");
+  it2.SetURL(L"https://example.com/");
+  it2.SetProtected(true);
+
+  Command *pcmd = EditEntryCommand::Create(&core, it, it2);
+  core.Execute(pcmd);
+  // Only what changed is kept, not two copies of the entry
+  EXPECT_LT(pcmd->GetMemoryUsage(), 2 * it.GetMemoryUsage());
+
+  ItemListConstIter iter = core.Find(it.GetUUID());
+  ASSERT_NE(core.GetEntryEndIter(), iter);
+  EXPECT_EQ(it2, core.GetEntry(iter));
+
+  for (int i = 0; i < 2; i++) {
+    core.Undo();
+    iter = core.Find(it.GetUUID());
+    EXPECT_EQ(it, core.GetEntry(iter));
+    EXPECT_EQ(1, core.GetNumEntries());
+
+    core.Redo();
+    iter = core.Find(it.GetUUID());
+    EXPECT_EQ(it2, core.GetEntry(iter));
+    EXPECT_EQ(L"New.Group", core.GetEntry(iter).GetGroup());
+  }
+
+  core.ClearCommands();
+}
+
+TEST_F(CommandsTest, UndoMemoryLimit)
+{
+  PWScore core;
+  CItemData it;
+  it.CreateUUID();
+  it.SetTitle(L"Ed1tedOften");
+  it.SetPassword(L"Passw0rd");
+
+  core.Execute(AddEntryCommand::Create(&core, it));
+  const size_t addUsage = core.GetUndoMemoryUsage();
+  EXPECT_GT(addUsage, 0U);
+
+  core.SetUndoMemoryLimit(addUsage * 3);
+  for (int i = 0; i < 20; i++) {
+    CItemData before(core.GetEntry(core.Find(it.GetUUID())));
+    CItemData after(before);
+    after.SetNotes(StringX(L"Revision ") + std::to_wstring(i).c_str());
+    core.Execute(EditEntryCommand::Create(&core, before, after));
+    EXPECT_LE(core.GetUndoMemoryUsage(), core.GetUndoMemoryLimit());
+  }
+
+  // The oldest changes were dropped, the latest can still be undone
+  int nundo = 0;
+  while (core.AnyToUndo()) {
+    core.Undo();
+    nundo++;
+  }
+  EXPECT_GT(nundo, 0);
+  EXPECT_LT(nundo, 20);
+  EXPECT_EQ(1, core.GetNumEntries());
+  EXPECT_EQ(StringX(L"Revision ") + std::to_wstring(19 - nundo).c_str(),
+            core.GetEntry(core.Find(it.GetUUID())).GetNotes());
+
+  // Even with a limit no command fits in, the latest is kept
+  while (core.AnyToRedo())
+    core.Redo();
+  core.SetUndoMemoryLimit(1);
+  EXPECT_TRUE(core.AnyToUndo());
+  core.Undo();
+  EXPECT_FALSE(core.AnyToUndo());
+
+  // The running total follows what's dropped: only the new command's left
+  CItemData it2(it);
+  it2.CreateUUID();
+  core.Execute(AddEntryCommand::Create(&core, it2));
+  EXPECT_FALSE(core.AnyToRedo());
+  EXPECT_GT(core.GetUndoMemoryUsage(), 0U);
+  EXPECT_LT(core.GetUndoMemoryUsage(), addUsage * 2);
+
+  core.ClearCommands();
+  EXPECT_EQ(0U, core.GetUndoMemoryUsage());
+}
@@ -0,0 +1,112 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// DeflateTest.cpp: Unit test for DEFLATE compression of attachments
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/Deflate.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <string>
+
+namespace {
+  std::string Sample()
+  {
+    std::string s;
+    for (int i = 0; i < 20; i++)
+      s += "Password Safe stores attachments. ";
+    for (int i = 0; i < 10; i++)
+      s += "The quick brown fox jumps over the lazy dog.\n";
+    return s;
+  }
+
+  bool RoundTrip(const std::vector<unsigned char> &data, size_t *packedLen = nullptr)
+  {
+    std::vector<unsigned char> packed;
+    if (!PWSDeflate::Compress(data.data(), data.size(), packed))
+      return false;
+    if (packedLen != nullptr)
+      *packedLen = packed.size();
+    std::vector<unsigned char> unpacked(data.size());
+    return PWSDeflate::Decompress(packed.data(), packed.size(),
+                                  unpacked.data(), unpacked.size()) &&
+      unpacked == data;
+  }
+}
+
+TEST(DeflateTest, RoundTrip)
+{
+  const std::string s = Sample();
+  std::vector<unsigned char> text(s.begin(), s.end());
+  size_t packedLen = 0;
+  EXPECT_TRUE(RoundTrip(text, &packedLen));
+  EXPECT_LT(packedLen * 5, text.size());
+
+  // Longest matches, and distances beyond the window
+  std::vector<unsigned char> zeros(100000, 0);
+  EXPECT_TRUE(RoundTrip(zeros));
+  std::vector<unsigned char> mixed;
+  unsigned x = 12345;
+  for (int i = 0; i < 70000; i++) {
+    x = x * 1103515245 + 12345;
+    mixed.push_back(static_cast<unsigned char>((i % 40000 < 100) ? 'a' : (x >> 24) % 4));
+  }
+  EXPECT_TRUE(RoundTrip(mixed));
+}
+
+TEST(DeflateTest, Incompressible)
+{
+  std::vector<unsigned char> noise;
+  unsigned x = 1;
+  for (int i = 0; i < 4096; i++) {
+    x = x * 1103515245 + 12345;
+    noise.push_back(static_cast<unsigned char>(x >> 24));
+  }
+  std::vector<unsigned char> packed;
+  EXPECT_FALSE(PWSDeflate::Compress(noise.data(), noise.size(), packed));
+  EXPECT_TRUE(packed.empty());
+  const unsigned char two[] = {1, 2};
+  EXPECT_FALSE(PWSDeflate::Compress(two, sizeof(two), packed));
+}
+
+TEST(DeflateTest, Inflate)
+{
+  // From zlib, level 9 (dynamic Huffman codes) and level 0 (stored)
+  static const unsigned char dynamic[] = {
+    0xed, 0xca, 0xb9, 0x11, 0x80, 0x30, 0x0c, 0x04, 0xc0, 0x9c, 0x2a, 0xae,
+    0x02, 0x6a, 0xf1, 0x0c, 0x34, 0x20, 0xb0, 0xcc, 0x8f, 0xc0, 0x12, 0x6f,
+    0xf5, 0xd0, 0x05, 0x04, 0x8e, 0x77, 0x1d, 0xa9, 0x1e, 0x12, 0x3d, 0x0a,
+    0x0a, 0x0c, 0x35, 0x89, 0xac, 0x20, 0x33, 0xaa, 0xdb, 0x89, 0x67, 0xd3,
+    0x1c, 0x2e, 0x8d, 0x34, 0x3e, 0x1f, 0x65, 0xcb, 0x58, 0xb7, 0xae, 0x1e,
+    0x50, 0x45, 0x39, 0x66, 0x04, 0x39, 0xd1, 0x6f, 0xd3, 0xa2, 0x90, 0x9d,
+    0x23, 0xec, 0xe5, 0x91, 0xee, 0x0b, 0x5e, 0x9a, 0x3c, 0x4b, 0xf9, 0x87,
+    0xf9, 0x01};
+  static const unsigned char stored[] = {
+    0x01, 0x07, 0x00, 0xf8, 0xff, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x21};
+
+  const std::string s = Sample();
+  std::vector<unsigned char> out(s.size());
+  ASSERT_TRUE(PWSDeflate::Decompress(dynamic, sizeof(dynamic), out.data(), out.size()));
+  EXPECT_EQ(0, memcmp(out.data(), s.data(), s.size()));
+
+  unsigned char buf[7];
+  ASSERT_TRUE(PWSDeflate::Decompress(stored, sizeof(stored), buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "stored!", 7));
+
+  // Wrong length, truncated or corrupt input
+  EXPECT_FALSE(PWSDeflate::Decompress(stored, sizeof(stored), buf, 6));
+  EXPECT_FALSE(PWSDeflate::Decompress(dynamic, sizeof(dynamic), out.data(), out.size() + 1));
+  EXPECT_FALSE(PWSDeflate::Decompress(dynamic, sizeof(dynamic) - 10, out.data(), out.size()));
+  unsigned char bad[sizeof(dynamic)];
+  memcpy(bad, dynamic, sizeof(bad));
+  bad[0] ^= 0x06; // block type 3
+  EXPECT_FALSE(PWSDeflate::Decompress(bad, sizeof(bad), out.data(), out.size()));
+}
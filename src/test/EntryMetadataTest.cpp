@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// EntryMetadataTest.cpp: Unit test for CEntryMetadata and its upkeep by PWScore
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWScore.h"
+#include "core/EntryMetadata.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+class EntryMetadataTest : public ::testing::Test
+{
+protected:
+  EntryMetadataTest() {}
+  void SetUp();
+
+  CItemData ci1, ci2, ci3;
+  const time_t t1 = 1000000000, t2 = 1200000000;
+};
+
+void EntryMetadataTest::SetUp()
+{
+  ci1.CreateUUID();
+  ci1.SetGroup(L"Work");
+  ci1.SetTitle(L"Mail");
+  ci1.SetUser(L"jdoe");
+  ci1.SetPassword(L"secret-one");
+  ci1.SetCTime(t1);
+  ci1.SetXTime(t2);
+  ci1.SetPolicyName(L"Strong");
+
+  ci2.CreateUUID();
+  ci2.SetGroup(L"Home");
+  ci2.SetTitle(L"Router");
+  ci2.SetUser(L"admin");
+  ci2.SetPassword(L"secret-two");
+  ci2.SetCTime(t2);
+
+  ci3.CreateUUID();
+  ci3.SetGroup(L"Work");
+  ci3.SetTitle(L"Mai");
+  ci3.SetUser(L"ljdoe");
+  ci3.SetPassword(L"secret-three");
+  ci3.SetCTime(t1);
+  ci3.SetPolicyName(L"Strong");
+}
+
+static bool Contains(const UUIDVector &v, const pws_os::CUUID &uuid)
+{
+  return std::find(v.begin(), v.end(), uuid) != v.end();
+}
+
+TEST_F(EntryMetadataTest, Basics)
+{
+  CEntryMetadata md;
+  md.Add(ci1);
+  md.Add(ci2);
+  md.Add(ci3);
+  EXPECT_EQ(3U, md.size());
+
+  time_t t;
+  EXPECT_TRUE(md.GetTime(ci2.GetUUID(), CItemData::CTIME, t));
+  EXPECT_EQ(t2, t);
+  EXPECT_FALSE(md.GetTime(ci2.GetUUID(), CItemData::TITLE, t));
+
+  UUIDVector v;
+  md.FindByTime(CItemData::XTIME, 0, 0, PWSMatch::MR_PRESENT, v);
+  ASSERT_EQ(1U, v.size());
+  EXPECT_EQ(ci1.GetUUID(), v[0]);
+
+  v.clear();
+  md.FindByGTU(L"Work", L"Mail", L"jdoe", v);
+  EXPECT_TRUE(Contains(v, ci1.GetUUID()));
+  EXPECT_FALSE(Contains(v, ci3.GetUUID())); // same characters, different split
+
+  v.clear();
+  md.FindByPolicyName(L"Strong", v);
+  EXPECT_EQ(2U, v.size());
+  EXPECT_FALSE(Contains(v, ci2.GetUUID()));
+
+  // Removal swaps the last row in - make sure it's still found
+  md.Remove(ci1.GetUUID());
+  EXPECT_EQ(2U, md.size());
+  EXPECT_FALSE(md.Has(ci1.GetUUID()));
+  EXPECT_TRUE(md.GetTime(ci3.GetUUID(), CItemData::CTIME, t));
+  EXPECT_EQ(t1, t);
+
+  ci2.SetTitle(L"Modem");
+  md.Update(ci2);
+  EXPECT_EQ(2U, md.size());
+  v.clear();
+  md.FindByGTU(L"Home", L"Modem", L"admin", v);
+  EXPECT_TRUE(Contains(v, ci2.GetUUID()));
+}
+
+TEST_F(EntryMetadataTest, CoreAndCommands)
+{
+  PWScore core;
+  core.Execute(AddEntryCommand::Create(&core, ci1));
+  core.Execute(AddEntryCommand::Create(&core, ci2));
+  EXPECT_EQ(2U, core.GetEntryMetadata().size());
+
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"Home", L"Router", L"admin"));
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"Home", L"Router", L"root"));
+
+  core.Execute(UpdateEntryCommand::Create(&core, ci2, CItemData::TITLE, L"Modem"));
+  CItemData::EntryStatus es;
+  EXPECT_TRUE(core.GetEntryMetadata().GetStatus(ci2.GetUUID(), es));
+  EXPECT_EQ(CItemData::ES_MODIFIED, es);
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"Home", L"Router", L"admin"));
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"Home", L"Modem", L"admin"));
+
+  core.Undo();
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"Home", L"Router", L"admin"));
+
+  std::vector<st_GroupTitleUser> ventries;
+  EXPECT_TRUE(core.GetEntriesUsingNamedPasswordPolicy(L"Strong", ventries));
+  ASSERT_EQ(1U, ventries.size());
+  EXPECT_EQ(L"Mail", ventries[0].title);
+
+  core.Execute(DeleteEntryCommand::Create(&core, ci1));
+  EXPECT_EQ(1U, core.GetEntryMetadata().size());
+  EXPECT_FALSE(core.GetEntryMetadata().Has(ci1.GetUUID()));
+
+  core.Undo();
+  EXPECT_TRUE(core.GetEntryMetadata().Has(ci1.GetUUID()));
+
+  core.ClearCommands();
+  core.ClearDBData();
+  EXPECT_EQ(0U, core.GetEntryMetadata().size());
+}
+
+TEST_F(EntryMetadataTest, ChangedInPlace)
+{
+  PWScore core;
+  core.Execute(AddEntryCommand::Create(&core, ci1));
+  core.Execute(AddEntryCommand::Create(&core, ci2));
+
+  // As the UI may, without RefreshEntryMetadata()
+  ItemListIter iter = core.Find(ci2.GetUUID());
+  ASSERT_NE(core.GetEntryEndIter(), iter);
+  iter->second.SetTitle(L"Modem");
+  iter->second.SetPolicyName(L"Strong");
+  ASSERT_TRUE(core.GetEntryMetadata().size() == core.GetNumEntries());
+
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"Home", L"Modem", L"admin"));
+  std::vector<st_GroupTitleUser> ventries;
+  EXPECT_TRUE(core.GetEntriesUsingNamedPasswordPolicy(L"Strong", ventries));
+  EXPECT_EQ(2U, ventries.size());
+}
@@ -17,6 +17,8 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 // A fixture for factoring common code across tests
 class FileEncDecTest : public ::testing::Test
 {
@@ -123,6 +125,85 @@ TEST_F(FileEncDecTest, BigFile)
   PWSfile::fileThresholdSize = oldThreshold;
 }
 
+// Pipelined and block at a time en/decryption must produce the same
+// format, for files spanning several pipeline buffers & an uneven last block
+TEST_F(FileEncDecTest, Pipelined)
+{
+  const stringT plainFile(L"PipelineTest");
+  const stringT cipherFile = plainFile + suffix;
+  std::vector<unsigned char> data(1000 * 1000 + 13);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<unsigned char>(i * 7 + (i >> 8));
+
+  PWSfile::CryptOptions pipelined, blockwise;
+  pipelined.bufferSize = 256 * 1024; // with 4 threads, one per 64KB
+  pipelined.nThreads = 4;
+  blockwise.bPipelined = false;
+
+  auto oldThreshold = PWSfile::fileThresholdSize;
+  for (int big = 0; big < 2; big++) { // BlowFish, then TwoFish
+    PWSfile::fileThresholdSize = big ? 100000 : oldThreshold;
+    for (int encPipelined = 0; encPipelined < 2; encPipelined++) {
+      auto fp = pws_os::FOpen(plainFile, L"wb");
+      ASSERT_TRUE(fp != nullptr);
+      ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), fp));
+      ASSERT_EQ(0, pws_os::FClose(fp, true));
+
+      PWSfile::CryptStats stats;
+      EXPECT_TRUE(PWSfile::Encrypt(plainFile, passphrase, errmes,
+                                   encPipelined ? pipelined : blockwise, &stats));
+      EXPECT_EQ(data.size(), stats.nBytes);
+      ASSERT_TRUE(pws_os::DeleteAFile(plainFile));
+
+      EXPECT_TRUE(PWSfile::Decrypt(cipherFile, passphrase, errmes,
+                                   encPipelined ? blockwise : pipelined, &stats));
+      EXPECT_EQ(data.size(), stats.nBytes);
+      EXPECT_EQ(encPipelined ? 1U : 4U, stats.nThreads);
+
+      fp = pws_os::FOpen(plainFile, L"rb");
+      ASSERT_TRUE(fp != nullptr);
+      std::vector<unsigned char> decrypted(data.size() + 1);
+      EXPECT_EQ(data.size(), fread(decrypted.data(), 1, decrypted.size(), fp));
+      pws_os::FClose(fp, false);
+      decrypted.resize(data.size());
+      EXPECT_TRUE(decrypted == data) << "big " << big << ", pipelined encryption " << encPipelined;
+
+      ASSERT_TRUE(pws_os::DeleteAFile(plainFile));
+      ASSERT_TRUE(pws_os::DeleteAFile(cipherFile));
+    }
+  }
+  PWSfile::fileThresholdSize = oldThreshold;
+}
+
+TEST_F(FileEncDecTest, PipelinedTruncated)
+{
+  const stringT plainFile(L"PipelineTest");
+  const stringT cipherFile = plainFile + suffix;
+  std::vector<unsigned char> data(100000, 'x');
+
+  auto fp = pws_os::FOpen(plainFile, L"wb");
+  ASSERT_TRUE(fp != nullptr);
+  ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), fp));
+  ASSERT_EQ(0, pws_os::FClose(fp, true));
+  EXPECT_TRUE(PWSfile::Encrypt(plainFile, passphrase, errmes));
+
+  // Chop off the last few blocks
+  fp = pws_os::FOpen(cipherFile, L"rb");
+  ASSERT_TRUE(fp != nullptr);
+  std::vector<unsigned char> ct(pws_os::fileLength(fp));
+  ASSERT_EQ(ct.size(), fread(ct.data(), 1, ct.size(), fp));
+  pws_os::FClose(fp, false);
+  fp = pws_os::FOpen(cipherFile, L"wb");
+  ASSERT_TRUE(fp != nullptr);
+  ASSERT_EQ(ct.size() - 64, fwrite(ct.data(), 1, ct.size() - 64, fp));
+  ASSERT_EQ(0, pws_os::FClose(fp, true));
+
+  EXPECT_FALSE(PWSfile::Decrypt(cipherFile, passphrase, errmes));
+
+  ASSERT_TRUE(pws_os::DeleteAFile(plainFile));
+  ASSERT_TRUE(pws_os::DeleteAFile(cipherFile));
+}
+
 void FileEncDecTest::TestFile(const stringT& testfile)
 {
   const stringT originalTestFile = testfile; 
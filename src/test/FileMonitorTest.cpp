@@ -0,0 +1,110 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// FileMonitorTest.cpp: Unit test for PWSFileSig and CFileMonitor
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/FileMonitor.h"
+#include "core/PWSfile.h"
+#include "os/file.h"
+#include "os/sleep.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <string>
+
+class FileMonitorTest : public ::testing::Test
+{
+protected:
+  FileMonitorTest() : fname(_T("monitortest.dat")) {}
+  void SetUp() {Write(std::string(5000, 'a'));}
+  void TearDown() {pws_os::DeleteAFile(fname);}
+
+  void Write(const std::string &data)
+  {
+    FILE *fp = pws_os::FOpen(fname, _T("wb"));
+    ASSERT_NE(nullptr, fp);
+    fwrite(data.data(), 1, data.size(), fp);
+    fclose(fp);
+  }
+
+  // Change is reported asynchronously - give it a while
+  bool WaitForChange(const CFileMonitor &fm)
+  {
+    for (int i = 0; i < 100 && !fm.HasChanged(); i++)
+      pws_os::sleep_ms(50);
+    return fm.HasChanged();
+  }
+
+  const stringT fname;
+};
+
+TEST_F(FileMonitorTest, FullSig)
+{
+  const PWSFileSig head(fname), full(fname, true);
+  EXPECT_TRUE(full.IsValid());
+  EXPECT_TRUE(full.IsFullFile());
+  EXPECT_FALSE(head == full); // different kinds never match
+
+  // Change in the middle - only the full signature notices
+  std::string data(5000, 'a');
+  data[2500] = 'b';
+  Write(data);
+  EXPECT_TRUE(PWSFileSig(fname) == head);
+  EXPECT_FALSE(PWSFileSig(fname, true) == full);
+
+  EXPECT_FALSE(PWSFileSig(_T("no-such-file.dat"), true).IsValid());
+}
+
+TEST_F(FileMonitorTest, Watch)
+{
+  if (!PWSFileWatch::IsSupported())
+    GTEST_SKIP() << "No file watch on this platform";
+
+  for (const bool bFullSig : {false, true}) {
+    std::atomic<int> ncalls(0);
+    CFileMonitor fm;
+    ASSERT_TRUE(fm.Start(fname, bFullSig, [&ncalls]() {ncalls++;}));
+    EXPECT_TRUE(fm.IsActive());
+    EXPECT_FALSE(fm.HasChanged());
+
+    // Give the full signature baseline time to finish
+    pws_os::sleep_ms(300);
+
+    // Same contents rewritten isn't a change
+    Write(std::string(5000, 'a'));
+    pws_os::sleep_ms(600);
+    EXPECT_FALSE(fm.HasChanged());
+
+    Write(std::string(6000, 'c'));
+    EXPECT_TRUE(WaitForChange(fm));
+    // HasChanged() can tell before the watch thread calls back
+    for (int i = 0; i < 100 && ncalls == 0; i++)
+      pws_os::sleep_ms(50);
+    fm.Stop();
+    EXPECT_FALSE(fm.IsActive());
+    EXPECT_EQ(1, ncalls);
+
+    Write(std::string(5000, 'a'));
+  }
+}
+
+TEST_F(FileMonitorTest, ChangeNotYetSettled)
+{
+  if (!PWSFileWatch::IsSupported())
+    GTEST_SKIP() << "No file watch on this platform";
+
+  CFileMonitor fm;
+  ASSERT_TRUE(fm.Start(fname, false));
+  // Changed just before asking - well inside the watch's settling time
+  Write(std::string(6000, 'c'));
+  EXPECT_TRUE(fm.HasChanged());
+}
@@ -280,6 +280,103 @@ TEST_F(FileV3Test, V4Extension)
   ASSERT_EQ(0, std::rename("V3test.psafe4", "V3test.psafe3"));
 }
 
+TEST_F(FileV3Test, KeyMaterialTest)
+{
+  PWSKeyMaterial km1, km2, km3;
+  {
+    PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    ASSERT_TRUE(fw.GetKeyMaterial(km1));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  EXPECT_TRUE(km1.Matches(PWSfile::V30, MIN_HASH_ITERATIONS));
+  {
+    PWSfileV3 fr(fname.c_str(), PWSfile::Read, PWSfile::V30);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+    ASSERT_TRUE(fr.GetKeyMaterial(km2));
+    EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+  EXPECT_EQ(0, memcmp(km1.m_salt, km2.m_salt, sizeof(km1.m_salt)));
+  EXPECT_EQ(0, memcmp(km1.m_key, km2.m_key, sizeof(km1.m_key)));
+
+  // Write reusing what was read - same salt, still readable
+  {
+    PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+    fw.SetNHashIters(km2.m_nHashIters);
+    fw.SetKeyMaterial(&km2);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+    ASSERT_TRUE(fw.GetKeyMaterial(km3));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  EXPECT_EQ(0, memcmp(km2.m_salt, km3.m_salt, sizeof(km2.m_salt)));
+  {
+    PWSfileV3 fr(fname.c_str(), PWSfile::Read, PWSfile::V30);
+    EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr.Open(_T("x")));
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+    EXPECT_EQ(fullItem, item);
+    EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+
+  // Different number of iterations - ignored
+  {
+    PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+    fw.SetNHashIters(km2.m_nHashIters + 1);
+    fw.SetKeyMaterial(&km2);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    ASSERT_TRUE(fw.GetKeyMaterial(km3));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  EXPECT_NE(0, memcmp(km2.m_salt, km3.m_salt, sizeof(km2.m_salt)));
+  EXPECT_TRUE(km3.Matches(PWSfile::V30, km2.m_nHashIters + 1));
+
+  // A core that changes its passkey mustn't save with the old one
+  PWScore core;
+  core.SetCurFile(fname.c_str());
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passphrase));
+  core.ChangePasskey(_T("new-passkey")); // saves
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, core.CheckPasskey(fname.c_str(), passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, core.CheckPasskey(fname.c_str(), _T("new-passkey")));
+}
+
+TEST_F(FileV3Test, CheckThenReadTest)
+{
+  {
+    PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+
+  // What CheckPasskey learns lets a read skip the stretching
+  PWSfile::VERSION version;
+  PWSKeyMaterial km;
+  ASSERT_EQ(PWSfile::SUCCESS, PWSfile::CheckPasskey(fname.c_str(), passphrase, version, &km));
+  EXPECT_EQ(PWSfile::V30, version);
+  EXPECT_TRUE(km.IsValid());
+  {
+    PWSfileV3 fr(fname.c_str(), PWSfile::Read, PWSfile::V30);
+    fr.SetKeyMaterial(&km);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+    EXPECT_EQ(fullItem, item);
+    EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+
+  // The core only hands it on for the same file and passkey
+  PWScore core;
+  ASSERT_EQ(PWSfile::SUCCESS, core.CheckPasskey(fname.c_str(), passphrase));
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, core.ReadFile(fname.c_str(), _T("x")));
+  ASSERT_EQ(PWSfile::SUCCESS, core.CheckPasskey(fname.c_str(), passphrase));
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passphrase));
+  EXPECT_EQ(1U, core.GetNumEntries());
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, core.CheckPasskey(fname.c_str(), _T("x")));
+}
+
 TEST_F(FileV3Test, PasskeyTest)
 {
   CItemData ci;
@@ -307,3 +404,20 @@ TEST_F(FileV3Test, PasskeyTest)
   EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
   EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
 }
+
+TEST(KeyStretchTest, Calibration)
+{
+  for (auto version : {PWSfile::V30, PWSfile::V40}) {
+    EXPECT_GT(PWSfile::TimeKeyStretch(version, MIN_HASH_ITERATIONS), 0.0);
+    // Clamped to the usable range
+    EXPECT_EQ(uint32(MIN_HASH_ITERATIONS), PWSfile::CalibrateHashIters(version, 1));
+    EXPECT_EQ(uint32(MAX_USABLE_HASH_ITERS), PWSfile::CalibrateHashIters(version, 10000000));
+  }
+
+  PWScore core;
+  core.NewFile(_T("calibrate"));
+  const uint32 n = core.CalibrateHashIters(200);
+  EXPECT_GE(n, uint32(MIN_HASH_ITERATIONS));
+  EXPECT_LE(n, uint32(MAX_USABLE_HASH_ITERS));
+  EXPECT_EQ(uint32(MIN_HASH_ITERATIONS), core.GetHashIters()); // unchanged
+}
@@ -13,6 +13,7 @@
 
 #include "core/PWSfileV4.h"
 #include "core/PWScore.h"
+#include "core/crypto/hmac.h"
 
 #include "os/file.h"
 
@@ -256,6 +257,259 @@ TEST_F(FileV4Test, MulitKeysTest)
   EXPECT_FALSE(kbs.RemoveKeyBlock(passphrase));
 }
 
+TEST_F(FileV4Test, ManyKeysTest)
+{
+  // Key blocks are tried concurrently - make sure we still get the
+  // right one wherever it is, and none for a wrong passkey
+  const int N = 12;
+  PWSfileV4::CKeyBlocks kbs;
+  std::vector<StringX> pws;
+  ASSERT_TRUE(kbs.AddKeyBlock(passphrase, passphrase));
+  for (int i = 1; i < N; i++) {
+    pws.push_back(passphrase + StringX(_T("#")) + StringX(std::to_wstring(i).c_str()));
+    ASSERT_TRUE(kbs.AddKeyBlock(passphrase, pws.back()));
+  }
+  ASSERT_TRUE(kbs.AddKeyBlock(pws.back(), pws.front())); // same passkey, two blocks
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  fw.SetKeyBlocks(kbs);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr.Open(_T("none of the above")));
+  for (const auto &pw : {pws.back(), pws.front(), passphrase}) {
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(pw));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+    EXPECT_EQ(fullItem, item);
+    EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+
+  // Removes both blocks for that passkey
+  EXPECT_TRUE(kbs.RemoveKeyBlock(pws.front()));
+  EXPECT_FALSE(kbs.RemoveKeyBlock(pws.front()));
+  EXPECT_TRUE(kbs.RemoveKeyBlock(pws.back()));
+}
+
+TEST_F(FileV4Test, Argon2KeysTest)
+{
+  const StringX pw2(_T("Argon2 hasn't got it"));
+  PWSfileV4::CKeyBlocks kbs;
+  EXPECT_FALSE(kbs.AddArgon2KeyBlock(passphrase, passphrase, 0, 64, 1));
+  EXPECT_FALSE(kbs.AddArgon2KeyBlock(passphrase, passphrase, 1, 15, 2));
+  ASSERT_TRUE(kbs.AddArgon2KeyBlock(passphrase, passphrase, 2, 64, 2));
+  ASSERT_TRUE(kbs.AddKeyBlock(passphrase, pw2)); // PBKDF2 alongside
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  fw.SetKeyBlocks(kbs);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr.Open(_T("neither")));
+  for (const auto &pw : {passphrase, pw2}) {
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(pw));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+    EXPECT_EQ(fullItem, item);
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+
+  // Pretend the first key block's KDF is one from the future: it can't
+  // be tried, so that's what we're told rather than "wrong password".
+  // The PBKDF2 one can, but then the change is caught by endKB.
+  FILE *fd = pws_os::FOpen(fname, _T("r+b"));
+  ASSERT_TRUE(fd != nullptr);
+  const unsigned char unknownKDF = 0x7f;
+  fseek(fd, 32 + 16, SEEK_SET); // nonce, salt
+  fwrite(&unknownKDF, 1, 1, fd);
+  fclose(fd);
+  EXPECT_EQ(PWSfile::UNSUPPORTED_VERSION, fr.Open(passphrase));
+  EXPECT_EQ(PWSfile::BAD_DIGEST, fr.Open(pw2));
+}
+
+TEST_F(FileV4Test, Argon2LimitsTest)
+{
+  using KB = PWSfileV4::CKeyBlocks;
+  PWSfileV4::CKeyBlocks kbs;
+  EXPECT_FALSE(kbs.AddArgon2KeyBlock(passphrase, passphrase, KB::MAX_ARGON2_T_COST + 1, 64, 1));
+  EXPECT_FALSE(kbs.AddArgon2KeyBlock(passphrase, passphrase, 1, KB::MAX_ARGON2_M_COST_KIB + 1, 1));
+  EXPECT_FALSE(kbs.AddArgon2KeyBlock(passphrase, passphrase, 1, 8 * 65, KB::MAX_ARGON2_PARALLELISM + 1));
+  ASSERT_TRUE(kbs.AddArgon2KeyBlock(passphrase, passphrase, 1, 64, 1));
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  fw.SetKeyBlocks(kbs);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  // A file asking for more memory than we'll give isn't even tried
+  FILE *fd = pws_os::FOpen(fname, _T("r+b"));
+  ASSERT_TRUE(fd != nullptr);
+  const unsigned char mCost[4] = {0xff, 0xff, 0xff, 0xff}; // little endian
+  fseek(fd, 32 + 20 + 4, SEEK_SET); // nonce, salt up to m_cost
+  fwrite(mCost, 1, sizeof(mCost), fd);
+  fclose(fd);
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  EXPECT_EQ(PWSfile::UNSUPPORTED_VERSION, fr.Open(passphrase));
+}
+
+TEST_F(FileV4Test, Argon2KeptTest)
+{
+  const PWSKDFParams argon2(2, 64, 2);
+  PWScore core;
+  core.SetPassKey(passphrase);
+  core.SetKDFParams(argon2);
+  ASSERT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+
+  core.ClearDBData();
+  core.SetKDFParams(PWSKDFParams());
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passphrase));
+  EXPECT_EQ(argon2, core.GetKDFParams());
+  EXPECT_NE(0U, core.GetHashIters());
+  // Hash iterations don't apply, so there's nothing to calibrate
+  EXPECT_FALSE(core.UsesHashIters());
+  EXPECT_EQ(core.GetHashIters(), core.CalibrateHashIters(200));
+
+  // Without key material to reuse, a new key block's made - still Argon2id
+  const StringX newpass(_T("argon2 again"));
+  core.SetCurFile(fname.c_str());
+  core.SetReadOnly(false);
+  core.ChangePasskey(newpass); // saves
+  core.ClearDBData();
+  core.SetKDFParams(PWSKDFParams());
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), newpass));
+  EXPECT_EQ(argon2, core.GetKDFParams());
+
+  // And PBKDF2 stays PBKDF2
+  core.SetKDFParams(PWSKDFParams());
+  ASSERT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fr.Open(newpass));
+  EXPECT_EQ(PWSKDFParams(), fr.GetKDFParams());
+  EXPECT_EQ(core.GetHashIters(), fr.GetNHashIters());
+  EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  EXPECT_TRUE(core.UsesHashIters());
+}
+
+TEST_F(FileV4Test, BigAttTest)
+{
+  // Big enough to be decrypted a range at a time
+  std::vector<unsigned char> big(2 * PWSfileV4::CONTENT_RANGE + 1234);
+  for (size_t i = 0; i < big.size(); i++)
+    big[i] = static_cast<unsigned char>(i * 7 + i / 251);
+  CItemAtt bigAtt;
+  bigAtt.CreateUUID();
+  bigAtt.SetFileCTime(1011);
+  bigAtt.SetMediaType(L"application/octet-stream");
+  bigAtt.SetContent(big.data(), big.size());
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(bigAtt));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(attItem17));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  {
+    CItemAtt readAtt, readAtt17;
+    PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(readAtt));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(readAtt17));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+    bigAtt.SetOffset(readAtt.GetOffset());
+    EXPECT_EQ(bigAtt, readAtt);
+    attItem17.SetOffset(readAtt17.GetOffset());
+    EXPECT_EQ(attItem17, readAtt17);
+  }
+
+  // A change to the second range is caught by the ContentHMAC
+  std::FILE *fd = pws_os::FOpen(fname, _T("r+b"));
+  ASSERT_TRUE(fd != nullptr);
+  fseek(fd, static_cast<long>(PWSfileV4::CONTENT_RANGE + 4321), SEEK_SET);
+  const int c = fgetc(fd);
+  fseek(fd, -1, SEEK_CUR);
+  fputc(c ^ 1, fd);
+  fclose(fd);
+  CItemAtt readAtt;
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+  EXPECT_EQ(PWSfile::BAD_DIGEST, fr.ReadRecord(readAtt));
+}
+
+TEST_F(FileV4Test, CompressedAttTest)
+{
+  std::string text;
+  while (text.size() < 100000)
+    text += "Line " + std::to_string(text.size() % 97) + " of a very repetitive log\n";
+  CItemAtt textAtt;
+  textAtt.CreateUUID();
+  textAtt.SetMediaType(L"text/plain");
+  textAtt.SetCompression(CItemAtt::CC_DEFLATE);
+  textAtt.SetContent(reinterpret_cast<const unsigned char *>(text.data()), text.size());
+  EXPECT_EQ(text.size(), textAtt.GetContentLength());
+  EXPECT_LT(textAtt.GetStoredLength(), text.size() / 4);
+
+  // Doesn't compress, so stored as is
+  attItem17.SetCompression(CItemAtt::CC_DEFLATE);
+  EXPECT_EQ(attItem17.GetContentLength(), attItem17.GetStoredLength());
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(textAtt));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(attItem17));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  std::FILE *f = pws_os::FOpen(fname, L"rb");
+  ASSERT_NE(nullptr, f);
+  EXPECT_LT(pws_os::fileLength(f), text.size() / 2);
+  pws_os::FClose(f, false);
+
+  CItemAtt readAtt, readAtt17;
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(readAtt));
+  EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(readAtt17));
+  EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+
+  textAtt.SetOffset(readAtt.GetOffset());
+  EXPECT_EQ(textAtt, readAtt);
+  EXPECT_EQ(CItemAtt::CC_DEFLATE, readAtt.GetCompression());
+  std::vector<unsigned char> content(readAtt.GetContentSize());
+  ASSERT_TRUE(readAtt.GetContent(content.data(), content.size()));
+  EXPECT_EQ(0, memcmp(text.data(), content.data(), text.size()));
+
+  // What a version that doesn't know about compression finds: the
+  // compressed bytes in a field of their own, and no content to read
+  {
+    PWSfileV4 fraw(fname.c_str(), PWSfile::Read, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fraw.Open(passphrase));
+    unsigned char type;
+    unsigned char *data = nullptr;
+    size_t len = 0;
+    bool gotPacked = false;
+    do {
+      ASSERT_GT(fraw.ReadField(type, data, len), 0U);
+      if (type == CItemAtt::COMPRESSEDCONTENT) {
+        gotPacked = (len == textAtt.GetStoredLength());
+      } else {
+        EXPECT_NE(CItemAtt::CONTENT, type);
+        EXPECT_NE(CItemAtt::ATTEK, type);
+        EXPECT_NE(CItemAtt::CONTENTHMAC, type);
+      }
+      delete[] data;
+      data = nullptr;
+      len = 0;
+    } while (type != CItemAtt::END);
+    EXPECT_TRUE(gotPacked);
+    fraw.Close();
+  }
+
+  attItem17.SetOffset(readAtt17.GetOffset());
+  EXPECT_EQ(attItem17, readAtt17);
+  EXPECT_EQ(CItemAtt::CC_NONE, readAtt17.GetCompression());
+}
+
 TEST_F(FileV4Test, AttTest)
 {
   PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
@@ -352,6 +606,102 @@ TEST_F(FileV4Test, CoreRWTest)
   core.ClearCommands();
 }
 
+TEST_F(FileV4Test, SharedAttTest)
+{
+  PWScore core;
+  core.SetPassKey(passphrase);
+
+  // Duplicates from before attachments could be shared
+  CItemAtt dupAtt(attItem);
+  dupAtt.CreateUUID();
+  core.PutAtt(attItem);
+  core.PutAtt(dupAtt);
+  CItemData item2(fullItem);
+  item2.CreateUUID();
+  item2.SetTitle(L"another title");
+  fullItem.SetAttUUID(attItem.GetUUID());
+  item2.SetAttUUID(dupAtt.GetUUID());
+  core.Execute(AddEntryCommand::Create(&core, fullItem));
+  core.Execute(AddEntryCommand::Create(&core, item2));
+  EXPECT_EQ(2U, core.GetNumAtts());
+  EXPECT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+
+  // Validate() merges them
+  core.ClearDBData();
+  EXPECT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passphrase, true));
+  ASSERT_EQ(2U, core.GetNumEntries());
+  ASSERT_EQ(1U, core.GetNumAtts());
+  const CItemData &read1 = core.GetEntry(core.Find(fullItem.GetUUID()));
+  const CItemData &read2 = core.GetEntry(core.Find(item2.GetUUID()));
+  EXPECT_EQ(read1.GetAttUUID(), read2.GetAttUUID());
+  EXPECT_EQ(2U, core.GetAtt(read1.GetAttUUID()).GetRefcount());
+
+  // Written once from now on
+  EXPECT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+  core.ClearDBData();
+  EXPECT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passphrase, false));
+  EXPECT_EQ(1U, core.GetNumAtts());
+  core.ClearCommands();
+}
+
+TEST_F(FileV4Test, KeyMaterialTest)
+{
+  PWSKeyMaterial km1, km2;
+  {
+    PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    ASSERT_TRUE(fw.GetKeyMaterial(km1));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  uint32 nHashIters;
+  {
+    PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+    ASSERT_TRUE(fr.GetKeyMaterial(km2));
+    nHashIters = fr.GetNHashIters();
+    EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+    EXPECT_FALSE(fr.GetKeyMaterial(km2)); // key blocks gone
+  }
+  EXPECT_TRUE(km2.IsValid());
+  EXPECT_EQ(0, memcmp(km1.m_salt, km2.m_salt, sizeof(km1.m_salt)));
+  EXPECT_EQ(0, memcmp(km1.m_key, km2.m_key, sizeof(km1.m_key)));
+  EXPECT_EQ(0, memcmp(km1.m_ell, km2.m_ell, sizeof(km1.m_ell)));
+
+  // Write reusing what was read - same key block, still readable
+  {
+    PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+    fw.SetNHashIters(nHashIters);
+    fw.SetKeyMaterial(&km2);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+    ASSERT_TRUE(fw.GetKeyMaterial(km1));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  EXPECT_EQ(0, memcmp(km1.m_kw_k, km2.m_kw_k, sizeof(km1.m_kw_k)));
+  {
+    PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+    EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr.Open(_T("x")));
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+    EXPECT_EQ(fullItem, item);
+    EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+
+  // V3 material doesn't fit
+  km2.m_version = PWSfile::V30;
+  {
+    PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+    fw.SetNHashIters(nHashIters);
+    fw.SetKeyMaterial(&km2);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+    ASSERT_TRUE(fw.GetKeyMaterial(km1));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  EXPECT_NE(0, memcmp(km1.m_salt, km2.m_salt, sizeof(km1.m_salt)));
+}
+
 TEST_F(FileV4Test, PasskeyTest)
 {
   CItemData ci;
@@ -435,3 +785,34 @@ TEST_F(FileV4Test, V3ToV4AttachmentConversion) {
   att.GetFileMTime(v4mtime);
   EXPECT_EQ(v4mtime, mtime);
 }
+
+TEST_F(FileV4Test, V3ToV4SharedAttachmentConversion) {
+  PWScore core;
+
+  // Same V3 attachment in two records
+  CItemData v3Item1, v3Item2;
+  v3Item1.CreateUUID();
+  v3Item1.SetTitle(L"Host 1");
+  v3Item1.SetPassword(L"mandatory field...");
+  v3Item1.SetAttFileName(L"ca.pem");
+  v3Item1.SetAttMediaType(L"application/x-pem-file");
+  std::vector<unsigned char> content{ 'c','e','r','t' };
+  v3Item1.SetAttContent(content.data(), content.size());
+  v3Item2 = v3Item1;
+  v3Item2.CreateUUID();
+  v3Item2.SetTitle(L"Host 2");
+
+  core.SetPassKey(passphrase);
+  core.Execute(AddEntryCommand::Create(&core, v3Item1));
+  core.Execute(AddEntryCommand::Create(&core, v3Item2));
+  EXPECT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+
+  core.ClearDBData();
+  EXPECT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passphrase, false));
+  ASSERT_EQ(2U, core.GetNumEntries());
+  ASSERT_EQ(1U, core.GetNumAtts());
+  const CItemData &read1 = core.GetEntry(core.Find(v3Item1.GetUUID()));
+  const CItemData &read2 = core.GetEntry(core.Find(v3Item2.GetUUID()));
+  EXPECT_EQ(read1.GetAttUUID(), read2.GetAttUUID());
+  EXPECT_EQ(2U, core.GetAtt(read1.GetAttUUID()).GetRefcount());
+}
@@ -13,6 +13,7 @@
 
 #include "core/ItemAtt.h"
 #include "core/PWScore.h"
+#include "core/PWSprefs.h"
 #include "os/file.h"
 #include "os/dir.h"
 #include "os/debug.h"
@@ -98,6 +99,14 @@ TEST_F(ItemAttTest, ImpExp)
   EXPECT_STREQ(fileName.c_str(), ai.GetFileName().c_str());
   EXPECT_STREQ(filePath.c_str(), ai.GetFilePath().c_str());
   EXPECT_TRUE(ai.HasContent());
+  // Compressed only if asked for
+  EXPECT_EQ(CItemAtt::CC_NONE, ai.GetCompression());
+  PWSprefs *prefs = PWSprefs::GetInstance();
+  prefs->SetPref(PWSprefs::CompressAttachments, true);
+  CItemAtt compressed;
+  EXPECT_EQ(PWScore::SUCCESS, compressed.Import(testImpFile));
+  prefs->SetPref(PWSprefs::CompressAttachments, false);
+  EXPECT_EQ(CItemAtt::CC_DEFLATE, compressed.GetCompression());
 
   status = ai.Export(testExpFile);
   EXPECT_EQ(PWScore::SUCCESS, status);
@@ -489,3 +489,44 @@ TEST_F(ItemDataTest, UnknownFields)
   // how they're processed. Worth exposing an API
   // just for testing, TBD.
 }
+
+TEST_F(ItemDataTest, DecodedView)
+{
+  CItemData di;
+  di.SetTitle(title);
+  di.SetUser(user);
+  di.SetPassword(password);
+
+  {
+    CItemData::DecodedView view(di);
+    EXPECT_EQ(title, di.GetTitle());
+    EXPECT_EQ(title, di.GetTitle());
+    EXPECT_EQ(password, di.GetPassword());
+
+    // Changes are seen while in scope
+    di.SetTitle(L"New Title");
+    EXPECT_EQ(L"New Title", di.GetTitle());
+    di.SetUser(L"");
+    EXPECT_TRUE(di.GetUser().empty());
+
+    {
+      CItemData::DecodedView inner(di);
+      EXPECT_EQ(L"New Title", di.GetTitle());
+    }
+    EXPECT_EQ(L"New Title", di.GetTitle()); // outer view still in effect
+
+    // Copies don't share the view
+    CItemData copy(di);
+    copy.SetTitle(title);
+    EXPECT_EQ(L"New Title", di.GetTitle());
+    EXPECT_EQ(title, copy.GetTitle());
+
+    di = copy;
+    EXPECT_EQ(title, di.GetTitle());
+
+    di.Clear();
+    EXPECT_TRUE(di.GetTitle().empty());
+    di.SetTitle(title);
+  }
+  EXPECT_EQ(title, di.GetTitle());
+}
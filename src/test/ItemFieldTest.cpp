@@ -78,3 +78,20 @@ TEST_F(ItemFieldTest, testMe)
   EXPECT_EQ(sizeof(v1), lenV2);
   EXPECT_TRUE(memcmp(v1, v2, sizeof(v1)) == 0);
 }
+
+TEST_F(ItemFieldTest, SecureString)
+{
+  const StringX values[] = {L"", L"a", L"ab", L"abc", L"web01",
+                            L"A title that doesn't fit inline, whatever the TCHAR size"};
+  for (const auto &value : values) {
+    CItemField field(3);
+    field.Set(value, m_bf);
+    StringX sx;
+    field.Get(sx, m_bf);
+    SecureStringX ss(L"previous");
+    field.Get(ss, m_bf);
+    EXPECT_EQ(value, sx);
+    EXPECT_EQ(value.length(), ss.length());
+    EXPECT_TRUE(ss == SecureStringX(value)) << value.c_str();
+  }
+}
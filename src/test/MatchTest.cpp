@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// MatchTest.cpp: Unit test for PWSMatch string matching
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/Match.h"
+
+#include "gtest/gtest.h"
+
+using namespace PWSMatch;
+
+TEST(MatchTest, StringMatcherBasics)
+{
+  EXPECT_TRUE(StringMatcher(L"BANK", MR_CONTAINS).Match(L"My bank account"));
+  EXPECT_FALSE(StringMatcher(L"BANK", -MR_CONTAINS).Match(L"My bank account"));
+  EXPECT_TRUE(StringMatcher(L"my", MR_BEGINS).Match(L"My bank account"));
+  EXPECT_TRUE(StringMatcher(L"Count", MR_ENDS).Match(L"My bank account"));
+  EXPECT_FALSE(StringMatcher(L"account", MR_ENDS).Match(L"account"));
+  EXPECT_TRUE(StringMatcher(L"", MR_CONTAINS).Match(L"x"));
+  EXPECT_TRUE(StringMatcher(L"abab", MR_CONTAINS).Match(L"aabaabab"));
+  EXPECT_TRUE(StringMatcher(L"x", MR_NOTCONTAIN).Match(L""));
+}
+
+TEST(MatchTest, StringMatcherSameAsMatch)
+{
+  const StringX values[] = {L"", L"a", L"ab", L"Ab", L"abc", L"bca", L"xyz",
+                            L"\x0100\x0101", L"Bank", L"ANK"};
+  const StringX objects[] = {L"", L"a", L"AB", L"ab", L"abcabc", L"cab", L"zzzxyz",
+                             L"\x0100\x0101\x0102", L"bank", L"my bank", L"aabbcc"};
+  const MatchRule rules[] = {MR_EQUALS, MR_NOTEQUAL, MR_BEGINS, MR_NOTBEGIN,
+                             MR_ENDS, MR_NOTEND, MR_CONTAINS, MR_NOTCONTAIN,
+                             MR_CNTNANY, MR_NOTCNTNANY, MR_CNTNALL, MR_NOTCNTNALL};
+
+  for (const auto &v : values) {
+    for (const auto rule : rules) {
+      for (const int ifunction : {static_cast<int>(rule), -static_cast<int>(rule)}) {
+        const StringMatcher matcher(v, ifunction);
+        for (const auto &o : objects) {
+          EXPECT_EQ(Match(v, o, ifunction), matcher.Match(o))
+            << "value '" << v.c_str() << "' object '" << o.c_str()
+            << "' function " << ifunction;
+        }
+      }
+    }
+  }
+}
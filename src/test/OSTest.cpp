@@ -9,8 +9,27 @@
 
 #include "os/media.h"
 #include "os/dir.h"
+#include "os/file.h"
 #include "gtest/gtest.h"
 
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+static std::string ReadAll(const stringT &fname)
+{
+  std::string retval;
+  std::FILE *fd = pws_os::FOpen(fname, _T("rb"));
+  if (fd != nullptr) {
+    char buf[256];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), fd)) > 0)
+      retval.append(buf, n);
+    pws_os::FClose(fd, false);
+  }
+  return retval;
+}
+
 TEST(OSTest, testMedia)
 {
   EXPECT_EQ(_T("unknown"), pws_os::GetMediaType(_T("nosuchfile")));
@@ -44,4 +63,57 @@ TEST(OSTest, testPath)
 
   out_path = pws_os::makepath(in_drive, in_dir, in_file, in_ext);
   EXPECT_EQ(in_path, out_path);
-}
\ No newline at end of file
+}
+TEST(OSTest, testCopyAndClone)
+{
+  const stringT src(_T("ostest_src.dat")), copy(_T("ostest_copy.dat")),
+    clone(_T("ostest_clone.dat"));
+  const std::string data(10000, 'x');
+  std::FILE *fd = pws_os::FOpen(src, _T("wb"));
+  ASSERT_TRUE(fd != nullptr);
+  std::fwrite(data.data(), 1, data.size(), fd);
+  pws_os::FClose(fd, true);
+
+  EXPECT_TRUE(pws_os::CopyAFile(src, copy));
+  EXPECT_EQ(data, ReadAll(copy));
+
+  // Not supported by every filesystem, but either works or does nothing
+  if (pws_os::CloneFile(src, clone))
+    EXPECT_EQ(data, ReadAll(clone));
+  else
+    EXPECT_FALSE(pws_os::FileExists(clone));
+  EXPECT_FALSE(pws_os::CloneFile(src, copy)); // never overwrites
+  EXPECT_EQ(data, ReadAll(copy));
+
+  pws_os::DeleteAFile(src);
+  pws_os::DeleteAFile(copy);
+  pws_os::DeleteAFile(clone);
+}
+
+TEST(OSTest, testSyncDir)
+{
+  EXPECT_TRUE(pws_os::SyncDir(_T("ostest_nosuchfile.dat"))); // current directory
+#ifndef WIN32
+  EXPECT_TRUE(pws_os::SyncDir(_T("/ostest_nosuchfile.dat")));
+  EXPECT_FALSE(pws_os::SyncDir(_T("ostest_nosuchdir/ostest_nosuchfile.dat")));
+#endif
+}
+
+TEST(OSTest, testCreateReplacement)
+{
+  const stringT fname(_T("ostest_replace.dat"));
+  stringT target, tmpname;
+  ASSERT_TRUE(pws_os::CreateReplacement(fname, target, tmpname));
+  ASSERT_FALSE(tmpname.empty());
+  EXPECT_EQ(target + _T(".tmp"), tmpname);
+  EXPECT_TRUE(pws_os::FileExists(tmpname));
+  EXPECT_TRUE(ReadAll(tmpname).empty());
+#ifndef WIN32
+  // Not readable by others while it's being written, as there's nothing to copy
+  EXPECT_EQ(std::filesystem::perms::owner_read | std::filesystem::perms::owner_write,
+            std::filesystem::status(tmpname).permissions());
+#endif
+  EXPECT_TRUE(pws_os::ReplaceAFile(tmpname, target));
+  EXPECT_TRUE(pws_os::FileExists(fname));
+  pws_os::DeleteAFile(fname);
+}
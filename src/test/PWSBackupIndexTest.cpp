@@ -0,0 +1,162 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// PWSBackupIndexTest.cpp: Unit test for intermediate backup rotation
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWSBackupIndex.h"
+#include "core/PWScore.h"
+#include "os/file.h"
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+
+class PWSBackupIndexTest : public ::testing::Test
+{
+protected:
+  PWSBackupIndexTest() : prefix(_T("bkidxtest")) {}
+  void TearDown();
+
+  void Touch(const stringT &suffix);
+  bool Exists(const stringT &suffix);
+  std::vector<stringT> Suffixes(std::initializer_list<const TCHAR *> l)
+  {return std::vector<stringT>(l.begin(), l.end());}
+
+  const stringT prefix;
+};
+
+void PWSBackupIndexTest::TearDown()
+{
+  std::vector<stringT> files;
+  pws_os::FindFiles(prefix + _T("*"), files);
+  for (const auto &f : files)
+    pws_os::DeleteAFile(f);
+}
+
+void PWSBackupIndexTest::Touch(const stringT &suffix)
+{
+  std::FILE *fd = pws_os::FOpen(prefix + _T("_") + suffix + _T(".ibak"), _T("w"));
+  ASSERT_TRUE(fd != nullptr);
+  pws_os::FClose(fd, true);
+}
+
+bool PWSBackupIndexTest::Exists(const stringT &suffix)
+{
+  return pws_os::FileExists(prefix + _T("_") + suffix + _T(".ibak"));
+}
+
+TEST_F(PWSBackupIndexTest, Numbered)
+{
+  for (int i = 0; i < 5; i++) {
+    PWSBackupIndex index(prefix);
+    const stringT next = index.NextNumber();
+    Touch(next);
+    for (const auto &f : index.Add(next, 3))
+      EXPECT_TRUE(pws_os::DeleteAFile(f));
+  }
+  EXPECT_FALSE(Exists(_T("002")));
+  EXPECT_TRUE(Exists(_T("003")));
+  EXPECT_TRUE(pws_os::FileExists(PWSBackupIndex::GetIndexFileName(prefix)));
+
+  PWSBackupIndex index(prefix);
+  EXPECT_EQ(Suffixes({_T("003"), _T("004"), _T("005")}), index.GetSuffixes());
+  EXPECT_EQ(_T("006"), index.NextNumber());
+}
+
+TEST_F(PWSBackupIndexTest, DateTime)
+{
+  PWSBackupIndex index(prefix);
+  EXPECT_TRUE(index.Add(_T("20260101_120000"), 2).empty());
+  EXPECT_TRUE(index.Add(_T("20260101_120000"), 2).empty()); // same second
+  EXPECT_TRUE(index.Add(_T("20260102_090000"), 2).empty());
+  const std::vector<stringT> excess = index.Add(_T("20260103_090000"), 2);
+  ASSERT_EQ(1u, excess.size());
+  EXPECT_EQ(prefix + _T("_20260101_120000.ibak"), excess[0]);
+  EXPECT_EQ(_T("001"), index.NextNumber());
+}
+
+TEST_F(PWSBackupIndexTest, Rebuild)
+{
+  Touch(_T("20251231_235959"));
+  Touch(_T("002"));
+  Touch(_T("001"));
+  Touch(_T("old")); // not one of ours
+  {
+    PWSBackupIndex index(prefix); // no index yet
+    // Date-time backups from before the index aren't ours to rotate
+    EXPECT_EQ(Suffixes({_T("001"), _T("002")}), index.GetSuffixes());
+    EXPECT_EQ(_T("003"), index.NextNumber());
+    Touch(_T("003"));
+    index.Add(_T("003"), 10);
+  }
+  Touch(_T("004")); // by a version without the index
+  {
+    PWSBackupIndex index(prefix);
+    EXPECT_EQ(_T("005"), index.NextNumber());
+  }
+  pws_os::DeleteAFile(prefix + _T("_004.ibak"));
+  {
+    PWSBackupIndex index(prefix);
+    EXPECT_EQ(_T("004"), index.NextNumber());
+    Touch(_T("20260101_120000"));
+    index.Add(_T("20260101_120000"), 10);
+  }
+  Touch(_T("004"));
+  {
+    PWSBackupIndex index(prefix); // rebuilt, but still has the one it recorded
+    EXPECT_EQ(Suffixes({_T("001"), _T("002"), _T("003"), _T("004"), _T("20260101_120000")}),
+              index.GetSuffixes());
+    pws_os::DeleteAFile(prefix + _T("_004.ibak"));
+  }
+  std::FILE *fd = pws_os::FOpen(PWSBackupIndex::GetIndexFileName(prefix), _T("w"));
+  ASSERT_TRUE(fd != nullptr);
+  std::fputs("garbage\n", fd);
+  pws_os::FClose(fd, true);
+  {
+    PWSBackupIndex index(prefix);
+    EXPECT_EQ(3u, index.GetSuffixes().size());
+  }
+}
+
+TEST_F(PWSBackupIndexTest, Wraps)
+{
+  Touch(_T("999"));
+  PWSBackupIndex index(prefix);
+  EXPECT_TRUE(index.NextNumber().empty());
+}
+
+TEST_F(PWSBackupIndexTest, BackupCurFile)
+{
+  const stringT fname = prefix + _T(".psafe3");
+  const stringT bu_prefix = prefix + _T("_core");
+  stringT bu_fname;
+  {
+    PWScore core;
+    core.NewFile(_T("b4ckup"));
+    core.SetReadOnly(false);
+    core.SetCurFile(fname.c_str());
+    for (int i = 0; i < 4; i++) {
+      ASSERT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+      ASSERT_TRUE(core.BackupCurFile(2, 2, bu_prefix, _T(""), bu_fname));
+    }
+    const stringT last = bu_prefix + _T("_004.ibak");
+    ASSERT_GE(bu_fname.length(), last.length());
+    EXPECT_EQ(last, bu_fname.substr(bu_fname.length() - last.length()));
+    ASSERT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+    EXPECT_TRUE(pws_os::FileExists(fname));
+    EXPECT_FALSE(pws_os::FileExists(fname + _T(".tmp")));
+  } // waits for the last rotation
+
+  EXPECT_FALSE(pws_os::FileExists(bu_prefix + _T("_001.ibak")));
+  EXPECT_FALSE(pws_os::FileExists(bu_prefix + _T("_002.ibak")));
+  EXPECT_TRUE(pws_os::FileExists(bu_prefix + _T("_003.ibak")));
+  EXPECT_TRUE(pws_os::FileExists(bu_fname));
+}
@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// PWSCountersTest.cpp: Unit test for the performance counters
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWScore.h"
+#include "core/PWSCounters.h"
+#include "os/file.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+TEST(PWSCountersTest, Basics)
+{
+  PWSCounters::Reset();
+  EXPECT_EQ(0U, PWSCounters::Get(PWSCounters::RecordsRead));
+  PWSCounters::Add(PWSCounters::RecordsRead);
+  PWSCounters::Add(PWSCounters::RecordsRead, 41);
+  EXPECT_EQ(42U, PWSCounters::Get(PWSCounters::RecordsRead));
+
+  PWSCounters::Set(PWSCounters::UndoMemory, 1000);
+  PWSCounters::Set(PWSCounters::UndoMemory, 10);
+  EXPECT_EQ(10U, PWSCounters::Get(PWSCounters::UndoMemory));
+
+  PWSCounters::Record(PWSCounters::Search, 500);        // < 1us
+  PWSCounters::Record(PWSCounters::Search, 3000);       // [2, 4) us
+  PWSCounters::Record(PWSCounters::Search, 3999);       // [2, 4) us
+  PWSCounters::Record(PWSCounters::Search, 100000000000ULL); // 100 s, last bucket
+  const PWSCounters::TimerStats stats = PWSCounters::Get(PWSCounters::Search);
+  EXPECT_EQ(4U, stats.count);
+  EXPECT_EQ(100000007499ULL, stats.totalNs);
+  EXPECT_EQ(100000000000ULL, stats.maxNs);
+  EXPECT_EQ(1U, stats.buckets[0]);
+  EXPECT_EQ(2U, stats.buckets[2]);
+  EXPECT_EQ(1U, stats.buckets[PWSCounters::NUM_BUCKETS - 1]);
+
+  const std::string json = PWSCounters::GetJSON();
+  EXPECT_NE(std::string::npos, json.find("\"records_read\":42"));
+  EXPECT_NE(std::string::npos, json.find("\"undo_memory\":10"));
+  EXPECT_NE(std::string::npos, json.find("\"search\":{\"count\":4,"));
+  EXPECT_NE(std::string::npos, json.find("\"histogram_us\":{\"1\":1,\"4\":2,\"inf\":1}"));
+
+  const StringX summary = PWSCounters::GetSummary();
+  EXPECT_NE(StringX::npos, summary.find(_T("records_read: 42")));
+  EXPECT_NE(StringX::npos, summary.find(_T("search: 4 in ")));
+  EXPECT_EQ(StringX::npos, summary.find(_T("files_read"))); // unused counters are left out
+
+  {
+    PWSCounters::Timing timing(PWSCounters::ReadFileOpen);
+    timing.Next(PWSCounters::ReadFileRecords);
+    timing.Stop();
+    timing.Stop(); // only counts once
+  }
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::ReadFileOpen).count);
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::ReadFileRecords).count);
+
+  PWSCounters::Reset();
+  EXPECT_EQ(0U, PWSCounters::Get(PWSCounters::RecordsRead));
+  EXPECT_EQ(0U, PWSCounters::Get(PWSCounters::Search).count);
+  EXPECT_EQ(0U, PWSCounters::Get(PWSCounters::Search).buckets[0]);
+}
+
+TEST(PWSCountersTest, ReadWrite)
+{
+  const stringT fname(_T("counterstest.psafe3"));
+  const StringX passkey(_T("C0unt3r5"));
+
+  PWScore core;
+  core.NewFile(passkey);
+  core.SetReadOnly(false);
+  for (int i = 0; i < 3; i++) {
+    CItemData ci;
+    ci.CreateUUID();
+    ci.SetTitle(StringX(_T("entry")) + StringX(1, _T('a') + i));
+    ci.SetPassword(_T("password"));
+    core.Execute(AddEntryCommand::Create(&core, ci));
+  }
+
+  PWSCounters::Reset();
+  ASSERT_EQ(PWScore::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V30));
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::FilesWritten));
+  EXPECT_EQ(3U, PWSCounters::Get(PWSCounters::RecordsWritten));
+  EXPECT_LT(0U, PWSCounters::Get(PWSCounters::BytesEncrypted));
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::WriteFileTotal).count);
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::WriteFileRecords).count);
+
+  PWScore core2;
+  ASSERT_EQ(PWScore::SUCCESS, core2.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::FilesRead));
+  EXPECT_EQ(3U, PWSCounters::Get(PWSCounters::RecordsRead));
+  EXPECT_LT(0U, PWSCounters::Get(PWSCounters::BytesDecrypted));
+  EXPECT_LE(1U, PWSCounters::Get(PWSCounters::StretchKey).count);
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::ReadFileTotal).count);
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::ReadFileOpen).count);
+  EXPECT_EQ(1U, PWSCounters::Get(PWSCounters::ReadFileValidate).count);
+
+  // Gauges are this core's
+  const std::string json = core.GetPerfStatsJSON();
+  EXPECT_NE(std::string::npos, json.find("\"undo_commands\":3"));
+  EXPECT_LT(0U, PWSCounters::Get(PWSCounters::UndoMemory));
+  core2.GetPerfStats();
+  EXPECT_EQ(0U, PWSCounters::Get(PWSCounters::UndoCommands));
+
+  st_DBProperties st_dbp;
+  core2.GetDBProperties(st_dbp);
+  EXPECT_NE(StringX::npos, st_dbp.perfstats.find(_T("records_read: 3")));
+
+  pws_os::DeleteAFile(fname);
+}
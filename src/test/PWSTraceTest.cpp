@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// PWSTraceTest.cpp: Unit test for the tracing spans
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "core/PWSTrace.h"
+#include "gtest/gtest.h"
+
+namespace {
+  size_t Count(const std::string &s, const std::string &what)
+  {
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos;
+         pos = s.find(what, pos + what.length()))
+      n++;
+    return n;
+  }
+}
+
+class PWSTraceTest : public ::testing::Test
+{
+protected:
+  void SetUp() override {PWSTrace::Enable(true); PWSTrace::Clear();}
+  void TearDown() override {PWSTrace::Enable(false); PWSTrace::Clear();}
+};
+
+TEST_F(PWSTraceTest, Spans)
+{
+  PWSTrace::Enable(false);
+  {PWSTrace::Span span("TraceOff");}
+  PWSTrace::Enable(true);
+  {
+    PWSTrace::Span span("TraceOn");
+    span.SetArg(42);
+  }
+  {PWSTrace::Span span("NoArg");}
+
+  const std::string json = PWSTrace::GetChromeTrace();
+  EXPECT_EQ(0U, json.find("{\"traceEvents\":["));
+  EXPECT_EQ(0U, Count(json, "TraceOff"));
+  EXPECT_EQ(1U, Count(json, "\"name\":\"TraceOn\""));
+  EXPECT_EQ(1U, Count(json, "\"args\":{\"n\":42}"));
+  EXPECT_EQ(1U, Count(json, "\"name\":\"NoArg\""));
+  EXPECT_EQ(2U, Count(json, "\"ph\":\"X\""));
+
+  PWSTrace::Clear();
+  EXPECT_EQ(0U, Count(PWSTrace::GetChromeTrace(), "\"name\""));
+}
+
+TEST_F(PWSTraceTest, Wraparound)
+{
+  for (int i = 0; i < 5000; i++) {
+    PWSTrace::Span span("Loop");
+    span.SetArg(i);
+  }
+  // A full ring, none of it being overwritten as it's read
+  const std::string json = PWSTrace::GetChromeTrace();
+  EXPECT_EQ(2048U, Count(json, "\"name\":\"Loop\""));
+  EXPECT_EQ(1U, Count(json, "\"n\":4999}"));
+  EXPECT_EQ(1U, Count(json, "\"n\":2952}"));
+  EXPECT_EQ(0U, Count(json, "\"n\":2951}"));
+}
+
+TEST_F(PWSTraceTest, Threads)
+{
+  {PWSTrace::Span span("Main");}
+  std::thread t([] {PWSTrace::Span span("Other");});
+  t.join();
+
+  const std::string json = PWSTrace::GetChromeTrace();
+  const size_t main = json.find("\"name\":\"Main\"");
+  const size_t other = json.find("\"name\":\"Other\"");
+  ASSERT_NE(std::string::npos, main);
+  ASSERT_NE(std::string::npos, other);
+  auto tid = [&json](size_t pos) {
+    pos = json.find("\"tid\":", pos) + 6;
+    return json.substr(pos, json.find(',', pos) - pos);
+  };
+  EXPECT_NE(tid(main), tid(other));
+}
+
+TEST_F(PWSTraceTest, ReadWhileWriting)
+{
+  std::atomic<bool> bStop(false);
+  std::thread t([&bStop] {
+    for (int64 i = 0; !bStop; i++) {
+      PWSTrace::Span span("Busy");
+      span.SetArg(i);
+    }
+  });
+
+  // Whatever's exported is whole: in the order written, none repeated
+  for (int pass = 0; pass < 20; pass++) {
+    const std::string json = PWSTrace::GetChromeTrace();
+    long long last = -1;
+    for (size_t pos = json.find("\"n\":"); pos != std::string::npos;
+         pos = json.find("\"n\":", pos + 1)) {
+      const long long n = std::stoll(json.substr(pos + 4));
+      EXPECT_GT(n, last);
+      last = n;
+    }
+    EXPECT_LE(Count(json, "\"name\":\"Busy\""), 2048U);
+  }
+  bStop = true;
+  t.join();
+}
@@ -0,0 +1,148 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SearchIndexTest.cpp: Unit test for CSearchIndex
+
+#if defined(WIN32) && !defined(__WX__)
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWScore.h"
+#include "core/SearchIndex.h"
+#include "core/SearchUtils.h"
+
+#include "gtest/gtest.h"
+
+class SearchIndexTest : public ::testing::Test
+{
+protected:
+  SearchIndexTest() {}
+  void SetUp();
+
+  CItemData ci1, ci2, ci3;
+};
+
+void SearchIndexTest::SetUp()
+{
+  ci1.CreateUUID();
+  ci1.SetGroup(L"Work.Mail");
+  ci1.SetTitle(L"Exchange server");
+  ci1.SetUser(L"jdoe");
+  ci1.SetPassword(L"secret-one");
+  ci1.SetURL(L"https://mail.example.com");
+
+  ci2.CreateUUID();
+  ci2.SetGroup(L"Home");
+  ci2.SetTitle(L"Router");
+  ci2.SetUser(L"admin");
+  ci2.SetPassword(L"exchange");
+  ci2.SetNotes(L"Serial number on the bottom");
+
+  ci3.CreateUUID();
+  ci3.SetGroup(L"Home");
+  ci3.SetTitle(L"Bank");
+  ci3.SetUser(L"jdoe");
+  ci3.SetPassword(L"secret-three");
+  ci3.SetEmail(L"jdoe@example.com");
+}
+
+TEST_F(SearchIndexTest, Candidates)
+{
+  ItemList il;
+  il[ci1.GetUUID()] = ci1;
+  il[ci2.GetUUID()] = ci2;
+  il[ci3.GetUUID()] = ci3;
+
+  CSearchIndex si;
+  si.Build(il);
+  EXPECT_EQ(3U, si.GetNumEntries());
+
+  UUIDSet cands;
+  EXPECT_TRUE(si.GetCandidates(L"EXCHANGE", CItemData::TITLE, cands));
+  EXPECT_EQ(1U, cands.size());
+  EXPECT_EQ(1U, cands.count(ci1.GetUUID()));
+
+  cands.clear();
+  EXPECT_TRUE(si.GetCandidates(L"example.com", CItemData::FieldBits().set(), cands));
+  EXPECT_EQ(2U, cands.size());
+  EXPECT_EQ(0U, cands.count(ci2.GetUUID()));
+
+  cands.clear();
+  EXPECT_TRUE(si.GetCandidates(L"nothing like it", CItemData::NOTES, cands));
+  EXPECT_TRUE(cands.empty());
+
+  // Too short, or not an indexed field
+  EXPECT_FALSE(si.GetCandidates(L"jd", CItemData::USER, cands));
+  EXPECT_FALSE(si.GetCandidates(L"secret", CItemData::PASSWORD, cands));
+
+  // Same text in a different field isn't a candidate
+  EXPECT_FALSE(si.MayContain(ci2.GetUUID(), CItemData::TITLE, L"exchange"));
+  EXPECT_TRUE(si.MayContain(ci2.GetUUID(), CItemData::NOTES, L"BOTTOM"));
+  EXPECT_TRUE(si.MayContain(ci2.GetUUID(), CItemData::PASSWORD, L"whatever"));
+}
+
+TEST_F(SearchIndexTest, Update)
+{
+  CSearchIndex si;
+  si.Add(ci1);
+  si.Add(ci2);
+
+  ci1.SetTitle(L"Webmail");
+  si.Update(ci1);
+  EXPECT_FALSE(si.MayContain(ci1.GetUUID(), CItemData::TITLE, L"exchange"));
+  EXPECT_TRUE(si.MayContain(ci1.GetUUID(), CItemData::TITLE, L"webm"));
+
+  si.Remove(ci2.GetUUID());
+  EXPECT_FALSE(si.IsIndexed(ci2.GetUUID()));
+  UUIDSet cands;
+  EXPECT_TRUE(si.GetCandidates(L"router", CItemData::TITLE, cands));
+  EXPECT_TRUE(cands.empty());
+
+  // Slot reuse
+  si.Add(ci3);
+  cands.clear();
+  EXPECT_TRUE(si.GetCandidates(L"jdoe", CItemData::USER, cands));
+  EXPECT_EQ(2U, cands.size());
+}
+
+TEST_F(SearchIndexTest, CoreAndCommands)
+{
+  PWScore core;
+  core.SetSearchIndexEnabled(true);
+  ASSERT_NE(nullptr, core.GetSearchIndex());
+
+  core.Execute(AddEntryCommand::Create(&core, ci1));
+  core.Execute(AddEntryCommand::Create(&core, ci2));
+  EXPECT_EQ(2U, core.GetSearchIndex()->GetNumEntries());
+
+  core.Execute(UpdateEntryCommand::Create(&core, ci2, CItemData::TITLE, L"Modem"));
+  EXPECT_FALSE(core.GetSearchIndex()->MayContain(ci2.GetUUID(), CItemData::TITLE, L"router"));
+  core.Undo();
+  EXPECT_TRUE(core.GetSearchIndex()->MayContain(ci2.GetUUID(), CItemData::TITLE, L"router"));
+
+  // FindMatches must give the same answer with or without the index
+  for (const wchar_t *text : {L"exchange", L"ex", L"JDOE", L"bottom", L"zzz"}) {
+    size_t nWith(0), nWithout(0);
+    CItemData::FieldBits bsFields;
+    bsFields.set();
+    ::FindMatches(StringX(text), false, bsFields, false, stringT{}, CItemData::END,
+                  PWSMatch::MR_INVALID, false, core.GetEntryIter(), core.GetEntryEndIter(),
+                  get_second<ItemList>{}, [&nWith](ItemListConstIter, bool *) {nWith++;},
+                  core.GetSearchIndex());
+    ::FindMatches(StringX(text), false, bsFields, false, stringT{}, CItemData::END,
+                  PWSMatch::MR_INVALID, false, core.GetEntryIter(), core.GetEntryEndIter(),
+                  get_second<ItemList>{}, [&nWithout](ItemListConstIter, bool *) {nWithout++;});
+    EXPECT_EQ(nWithout, nWith) << text;
+  }
+
+  core.Execute(DeleteEntryCommand::Create(&core, ci1));
+  EXPECT_EQ(1U, core.GetSearchIndex()->GetNumEntries());
+
+  core.SetSearchIndexEnabled(false);
+  EXPECT_EQ(nullptr, core.GetSearchIndex());
+  core.ClearCommands();
+}
@@ -0,0 +1,110 @@
+/*
+* Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SecureStringTest.cpp: Unit test for the inline-storage secure strings
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include <utility>
+
+#include "core/SecureString.h"
+#include "gtest/gtest.h"
+
+TEST(SecureStringTest, InlineAndHeap)
+{
+  SecureStringX s0;
+  EXPECT_TRUE(s0.empty());
+  EXPECT_TRUE(s0.IsInline());
+  EXPECT_EQ(L'\0', s0.c_str()[0]);
+
+  SecureStringX s1(L"short title");
+  EXPECT_EQ(11U, s1.length());
+  EXPECT_TRUE(s1.IsInline());
+  EXPECT_STREQ(L"short title", s1.c_str());
+
+  const StringX sxLong(100, L'x');
+  SecureStringX s2(sxLong);
+  EXPECT_FALSE(s2.IsInline());
+  EXPECT_EQ(100U, s2.length());
+  EXPECT_TRUE(s2.Str<StringX>() == sxLong);
+
+  // Growing past the inline buffer keeps the contents
+  SecureStringX s3(L"abc");
+  for (int i = 0; i < 40; i++)
+    s3 += L'd';
+  EXPECT_FALSE(s3.IsInline());
+  EXPECT_EQ(43U, s3.length());
+  EXPECT_EQ(L'c', s3[2]);
+  EXPECT_EQ(L'd', s3[42]);
+  EXPECT_EQ(L'\0', s3.c_str()[43]);
+
+  s3.clear();
+  EXPECT_TRUE(s3.empty());
+  EXPECT_EQ(L'\0', s3.c_str()[0]);
+}
+
+TEST(SecureStringTest, CopyAndMove)
+{
+  SecureStringX a(L"inline"), b(a);
+  EXPECT_TRUE(a == b);
+
+  SecureStringX c(std::move(a));
+  EXPECT_TRUE(c == b);
+  EXPECT_TRUE(a.empty());
+  EXPECT_TRUE(a.IsInline());
+
+  SecureStringX big(StringX(50, L'y'));
+  const wchar_t *heap = big.c_str();
+  SecureStringX d(std::move(big));
+  EXPECT_EQ(heap, d.c_str()); // heap storage changes hands, no copy
+  EXPECT_TRUE(big.empty());
+  EXPECT_TRUE(big.IsInline());
+
+  d = c;
+  EXPECT_TRUE(d == c);
+  d = L"other";
+  EXPECT_TRUE(d != c);
+}
+
+TEST(SecureStringTest, Compare)
+{
+  const SecureStringX a(L"abc"), b(L"abd"), c(L"ab");
+  EXPECT_TRUE(a < b);
+  EXPECT_TRUE(c < a);
+  EXPECT_FALSE(a < c);
+  EXPECT_EQ(0, a.compare(SecureStringX(L"abc")));
+
+  SecureStringX lower(L"MiXeD");
+  ToLower(lower);
+  EXPECT_STREQ(L"mixed", lower.c_str());
+}
+
+TEST(SecureStringTest, UTF8)
+{
+  SecureStringU8 utf8;
+  ToSecureUTF8(StringX(L"plain"), utf8);
+  EXPECT_STREQ("plain", utf8.c_str());
+
+  // 2, 3 & 4 byte sequences
+  StringX sx(L"é€");
+  sx += (sizeof(wchar_t) == 2) ? StringX(L"\xd83d\xde00") : StringX(1, wchar_t(0x1f600));
+  ToSecureUTF8(sx, utf8);
+  EXPECT_STREQ("\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", utf8.c_str());
+
+  StringX back;
+  FromSecureUTF8(utf8, back);
+  EXPECT_TRUE(back == sx);
+
+  // Overlong, truncated & surrogate encodings become U+FFFD
+  const char *bad[] = {"\xc0\xaf", "\xe2\x82", "\xed\xa0\x80", "\xff"};
+  for (const char *b : bad) {
+    FromSecureUTF8(SecureStringU8(b), back);
+    EXPECT_TRUE(back == StringX(L"�")) << "input length " << strlen(b);
+  }
+}
@@ -2977,6 +2977,7 @@ void DboxMain::UpdateAccessTime(const pws_os::CUUID &uuid)
       return;
     CItemData &item = iter->second;
     item.SetATime();
+    m_core.RefreshEntryMetadata(item);
     SetEntryTimestampsChanged(true);
 
     if (!IsGUIEmpty() &&
@@ -30,6 +30,7 @@
 #include "core/core.h"
 #include "core/PWHistory.h"
 #include "core/PWSLog.h"
+#include "core/PWSTrace.h"
 #include "core/StringXStream.h"
 
 #include "os/Debug.h"
@@ -1371,20 +1372,24 @@ void DboxMain::RefreshViews(const ViewType iView)
 
   m_bBoldItem = false;
 
-  for (auto listPos = m_core.GetEntryIter(); listPos != m_core.GetEntryEndIter();
-       listPos++) {
-    CItemData &ci = m_core.GetEntry(listPos);
-    DisplayInfo *pdi = GetEntryGUIInfo(ci, true);
-    if (pdi != NULL) {
-      if (iView & LISTONLY) {
-        pdi->list_index = -1;
-      }
-      if (iView & TREEONLY) {
-        pdi->tree_item = 0;
+  {
+    PWSTrace::Span span(m_bFilterActive ? "Filter" : "RefreshViews");
+    for (auto listPos = m_core.GetEntryIter(); listPos != m_core.GetEntryEndIter();
+         listPos++) {
+      CItemData &ci = m_core.GetEntry(listPos);
+      DisplayInfo *pdi = GetEntryGUIInfo(ci, true);
+      if (pdi != NULL) {
+        if (iView & LISTONLY) {
+          pdi->list_index = -1;
+        }
+        if (iView & TREEONLY) {
+          pdi->tree_item = 0;
+        }
       }
-    }
 
-    InsertItemIntoGUITreeList(ci, -1, false, iView);
+      InsertItemIntoGUITreeList(ci, -1, false, iView);
+    }
+    span.SetArg(m_bNumPassedFiltering);
   }
 
   // Need to add any empty groups into the view
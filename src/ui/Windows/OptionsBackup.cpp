@@ -321,7 +321,7 @@ BOOL COptionsBackup::VerifyFields()
   ((CEdit *)GetDlgItem(IDC_BACKUPMAXINC))->GetWindowText(csText);
   m_MaxNumIncBackups = _wtoi(csText);
 
-  if (m_BackupSuffix == PWSprefs::BKSFX_IncNumber &&
+  if (m_BackupSuffix != PWSprefs::BKSFX_None &&
       ((m_MaxNumIncBackups < M_prefminBackupIncrement()) ||
        (m_MaxNumIncBackups > M_prefmaxBackupIncrement()))) {
     csText.Format(IDS_OPTBACKUPMAXNUM, M_prefminBackupIncrement(), M_prefmaxBackupIncrement());
@@ -351,7 +351,8 @@ void COptionsBackup::OnComboChanged()
 {
   int nIndex = m_backupsuffix_cbox.GetCurSel();
   m_BackupSuffix = (int)m_backupsuffix_cbox.GetItemData(nIndex);
-  if (m_BackupSuffix == PWSprefs::BKSFX_IncNumber) {
+  // Both numbered and date-time backups are rotated
+  if (m_BackupSuffix != PWSprefs::BKSFX_None) {
     GetDlgItem(IDC_BACKUPMAXINC)->EnableWindow(TRUE);
     GetDlgItem(IDC_BKPMAXINCSPIN)->EnableWindow(TRUE);
     GetDlgItem(IDC_BACKUPMAX)->EnableWindow(TRUE);
@@ -12,6 +12,7 @@
 
 #include "../../core/PWScore.h"
 #include "../../core/Match.h"
+#include "../../core/PWSfile.h"
 
 #include "./strutils.h"
 
@@ -37,7 +38,7 @@ struct UserArgs {
   StringX safe;
   StringX passphrase[2];
   enum OpType {Unset, Import, Export, CreateNew, Search, Add,
-               Diff, Sync, Merge, Help} Operation{Unset};
+               Diff, Sync, Merge, Calibrate, Encrypt, Decrypt, Batch, Daemon, Help} Operation{Unset};
   enum {Print, Delete, Update, ClearFields, ChangePassword, GenerateTotpCode} SearchAction{Print};
   enum {Unknown, XML, Text} Format{Unknown};
 
@@ -62,6 +63,26 @@ struct UserArgs {
   DiffFmt dfmt{DiffFmt::Unified};
   unsigned int colwidth{60}; // for side-by-side diff
 
+  // how search results and diffs are printed
+  enum class OutputFmt { Text, JSONL };
+  OutputFmt outputFmt{OutputFmt::Text};
+
+  // used by encrypt & decrypt
+  PWSfile::CryptOptions cryptOptions;
+
+  // where to write a Chrome trace of the operation, if anywhere
+  std::wstring traceFile;
+
+  // performance counters to print when done
+  enum class StatsFmt { None, Text, JSON };
+  StatsFmt stats{StatsFmt::None};
+
+  // used by daemon mode: whether to have a daemon run the operation, and how long it may be idle
+  bool connect{false};
+  std::string socket; // empty for DefaultDaemonSocket()
+  std::vector<const char *> connectArgs; // the argv elements of --connect, not sent on
+  unsigned int idleTimeout{300};
+
   // used by add & update
   using FieldValue = std::tuple<CItemData::FieldType, StringX>;
   using FieldUpdates = std::vector< FieldValue >;
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#include "./batch.h"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using Args = vector<string>;
+
+static Args Parse(const string &line)
+{
+  Args args;
+  string error;
+  EXPECT_TRUE(ParseBatchLine(line, args, error)) << line;
+  EXPECT_TRUE(error.empty());
+  return args;
+}
+
+static string ParseError(const string &line)
+{
+  Args args;
+  string error;
+  EXPECT_FALSE(ParseBatchLine(line, args, error)) << line;
+  return error;
+}
+
+TEST(BatchTest, SkipsBlankLinesAndComments)
+{
+  EXPECT_TRUE(Parse("").empty());
+  EXPECT_TRUE(Parse("   \t\r").empty());
+  EXPECT_TRUE(Parse("# --add=Title=x").empty());
+  EXPECT_EQ(Args({"--add=Title=x"}), Parse("--add=Title=x  # a comment"));
+  EXPECT_EQ(Args({"--add=Title=a#b"}), Parse("--add=Title=a#b"));
+}
+
+TEST(BatchTest, QuotesAsShell)
+{
+  EXPECT_EQ(Args({"--search=x", "--delete", "--yes"}), Parse("  --search=x\t--delete --yes\r"));
+  EXPECT_EQ(Args({"--add=Title=Bank Account,\"Created Time\"=now"}),
+            Parse("--add=Title=\"Bank Account\",'\"Created Time\"'=now"));
+  EXPECT_EQ(Args({"--search=a b\"c\\"}), Parse("--search=a\\ b\"\\\"c\\\\\""));
+  EXPECT_EQ(Args({"--search=$x\\n"}), Parse("'--search=$x\\n'"));
+  EXPECT_EQ(Args({"", "x"}), Parse("\"\" x"));
+
+  EXPECT_EQ("unterminated \"", ParseError("--search=\"x"));
+  EXPECT_EQ("unterminated '", ParseError("--search='x"));
+  EXPECT_EQ("\\ at end of line", ParseError("--search=x\\"));
+}
+
+TEST(BatchTest, JSONArrays)
+{
+  EXPECT_TRUE(Parse("[]").empty());
+  EXPECT_EQ(Args({"--search=Richard Miles", "--update=Notes=Line 1\nLine 2", "--yes"}),
+            Parse(" [\"--search=Richard Miles\",\"--update=Notes=Line 1\\nLine 2\" , \"--yes\"] "));
+  EXPECT_EQ(Args({"\"\\/\b\f\r\t"}), Parse("[\"\\\"\\\\\\/\\b\\f\\r\\t\"]"));
+  // e acute, euro sign, and G clef as a surrogate pair
+  EXPECT_EQ(Args({"\xC3\xA9\xE2\x82\xAC\xF0\x9D\x84\x9E"}), Parse("[\"\\u00e9\\u20AC\\ud834\\udd1e\"]"));
+  EXPECT_EQ(Args({"\xC3\xA9"}), Parse("[\"\xC3\xA9\"]")); // UTF-8 as is
+
+  EXPECT_EQ("expected a string", ParseError("[--add=Title=x]"));
+  EXPECT_EQ("expected a string", ParseError("[\"x\",]"));
+  EXPECT_EQ("expected , or ]", ParseError("[\"x\" \"y\"]"));
+  EXPECT_EQ("unterminated string", ParseError("[\"x"));
+  EXPECT_EQ("unexpected text after ]", ParseError("[\"x\"] --yes"));
+  EXPECT_EQ("invalid escape \\x", ParseError("[\"\\x\"]"));
+  EXPECT_EQ("invalid \\u escape", ParseError("[\"\\u12\"]"));
+  EXPECT_EQ("invalid surrogate pair", ParseError("[\"\\ud834\"]"));
+  EXPECT_EQ("invalid surrogate pair", ParseError("[\"\\udd1e\"]"));
+  EXPECT_EQ("control character in string", ParseError("[\"a\tb\"]"));
+}
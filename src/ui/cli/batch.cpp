@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#include "stdafx.h"
+#include "./batch.h"
+
+#include <cctype>
+
+using namespace std;
+
+namespace {
+  bool IsSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  void AppendUtf8(string &s, unsigned long cp)
+  {
+    if (cp < 0x80) {
+      s += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+      s += static_cast<char>(0xC0 | (cp >> 6));
+      s += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+      s += static_cast<char>(0xE0 | (cp >> 12));
+      s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      s += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+      s += static_cast<char>(0xF0 | (cp >> 18));
+      s += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+      s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      s += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+  }
+
+  bool ReadHex4(const string &line, size_t &i, unsigned long &value)
+  {
+    if (i + 4 > line.length())
+      return false;
+    value = 0;
+    for (size_t end = i + 4; i < end; i++) {
+      const char c = line[i];
+      if (!isxdigit(static_cast<unsigned char>(c)))
+        return false;
+      value = value * 16 + (isdigit(static_cast<unsigned char>(c)) ? c - '0' : (tolower(c) - 'a' + 10));
+    }
+    return true;
+  }
+
+  // A JSON string, starting at the opening quote
+  bool ParseJSONString(const string &line, size_t &i, string &value, string &error)
+  {
+    value.clear();
+    for (i++; i < line.length(); i++) {
+      const char c = line[i];
+      if (c == '"') {
+        i++;
+        return true;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        error = "control character in string";
+        return false;
+      }
+      if (c != '\\') {
+        value += c;
+        continue;
+      }
+      if (++i == line.length())
+        break;
+      switch (line[i]) {
+        case '"': case '\\': case '/': value += line[i]; break;
+        case 'b': value += '\b'; break;
+        case 'f': value += '\f'; break;
+        case 'n': value += '\n'; break;
+        case 'r': value += '\r'; break;
+        case 't': value += '\t'; break;
+        case 'u': {
+          unsigned long cp;
+          i++;
+          if (!ReadHex4(line, i, cp)) {
+            error = "invalid \\u escape";
+            return false;
+          }
+          if (cp >= 0xD800 && cp < 0xDC00) { // high surrogate, needs its low one
+            unsigned long low = 0;
+            const bool bEscape = line.compare(i, 2, "\\u") == 0;
+            i += 2;
+            if (!bEscape || !ReadHex4(line, i, low) || low < 0xDC00 || low >= 0xE000) {
+              error = "invalid surrogate pair";
+              return false;
+            }
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          } else if (cp >= 0xDC00 && cp < 0xE000) {
+            error = "invalid surrogate pair";
+            return false;
+          }
+          AppendUtf8(value, cp);
+          i--; // for the loop's i++
+          break;
+        }
+        default:
+          error = string("invalid escape \\") + line[i];
+          return false;
+      }
+    }
+    error = "unterminated string";
+    return false;
+  }
+
+  bool ParseJSONArray(const string &line, size_t i, vector<string> &args, string &error)
+  {
+    auto skipSpace = [&line, &i]() {while (i < line.length() && IsSpace(line[i])) i++;};
+
+    i++; // '['
+    skipSpace();
+    if (i < line.length() && line[i] == ']') {
+      i++;
+    } else {
+      while (true) {
+        if (i == line.length() || line[i] != '"') {
+          error = "expected a string";
+          return false;
+        }
+        string arg;
+        if (!ParseJSONString(line, i, arg, error))
+          return false;
+        args.push_back(arg);
+        skipSpace();
+        if (i < line.length() && line[i] == ',') {
+          i++;
+          skipSpace();
+        } else if (i < line.length() && line[i] == ']') {
+          i++;
+          break;
+        } else {
+          error = "expected , or ]";
+          return false;
+        }
+      }
+    }
+    skipSpace();
+    if (i != line.length()) {
+      error = "unexpected text after ]";
+      return false;
+    }
+    return true;
+  }
+
+  // Quoting as by a POSIX shell, without expansions
+  bool ParseArgLine(const string &line, size_t i, vector<string> &args, string &error)
+  {
+    while (i < line.length()) {
+      if (IsSpace(line[i])) {
+        i++;
+        continue;
+      }
+      if (line[i] == '#')
+        break;
+
+      string arg;
+      while (i < line.length() && !IsSpace(line[i])) {
+        const char c = line[i++];
+        if (c == '\'') {
+          const size_t end = line.find('\'', i);
+          if (end == string::npos) {
+            error = "unterminated '";
+            return false;
+          }
+          arg.append(line, i, end - i);
+          i = end + 1;
+        } else if (c == '"') {
+          while (i < line.length() && line[i] != '"') {
+            if (line[i] == '\\' && i + 1 < line.length() &&
+                (line[i + 1] == '"' || line[i + 1] == '\\' || line[i + 1] == '$' || line[i + 1] == '`'))
+              i++;
+            arg += line[i++];
+          }
+          if (i == line.length()) {
+            error = "unterminated \"";
+            return false;
+          }
+          i++;
+        } else if (c == '\\') {
+          if (i == line.length()) {
+            error = "\\ at end of line";
+            return false;
+          }
+          arg += line[i++];
+        } else {
+          arg += c;
+        }
+      }
+      args.push_back(arg);
+    }
+    return true;
+  }
+}
+
+bool ParseBatchLine(const string &line, vector<string> &args, string &error)
+{
+  args.clear();
+  error.clear();
+
+  size_t i = 0;
+  while (i < line.length() && IsSpace(line[i]))
+    i++;
+  if (i < line.length() && line[i] == '[')
+    return ParseJSONArray(line, i, args, error);
+  return ParseArgLine(line, i, args, error);
+}
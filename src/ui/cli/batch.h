@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#pragma once
+
+/*
+ * Batch mode: --batch=<file|-> runs an operation per line of a script, with
+ * the safe opened once and saved once, when all have succeeded.
+ *
+ * A line holds the arguments of an operation, as they'd follow the safe on
+ * the command line, either
+ *
+ *   --add=Title="Bank Account",Username=jdoe     # quoted as by a shell
+ *
+ * or as a JSON array of strings, which is easier to generate:
+ *
+ *   ["--search=jdoe", "--update=Notes=Said \"call me J\"", "--yes"]
+ *
+ * Blank lines and those starting with # are skipped.
+ */
+
+#include <string>
+#include <vector>
+
+// Splits a line of a batch script into arguments, leaving args empty for
+// blank lines and comments. Returns false, with why in error, if malformed.
+bool ParseBatchLine(const std::string &line, std::vector<std::string> &args,
+                    std::string &error);
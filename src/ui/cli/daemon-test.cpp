@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#ifndef _WIN32
+
+#include "./daemon.h"
+#include "core/PWScore.h"
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+TEST(DaemonTest, Strings)
+{
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  const vector<string> sent{"/home/user", "--search=x", "", string("a\0b", 3)};
+  ASSERT_TRUE(WriteStrings(fds[0], sent));
+  vector<string> received;
+  ASSERT_TRUE(ReadStrings(fds[1], received));
+  EXPECT_EQ(sent, received);
+
+  // Too many strings
+  const unsigned char tooMany[4] = {0xff, 0xff, 0, 0};
+  ASSERT_EQ(4, write(fds[0], tooMany, sizeof(tooMany)));
+  EXPECT_FALSE(ReadStrings(fds[1], received));
+
+  // Truncated
+  const unsigned char truncated[6] = {1, 0, 0, 0, 5, 0};
+  ASSERT_EQ(6, write(fds[0], truncated, sizeof(truncated)));
+  close(fds[0]);
+  EXPECT_FALSE(ReadStrings(fds[1], received));
+  close(fds[1]);
+}
+
+TEST(DaemonTest, Args)
+{
+  // As parseArgs would find them
+  char prog[] = "pwsafe-cli", safe[] = "my.psafe3", add[] = "--add=title=-Cx",
+       pass[] = "-P", passVal[] = "-Csecret", connect[] = "-C",
+       connectSock[] = "--connect=/tmp/s", grouped[] = "-yCsock";
+  char *argv[] = {prog, safe, add, pass, passVal, connect, connectSock, grouped};
+  const int argc = sizeof(argv) / sizeof(argv[0]);
+
+  const vector<string> args = DaemonArgs(argc, argv, {connect, connectSock, grouped});
+  EXPECT_EQ(vector<string>({"my.psafe3", "--add=title=-Cx", "-P", "-Csecret", "-y"}), args);
+  EXPECT_EQ(argc - 1, static_cast<int>(DaemonArgs(argc, argv, {}).size()));
+}
+
+TEST(DaemonTest, ServeAndCall)
+{
+  char dirTemplate[] = "/tmp/pwsafe-cli-test-XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+  const string dir(dirTemplate);
+  const string socket = dir + "/test.sock";
+
+  char cwd[PATH_MAX];
+  ASSERT_NE(nullptr, getcwd(cwd, sizeof(cwd)));
+
+  string handlerCwd;
+  auto handler = [&handlerCwd](const vector<string> &args) {
+    char buf[PATH_MAX];
+    handlerCwd = getcwd(buf, sizeof(buf)) != nullptr ? buf : "";
+    wcout << L"args: " << args.size() << endl;
+    cerr << "to stderr" << endl;
+    return (!args.empty() && args[0] == "three") ? 3 : 0;
+  };
+
+  int serveStatus = -1;
+  thread server([&]() {serveStatus = ServeDaemon(socket, 2, handler);});
+
+  struct stat st;
+  for (int i = 0; i < 200 && lstat(socket.c_str(), &st) != 0; i++)
+    this_thread::sleep_for(chrono::milliseconds(10));
+  ASSERT_EQ(0, lstat(socket.c_str(), &st));
+  EXPECT_TRUE(S_ISSOCK(st.st_mode));
+  EXPECT_EQ(0U, st.st_mode & 077); // only for us
+
+  string out, err;
+  EXPECT_EQ(3, CallDaemon(socket, {"three", "--search=x"}, out, err));
+  EXPECT_EQ("args: 2\n", out);
+  EXPECT_EQ("to stderr\n", err);
+  EXPECT_EQ(string(cwd), handlerCwd);
+
+  // A second daemon can't take over the socket
+  EXPECT_EQ(PWScore::FAILURE, ServeDaemon(socket, 1, handler));
+
+  // The server stops once idle, and cleans up after itself
+  server.join();
+  EXPECT_EQ(PWScore::SUCCESS, serveStatus);
+  EXPECT_NE(0, lstat(socket.c_str(), &st));
+  EXPECT_EQ(PWScore::FAILURE, CallDaemon(socket, {"three"}, out, err));
+
+  rmdir(dir.c_str());
+}
+
+#endif /* _WIN32 */
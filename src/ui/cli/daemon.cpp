@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#include "stdafx.h"
+#include "./daemon.h"
+#include "./strutils.h"
+
+#include "core/PWScore.h"
+#include "os/utf8conv.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifndef _WIN32
+
+namespace {
+  const uint32_t MAX_STRINGS = 1024;
+  const uint32_t MAX_STRING_LEN = 64 << 20; // a big --print or --diff
+  const int IO_TIMEOUT = 10; // seconds, so a stuck client can't stall the daemon
+
+  volatile sig_atomic_t s_bStop = 0;
+
+  // stderr is wide oriented once wcerr's been used, so all goes there
+  wstring W(const string &s)
+  {
+    return Utf82wstring(s.c_str());
+  }
+
+  extern "C" void OnStopSignal(int)
+  {
+    s_bStop = 1;
+  }
+
+  bool WriteAll(int fd, const void *buf, size_t len)
+  {
+    const char *p = static_cast<const char *>(buf);
+    while (len > 0) {
+      const ssize_t n = write(fd, p, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= size_t(n);
+    }
+    return true;
+  }
+
+  bool ReadAll(int fd, void *buf, size_t len)
+  {
+    char *p = static_cast<char *>(buf);
+    while (len > 0) {
+      const ssize_t n = read(fd, p, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= size_t(n);
+    }
+    return true;
+  }
+
+  bool WriteUint32(int fd, uint32_t v)
+  {
+    const unsigned char buf[4] = {static_cast<unsigned char>(v), static_cast<unsigned char>(v >> 8),
+                                  static_cast<unsigned char>(v >> 16), static_cast<unsigned char>(v >> 24)};
+    return WriteAll(fd, buf, sizeof(buf));
+  }
+
+  bool ReadUint32(int fd, uint32_t &v)
+  {
+    unsigned char buf[4];
+    if (!ReadAll(fd, buf, sizeof(buf)))
+      return false;
+    v = uint32_t(buf[0]) | uint32_t(buf[1]) << 8 | uint32_t(buf[2]) << 16 | uint32_t(buf[3]) << 24;
+    return true;
+  }
+
+  bool MakeAddress(const string &path, sockaddr_un &addr)
+  {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.length() >= sizeof(addr.sun_path)) {
+      wcerr << L"Invalid socket path: " << W(path) << endl;
+      return false;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
+  }
+
+  // Anyone who could write to the directory could replace our socket
+  bool IsPrivateDir(const string &socketPath)
+  {
+    const size_t slash = socketPath.rfind('/');
+    const string dir = (slash == string::npos) ? string(".") :
+                       (slash == 0) ? string("/") : socketPath.substr(0, slash);
+    struct stat st;
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+      wcerr << W(dir) << L" must be a directory of this user's that others can't write to" << endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool PeerIsUs(int fd)
+  {
+#if defined(SO_PEERCRED)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+           cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+  }
+
+  void SetTimeouts(int fd)
+  {
+    struct timeval tv = {IO_TIMEOUT, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  }
+
+  // Redirects the standard streams while a request is handled
+  class CapturedStreams
+  {
+  public:
+    CapturedStreams()
+      : m_cout(cout.rdbuf(m_out.rdbuf())), m_cerr(cerr.rdbuf(m_err.rdbuf())),
+        m_wcout(wcout.rdbuf(m_wout.rdbuf())), m_wcerr(wcerr.rdbuf(m_werr.rdbuf())),
+        m_wcin(wcin.rdbuf(m_win.rdbuf())) {} // no prompting for input
+    ~CapturedStreams()
+    {
+      cout.rdbuf(m_cout); cerr.rdbuf(m_cerr);
+      wcout.rdbuf(m_wcout); wcerr.rdbuf(m_wcerr);
+      wcin.rdbuf(m_wcin);
+      wcin.clear();
+    }
+
+    string GetOut() const {return m_out.str() + pws_os::tomb(m_wout.str());}
+    string GetErr() const {return m_err.str() + pws_os::tomb(m_werr.str());}
+
+  private:
+    ostringstream m_out, m_err;
+    wostringstream m_wout, m_werr;
+    wistringstream m_win;
+    streambuf *m_cout, *m_cerr;
+    wstreambuf *m_wcout, *m_wcerr, *m_wcin;
+  };
+
+  void Serve(int fd, const DaemonHandler &handler)
+  {
+    vector<string> request;
+    if (!ReadStrings(fd, request) || request.empty())
+      return;
+
+    int cwd = open(".", O_RDONLY);
+    int status = PWScore::FAILURE;
+    string out, err;
+    {
+      CapturedStreams captured;
+      if (chdir(request[0].c_str()) != 0) {
+        wcerr << L"Couldn't change to " << W(request[0]) << L": " << W(strerror(errno)) << endl;
+      } else {
+        try {
+          status = handler(vector<string>(request.begin() + 1, request.end()));
+        } catch (const exception &e) {
+          wcerr << e.what() << endl;
+          status = PWScore::FAILURE;
+        }
+      }
+      wcout.flush(); wcerr.flush();
+      out = captured.GetOut();
+      err = captured.GetErr();
+    }
+    if (cwd >= 0) {
+      if (fchdir(cwd) != 0)
+        wcerr << L"Couldn't restore working directory: " << W(strerror(errno)) << endl;
+      close(cwd);
+    }
+
+    WriteStrings(fd, {to_string(status), out, err});
+  }
+}
+
+bool WriteStrings(int fd, const vector<string> &strings)
+{
+  if (!WriteUint32(fd, static_cast<uint32_t>(strings.size())))
+    return false;
+  for (const auto &s : strings) {
+    if (!WriteUint32(fd, static_cast<uint32_t>(s.length())) ||
+        !WriteAll(fd, s.data(), s.length()))
+      return false;
+  }
+  return true;
+}
+
+bool ReadStrings(int fd, vector<string> &strings)
+{
+  uint32_t n;
+  if (!ReadUint32(fd, n) || n > MAX_STRINGS)
+    return false;
+  strings.assign(n, string());
+  for (auto &s : strings) {
+    uint32_t len;
+    if (!ReadUint32(fd, len) || len > MAX_STRING_LEN)
+      return false;
+    s.resize(len);
+    if (len > 0 && !ReadAll(fd, &s[0], len))
+      return false;
+  }
+  return true;
+}
+
+string DefaultDaemonSocket()
+{
+  const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+  string dir;
+  if (runtimeDir != nullptr && *runtimeDir != '\0') {
+    dir = runtimeDir;
+  } else {
+    dir = "/tmp/pwsafe-cli-" + to_string(geteuid());
+    mkdir(dir.c_str(), 0700); // if it's someone else's, ServeDaemon will refuse it
+  }
+  return dir + "/pwsafe-cli.sock";
+}
+
+string CanonicalPath(const string &path)
+{
+  char buf[PATH_MAX];
+  return (realpath(path.c_str(), buf) != nullptr) ? string(buf) : string();
+}
+
+int ServeDaemon(const string &socketPath, unsigned idleSecs, const DaemonHandler &handler)
+{
+  sockaddr_un addr;
+  if (!MakeAddress(socketPath, addr) || !IsPrivateDir(socketPath))
+    return PWScore::FAILURE;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    wcerr << L"socket: " << W(strerror(errno)) << endl;
+    return PWScore::FAILURE;
+  }
+
+  // A socket left behind by a daemon that died can go, a live one can't
+  struct stat st;
+  if (lstat(socketPath.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode) ||
+        connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+      wcerr << W(socketPath) << L" is in use" << endl;
+      close(fd);
+      return PWScore::FAILURE;
+    }
+    unlink(socketPath.c_str());
+    close(fd);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  }
+
+  const mode_t oldMask = umask(077);
+  const bool bBound = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+  umask(oldMask);
+  if (!bBound || listen(fd, 8) != 0) {
+    wcerr << L"Couldn't listen on " << W(socketPath) << L": " << W(strerror(errno)) << endl;
+    close(fd);
+    return PWScore::FAILURE;
+  }
+
+  struct sigaction sa, oldInt, oldTerm, oldHup, oldPipe;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = OnStopSignal; // no SA_RESTART, so that poll() returns
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, &oldInt);
+  sigaction(SIGTERM, &sa, &oldTerm);
+  sigaction(SIGHUP, &sa, &oldHup);
+  sa.sa_handler = SIG_IGN; // a client going away mustn't kill us
+  sigaction(SIGPIPE, &sa, &oldPipe);
+  s_bStop = 0;
+
+  using clock = chrono::steady_clock;
+  clock::time_point lastRequest = clock::now();
+  int status = PWScore::SUCCESS;
+
+  while (!s_bStop) {
+    int timeout = -1;
+    if (idleSecs != 0) {
+      const auto idle = chrono::duration_cast<chrono::milliseconds>(clock::now() - lastRequest);
+      const auto left = chrono::milliseconds(chrono::seconds(idleSecs)) - idle;
+      if (left.count() <= 0)
+        break; // idle for too long
+      timeout = static_cast<int>(left.count());
+    }
+
+    struct pollfd pfd = {fd, POLLIN, 0};
+    const int n = poll(&pfd, 1, timeout);
+    if (n < 0 && errno != EINTR) {
+      wcerr << L"poll: " << W(strerror(errno)) << endl;
+      status = PWScore::FAILURE;
+      break;
+    }
+    if (n <= 0)
+      continue;
+
+    int client = accept(fd, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    if (PeerIsUs(client)) {
+      SetTimeouts(client);
+      Serve(client, handler);
+      lastRequest = clock::now();
+    } else {
+      wcerr << L"Refused a connection from another user" << endl;
+    }
+    close(client);
+  }
+
+  close(fd);
+  unlink(socketPath.c_str());
+  sigaction(SIGINT, &oldInt, nullptr);
+  sigaction(SIGTERM, &oldTerm, nullptr);
+  sigaction(SIGHUP, &oldHup, nullptr);
+  sigaction(SIGPIPE, &oldPipe, nullptr);
+  return status;
+}
+
+int CallDaemon(const string &socketPath, const vector<string> &args,
+               string &out, string &err)
+{
+  // Not sending our arguments (passphrases, passwords...) to just anyone
+  sockaddr_un addr;
+  if (!MakeAddress(socketPath, addr) || !IsPrivateDir(socketPath))
+    return PWScore::FAILURE;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    wcerr << L"Couldn't connect to a daemon on " << W(socketPath) << L": " << W(strerror(errno)) << endl;
+    if (fd >= 0)
+      close(fd);
+    return PWScore::FAILURE;
+  }
+
+  char cwd[PATH_MAX];
+  vector<string> request;
+  request.push_back(getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : "/");
+  request.insert(request.end(), args.begin(), args.end());
+
+  vector<string> reply;
+  const bool bOK = WriteStrings(fd, request) && ReadStrings(fd, reply) && reply.size() == 3;
+  close(fd);
+  if (!bOK) {
+    wcerr << L"The daemon on " << W(socketPath) << L" didn't reply" << endl;
+    return PWScore::FAILURE;
+  }
+  out = reply[1];
+  err = reply[2];
+  return atoi(reply[0].c_str());
+}
+
+#else /* _WIN32 */
+
+bool WriteStrings(int, const vector<string> &) {return false;}
+bool ReadStrings(int, vector<string> &) {return false;}
+string DefaultDaemonSocket() {return string();}
+string CanonicalPath(const string &path) {return path;}
+
+int ServeDaemon(const string &, unsigned, const DaemonHandler &)
+{
+  wcerr << L"Daemon mode isn't supported on Windows" << endl;
+  return PWScore::FAILURE;
+}
+
+int CallDaemon(const string &, const vector<string> &, string &, string &)
+{
+  wcerr << L"Daemon mode isn't supported on Windows" << endl;
+  return PWScore::FAILURE;
+}
+
+#endif /* _WIN32 */
+
+vector<string> DaemonArgs(int argc, char *argv[], const vector<const char *> &connectArgs)
+{
+  vector<string> args;
+  for (int i = 1; i < argc; i++) {
+    if (find(connectArgs.begin(), connectArgs.end(), argv[i]) == connectArgs.end()) {
+      args.push_back(argv[i]);
+      continue;
+    }
+    // -C takes the rest of its token, so only options before it can share it, as in -yC
+    const string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      const size_t c = arg.find('C', 1);
+      if (c != string::npos && c > 1)
+        args.push_back(arg.substr(0, c));
+    }
+  }
+  return args;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#pragma once
+
+/*
+ * Daemon mode: a pwsafe-cli started with --daemon unlocks its safe once
+ * and then serves the operations of pwsafe-cli's started with --connect,
+ * over a Unix-domain socket, so that each needn't stretch the passphrase.
+ *
+ * Only processes of the same user may connect (checked with the peer's
+ * credentials, as well as by the socket's permissions).
+ *
+ * A request is the client's working directory followed by its arguments,
+ * a reply its exit status, stdout and stderr, each sent as a list of
+ * length prefixed strings.
+ */
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Called with a request's arguments, in its working directory, with
+// cout/wcout/cerr/wcerr captured for the reply. Returns the exit status.
+using DaemonHandler = std::function<int(const std::vector<std::string> &args)>;
+
+// $XDG_RUNTIME_DIR/pwsafe-cli.sock, else in a private directory in /tmp
+std::string DefaultDaemonSocket();
+
+// Absolute, with symbolic links resolved; empty if it doesn't exist
+std::string CanonicalPath(const std::string &path);
+
+// Serves requests until idle for idleSecs (0 for ever) or signalled
+int ServeDaemon(const std::string &socketPath, unsigned idleSecs,
+                const DaemonHandler &handler);
+
+// Runs args in the daemon, returning its exit status and output
+int CallDaemon(const std::string &socketPath, const std::vector<std::string> &args,
+               std::string &out, std::string &err);
+
+// The arguments to send the daemon: argv[1..] without the --connect
+// options, which are the elements of argv that parseArgs saw them in.
+// By address, as getopt_long may have permuted argv.
+std::vector<std::string> DaemonArgs(int argc, char *argv[],
+                                    const std::vector<const char *> &connectArgs);
+
+// Length prefixed string lists, as sent over the socket
+bool WriteStrings(int fd, const std::vector<std::string> &strings);
+bool ReadStrings(int fd, std::vector<std::string> &strings);
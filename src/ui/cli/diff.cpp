@@ -11,6 +11,7 @@
 #include "./diff.h"
 #include "./argutils.h"
 #include "./safeutils.h"
+#include "./jsonl.h"
 
 #include "../../os/file.h"
 #include "../../core/core.h"
@@ -21,6 +22,7 @@
 #include <iomanip>
 #include <functional>
 #include <cassert>
+#include <iostream>
 
 using namespace std;
 
@@ -106,8 +108,7 @@ lines_vec stream2vec(StringXStream &wss) {
     return vlines;
 }
 
-inline wostream& print_field_value(wostream &os, wchar_t tag,
-                                    const CItemData &item, CItemData::FieldType ft)
+StringX field_value(const CItemData &item, CItemData::FieldType ft)
 {
   StringX fieldValue;
   switch (ft) {
@@ -144,6 +145,13 @@ inline wostream& print_field_value(wostream &os, wchar_t tag,
       fieldValue = item.GetFieldValue(ft);
       break;
   }
+  return fieldValue;
+}
+
+inline wostream& print_field_value(wostream &os, wchar_t tag,
+                                    const CItemData &item, CItemData::FieldType ft)
+{
+  const StringX fieldValue{field_value(item, ft)};
   const StringX sep1{L' '}, sep2{L": "};
   StringXStream tmpStream;
   tmpStream << tag << L' ' << item.FieldName(ft) << L": " << fieldValue;
@@ -482,6 +490,67 @@ static void sidebyside_diff(const PWScore &core, const PWScore &otherCore,
   sbs_print<blank, field_to_line>(core, otherCore, comparison, comparedFields, cols, false);
 }
 
+//////////////////////////////////////////////
+// JSON Lines diff
+//////////
+static void jsonl_entry(JSONLWriter &writer, const wchar_t *change, const st_CompareData &cd)
+{
+  writer.BeginObject();
+  writer.Field(_T("change"), change);
+  writer.Field(CItemData::EngFieldName(CItem::GROUP), cd.group);
+  writer.Field(CItemData::EngFieldName(CItem::TITLE), cd.title);
+  writer.Field(CItemData::EngFieldName(CItem::USER), cd.user);
+}
+
+static void jsonl_unique_items(JSONLWriter &writer, const wchar_t *change,
+                               const CompareData &cd, const PWScore &core)
+{
+  for (const auto &d : cd) {
+    const CItemData &item = core.Find(d.indatabase == CURRENT ? d.uuid0 : d.uuid1)->second;
+    jsonl_entry(writer, change, d);
+    writer.BeginObject(_T("fields"));
+    for (auto ft : diff_fields) {
+      if (ft != CItem::GROUP && ft != CItem::TITLE && ft != CItem::USER &&
+          d.bsDiffs.test(ft) && !item.GetFieldValue(ft).empty())
+        writer.Field(CItemData::EngFieldName(ft), field_value(item, ft));
+    }
+    writer.EndObject();
+    writer.EndObject();
+  }
+}
+
+// An object per entry that's only in one safe, or differs between them,
+// with "change" being "removed", "added" or "changed" respectively
+static void jsonl_diff(const PWScore &core, const PWScore &otherCore,
+                       const CompareData &current, const CompareData &comparison,
+                       const CompareData &conflicts, std::wostream &os)
+{
+  JSONLWriter writer(os);
+
+  jsonl_unique_items(writer, L"removed", current, core);
+
+  for (const auto &cd : conflicts) {
+    const CItemData &item = core.Find(cd.uuid0)->second;
+    const CItemData &otherItem = otherCore.Find(cd.uuid1)->second;
+    if (cd.bsDiffs.count() == 1 && cd.bsDiffs.test(CItemData::POLICY) && have_empty_policies(item, otherItem))
+      continue;
+    jsonl_entry(writer, L"changed", cd);
+    writer.BeginObject(_T("fields"));
+    print_conflicting_item(item, otherItem, cd.bsDiffs,
+                           [&writer](const CItemData &item, const CItemData &otherItem,
+                                     const CItemData::FieldBits &, CItemData::FieldType ft) {
+      writer.BeginObject(CItemData::EngFieldName(ft));
+      writer.Field(_T("old"), field_value(item, ft));
+      writer.Field(_T("new"), field_value(otherItem, ft));
+      writer.EndObject();
+    });
+    writer.EndObject();
+    writer.EndObject();
+  }
+
+  jsonl_unique_items(writer, L"added", comparison, otherCore);
+}
+
 ///////////////////////////////////
 // dispatcher. Called from main()
 /////////
@@ -514,6 +583,12 @@ int Diff(PWScore &core, const UserArgs &ua)
                          conflicts,
                          identical);
 
+    if (ua.outputFmt == UserArgs::OutputFmt::JSONL) {
+      jsonl_diff(core, otherCore, current, comparison, conflicts, wcout);
+      otherCore.UnlockFile(otherSafe.c_str());
+      return status;
+    }
+
     switch (ua.dfmt) {
       case UserArgs::DiffFmt::Unified:
         unified_diff(core, otherCore, current, comparison, conflicts, identical);
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#include "./jsonl.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static wstring Quoted(const wstring &s)
+{
+  StringX out;
+  JSONLWriter::AppendString(out, s.c_str(), s.length());
+  return stringx2std(out);
+}
+
+TEST(JSONLTest, Strings)
+{
+  EXPECT_EQ(L"\"\"", Quoted(L""));
+  EXPECT_EQ(L"\"Bank \\\"Account\\\"\"", Quoted(L"Bank \"Account\""));
+  EXPECT_EQ(L"\"C:\\\\x\\nl2\\r\\tend\"", Quoted(L"C:\\x\nl2\r\tend"));
+  EXPECT_EQ(L"\"\\u0001\\u001f/\"", Quoted(L"\x01\x1f/"));
+  // e acute, euro sign, G clef: ASCII whatever the locale
+  EXPECT_EQ(L"\"\\u00e9\\u20ac\\ud834\\udd1e\"", Quoted(L"\u00e9\u20ac\U0001D11E"));
+}
+
+TEST(JSONLTest, Objects)
+{
+  wostringstream os;
+  {
+    JSONLWriter writer(os);
+    writer.BeginObject();
+    writer.Field(L"Title", L"t1");
+    writer.BeginObject(L"fields");
+    writer.BeginObject(L"Notes");
+    writer.Field(L"old", L"a");
+    writer.Field(L"new", L"b");
+    writer.EndObject();
+    writer.EndObject();
+    writer.EndObject();
+    writer.BeginObject();
+    writer.EndObject();
+    EXPECT_TRUE(os.str().empty()); // still buffered
+  }
+  EXPECT_EQ(L"{\"Title\":\"t1\",\"fields\":{\"Notes\":{\"old\":\"a\",\"new\":\"b\"}}}\n{}\n", os.str());
+}
+
+TEST(JSONLTest, WritesWhenBufferFull)
+{
+  wostringstream os;
+  JSONLWriter writer(os, 16);
+  writer.BeginObject();
+  writer.Field(L"k", L"v");
+  writer.EndObject();
+  EXPECT_TRUE(os.str().empty());
+  writer.BeginObject();
+  writer.Field(L"k", L"v");
+  writer.EndObject();
+  EXPECT_EQ(L"{\"k\":\"v\"}\n{\"k\":\"v\"}\n", os.str()); // whole lines only
+  writer.BeginObject();
+  writer.EndObject();
+  writer.Flush();
+  EXPECT_EQ(L"{\"k\":\"v\"}\n{\"k\":\"v\"}\n{}\n", os.str());
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#include "stdafx.h"
+#include "./jsonl.h"
+#include "../../core/Util.h"
+
+#include <cassert>
+#include <ostream>
+
+using namespace std;
+
+JSONLWriter::JSONLWriter(wostream &os, size_t bufsize)
+  : m_os(os), m_bufsize(bufsize)
+{
+  m_buf.reserve(bufsize + 1024);
+}
+
+JSONLWriter::~JSONLWriter()
+{
+  assert(m_first.empty());
+  Flush();
+}
+
+void JSONLWriter::BeginObject()
+{
+  assert(m_first.empty());
+  m_buf += '{';
+  m_first.push_back(true);
+}
+
+void JSONLWriter::BeginObject(const stringT &key)
+{
+  assert(!m_first.empty());
+  Key(key);
+  m_buf += '{';
+  m_first.push_back(true);
+}
+
+void JSONLWriter::EndObject()
+{
+  assert(!m_first.empty());
+  m_buf += '}';
+  m_first.pop_back();
+  if (m_first.empty()) {
+    m_buf += '\n';
+    if (m_buf.size() >= m_bufsize)
+      Flush();
+  }
+}
+
+void JSONLWriter::Field(const stringT &key, const StringX &value)
+{
+  Key(key);
+  AppendString(m_buf, value.c_str(), value.length());
+}
+
+void JSONLWriter::Flush()
+{
+  if (!m_buf.empty()) {
+    m_os.write(m_buf.data(), static_cast<streamsize>(m_buf.size()));
+    trashMemory(&m_buf[0], m_buf.size());
+    m_buf.clear();
+  }
+  m_os.flush();
+}
+
+void JSONLWriter::Key(const stringT &key)
+{
+  assert(!m_first.empty());
+  if (!m_first.back())
+    m_buf += ',';
+  m_first.back() = false;
+  AppendString(m_buf, key.c_str(), key.length());
+  m_buf += ':';
+}
+
+void JSONLWriter::AppendString(StringX &out, const wchar_t *s, size_t len)
+{
+  static const wchar_t hex[] = L"0123456789abcdef";
+  auto escape = [&out](unsigned long u) {
+    out += L"\\u";
+    for (int shift = 12; shift >= 0; shift -= 4)
+      out += hex[(u >> shift) & 0xF];
+  };
+
+  out += L'"';
+  for (size_t i = 0; i < len; i++) {
+    const unsigned long c = static_cast<unsigned long>(s[i]);
+    switch (c) {
+      case L'"':  out += L"\\\""; continue;
+      case L'\\': out += L"\\\\"; continue;
+      case L'\n': out += L"\\n"; continue;
+      case L'\r': out += L"\\r"; continue;
+      case L'\t': out += L"\\t"; continue;
+      default: break;
+    }
+    if (c >= 0x20 && c < 0x7F) {
+      out += static_cast<wchar_t>(c);
+    } else if (c < 0x10000) {
+      // Includes UTF-16 surrogates, where wchar_t is 16 bits, which are
+      // escaped as they are, pairs and all
+      escape(c);
+    } else if (c <= 0x10FFFF) {
+      escape(0xD800 + ((c - 0x10000) >> 10));
+      escape(0xDC00 + ((c - 0x10000) & 0x3FF));
+    } else {
+      escape(0xFFFD);
+    }
+  }
+  out += L'"';
+}
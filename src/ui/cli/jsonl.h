@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2003-2026 Rony Shapiro <ronys@pwsafe.org>.
+ * All rights reserved. Use of the code is allowed under the
+ * Artistic License 2.0 terms, as specified in the LICENSE file
+ * distributed with this code, or available from
+ * http://www.opensource.org/licenses/artistic-license-2.0.php
+ */
+
+#pragma once
+
+#include "../../core/StringX.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Writes JSON Lines, one object per line, for --format=jsonl.
+// It goes to a wide stream, like the rest of the CLI's output, as mixing
+// narrow and wide output to stdout doesn't work. Non-ASCII characters
+// are escaped, so the output is ASCII, and so UTF-8, whatever the locale.
+// Output is buffered and written in large chunks, not flushed line by line,
+// so it should be the only output to its stream until Flush().
+class JSONLWriter
+{
+public:
+  explicit JSONLWriter(std::wostream &os, size_t bufsize = 64 * 1024);
+  ~JSONLWriter(); // flushes
+
+  JSONLWriter(const JSONLWriter &) = delete;
+  JSONLWriter &operator=(const JSONLWriter &) = delete;
+
+  // An object is a line of its own, unless it's a field's value
+  void BeginObject();
+  void BeginObject(const stringT &key);
+  void EndObject();
+
+  void Field(const stringT &key, const StringX &value);
+
+  void Flush();
+
+  // Appends s to out as a quoted JSON string
+  static void AppendString(StringX &out, const wchar_t *s, size_t len);
+
+private:
+  void Key(const stringT &key);
+
+  std::wostream &m_os;
+  StringX m_buf; // holds field values, so wiped when done with
+  size_t m_bufsize;
+  std::vector<bool> m_first; // whether an object has no fields yet, innermost last
+};
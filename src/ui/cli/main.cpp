@@ -32,9 +32,14 @@
 #include "./safeutils.h"
 #include "./impexp.h"
 #include "./cli-version.h"
+#include "./daemon.h"
+#include "./batch.h"
 
 #include "core/PWScore.h"
+#include "core/PWSfile.h"
+#include "core/PWSTrace.h"
 #include "os/file.h"
+#include "os/utf8conv.h"
 #include "core/UTF8Conv.h"
 #include "core/Report.h"
 #include "core/XML/XMLDefs.h"
@@ -67,6 +72,14 @@ int SaveCore(PWScore &core, const UserArgs &);
 static int CreateNewSafe(PWScore &core, const StringX &filename, const StringX &passphrase, bool);
 static int Sync(PWScore &core, const UserArgs &ua);
 static int Merge(PWScore &core, const UserArgs &ua);
+static int Calibrate(PWScore &core, const UserArgs &ua);
+static int SaveAfterCalibrate(PWScore &core, const UserArgs &ua);
+static int EncryptFile(PWScore &core, const UserArgs &ua);
+static int DecryptFile(PWScore &core, const UserArgs &ua);
+static int RunBatch(PWScore &core, const UserArgs &ua);
+static int SaveAfterBatch(PWScore &core, const UserArgs &ua);
+static int RunDaemon(PWScore &core, const UserArgs &ua);
+static int ConnectToDaemon(int argc, char *argv[], const UserArgs &ua);
 
 //-----------------------------------------------------------------
 
@@ -75,6 +88,8 @@ using main_op_fn = function<int(PWScore &, const UserArgs &)>;
 using post_op_fn = function<int(PWScore &, const UserArgs &)>;
 
 auto null_op = [](PWScore &, const UserArgs &)-> int{ return PWScore::SUCCESS;};
+// for operations on files other than databases
+auto null_pre_op = [](PWScore &, const StringX &, const StringX &, bool)-> int{ return PWScore::SUCCESS;};
 
 struct pws_op {
   pre_op_fn pre_op;
@@ -92,6 +107,11 @@ const map<UserArgs::OpType, pws_op> pws_ops = {
   { UserArgs::Diff,       {OpenCore,        Diff,       null_op}},
   { UserArgs::Sync,       {OpenCore,        Sync,       SaveCore}},
   { UserArgs::Merge,      {OpenCore,        Merge,      SaveCore}},
+  { UserArgs::Calibrate,  {OpenCore,        Calibrate,  SaveAfterCalibrate}},
+  { UserArgs::Encrypt,    {null_pre_op,     EncryptFile, null_op}},
+  { UserArgs::Decrypt,    {null_pre_op,     DecryptFile, null_op}},
+  { UserArgs::Batch,      {OpenCore,        RunBatch,   SaveAfterBatch}},
+  { UserArgs::Daemon,     {OpenCore,        RunDaemon,  null_op}},
 };
 
 static wstring usage_string = LR"usagestring(
@@ -106,16 +126,26 @@ Usage: %PROGNAME% safe --imp[=file] --text|--xml
        %PROGNAME% safe --search=<text> [--ignore-case]
                       [--subset=<Field><OP><string>[/iI] [--fields=f1,f2,..]
                       [--delete | --update=Field1=Value1,Field2=Value2,.. | --print[=field1,field2...] ] [--yes]
-                      [--generate-totp]
+                      [--generate-totp] [--format=text|jsonl]
 
        %PROGNAME% safe --diff=<other-safe> [ --subset=<Field><OP><Value>[/iI] ]
                       [--fields=f1,f2,..] [--unified | --context | --sidebyside]
-                      [--colwidth=column-size]
+                      [--colwidth=column-size] [--format=text|jsonl]
 
        %PROGNAME% safe --synchronize=<other-safe> [ --subset=<Field><OP><string>[/iI] ] [ --fields=f1,f2,.. ] [--yes]
 
        %PROGNAME% safe --merge=<other-safe> [ --subset=<Field><OP><Value>[/iI] ] [--yes]
 
+       %PROGNAME% safe --calibrate[=milliseconds] [--yes]
+
+       %PROGNAME% file --encrypt | --decrypt [--threads=n] [--no-pipeline]
+
+       %PROGNAME% safe --batch=<file|-> [--yes] [--dry-run]
+
+       %PROGNAME% safe --daemon[=socket] [--idle-timeout=seconds]
+
+       %PROGNAME% safe <--search ... | --add ... | --diff ...> --connect[=socket]
+
                         where OP is one of ==, !==, ^= !^=, $=, !$=, ~=, !~=
                          = => exactly similar
                          ^ => begins with
@@ -129,6 +159,19 @@ Usage: %PROGNAME% safe --imp[=file] --text|--xml
        Note that --passphrase <passphrase> and --passphrase2 <2nd passphrase> may be used to skip the prompt
        for the master passphrase(s). However, this should be avoided if possible for security reasons.
 
+       --trace=<file> (or the PWS_TRACE environment variable) writes the time spent in reading, writing,
+       key stretching, searching etc. to <file>, which can be viewed with chrome://tracing or ui.perfetto.dev
+
+       --stats[=json] writes counts and timings of what the operation did (records and bytes read, time spent
+       key stretching, search latencies etc.) to stderr when it's done, as text or as JSON.
+
+       --format=jsonl prints search results (with --print) and diffs as JSON Lines: a JSON object per line,
+       for each entry found, or each entry that's only in one of the safes or differs between them.
+
+       --daemon keeps the safe open, serving --search, --add and --diff operations run with --connect, until
+       it's been idle for --idle-timeout seconds (300 by default, 0 for ever). The socket defaults to
+       $XDG_RUNTIME_DIR/pwsafe-cli.sock.
+
        Valid field names are:
        %FIELDNAMES%
 
@@ -203,6 +246,51 @@ static std::wstring help_delete_string = LR"helpstring(
           This deletes the found entry without asking for confirmation.
 )helpstring";
 
+static std::wstring help_calibrate_string = LR"helpstring(
+ Example: Calibrating key stretching
+
+            %PROGNAME% pwsafe.psafe3 --calibrate
+
+          This shows how long unlocking pwsafe.psafe3 takes on this machine, and how many hash
+          iterations would make it take about one second.
+
+            %PROGNAME% pwsafe.psafe3 --calibrate=500 --yes
+
+          This sets the number of hash iterations to what takes about half a second on this machine,
+          and saves the database.
+)helpstring";
+
+static std::wstring help_encrypt_string = LR"helpstring(
+ Example: Encrypting a file
+
+            %PROGNAME% report.pdf --encrypt
+
+          This encrypts report.pdf to report.pdf.PSF, as the "Encrypt file" menu item does, and
+          reports how fast this was.
+
+            %PROGNAME% report.pdf.PSF --decrypt --threads=4
+
+          This decrypts report.pdf.PSF back to report.pdf, with up to 4 threads. By default, one
+          per processor is used. With --no-pipeline, the file is read, en/decrypted and written a
+          few KB at a time instead, as by older versions, for comparison.
+)helpstring";
+
+static std::wstring help_batch_string = LR"helpstring(
+ Example: Running a batch of operations
+
+            %PROGNAME% pwsafe.psafe3 --batch=accounts.txt --yes
+
+          This runs the --add and --search operations in accounts.txt, one per line, saving the database
+          once they've all succeeded, and not at all otherwise. A line can be written as on the command
+          line, or as a JSON array of strings:
+
+            --add=Group=Email,Title=Yahoo,Username="Richard Miles"
+            ["--search=Richard Miles", "--update=Notes=Said \"call me Rick\""]
+
+          Lines starting with # are ignored. With --batch=-, the operations are read from stdin, and
+          --passphrase is needed. Changes need --yes, either with --batch or on their line.
+)helpstring";
+
 static std::wstring help_synchronize_string = LR"helpstring(
  Example: Synchronizing databases
 
@@ -217,6 +305,10 @@ const map<wstring, wstring> pws_help_examples = {
   { L"update",      help_update_string      },
   { L"search",      help_search_string      },
   { L"delete",      help_delete_string      },
+  { L"calibrate",   help_calibrate_string   },
+  { L"encrypt",     help_encrypt_string     },
+  { L"batch",       help_batch_string       },
+  { L"decrypt",     help_encrypt_string     },
   { L"sync",        help_synchronize_string },
   { L"synchronize", help_synchronize_string },
 };
@@ -325,7 +417,7 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
   }
 
   try {
-    static const char* short_options = "i::e::txcs:b:f:oa:u:p::rl:vyd:gjknz:m:w:P:Q:GVh::";
+    static const char* short_options = "i::e::txcs:b:f:oa:u:p::rl:vyd:gjknz:m:w:F:P:Q:GK::EDT:NR:S::B:X::C::I:Vh::";
     static constexpr struct option long_options[] = {
       // name,          has_arg,            flag,    val
       {"import",        optional_argument,  nullptr, 'i'},
@@ -352,9 +444,21 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
       {"synchronize",   required_argument,  nullptr, 'z'},
       {"merge",         required_argument,  nullptr, 'm'},
       {"colwidth",      required_argument,  nullptr, 'w'},
+      {"format",        required_argument,  nullptr, 'F'},
       {"passphrase",    required_argument,  nullptr, 'P'},
       {"passphrase2",   required_argument,  nullptr, 'Q'},
       {"generate-totp", no_argument,        nullptr, 'G'},
+      {"calibrate",     optional_argument,  nullptr, 'K'},
+      {"encrypt",       no_argument,        nullptr, 'E'},
+      {"decrypt",       no_argument,        nullptr, 'D'},
+      {"threads",       required_argument,  nullptr, 'T'},
+      {"no-pipeline",   no_argument,        nullptr, 'N'},
+      {"trace",         required_argument,  nullptr, 'R'},
+      {"stats",         optional_argument,  nullptr, 'S'},
+      {"batch",         required_argument,  nullptr, 'B'},
+      {"daemon",        optional_argument,  nullptr, 'X'},
+      {"connect",       optional_argument,  nullptr, 'C'},
+      {"idle-timeout",  required_argument,  nullptr, 'I'},
       {"verbose",       no_argument,        nullptr, 'V'},
       {"help",          optional_argument,  nullptr, 'h'},
       {nullptr,         0,                  nullptr,  0 }
@@ -491,6 +595,16 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
         ua.colwidth = atoi(optarg);
         break;
 
+      case 'F':
+        assert(optarg);
+        if (string(optarg) == "text")
+          ua.outputFmt = UserArgs::OutputFmt::Text;
+        else if (string(optarg) == "jsonl")
+          ua.outputFmt = UserArgs::OutputFmt::JSONL;
+        else
+          throw std::invalid_argument("Invalid output format: " + string(optarg));
+        break;
+
       case 'P':
         assert(optarg);
         Utf82StringX(optarg, ua.passphrase[0]);
@@ -505,6 +619,71 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
         ua.SearchAction = UserArgs::GenerateTotpCode;
         break;
 
+      case 'K':
+        ua.SetMainOp(UserArgs::Calibrate, optarg);
+        if (optarg && (ua.opArg.empty() || ua.opArg.find_first_not_of(L"0123456789") != wstring::npos ||
+                       ua.opArg.length() > 7 || stoul(ua.opArg) == 0))
+          throw std::invalid_argument("Invalid unlock time: " + string(optarg));
+        break;
+
+      case 'E':
+        ua.SetMainOp(UserArgs::Encrypt);
+        break;
+
+      case 'D':
+        ua.SetMainOp(UserArgs::Decrypt);
+        break;
+
+      case 'T':
+        assert(optarg);
+        ua.cryptOptions.nThreads = static_cast<unsigned>(atoi(optarg));
+        if (ua.cryptOptions.nThreads == 0)
+          throw std::invalid_argument("Invalid number of threads: " + string(optarg));
+        break;
+
+      case 'N':
+        ua.cryptOptions.bPipelined = false;
+        break;
+
+      case 'R':
+        assert(optarg);
+        ua.traceFile = Utf82wstring(optarg);
+        break;
+
+      case 'S':
+        if (optarg == nullptr)
+          ua.stats = UserArgs::StatsFmt::Text;
+        else if (string(optarg) == "json")
+          ua.stats = UserArgs::StatsFmt::JSON;
+        else
+          throw std::invalid_argument("Invalid stats format: " + string(optarg));
+        break;
+
+      case 'B':
+        assert(optarg);
+        ua.SetMainOp(UserArgs::Batch, optarg);
+        break;
+
+      case 'X':
+        ua.SetMainOp(UserArgs::Daemon);
+        if (optarg)
+          ua.socket = optarg;
+        break;
+
+      case 'C':
+        ua.connect = true;
+        ua.connectArgs.push_back(argv[optind - 1]); // optional argument, so always the last one taken
+        if (optarg)
+          ua.socket = optarg;
+        break;
+
+      case 'I':
+        assert(optarg);
+        if (string(optarg).find_first_not_of("0123456789") != string::npos || strlen(optarg) > 7)
+          throw std::invalid_argument("Invalid idle timeout: " + string(optarg));
+        ua.idleTimeout = static_cast<unsigned>(atoi(optarg));
+        break;
+
       case 'V':
         ua.verbosity_level++;
         break;
@@ -579,11 +758,35 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  if (ua.connect)
+    return ConnectToDaemon(argc, argv, ua);
+
+  if (ua.Operation == UserArgs::Daemon) {
+    // Requests may come from anywhere, and be relative to there
+    const string safe = CanonicalPath(pws_os::tomb(stringx2std(ua.safe)));
+    if (safe.empty()) {
+      wcerr << ua.safe << L" - file not found" << endl;
+      return 2;
+    }
+    Utf82StringX(safe.c_str(), ua.safe);
+  }
+
+  if (ua.Operation == UserArgs::Batch && ua.opArg == L"-" && ua.passphrase[0].empty()) {
+    wcerr << L"Use --passphrase with --batch=-, as stdin is the script" << endl;
+    return 1;
+  }
+
+  if (ua.traceFile.empty())
+    ua.traceFile = PWSTrace::EnableFromEnvironment();
+  else
+    PWSTrace::Enable(true);
+
   int status = 1;
   auto itr = pws_ops.find(ua.Operation);
 
   if (itr != pws_ops.end()) {
     const bool openReadOnly = ua.Operation == UserArgs::Export || ua.Operation == UserArgs::Diff ||
+                              ua.Operation == UserArgs::Encrypt || ua.Operation == UserArgs::Decrypt ||
                               (ua.Operation == UserArgs::Search && (ua.SearchAction == UserArgs::Print || ua.SearchAction == UserArgs::GenerateTotpCode));
     PWScore core;
     try {
@@ -601,6 +804,12 @@ int main(int argc, char *argv[])
 
     if (!openReadOnly) // unlock if locked by pre_op
       core.UnlockFile(ua.safe.c_str());
+    if (ua.stats == UserArgs::StatsFmt::Text)
+      wcerr << core.GetPerfStats();
+    else if (ua.stats == UserArgs::StatsFmt::JSON)
+      wcerr << Utf82wstring(core.GetPerfStatsJSON().c_str()); // stderr may be wide oriented already
+    if (!ua.traceFile.empty() && !PWSTrace::ExportChromeTrace(ua.traceFile))
+      wcerr << L"Couldn't write trace to " << ua.traceFile << endl;
     return status;
   }
   wcerr << L"No main operation specified" << endl;
@@ -671,3 +880,278 @@ int Merge(PWScore &core, const UserArgs &ua)
   }
   return status;
 }
+
+int Calibrate(PWScore &core, const UserArgs &ua)
+{
+  // ms, already checked by parseArgs
+  const unsigned targetMs = ua.opArg.empty() ? 1000 : static_cast<unsigned>(stoul(ua.opArg));
+
+  if (!core.UsesHashIters()) {
+    const PWSKDFParams &kdf = core.GetKDFParams();
+    wcout << L"Argon2id: " << kdf.tCost << L" passes, " << kdf.mCostKiB << L" KiB, "
+          << kdf.parallelism << L" lanes, unlock takes about "
+          << static_cast<unsigned>(core.GetUnlockTime() + 0.5) << L" ms here" << endl
+          << L"Calibration only sets PBKDF2 hash iterations, which don't apply to Argon2id:"
+          << L" nothing to change" << endl;
+    return PWScore::SUCCESS;
+  }
+
+  const uint32 curIters = core.GetHashIters();
+  wcout << L"Hash iterations: " << curIters << L", unlock takes about "
+        << static_cast<unsigned>(core.GetUnlockTime() + 0.5) << L" ms here" << endl;
+
+  const uint32 newIters = core.CalibrateHashIters(targetMs);
+  wcout << L"For about " << targetMs << L" ms: " << newIters << L" hash iterations" << endl;
+
+  if (ua.confirmed && newIters != curIters)
+    core.Execute(DBPrefsCommand::Create(&core, PWSprefs::GetInstance()->Store(), newIters));
+  else if (!ua.confirmed)
+    wcout << L"Use --yes to apply" << endl;
+  return PWScore::SUCCESS;
+}
+
+int SaveAfterCalibrate(PWScore &core, const UserArgs &ua)
+{
+  if (core.HasDBChanged())
+    return SaveCore(core, ua);
+  return PWScore::SUCCESS;
+}
+
+static void ReportThroughput(const wchar_t *what, const PWSfile::CryptStats &stats,
+                             const UserArgs &ua)
+{
+  const double MB = 1024.0 * 1024.0;
+  wcout << what << L" " << stats.nBytes << L" bytes in " << stats.dSeconds << L" s";
+  if (stats.dSeconds > 0)
+    wcout << L", " << static_cast<unsigned>(stats.nBytes / MB / stats.dSeconds + 0.5) << L" MB/s";
+  wcout << L" (" << (ua.cryptOptions.bPipelined ? L"pipelined, " : L"") << stats.nThreads
+        << (stats.nThreads == 1 ? L" thread" : L" threads") << L")" << endl;
+}
+
+int EncryptFile(PWScore &, const UserArgs &ua)
+{
+  const stringT fn = stringx2std(ua.safe);
+  if (!pws_os::FileExists(fn)) {
+    wcerr << fn << L" - file not found" << endl;
+    return 2;
+  }
+  const StringX passkey = ua.passphrase[0].empty() ? GetNewPassphrase() : ua.passphrase[0];
+
+  stringT errmess;
+  PWSfile::CryptStats stats;
+  if (!PWSfile::Encrypt(fn, passkey, errmess, ua.cryptOptions, &stats)) {
+    wcerr << L"Couldn't encrypt " << fn << L": " << errmess << endl;
+    return PWScore::FAILURE;
+  }
+  ReportThroughput(L"Encrypted", stats, ua);
+  return PWScore::SUCCESS;
+}
+
+int DecryptFile(PWScore &, const UserArgs &ua)
+{
+  const stringT fn = stringx2std(ua.safe);
+  const stringT suffix(L".PSF");
+  if (fn.length() <= suffix.length() ||
+      fn.compare(fn.length() - suffix.length(), suffix.length(), suffix) != 0) {
+    wcerr << fn << L" - only " << suffix << L" files can be decrypted" << endl;
+    return PWScore::FAILURE;
+  }
+  if (!pws_os::FileExists(fn)) {
+    wcerr << fn << L" - file not found" << endl;
+    return 2;
+  }
+  const StringX passkey = ua.passphrase[0].empty() ?
+    GetPassphrase(L"Enter Password [" + fn + L"]: ") : ua.passphrase[0];
+
+  stringT errmess;
+  PWSfile::CryptStats stats;
+  if (!PWSfile::Decrypt(fn, passkey, errmess, ua.cryptOptions, &stats)) {
+    wcerr << L"Couldn't decrypt " << fn << L": " << errmess << endl;
+    return PWScore::FAILURE;
+  }
+  ReportThroughput(L"Decrypted", stats, ua);
+  return PWScore::SUCCESS;
+}
+
+static void ResetGetopt()
+{
+#if defined(__GLIBC__) || defined(_WIN32)
+  optind = 0; // makes getopt_long start over
+#else
+  optreset = 1;
+  optind = 1;
+#endif
+}
+
+// Whether the operation would ask before changing entries
+static bool NeedsConfirmation(const UserArgs &ua)
+{
+  return ua.Operation == UserArgs::Search && !ua.confirmed &&
+         ua.SearchAction != UserArgs::Print && ua.SearchAction != UserArgs::GenerateTotpCode;
+}
+
+// Runs a request from a pwsafe-cli --connect on the daemon's open safe
+static int DaemonRequest(PWScore &core, const vector<string> &args)
+{
+  vector<string> arguments{"pwsafe-cli"};
+  arguments.insert(arguments.end(), args.begin(), args.end());
+  vector<char *> argv;
+  for (auto &arg : arguments)
+    argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+
+  UserArgs ua;
+  ResetGetopt();
+  if (!parseArgs(static_cast<int>(arguments.size()), argv.data(), ua))
+    return 1;
+
+  if (ua.Operation != UserArgs::Search && ua.Operation != UserArgs::Add &&
+      ua.Operation != UserArgs::Diff) {
+    wcerr << L"Only --search, --add and --diff can be run by the daemon" << endl;
+    return 1;
+  }
+  const string safe = CanonicalPath(pws_os::tomb(stringx2std(ua.safe)));
+  if (safe != pws_os::tomb(stringx2std(core.GetCurFile()))) {
+    wcerr << L"The daemon has " << core.GetCurFile() << L" open, not " << ua.safe << endl;
+    return 1;
+  }
+  // Nobody to ask
+  if (NeedsConfirmation(ua)) {
+    wcerr << L"Changes made by the daemon need --yes, as it can't ask for confirmation" << endl;
+    return 1;
+  }
+  if (ua.Operation == UserArgs::Diff && ua.passphrase[1].empty()) {
+    wcerr << L"The daemon can't prompt for the passphrase of " << ua.opArg
+          << L", use --passphrase2" << endl;
+    return 1;
+  }
+
+  const auto &op = pws_ops.at(ua.Operation);
+  int status = op.main_op(core, ua);
+  if (status == PWScore::SUCCESS)
+    status = op.post_op(core, ua);
+  if (ua.stats == UserArgs::StatsFmt::Text)
+    wcerr << core.GetPerfStats();
+  else if (ua.stats == UserArgs::StatsFmt::JSON)
+    wcerr << Utf82wstring(core.GetPerfStatsJSON().c_str());
+  return status;
+}
+
+int RunDaemon(PWScore &core, const UserArgs &ua)
+{
+  const string socket = ua.socket.empty() ? DefaultDaemonSocket() : ua.socket;
+  wcerr << L"Serving " << core.GetCurFile() << L" on " << Utf82wstring(socket.c_str()) << endl;
+
+  const int status = ServeDaemon(socket, ua.idleTimeout,
+                                 [&core](const vector<string> &args) {
+                                   return DaemonRequest(core, args);
+                                 });
+
+  // Whether idle or stopped, don't leave the keys in memory any longer
+  core.SafeUnlockCurFile();
+  core.ReInit();
+  wcerr << L"Daemon stopped" << endl;
+  return status;
+}
+
+int ConnectToDaemon(int argc, char *argv[], const UserArgs &ua)
+{
+  const vector<string> args = DaemonArgs(argc, argv, ua.connectArgs);
+
+  string out, err;
+  const int status = CallDaemon(ua.socket.empty() ? DefaultDaemonSocket() : ua.socket,
+                                args, out, err);
+  wcout << Utf82wstring(out.c_str()) << flush;
+  wcerr << Utf82wstring(err.c_str()) << flush;
+  return status;
+}
+
+static bool ReadLine(FILE *fd, string &line)
+{
+  line.clear();
+  int c;
+  while ((c = getc(fd)) != EOF && c != '\n')
+    line += static_cast<char>(c);
+  return c != EOF || !line.empty();
+}
+
+// Runs one line of a --batch script, where is its "file:line" for messages
+static int BatchOperation(PWScore &core, const UserArgs &batchArgs, const string &where,
+                          const vector<string> &args)
+{
+  // where goes in place of the safe, which getopt_long names in its errors
+  vector<string> arguments{"pwsafe-cli", where};
+  arguments.insert(arguments.end(), args.begin(), args.end());
+  vector<char *> argv;
+  for (auto &arg : arguments)
+    argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+
+  const wstring wwhere = Utf82wstring(where.c_str());
+  UserArgs ua;
+  ResetGetopt();
+  if (!parseArgs(static_cast<int>(arguments.size()), argv.data(), ua)) {
+    wcerr << wwhere << L": invalid operation" << endl;
+    return PWScore::FAILURE;
+  }
+  if (ua.Operation != UserArgs::Search && ua.Operation != UserArgs::Add) {
+    wcerr << wwhere << L": only --add and --search can be run in a batch" << endl;
+    return PWScore::FAILURE;
+  }
+  ua.safe = batchArgs.safe;
+  ua.confirmed = ua.confirmed || batchArgs.confirmed;
+  if (NeedsConfirmation(ua)) {
+    wcerr << wwhere << L": changes in a batch need --yes" << endl;
+    return PWScore::FAILURE;
+  }
+
+  const int status = pws_ops.at(ua.Operation).main_op(core, ua);
+  if (status != PWScore::SUCCESS)
+    wcerr << wwhere << L": failed (" << status_text(status) << L")" << endl;
+  return status;
+}
+
+// Runs the operations of a --batch script in turn on the open safe, each
+// seeing what those before it did. Stops at the first to fail, in which
+// case SaveAfterBatch isn't called, so the safe is left as it was.
+int RunBatch(PWScore &core, const UserArgs &ua)
+{
+  const bool bStdin = ua.opArg == L"-";
+  FILE *fd = bStdin ? stdin : pws_os::FOpen(ua.opArg, _T("rb"));
+  if (fd == nullptr) {
+    wcerr << L"Couldn't open " << ua.opArg << endl;
+    return 2;
+  }
+
+  const string name = bStdin ? string("stdin") : pws_os::tomb(ua.opArg);
+  int status = PWScore::SUCCESS;
+  unsigned int nLine = 0, nOps = 0;
+  string line;
+  while (status == PWScore::SUCCESS && ReadLine(fd, line)) {
+    const string where = name + ":" + to_string(++nLine);
+    vector<string> args;
+    string error;
+    if (!ParseBatchLine(line, args, error)) {
+      wcerr << Utf82wstring(where.c_str()) << L": " << Utf82wstring(error.c_str()) << endl;
+      status = PWScore::FAILURE;
+    } else if (!args.empty()) {
+      status = BatchOperation(core, ua, where, args);
+      nOps++;
+    }
+  }
+  if (!bStdin)
+    fclose(fd);
+
+  if (status != PWScore::SUCCESS)
+    wcerr << L"Nothing saved, as the batch didn't complete" << endl;
+  else if (ua.verbosity_level > 0)
+    wcerr << nOps << L" operations run" << endl;
+  return status;
+}
+
+int SaveAfterBatch(PWScore &core, const UserArgs &ua)
+{
+  if (core.HasDBChanged())
+    return SaveCore(core, ua);
+  return PWScore::SUCCESS;
+}
@@ -16,6 +16,7 @@ class PWScore;
 struct PWPolicy;
 
 int OpenCore(PWScore &core, const StringX &safe, const StringX &passphrase, bool openReadOnly = false);
+StringX GetPassphrase(const std::wstring &prompt);
 StringX GetNewPassphrase();
 
 int AddEntry(PWScore &core, const UserArgs &ua);
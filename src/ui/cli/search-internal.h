@@ -14,4 +14,5 @@
 class PWScore;
 struct UserArgs;
 
+// Results are printed to os, with --format=jsonl too
 int SearchInternal(PWScore &core, const UserArgs &ua, std::wostream &os);
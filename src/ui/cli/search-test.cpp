@@ -135,5 +135,24 @@ TEST_F(SearchTest, SearchAndChangePasswords) {
   EXPECT_NE( before, after );
 }
 
+TEST_F(SearchTest, SearchAndPrintJSONL) {
+  UserArgs ua;
+
+  ua.Operation = UserArgs::OpType::Search;
+  ua.opArg = L"SomeTitle";
+  ua.opArg2 = L"Notes,e-mail";
+  ua.outputFmt = UserArgs::OutputFmt::JSONL;
+
+  EXPECT_EQ( SearchInternal(core, ua, os), PWScore::SUCCESS );
+
+  EXPECT_EQ( os.str(), L"{\"Group\":\"Example.Group\",\"Title\":\"SomeTitle\",\"Username\":\"ExampleUser\","
+                       L"\"Notes\":\"Line1\\nLine2\\nLine3\",\"e-mail\":\"test@example.com\"}\n" );
+
+  ua.SearchAction = UserArgs::Delete;
+  ua.confirmed = true;
+  EXPECT_EQ( SearchInternal(core, ua, os), PWScore::FAILURE );
+  EXPECT_EQ( core.GetNumEntries(), 1u );
+}
+
 
 }  // namespace
@@ -14,6 +14,7 @@
 #include "./searchaction.h"
 #include "./search-internal.h"
 
+#include <iostream>
 #include <vector>
 #include <exception>
 #include <functional>
@@ -43,7 +44,7 @@ void SearchForEntries(PWScore &core, const wstring &searchText, bool ignoreCase,
                 core.GetEntryIter(), core.GetEntryEndIter(), get_second<ItemList>{},
                   [&cb](ItemListIter itr, bool *keep_going){
                   cb(itr->first, itr->second, keep_going);
-                });
+                }, core.GetSearchIndex());
 }
 
 int SaveAfterSearch(PWScore &core, const UserArgs &ua)
@@ -203,11 +204,20 @@ int Search(PWScore &core, const UserArgs &ua)
 
 int SearchInternal(PWScore &core, const UserArgs &ua, wostream &os)
 {
+  if (ua.outputFmt == UserArgs::OutputFmt::JSONL && ua.SearchAction != UserArgs::Print) {
+    wcerr << L"--format=jsonl is only for printing search results" << endl;
+    return PWScore::FAILURE;
+  }
+
   switch( ua.SearchAction) {
 
     case UserArgs::Print:
     {
       CItemData::FieldBits ftp = ParseFields(ua.opArg2);
+      if (ua.outputFmt == UserArgs::OutputFmt::JSONL)
+        return DoSearch<UserArgs::Print>(core, ua, [&core, &ftp, &os](const ItemPtrVec &matches) {
+          return PrintSearchResultsJSONL(matches, core, ftp, os);
+        });
       return DoSearch<UserArgs::Print>(core, ua, [&core, &ftp, &os](const ItemPtrVec &matches) {
         return PrintSearchResults(matches, core, ftp, os);
       });
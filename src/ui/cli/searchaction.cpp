@@ -12,6 +12,7 @@
 #include "./searchaction.h"
 #include "./strutils.h"
 #include "./safeutils.h"
+#include "./jsonl.h"
 
 #include "./argutils.h"
 
@@ -62,6 +63,22 @@ int PrintSearchResults(const ItemPtrVec &items, PWScore &, const CItemData::Fiel
   return PWScore::SUCCESS;
 }
 
+int PrintSearchResultsJSONL(const ItemPtrVec &items, PWScore &, const CItemData::FieldBits &ftp,
+                            std::wostream &os) {
+  JSONLWriter writer(os);
+  for (const CItemData *p : items) {
+    writer.BeginObject();
+    for (auto ft : {CItemData::GROUP, CItemData::TITLE, CItemData::USER})
+      writer.Field(p->EngFieldName(ft), p->GetFieldValue(ft));
+    for (auto ft : known_fields) {
+      if (ftp.test(ft) && ft != CItemData::GROUP && ft != CItemData::TITLE && ft != CItemData::USER)
+        writer.Field(p->EngFieldName(ft), p->GetFieldValue(ft));
+    }
+    writer.EndObject();
+  }
+  return PWScore::SUCCESS;
+}
+
 int DeleteSearchResults(const ItemPtrVec &items, PWScore &core)
 {
   if ( !items.empty() ) {
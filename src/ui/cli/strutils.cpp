@@ -42,6 +42,7 @@ const char *status_text(int status)
   case PWScore::SUCCESS: return "SUCCESS";
   case PWScore::FAILURE: return "FAILURE";
   case PWScore::CANT_OPEN_FILE: return "CANT_OPEN_FILE";
+  case PWScore::OUT_OF_MEMORY: return "OUT_OF_MEMORY";
   case PWScore::USER_CANCEL: return "USER_CANCEL";
   case PWScore::WRONG_PASSWORD: return "WRONG_PASSWORD";
   case PWScore::BAD_DIGEST: return "BAD_DIGEST";
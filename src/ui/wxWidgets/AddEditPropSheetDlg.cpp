@@ -1250,7 +1250,15 @@ void AddEditPropSheetDlg::ShowAttachmentData(const CItemAtt &itemAttachment)
   }
 
   // Get attachment's size - GetContentLength() returns original size, as opposed to GetContentSize(), which returns BlockSize()
-  m_AttachmentFileSize->SetLabel(wxString::Format(wxT("%u"), (unsigned int)itemAttachment.GetContentLength()));
+  // If compressed, also show how much is stored in the database
+  if (itemAttachment.GetStoredLength() != itemAttachment.GetContentLength()) {
+    m_AttachmentFileSize->SetLabel(wxString::Format(_("%u (%u compressed)"),
+                                   (unsigned int)itemAttachment.GetContentLength(),
+                                   (unsigned int)itemAttachment.GetStoredLength()));
+  }
+  else {
+    m_AttachmentFileSize->SetLabel(wxString::Format(wxT("%u"), (unsigned int)itemAttachment.GetContentLength()));
+  }
 
   // Get attachment's file creation date
   if (itemAttachment.GetFileCTime().empty()) {
@@ -3349,9 +3357,10 @@ Command* AddEditPropSheetDlg::NewEditEntryCommand()
         }
         else if (hasTitleChanges || hasAttachmentChanges) {
           // Step 2)
-          commands->Add(
-            EditAttachmentCommand::Create(&m_Core, itemAttachment, m_ItemAttachment)
-          );
+          // If other entries share the attachment, the entry gets an edited copy
+          auto *pcmd = EditAttachmentCommand::Create(&m_Core, itemAttachment, m_ItemAttachment, &m_Item);
+          commands->Add(pcmd);
+          m_Item.SetAttUUID(pcmd->GetAttUUID());
 
           // Note:
           // The item might also have modifications,
@@ -324,11 +324,32 @@ int PasswordSafeFrame::SaveImmediately()
   return Save(SaveType::IMMEDIATELY);
 }
 
+void PasswordSafeFrame::FinishAsyncSave()
+{
+  const auto rc = m_core.FinishAsyncSave();
+  const stringT bu_fname = m_AsyncSaveBackup;
+  m_AsyncSaveBackup.clear();
+
+  if (rc != PWScore::SUCCESS) { // Save failed!
+    // Restore backup, if we have one
+    if (!bu_fname.empty() && m_core.IsDbFileSet() &&
+        !pws_os::FileExists(m_core.GetCurFile().c_str()))
+      pws_os::RenameFile(bu_fname, m_core.GetCurFile().c_str());
+    // Show user that we have a problem
+    DisplayFileWriteError(rc, m_core.GetCurFile());
+  }
+
+  UpdateStatusBar();
+}
+
 int PasswordSafeFrame::Save(SaveType savetype /* = SaveType::INVALID*/)
 {
   stringT bu_fname; // used to undo backup if save failed
   PWSprefs *prefs = PWSprefs::GetInstance();
 
+  // Deal with any background save first, while m_AsyncSaveBackup is its own
+  FinishAsyncSave();
+
   // Save Application related preferences
   prefs->SaveApplicationPreferences();
   prefs->SaveShortcuts();
@@ -411,8 +432,17 @@ int PasswordSafeFrame::Save(SaveType savetype /* = SaveType::INVALID*/)
 
   // Note: Writing out in in V4 DB format if the DB is already V4,
   // otherwise as V3 (this include saving pre-3.0 DBs as a V3 DB!
-  auto rc = m_core.WriteFile(m_core.GetCurFile(),
-                             m_core.GetReadFileVersion() == PWSfile::V40 ? PWSfile::V40 : PWSfile::V30);
+  const PWSfile::VERSION version = m_core.GetReadFileVersion() == PWSfile::V40 ? PWSfile::V40 : PWSfile::V30;
+
+  // Saves after every change are done in the background, so as not to hold
+  // up the user. DatabaseSaved() picks up the result.
+  if (savetype == SaveType::IMMEDIATELY && version == m_core.GetReadFileVersion() &&
+      m_core.WriteFileAsync(m_core.GetCurFile(), version) == PWScore::SUCCESS) {
+    m_AsyncSaveBackup = bu_fname;
+    return PWScore::SUCCESS;
+  }
+
+  auto rc = m_core.WriteFile(m_core.GetCurFile(), version);
 
   if (rc != PWScore::SUCCESS) { // Save failed!
     // Restore backup, if we have one
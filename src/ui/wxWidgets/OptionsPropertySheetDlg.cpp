@@ -1102,7 +1102,7 @@ void OptionsPropertySheetDlg::PropSheetToPrefs()
   prefs->SetPref(PWSprefs::BackupPrefixValue, tostringx(buprefixValue));
   int suffixIndex = m_Backups_SuffixCB->GetCurrentSelection();
   prefs->SetPref(PWSprefs::BackupSuffix, suffixIndex);
-  if (suffixIndex == INC_SFX)
+  if (suffixIndex != NO_SFX)
     prefs->SetPref(PWSprefs::BackupMaxIncremented, m_Backups_MaxIncrSB->GetValue());
   wxString budirValue;
   if (m_Backups_UserDirRB->GetValue())
@@ -1266,7 +1266,8 @@ void OptionsPropertySheetDlg::OnSuffixCBSet(wxCommandEvent& WXUNUSED(evt))
   if (example.empty())
     example = wxT("pwsafe"); // XXXX get current file's basename!
 
-  m_Backups_MaxIncrSB->Enable(suffixIndex == INC_SFX);
+  // Both numbered and date-time backups are rotated
+  m_Backups_MaxIncrSB->Enable(suffixIndex != NO_SFX);
   switch (suffixIndex) {
   case NO_SFX:
     m_Backups_SuffixExampleST->SetLabel(wxEmptyString);
@@ -49,6 +49,7 @@
 #include "core/PWSLog.h"
 #include "core/PWSprefs.h"
 #include "core/PWSrand.h"
+#include "core/PWSTrace.h"
 #include "core/SysInfo.h"
 #include "core/PWSdirs.h"
 #include "wxUtilities.h"
@@ -313,6 +314,7 @@ bool PWSafeApp::OnInit()
   wxFileSystem::AddHandler(new wxArchiveFSHandler);
 
   SetAppName(pwsafeAppName);
+  m_traceFile = PWSTrace::EnableFromEnvironment();
   PWSprefs::SetReporter(&aReporter);
   PWScore::SetReporter(&aReporter);
   PWScore::SetAsker(&anAsker);
@@ -829,6 +831,8 @@ int PWSafeApp::OnExit()
     PWSMenuShortcuts::GetShortcutsManager()->SaveUserShortcuts();
     PWSMenuShortcuts::DestroyShortcutsManager();
   }
+  if (!m_traceFile.empty())
+    PWSTrace::ExportChromeTrace(m_traceFile);
 
 ////@begin PWSafeApp cleanup
   return wxApp::OnExit();
@@ -119,6 +119,7 @@ private:
   StringToStringMap &GetHelpMap();
   wxIconBundle m_appIcons;
   wxLocale *m_locale; // set in Init(), deleted in d'tor, unused elsewhere
+  stringT m_traceFile; // from PWS_TRACE, written on exit
   wxString helpFileNamePath;
   bool isHelpActivated;
   bool ActivateHelp(wxLanguage language);
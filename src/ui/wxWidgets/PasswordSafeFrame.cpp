@@ -32,6 +32,7 @@
 #include "core/PWScore.h"
 #include "core/PWSdirs.h"
 #include "core/PWSprefs.h"
+#include "core/PWSTrace.h"
 #include "core/XML/XMLDefs.h"  // Required if testing "USE_XML_LIBRARY"
 #include "os/file.h"
 #include "os/sleep.h"
@@ -469,6 +470,11 @@ void PasswordSafeFrame::Init()
   }
 
   m_RUEList.SetMax(PWSprefs::GetInstance()->GetPref(PWSprefs::MaxREItems));
+
+  // Incremental search runs on every keystroke - let the core narrow it down
+  m_core.SetSearchIndexEnabled(true);
+  // Hear of changes to the open file as they happen, so saving needn't re-read it
+  m_core.SetFileWatchEnabled(true);
 ////@begin PasswordSafeFrame member initialisation
   m_Toolbar = nullptr;
   m_Dragbar = nullptr;
@@ -1315,6 +1321,7 @@ void PasswordSafeFrame::ShowGrid(bool show)
       m_grid->SetDefaultCellFont(font);
     ItemListConstIter iter;
     int i;
+    PWSTrace::Span span(m_bFilterActive ? "Filter" : "ShowGrid");
     for (iter = m_core.GetEntryIter(), i = 0;
          iter != m_core.GetEntryEndIter();
          iter++) {
@@ -1322,6 +1329,7 @@ void PasswordSafeFrame::ShowGrid(bool show)
           m_FilterManager.PassesFiltering(iter->second, m_core))
         m_grid->AddItem(iter->second, i++);
     }
+    span.SetArg(i);
     
     m_grid->AutoSizeRows(); // Forces row height recalculation based on font size
     if(PWSprefs::GetInstance()->GetPref(PWSprefs::AutoAdjColWidth)) {
@@ -1371,6 +1379,7 @@ void PasswordSafeFrame::ShowTree(bool show)
     if (font.IsOk())
       m_tree->SetFont(font);
     ItemListConstIter iter;
+    PWSTrace::Span span(m_bFilterActive ? "Filter" : "ShowTree");
     for (iter = m_core.GetEntryIter();
          iter != m_core.GetEntryEndIter();
          iter++) {
@@ -1769,6 +1778,7 @@ void PasswordSafeFrame::UpdateAccessTime(CItemData &ci)
 
   if (!m_core.IsReadOnly() && bMaintainDateTimeStamps) {
     ci.SetATime();
+    m_core.RefreshEntryMetadata(ci);
     UpdateStatusBar();
   }
 }
@@ -2636,6 +2646,24 @@ void PasswordSafeFrame::DatabaseModified(bool modified)
   }
 }
 
+/**
+ * Implements Observer::DatabaseFileChanged()
+ */
+void PasswordSafeFrame::DatabaseFileChanged()
+{
+  // Called from the core's file watch thread
+  CallAfter(&PasswordSafeFrame::UpdateStatusBar);
+}
+
+/**
+ * Implements Observer::DatabaseSaved(const StringX &, int)
+ */
+void PasswordSafeFrame::DatabaseSaved(const StringX &WXUNUSED(filename), int WXUNUSED(status))
+{
+  // Called from the core's save thread
+  CallAfter(&PasswordSafeFrame::FinishAsyncSave);
+}
+
 /**
  * Implements Observer::UpdateGUI(UpdateGUICommand::GUI_Action, const pws_os::CUUID&, CItemData::FieldType)
  */
@@ -3070,6 +3098,7 @@ void PasswordSafeFrame::UpdateStatusBar()
 
     text  = m_core.HasDBChanged()       ? wxT("*") : wxT(" ");
     text += m_core.HaveDBPrefsChanged() ? wxT("°") : wxT(" ");
+    text += m_core.HasDBFileChangedExternally() ? wxT("!") : wxT(" ");
     m_statusBar->SetStatusText(text, StatusBar::Field::MODIFIED);
 
     text = m_core.IsReadOnly() ? wxT("R-O") : wxT("R/W");
@@ -258,6 +258,12 @@ public:
   /// Implements Observer::DatabaseModified(bool)
   void DatabaseModified(bool bChanged) override;
 
+  /// Implements Observer::DatabaseFileChanged()
+  void DatabaseFileChanged() override;
+
+  /// Implements Observer::DatabaseSaved(const StringX &, int)
+  void DatabaseSaved(const StringX &filename, int status) override;
+
   /// Implements Observer::UpdateGUI(UpdateGUICommand::GUI_Action, const pws_os::CUUID&, CItemData::FieldType)
   void UpdateGUI(UpdateGUICommand::GUI_Action ga, const pws_os::CUUID &entry_uuid, CItemData::FieldType ft = CItemData::START) override;
 
@@ -594,6 +600,7 @@ public:
   ItemListConstIter FindEntry(const pws_os::CUUID& uuid) const {return m_core.Find(uuid);}
   ItemListConstIter GetEntryIter() const {return m_core.GetEntryIter();}
   ItemListConstIter GetEntryEndIter() const {return m_core.GetEntryEndIter();}
+  const CSearchIndex *GetSearchIndex() const {return m_core.GetSearchIndex();}
 
   void Execute(Command *pcmd, PWScore *pcore = nullptr);
 
@@ -698,6 +705,7 @@ private:
   int SaveAs(void);
   int Save(SaveType savetype = SaveType::INVALID);
   int SaveImmediately();
+  void FinishAsyncSave();
   void ShowGrid(bool show = true);
   void ShowTree(bool show = true);
   void ClearAppData();
@@ -868,6 +876,8 @@ private:
   PWSFilters m_MapAllFilters;     // Includes DB and temporary (added, imported, autoloaded etc.)
   FilterPool m_currentfilterpool; // Filter pool of the current active filter
   stringT m_selectedfiltername;   // Is the selected active filter
+
+  stringT m_AsyncSaveBackup; // intermediate backup to restore if a background save fails
   
   enum {NONE, EXPIRY, UNSAVED, LASTFIND} m_CurrentPredefinedFilter;
   bool m_bFilterActive;
@@ -209,7 +209,7 @@ void PasswordSafeSearch::OnDoSearchT(Iter begin, Iter end, Accessor afn)
             afn(itr).GetUUID(uuid);
             m_searchPointer.Add(pws_os::CUUID(uuid));
             *keep_going = true;
-          }
+          }, m_parentFrame->GetSearchIndex()
        );
     }
 
@@ -697,7 +697,7 @@ void PasswordSafeSearch::FindMatches(const StringX& searchText, bool fCaseSensit
                        afn(itr).GetUUID(uuid);
                        searchPtr.Add(pws_os::CUUID(uuid));
                        *keep_going = true;
-                     });
+                     }, m_parentFrame->GetSearchIndex());
 }
 
 /////////////////////////////////////////////////
@@ -23,6 +23,7 @@
 
 ////@begin includes
 #include <wx/grid.h>
+#include <wx/numdlg.h>
 #include <wx/textdlg.h>
 ////@end includes
 
@@ -214,12 +215,48 @@ void PropertiesModel::Init()
   m_PropertiesDb.db_description = m_Core.GetHeader().m_DB_Description;
   m_View.SetDatabaseDescription(towxstring(m_PropertiesDb.db_description));
 
+  /////////////////////////////////////////////////////////////////////////////
+  // Property: Key stretching iterations
+
+  m_HashItersDb = m_HashItersNew = m_Core.GetHashIters();
+  m_View.SetHashIters(FormatHashIters());
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Performance counters, for support
+
+  m_PropertiesDb.perfstats = m_Core.GetPerfStats();
+  m_View.SetPerfStats(towxstring(m_PropertiesDb.perfstats));
+
   /////////////////////////////////////////////////////////////////////////////
   // All user operations are performed on the copy of the properties
 
   m_PropertiesNew = m_PropertiesDb;
 }
 
+bool PropertiesModel::CanCalibrate() const
+{
+  // Older versions don't store the number of iterations, and Argon2id
+  // doesn't use them
+  return m_Core.IsDbFileSet() && !m_Core.IsReadOnly() &&
+    m_Core.GetReadFileVersion() >= PWSfile::V30 && m_Core.UsesHashIters();
+}
+
+void PropertiesModel::Calibrate(unsigned targetMs)
+{
+  m_HashItersNew = m_Core.CalibrateHashIters(targetMs);
+}
+
+wxString PropertiesModel::FormatHashIters() const
+{
+  if (!m_Core.UsesHashIters()) {
+    const PWSKDFParams &kdf = m_Core.GetKDFParams();
+    return wxString::Format(_("Argon2id, %u passes, %u KiB"), kdf.tCost, kdf.mCostKiB);
+  }
+  if (!HasHashItersChanged())
+    return wxString::Format(_("%u iterations"), m_HashItersNew);
+  return wxString::Format(_("%u iterations (was %u)"), m_HashItersNew, m_HashItersDb);
+}
+
 /// Instructs the application to save the database properties
 /// if there are any changes.
 void PropertiesModel::Save()
@@ -246,6 +283,15 @@ void PropertiesModel::Save()
       );
     }
 
+    if (HasHashItersChanged()) {
+
+      multiCommands->Add(
+        DBPrefsCommand::Create(
+          &m_Core, PWSprefs::GetInstance()->Store(), GetHashIters()
+        )
+      );
+    }
+
     if (!multiCommands->IsEmpty()) {
       m_Core.Execute(multiCommands);
     }
@@ -272,6 +318,7 @@ BEGIN_EVENT_TABLE( PropertiesDlg, wxDialog )
   EVT_TEXT(   wxID_DBDESCRIPTION, PropertiesDlg::OnLabelOrDescriptionChanged )
   EVT_BUTTON( wxID_CLOSE,         PropertiesDlg::OnCloseClick                )
   EVT_BUTTON( wxID_SAVE,          PropertiesDlg::OnSaveClick                 )
+  EVT_BUTTON( ID_CALIBRATE,       PropertiesDlg::OnCalibrateClick            )
 ////@end PropertiesDlg event table entries
 
 END_EVENT_TABLE()
@@ -333,7 +380,7 @@ void PropertiesDlg::CreateControls()
 
   auto flexGridSizer = new wxFlexGridSizer(2 /*cols*/, 0 /*vgap*/, 0 /*hgap*/);
   flexGridSizer->AddGrowableCol(1);   // For second column with database properties
-  flexGridSizer->AddGrowableRow(12);  // For multiline description field
+  flexGridSizer->AddGrowableRow(13);  // For multiline description field
   mainSizer->Add(flexGridSizer, 1, wxALL|wxEXPAND, 12);
 
   auto itemStaticText5 = new wxStaticText( this, wxID_STATIC, _("Password Database:"), wxDefaultPosition, wxDefaultSize, 0 );
@@ -394,6 +441,19 @@ void PropertiesDlg::CreateControls()
   flexGridSizer->Add(itemStaticText13 , 0, wxALIGN_RIGHT|wxALL        , 5);
   flexGridSizer->Add(unknownFieldsText, 1, wxALIGN_LEFT|wxALL|wxEXPAND, 5);
 
+  auto itemStaticText18 = new wxStaticText( this, wxID_STATIC, _("Key stretching:"), wxDefaultPosition, wxDefaultSize, 0 );
+  auto hashItersSizer = new wxBoxSizer(wxHORIZONTAL);
+  m_hashItersText = new wxStaticText( this, wxID_HASHITERS, wxT("99999999 iterations (was 99999999)"), wxDefaultPosition, wxDefaultSize, 0 );
+  auto calibrateButton = new wxButton( this, ID_CALIBRATE, _("Calibrate..."), wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT );
+  calibrateButton->SetToolTip(_("Choose the number of iterations by how long unlocking should take on this computer"));
+  if (!m_core.UsesHashIters())
+    calibrateButton->SetToolTip(_("Calibration chooses a number of iterations, which Argon2id doesn't use"));
+  calibrateButton->Enable(m_Model->CanCalibrate());
+  hashItersSizer->Add(m_hashItersText, 1, wxALIGN_CENTER_VERTICAL|wxRIGHT, 5);
+  hashItersSizer->Add(calibrateButton, 0, wxALIGN_CENTER_VERTICAL, 0);
+  flexGridSizer->Add(itemStaticText18, 0, wxALIGN_RIGHT|wxALIGN_CENTER_VERTICAL|wxALL        , 5);
+  flexGridSizer->Add(hashItersSizer  , 1, wxALIGN_LEFT|wxALIGN_CENTER_VERTICAL|wxALL|wxEXPAND, 5);
+
   auto itemStaticText16 = new wxStaticText( this, wxID_STATIC, _("Label:"), wxDefaultPosition, wxDefaultSize, 0 );
   m_dbLabelTextCtrl = new wxTextCtrl( this, wxID_DBLABEL,
     wxEmptyString, wxDefaultPosition, wxDefaultSize,
@@ -410,6 +470,14 @@ void PropertiesDlg::CreateControls()
   flexGridSizer->Add(itemStaticText17       , 0, wxALIGN_RIGHT|wxALL        , 5);
   flexGridSizer->Add(m_dbDescriptionTextCtrl, 1, wxALIGN_LEFT|wxALL|wxEXPAND, 5);
 
+  auto itemStaticText19 = new wxStaticText( this, wxID_STATIC, _("Performance:"), wxDefaultPosition, wxDefaultSize, 0 );
+  auto perfStatsTextCtrl = new wxTextCtrl( this, wxID_PERFSTATS,
+    wxEmptyString, wxDefaultPosition, wxSize(-1, 80),
+    wxTE_READONLY|wxTE_MULTILINE|wxTE_DONTWRAP );
+  perfStatsTextCtrl->SetToolTip(_("Counts and timings of operations since Password Safe started, to help diagnose slow databases"));
+  flexGridSizer->Add(itemStaticText19 , 0, wxALIGN_RIGHT|wxALL        , 5);
+  flexGridSizer->Add(perfStatsTextCtrl, 1, wxALIGN_LEFT|wxALL|wxEXPAND, 5);
+
   auto buttonsSizer = new wxStdDialogButtonSizer;
   mainSizer->Add(buttonsSizer, 0, wxALIGN_CENTER_HORIZONTAL|wxALL, 5);
 
@@ -436,8 +504,10 @@ void PropertiesDlg::CreateControls()
   lastChangedPwdDateText->SetValidator( wxGenericValidator(& m_whenpwdlastchanged) );
   uuidText->SetValidator( wxGenericValidator(& m_file_uuid) );
   unknownFieldsText->SetValidator( wxGenericValidator(& m_unknownfields) );
+  m_hashItersText->SetValidator( wxGenericValidator(& m_hashiters) );
   m_dbLabelTextCtrl->SetValidator( wxGenericValidator(& m_DbLabel) );
   m_dbDescriptionTextCtrl->SetValidator( wxGenericValidator(& m_DbDescription) );
+  perfStatsTextCtrl->SetValidator( wxGenericValidator(& m_perfstats) );
 ////@end PropertiesDlg content construction
 }
 
@@ -525,3 +595,30 @@ void PropertiesDlg::OnLabelOrDescriptionChanged(wxCommandEvent& evt)
     m_Model->HasChanges()
   );
 }
+
+/*!
+ * wxEVT_COMMAND_BUTTON_CLICKED event handler for ID_CALIBRATE
+ */
+
+void PropertiesDlg::OnCalibrateClick(wxCommandEvent& WXUNUSED(evt))
+{
+  const long targetMs = wxGetNumberFromUser(
+    _("Key stretching makes guessing the master password slow, at the cost of\n"
+      "making unlocking the database slow too. Choose how long unlocking\n"
+      "should take on this computer, in milliseconds."),
+    _("Unlock time:"), _("Calibrate Key Stretching"), 1000, 100, 60000, this);
+
+  if (targetMs < 0) {
+    return; // cancelled
+  }
+
+  {
+    wxBusyCursor busy;
+    m_Model->Calibrate(static_cast<unsigned>(targetMs));
+  }
+
+  m_hashItersText->SetLabel(m_Model->FormatHashIters());
+  m_saveButton->Enable(
+    m_Model->HasChanges()
+  );
+}
@@ -49,6 +49,9 @@
 #define wxID_UNKNOWFIELDS 10073
 #define wxID_DBLABEL 10302
 #define wxID_DBDESCRIPTION 10303
+#define wxID_HASHITERS 10304
+#define ID_CALIBRATE 10305
+#define wxID_PERFSTATS 10306
 #if WXWIN_COMPATIBILITY_2_6
 #define SYMBOL_PROPERTIESDLG_STYLE wxCAPTION|wxRESIZE_BORDER|wxSYSTEM_MENU|wxCLOSE_BOX|wxDIALOG_MODAL|wxTAB_TRAVERSAL|wxFULL_REPAINT_ON_RESIZE
 #else
@@ -80,7 +83,10 @@ public:
   void Save();
 
   /// Checks for changes to all properties.
-  bool HasChanges() const { return m_PropertiesDb != m_PropertiesNew; }
+  bool HasChanges() const { return m_PropertiesDb != m_PropertiesNew || HasHashItersChanged(); }
+
+  /// Checks for changes to the number of key stretching iterations, only.
+  bool HasHashItersChanged() const { return m_HashItersDb != m_HashItersNew; }
 
   /// Checks for changes to the databse 'name' property, only.
   bool HasDatabaseNameChanged() const { return m_PropertiesDb.db_name != m_PropertiesNew.db_name; }
@@ -121,6 +127,19 @@ public:
   StringX GetDatabaseDescription() const { return m_PropertiesNew.db_description; }
   void SetDatabaseDescription(const wxString& value) { m_PropertiesNew.db_description = tostringx(value); }
 
+  uint32 GetHashIters() const { return m_HashItersNew; }
+  void SetHashIters(uint32 value) { m_HashItersNew = value; }
+
+  /// Whether the number of key stretching iterations can be changed.
+  bool CanCalibrate() const;
+
+  /// Benchmarks key stretching on this computer and sets the number of
+  /// iterations that makes unlocking take about targetMs.
+  void Calibrate(unsigned targetMs);
+
+  /// Describes the number of key stretching iterations.
+  wxString FormatHashIters() const;
+
 private:
   /// Represents the currently stored database properties.
   st_DBProperties m_PropertiesDb;
@@ -128,6 +147,10 @@ private:
   /// Represents new, resp. modified database properties.
   st_DBProperties m_PropertiesNew;
 
+  /// Key stretching iterations, stored resp. modified.
+  uint32 m_HashItersDb = 0;
+  uint32 m_HashItersNew = 0;
+
   /// The application's user interface.
   PropertiesDlg &m_View;
 
@@ -178,6 +201,9 @@ protected:
   /// wxEVT_TEXT event handler for wxID_DBLABEL and wxID_DBDESCRIPTION
   void OnLabelOrDescriptionChanged(wxCommandEvent& evt);
 
+  /// wxEVT_COMMAND_BUTTON_CLICKED event handler for ID_CALIBRATE
+  void OnCalibrateClick(wxCommandEvent& evt);
+
 ////@end PropertiesDlg event handler declarations
 public:
 ////@begin PropertiesDlg member function declarations
@@ -215,9 +241,13 @@ public:
   wxString GetUnknownFields() const { return m_unknownfields ; }
   void SetUnknownFields(const wxString& value) { m_unknownfields = value ; }
 
+  void SetHashIters(const wxString& value) { m_hashiters = value; }
+
   void SetDatabaseName(const wxString& value) { m_DbLabel = value; }
   void SetDatabaseDescription(const wxString& value) { m_DbDescription = value; }
 
+  void SetPerfStats(const wxString& value) { m_perfstats = value; }
+
   /// Retrieves bitmap resources
   wxBitmap GetBitmapResource( const wxString& name );
 
@@ -240,11 +270,14 @@ private:
   wxString m_whenpwdlastchanged;
   wxString m_file_uuid;
   wxString m_unknownfields;
+  wxString m_hashiters;
   wxString m_DbLabel;
   wxString m_DbDescription;
+  wxString m_perfstats;
 
   wxButton *m_saveButton = nullptr;
   wxButton *m_closeButton = nullptr;
+  wxStaticText *m_hashItersText = nullptr;
   wxTextCtrl *m_dbLabelTextCtrl = nullptr;
   wxTextCtrl *m_dbDescriptionTextCtrl = nullptr;
 